@@ -78,6 +78,29 @@ if(MSVC)
     endforeach()
 
     add_definitions(-DWIN32 -D_WINDOWS)
+else()
+    # The bool& of the Light and Material flags alias their uint32_t
+    set(CMAKE_CXX_FLAGS "-Wall -Wextra -fno-strict-aliasing")
+
+    set(CMAKE_CXX_STANDARD 17)
+
+    if(CMAKE_CXX_COMPILER_ID MATCHES Clang)
+        set(golden_sun_compiler_name "clang")
+        set(golden_sun_compiler_clang TRUE)
+    else()
+        set(golden_sun_compiler_name "gcc")
+        set(golden_sun_compiler_gcc TRUE)
+    endif()
+    string(REGEX MATCHALL "[0-9]+" cxx_version_components ${CMAKE_CXX_COMPILER_VERSION})
+    list(GET cxx_version_components 0 golden_sun_compiler_version)
+
+    set(CMAKE_CXX_FLAGS_RELEASE "${CMAKE_CXX_FLAGS_RELEASE} -DGOLDEN_SUN_SHIP")
+
+    set(CMAKE_CXX_VISIBILITY_PRESET hidden)
+    set(CMAKE_VISIBILITY_INLINES_HIDDEN ON)
+    set(CMAKE_POSITION_INDEPENDENT_CODE ON)
+
+    set(CMAKE_C_FLAGS ${CMAKE_CXX_FLAGS})
 endif()
 
 set(CMAKE_C_FLAGS_DEBUG ${CMAKE_CXX_FLAGS_DEBUG})
@@ -1,7 +1,12 @@
 #pragma once
 
+#ifdef _WIN32
 #define GOLDEN_SUN_SYMBOL_EXPORT __declspec(dllexport)
 #define GOLDEN_SUN_SYMBOL_IMPORT __declspec(dllimport)
+#else
+#define GOLDEN_SUN_SYMBOL_EXPORT __attribute__((visibility("default")))
+#define GOLDEN_SUN_SYMBOL_IMPORT
+#endif
 
 #define DISALLOW_COPY_AND_ASSIGN(ClassName)     \
     ClassName(ClassName const& other) = delete; \
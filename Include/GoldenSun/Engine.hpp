@@ -1,7 +1,8 @@
 #pragma once
 
 #include <DirectXMath.h>
-#include <dxgiformat.h>
+
+#include <GoldenSun/Format.hpp>
 
 struct ID3D12Device5;
 struct ID3D12CommandQueue;
@@ -17,9 +18,32 @@ namespace GoldenSun
     {
         DISALLOW_COPY_AND_ASSIGN(Engine)
 
+    public:
+        // How acceleration structures trade build time for trace time, the same as the PREFER_FAST_TRACE and PREFER_FAST_BUILD flags
+        enum class BuildPreference : uint32_t
+        {
+            FastTrace,
+            FastBuild,
+            // FastTrace, plus spatial splits for long thin triangles in the CPU renderer
+            FastTraceSpatialSplits,
+        };
+
+        // Where the CPU renderer keeps the scene on a machine with several NUMA nodes, such as a dual socket one
+        enum class Placement : uint32_t
+        {
+            // A copy of the acceleration structures on every node
+            Replicated,
+            // The pages of the acceleration structures spread over the nodes
+            Interleaved,
+        };
+
     public:
         Engine();
+#ifndef GOLDEN_SUN_HOST_ONLY
         Engine(ID3D12Device5* device, ID3D12CommandQueue* cmd_queue);
+#endif
+        // CPU reference renderer. No D3D12 device is needed. 0 means using all hardware threads.
+        explicit Engine(uint32_t num_threads);
         ~Engine() noexcept;
 
         Engine(Engine&& other) noexcept;
@@ -28,12 +52,47 @@ namespace GoldenSun
         void RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format);
         void RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format, DirectX::XMFLOAT4 const& bg_color);
         void Meshes(Mesh const* meshes, uint32_t num_meshes);
+        // FastBuild suits scenes that are rebuilt often, such as ones being edited
+        void Meshes(Mesh const* meshes, uint32_t num_meshes, BuildPreference build_preference);
         void Lights(PointLight const* lights, uint32_t num_lights);
         void Camera(Camera const& camera);
 
+        // Every Render adds one sample per pixel. Changing the target, camera, meshes or lights starts over. Off by default.
+        void Accumulation(bool enable);
+        // Samples per pixel in the output so far, of the pixel with the most
+        uint32_t SampleCount() const noexcept;
+        // A tile stops getting samples below error_threshold or at max_samples, 0 turns either off. The GPU renderer only caps.
+        void AdaptiveSampling(float error_threshold, uint32_t max_samples);
+        // No tile gets samples anymore, until a change restarts the accumulation
+        bool Converged() const noexcept;
+        // Picks the texture mips by ray cones, instead of the top mip. Needs the mip chains. Off by default.
+        void TextureLod(bool enable);
+
+        // The ones below only change the CPU renderer, the GPU renderer ignores them
+
+        // Filters the noise of the output, for previews at a few samples per pixel. Off by default.
+        void Denoise(bool enable);
+        // Diffuse bounces after the first hit. 0, the default, is direct lighting only.
+        void PathTracing(uint32_t max_bounces);
+        // Lights picked at random per shading point. 0, the default, shades every light that reaches it.
+        void LightSampling(uint32_t num_samples);
+        // Bytes of the textures read on demand that stay in memory. 0, the default, has no limit.
+        void TextureCacheBudget(uint64_t bytes);
+        // Lookups of textures read on demand that found them in memory, and the ones that had to read them
+        uint64_t TextureCacheHits() const noexcept;
+        uint64_t TextureCacheMisses() const noexcept;
+        // Where the scene lives on a machine with several NUMA nodes. Interleaved by default.
+        void ScenePlacement(Placement placement);
+        // Render only touches [left, right) x [top, bottom), rounded out to multiples of 8. The whole frame when empty.
+        void Scissor(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom);
+
+        // cmd_list is ignored, and can be nullptr, in the CPU renderer
         void Render(ID3D12GraphicsCommandList4* cmd_list);
 
+        // nullptr in the CPU renderer
         ID3D12Resource* Output() const noexcept;
+        // Rows of width * FormatSize(format) bytes written by the CPU renderer. nullptr in the GPU renderer.
+        void const* HostOutput() const noexcept;
 
     private:
         class Impl;
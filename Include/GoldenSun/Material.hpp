@@ -2,12 +2,30 @@
 
 #include <DirectXMath.h>
 
+#include <GoldenSun/Format.hpp>
+
 struct ID3D12Resource;
 
 namespace GoldenSun
 {
     class EngineInternal;
 
+    // Texels of a host texture that the CPU renderer reads the first time a ray hits it, instead of keeping every texture in memory.
+    // The texture cache may drop them later and read them again, see Engine::TextureCacheBudget.
+    class TextureSource
+    {
+    public:
+        virtual ~TextureSource() noexcept = default;
+
+        virtual uint32_t Width() const noexcept = 0;
+        virtual uint32_t Height() const noexcept = 0;
+        // 8-bit RGBA or BGRA, the same as the host textures in memory
+        virtual DXGI_FORMAT Format() const noexcept = 0;
+        // Writes Width() * Height() texels, row by row. Called from the rendering threads, one call at a time for each source. False
+        // if they can't be read, the slot then uses its default texture.
+        virtual bool Read(void* texels) = 0;
+    };
+
     class GOLDEN_SUN_API PbrMaterial final
     {
         friend class EngineInternal;
@@ -62,8 +80,14 @@ namespace GoldenSun
         float& OcclusionStrength() noexcept;
         float OcclusionStrength() const noexcept;
 
+#ifndef GOLDEN_SUN_HOST_ONLY
         void Texture(TextureSlot slot, ID3D12Resource* value) noexcept;
         ID3D12Resource* Texture(TextureSlot slot) const noexcept;
+#endif
+        // Texture in host memory, for the CPU renderer. Only 8-bit RGBA and BGRA formats are supported.
+        void Texture(TextureSlot slot, uint32_t width, uint32_t height, DXGI_FORMAT format, void const* data);
+        // Texture read on demand, for the CPU renderer. The material takes ownership of source, its clones share it.
+        void Texture(TextureSlot slot, TextureSource* source);
 
     private:
         class Impl;
@@ -1,8 +1,20 @@
 #pragma once
 
 #include <DirectXMath.h>
+
+#include <GoldenSun/Format.hpp>
+
+#ifdef GOLDEN_SUN_HOST_ONLY
+// The values of d3d12.h, like DXGI_FORMAT in Format.hpp
+enum D3D12_RAYTRACING_GEOMETRY_FLAGS
+{
+    D3D12_RAYTRACING_GEOMETRY_FLAG_NONE = 0,
+    D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE = 0x1,
+    D3D12_RAYTRACING_GEOMETRY_FLAG_NO_DUPLICATE_ANYHIT_INVOCATION = 0x2,
+};
+#else
 #include <d3d12.h>
-#include <dxgiformat.h>
+#endif
 
 struct ID3D12Resource;
 
@@ -49,16 +61,27 @@ namespace GoldenSun
         PbrMaterial& Material(uint32_t material_id) noexcept;
         PbrMaterial const& Material(uint32_t material_id) const noexcept;
 
+#ifndef GOLDEN_SUN_HOST_ONLY
         // TODO #17: Support adding a region of buffers as a primitive
         uint32_t AddPrimitive(ID3D12Resource* vb, ID3D12Resource* ib, uint32_t material_id);
         uint32_t AddPrimitive(ID3D12Resource* vb, ID3D12Resource* ib, uint32_t material_id, D3D12_RAYTRACING_GEOMETRY_FLAGS flags);
+#endif
+        // Primitives in host memory, for the CPU renderer. The mesh must use Vertex and Index layout.
+        uint32_t AddPrimitive(
+            Vertex const* vertices, uint32_t num_vertices, Index const* indices, uint32_t num_indices, uint32_t material_id);
+        uint32_t AddPrimitive(Vertex const* vertices, uint32_t num_vertices, Index const* indices, uint32_t num_indices,
+            uint32_t material_id, D3D12_RAYTRACING_GEOMETRY_FLAGS flags);
 
         uint32_t NumPrimitives() const noexcept;
 
         uint32_t NumVertices(uint32_t primitive_id) const noexcept;
+#ifndef GOLDEN_SUN_HOST_ONLY
         ID3D12Resource* VertexBuffer(uint32_t primitive_id) const noexcept;
+#endif
         uint32_t NumIndices(uint32_t primitive_id) const noexcept;
+#ifndef GOLDEN_SUN_HOST_ONLY
         ID3D12Resource* IndexBuffer(uint32_t primitive_id) const noexcept;
+#endif
 
         void MaterialId(uint32_t primitive_id, uint32_t id) noexcept;
         uint32_t MaterialId(uint32_t primitive_id) const noexcept;
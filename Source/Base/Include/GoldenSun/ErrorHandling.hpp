@@ -6,9 +6,11 @@
 namespace GoldenSun
 {
     std::string CombineFileLine(std::string_view file, uint32_t line);
-    std::string CombineFileLine(HRESULT hr, std::string_view file, uint32_t line);
     void Verify(bool value);
 
+#ifndef GOLDEN_SUN_HOST_ONLY
+    std::string CombineFileLine(HRESULT hr, std::string_view file, uint32_t line);
+
     class HrException : public std::runtime_error
     {
     public:
@@ -25,9 +27,11 @@ namespace GoldenSun
     private:
         HRESULT const hr_;
     };
+#endif
 } // namespace GoldenSun
 
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #define TIFHR(hr)                                                 \
     {                                                             \
         if (FAILED(hr))                                           \
@@ -35,3 +39,4 @@ namespace GoldenSun
             throw GoldenSun::HrException(hr, __FILE__, __LINE__); \
         }                                                         \
     }
+#endif
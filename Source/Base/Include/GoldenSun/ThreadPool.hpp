@@ -0,0 +1,49 @@
+#pragma once
+
+#include <GoldenSun/ImplPtr.hpp>
+
+#include <cstdint>
+#include <functional>
+
+namespace GoldenSun
+{
+    class ThreadPool final
+    {
+        DISALLOW_COPY_AND_ASSIGN(ThreadPool)
+
+    public:
+        // 0 means one thread per hardware thread, in every processor group. The calling thread of ParallelFor counts as one of them.
+        // On a machine with several NUMA nodes, the threads are spread over the nodes in consecutive runs, and each worker is pinned
+        // to the processors of its node. The calling thread is never pinned, it counts as being on node 0.
+        explicit ThreadPool(uint32_t num_threads = 0);
+        ~ThreadPool() noexcept;
+
+        ThreadPool(ThreadPool&& other) noexcept;
+        ThreadPool& operator=(ThreadPool&& other) noexcept;
+
+        uint32_t NumThreads() const noexcept;
+
+        // NUMA nodes that have threads of the pool. 1 on a machine without NUMA, or when there are fewer threads than nodes.
+        uint32_t NumNodes() const noexcept;
+        // Node of a thread, in [0, NumNodes()). Non-decreasing in thread_index.
+        uint32_t Node(uint32_t thread_index) const noexcept;
+        // Number of a node as the OS knows it, for VirtualAllocExNuma and friends
+        uint32_t NodeNumber(uint32_t node) const noexcept;
+        // Node of the calling thread, while it runs a ParallelFor of any pool. 0 otherwise.
+        static uint32_t CurrentNode() noexcept;
+
+        // Calls func(index, thread_index) for every index in [0, count) and blocks until all of them are done. thread_index is in
+        // [0, NumThreads()) and is stable for the duration of one call, so it can be used to address per-thread scratch data.
+        // The first exception thrown by func is rethrown on the calling thread.
+        // A call from inside func to the same pool runs inline, with the thread_index of the caller. A call from inside a ParallelFor
+        // of another pool is like one from any other thread.
+        // Every thread starts on its own contiguous block of indices, and steals the back half of another block once its own is
+        // done, from a thread of its own node first. Nothing about which thread runs an index, or in which order, is stable from call
+        // to call. But the blocks are in thread order, so the first ones of the range start on node 0, the last ones on the last node.
+        void ParallelFor(uint32_t count, std::function<void(uint32_t index, uint32_t thread_index)> const& func);
+
+    private:
+        class Impl;
+        ImplPtr<Impl> impl_;
+    };
+} // namespace GoldenSun
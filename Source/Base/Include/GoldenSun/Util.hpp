@@ -1,8 +1,19 @@
 #pragma once
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <d3d12.h>
+#endif
+
+#include <cstdint>
+#include <string>
+
+#include <GoldenSun/Format.hpp>
 
+#ifdef _MSC_VER
 #define GOLDEN_SUN_UNREACHABLE(msg) __assume(false)
+#else
+#define GOLDEN_SUN_UNREACHABLE(msg) __builtin_unreachable()
+#endif
 
 #if __cpp_lib_to_underlying < 202102L
 #include <type_traits>
@@ -35,6 +46,7 @@ namespace GoldenSun
     bool IsSrgbFormat(DXGI_FORMAT fmt) noexcept;
     uint32_t FormatSize(DXGI_FORMAT fmt) noexcept;
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     D3D12_ROOT_PARAMETER CreateRootParameterAsDescriptorTable(const D3D12_DESCRIPTOR_RANGE* descriptor_ranges,
         uint32_t num_descriptor_ranges, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL) noexcept;
     D3D12_ROOT_PARAMETER CreateRootParameterAsShaderResourceView(
@@ -43,4 +55,5 @@ namespace GoldenSun
         uint32_t shader_register, uint32_t register_space = 0, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL) noexcept;
     D3D12_ROOT_PARAMETER CreateRootParameterAsConstants(uint32_t num_32bit_values, uint32_t shader_register, uint32_t register_space = 0,
         D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL) noexcept;
+#endif
 } // namespace GoldenSun
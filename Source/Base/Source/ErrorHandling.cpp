@@ -12,6 +12,7 @@ namespace GoldenSun
         return ss.str();
     }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     std::string CombineFileLine(HRESULT hr, std::string_view file, uint32_t line)
     {
         std::ostringstream ss;
@@ -19,6 +20,7 @@ namespace GoldenSun
         ss << CombineFileLine(std::move(file), line);
         return ss.str();
     }
+#endif
 
     void Verify(bool x)
     {
@@ -0,0 +1,506 @@
+#include "pch.hpp"
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "ImplPtrImpl.hpp"
+
+namespace
+{
+    // Impl of the pool whose ParallelFor the current thread is running, nullptr outside of any. Only compared, never dereferenced.
+    thread_local void const* tls_pool = nullptr;
+    // Index of the current thread inside that pool, or ~0U outside of any ParallelFor.
+    thread_local uint32_t tls_thread_index = ~0U;
+    // NUMA node of the current thread inside that pool
+    thread_local uint32_t tls_node = 0;
+
+#ifdef _WIN32
+    struct NumaNode
+    {
+        uint32_t number;
+        GROUP_AFFINITY affinity;
+    };
+
+    // Nodes with processors, in the order of their numbers
+    std::vector<NumaNode> NumaNodes()
+    {
+        std::vector<NumaNode> nodes;
+
+        ULONG highest_node;
+        if (GetNumaHighestNodeNumber(&highest_node))
+        {
+            for (ULONG number = 0; number <= highest_node; ++number)
+            {
+                GROUP_AFFINITY affinity{};
+                if (GetNumaNodeProcessorMaskEx(static_cast<USHORT>(number), &affinity) && (affinity.Mask != 0))
+                {
+                    nodes.push_back({static_cast<uint32_t>(number), affinity});
+                }
+            }
+        }
+
+        return nodes;
+    }
+
+    uint32_t NumProcessors()
+    {
+        // hardware_concurrency only counts the processor group of the process on some versions of Windows
+        return static_cast<uint32_t>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+    }
+
+    void PinCurrentThread(NumaNode const& node)
+    {
+        SetThreadGroupAffinity(GetCurrentThread(), &node.affinity, nullptr);
+    }
+#else
+    struct NumaNode
+    {
+        uint32_t number;
+        cpu_set_t affinity;
+    };
+
+    // Nodes with processors, in the order of their numbers. Empty without sysfs, where the pool runs as if on one node.
+    std::vector<NumaNode> NumaNodes()
+    {
+        std::vector<NumaNode> nodes;
+
+        std::error_code ec;
+        for (auto const& entry : std::filesystem::directory_iterator("/sys/devices/system/node", ec))
+        {
+            std::string const name = entry.path().filename().string();
+            if ((name.size() <= 4) || (name.compare(0, 4, "node") != 0) ||
+                (name.find_first_not_of("0123456789", 4) != std::string::npos))
+            {
+                continue;
+            }
+
+            NumaNode node;
+            node.number = static_cast<uint32_t>(std::stoul(name.substr(4)));
+            CPU_ZERO(&node.affinity);
+
+            // A list of ranges, like "0-7,16-23"
+            std::ifstream cpulist(entry.path() / "cpulist");
+            std::string range;
+            while (std::getline(cpulist, range, ','))
+            {
+                if (range.empty() || (range[0] < '0') || (range[0] > '9'))
+                {
+                    continue;
+                }
+
+                size_t const dash = range.find('-');
+                uint32_t const first = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+                uint32_t const last = dash == std::string::npos ? first : static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+                for (uint32_t cpu = first; (cpu <= last) && (cpu < CPU_SETSIZE); ++cpu)
+                {
+                    CPU_SET(cpu, &node.affinity);
+                }
+            }
+
+            if (CPU_COUNT(&node.affinity) != 0)
+            {
+                nodes.push_back(node);
+            }
+        }
+
+        std::sort(nodes.begin(), nodes.end(), [](NumaNode const& lhs, NumaNode const& rhs) { return lhs.number < rhs.number; });
+        return nodes;
+    }
+
+    uint32_t NumProcessors()
+    {
+        return std::thread::hardware_concurrency();
+    }
+
+    void PinCurrentThread(NumaNode const& node)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(node.affinity), &node.affinity);
+    }
+#endif
+
+    // [begin, end) of the indices a thread has left, packed so that either end can be taken with one compare-and-swap
+    uint64_t PackRange(uint32_t begin, uint32_t end) noexcept
+    {
+        return (static_cast<uint64_t>(end) << 32) | begin;
+    }
+
+    void UnpackRange(uint64_t range, uint32_t& begin, uint32_t& end) noexcept
+    {
+        begin = static_cast<uint32_t>(range);
+        end = static_cast<uint32_t>(range >> 32);
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    class ThreadPool::Impl final
+    {
+        DISALLOW_COPY_AND_ASSIGN(Impl)
+        DISALLOW_COPY_MOVE_AND_ASSIGN(Impl)
+
+    public:
+        explicit Impl(uint32_t num_threads)
+        {
+            if (num_threads == 0)
+            {
+                num_threads = std::max(NumProcessors(), 1U);
+            }
+
+            ranges_ = std::make_unique<WorkRange[]>(num_threads);
+
+            // Consecutive threads share a node, so the contiguous blocks of ParallelFor that start on one node are consecutive too
+            nodes_ = NumaNodes();
+            uint32_t const num_nodes = std::clamp(static_cast<uint32_t>(nodes_.size()), 1U, num_threads);
+            nodes_.resize(num_nodes == 1 ? 0 : num_nodes);
+            thread_nodes_.resize(num_threads);
+            for (uint32_t i = 0; i < num_threads; ++i)
+            {
+                thread_nodes_[i] = static_cast<uint32_t>(static_cast<uint64_t>(i) * num_nodes / num_threads);
+            }
+
+            workers_.reserve(num_threads - 1);
+            for (uint32_t i = 1; i < num_threads; ++i)
+            {
+                workers_.emplace_back([this, i] { this->WorkerLoop(i); });
+            }
+        }
+
+        ~Impl() noexcept
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            work_cv_.notify_all();
+
+            for (auto& worker : workers_)
+            {
+                worker.join();
+            }
+        }
+
+        uint32_t NumThreads() const noexcept
+        {
+            return static_cast<uint32_t>(workers_.size() + 1);
+        }
+
+        uint32_t NumNodes() const noexcept
+        {
+            return std::max(static_cast<uint32_t>(nodes_.size()), 1U);
+        }
+
+        uint32_t Node(uint32_t thread_index) const noexcept
+        {
+            return thread_nodes_[thread_index];
+        }
+
+        uint32_t NodeNumber(uint32_t node) const noexcept
+        {
+            return nodes_.empty() ? 0 : nodes_[node].number;
+        }
+
+        void ParallelFor(uint32_t count, std::function<void(uint32_t index, uint32_t thread_index)> const& func)
+        {
+            if (count == 0)
+            {
+                return;
+            }
+
+            // Nested or single-item loops don't pay for a round trip through the workers. Only a call from inside a ParallelFor of this
+            // pool is nested. A thread of another pool has an index of that pool, so it calls in like any other thread.
+            if (tls_pool == this)
+            {
+                uint32_t const thread_index = tls_thread_index;
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    func(i, thread_index);
+                }
+                return;
+            }
+
+            std::lock_guard<std::mutex> call_lock(call_mutex_);
+
+            if (workers_.empty() || (count == 1))
+            {
+                CurrentThreadScope scope(*this, 0);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    func(i, 0);
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                func_ = &func;
+                // Contiguous blocks, so neighboring indices, often touching neighboring data, run on the same thread
+                uint32_t const num_threads = this->NumThreads();
+                for (uint32_t i = 0; i < num_threads; ++i)
+                {
+                    ranges_[i].range.store(PackRange(static_cast<uint32_t>(static_cast<uint64_t>(count) * i / num_threads),
+                                               static_cast<uint32_t>(static_cast<uint64_t>(count) * (i + 1) / num_threads)),
+                        std::memory_order_relaxed);
+                }
+                cancelled_.store(false, std::memory_order_relaxed);
+                num_active_workers_ = static_cast<uint32_t>(workers_.size());
+                exception_ = nullptr;
+                ++generation_;
+            }
+            work_cv_.notify_all();
+
+            this->Run(0);
+
+            std::exception_ptr exception;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                done_cv_.wait(lock, [this] { return num_active_workers_ == 0; });
+
+                func_ = nullptr;
+                exception = std::move(exception_);
+                exception_ = nullptr;
+            }
+
+            if (exception)
+            {
+                std::rethrow_exception(exception);
+            }
+        }
+
+    private:
+        // Makes the current thread thread_index of this pool, and puts back what it was before on destruction. The calling thread of
+        // a ParallelFor can be running a ParallelFor of another pool.
+        class CurrentThreadScope final
+        {
+            DISALLOW_COPY_AND_ASSIGN(CurrentThreadScope)
+
+        public:
+            CurrentThreadScope(Impl const& pool, uint32_t thread_index) noexcept
+                : outer_pool_(tls_pool), outer_thread_index_(tls_thread_index), outer_node_(tls_node)
+            {
+                tls_pool = &pool;
+                tls_thread_index = thread_index;
+                tls_node = pool.thread_nodes_[thread_index];
+            }
+
+            ~CurrentThreadScope() noexcept
+            {
+                tls_pool = outer_pool_;
+                tls_thread_index = outer_thread_index_;
+                tls_node = outer_node_;
+            }
+
+        private:
+            void const* outer_pool_;
+            uint32_t outer_thread_index_;
+            uint32_t outer_node_;
+        };
+
+    private:
+        void WorkerLoop(uint32_t thread_index)
+        {
+            // Pages a pinned thread touches first come from its node, and the scheduler can't move it away from the data it placed
+            if (!nodes_.empty())
+            {
+                PinCurrentThread(nodes_[thread_nodes_[thread_index]]);
+            }
+
+            uint64_t seen_generation = 0;
+            for (;;)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    work_cv_.wait(lock, [this, seen_generation] { return stop_ || (generation_ != seen_generation); });
+                    if (stop_)
+                    {
+                        return;
+                    }
+                    seen_generation = generation_;
+                }
+
+                this->Run(thread_index);
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    --num_active_workers_;
+                    if (num_active_workers_ == 0)
+                    {
+                        done_cv_.notify_one();
+                    }
+                }
+            }
+        }
+
+        void Run(uint32_t thread_index)
+        {
+            CurrentThreadScope scope(*this, thread_index);
+
+            uint32_t index;
+            while (!cancelled_.load(std::memory_order_relaxed) && (this->PopFront(thread_index, index) || this->Steal(thread_index, index)))
+            {
+                try
+                {
+                    (*func_)(index, thread_index);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (!exception_)
+                    {
+                        exception_ = std::current_exception();
+                    }
+                    cancelled_.store(true, std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool PopFront(uint32_t thread_index, uint32_t& index) noexcept
+        {
+            auto& range = ranges_[thread_index].range;
+            uint64_t packed = range.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                uint32_t begin;
+                uint32_t end;
+                UnpackRange(packed, begin, end);
+                if (begin >= end)
+                {
+                    return false;
+                }
+                if (range.compare_exchange_weak(packed, PackRange(begin + 1, end), std::memory_order_relaxed))
+                {
+                    index = begin;
+                    return true;
+                }
+            }
+        }
+
+        // Takes the back half of the first other thread with indices left, starting from the next thread, and trying the threads of
+        // the same node before the others. A thread only steals once its own range is empty, so it can overwrite it with the rest of
+        // the stolen half.
+        bool Steal(uint32_t thread_index, uint32_t& index) noexcept
+        {
+            uint32_t const num_threads = this->NumThreads();
+            uint32_t const node = thread_nodes_[thread_index];
+            for (bool const same_node : {true, false})
+            {
+                for (uint32_t i = 1; i < num_threads; ++i)
+                {
+                    uint32_t const victim = (thread_index + i) % num_threads;
+                    if (((thread_nodes_[victim] == node) == same_node) && this->StealFrom(victim, thread_index, index))
+                    {
+                        return true;
+                    }
+                }
+                if (nodes_.empty())
+                {
+                    break;
+                }
+            }
+            return false;
+        }
+
+        bool StealFrom(uint32_t victim, uint32_t thread_index, uint32_t& index) noexcept
+        {
+            auto& victim_range = ranges_[victim].range;
+            uint64_t packed = victim_range.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                uint32_t begin;
+                uint32_t end;
+                UnpackRange(packed, begin, end);
+                if (begin >= end)
+                {
+                    return false;
+                }
+
+                uint32_t const mid = end - (end - begin + 1) / 2;
+                if (victim_range.compare_exchange_weak(packed, PackRange(begin, mid), std::memory_order_relaxed))
+                {
+                    index = mid;
+                    ranges_[thread_index].range.store(PackRange(mid + 1, end), std::memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+
+    private:
+        std::vector<std::thread> workers_;
+
+        std::mutex call_mutex_;
+        std::mutex mutex_;
+        std::condition_variable work_cv_;
+        std::condition_variable done_cv_;
+        uint64_t generation_ = 0;
+        bool stop_ = false;
+
+        std::function<void(uint32_t index, uint32_t thread_index)> const* func_ = nullptr;
+        // Indices left to each thread. Each on its own cache line, the owner and thieves hit them all the time.
+        struct alignas(64) WorkRange
+        {
+            std::atomic<uint64_t> range{0};
+        };
+        std::unique_ptr<WorkRange[]> ranges_;
+        // Empty without NUMA
+        std::vector<NumaNode> nodes_;
+        std::vector<uint32_t> thread_nodes_;
+        std::atomic<bool> cancelled_{false};
+        uint32_t num_active_workers_ = 0;
+        std::exception_ptr exception_;
+    };
+
+
+    ThreadPool::ThreadPool(uint32_t num_threads) : impl_(num_threads)
+    {
+    }
+
+    ThreadPool::~ThreadPool() noexcept = default;
+    ThreadPool::ThreadPool(ThreadPool&& other) noexcept = default;
+    ThreadPool& ThreadPool::operator=(ThreadPool&& other) noexcept = default;
+
+    uint32_t ThreadPool::NumThreads() const noexcept
+    {
+        return impl_->NumThreads();
+    }
+
+    uint32_t ThreadPool::NumNodes() const noexcept
+    {
+        return impl_->NumNodes();
+    }
+
+    uint32_t ThreadPool::Node(uint32_t thread_index) const noexcept
+    {
+        return impl_->Node(thread_index);
+    }
+
+    uint32_t ThreadPool::NodeNumber(uint32_t node) const noexcept
+    {
+        return impl_->NodeNumber(node);
+    }
+
+    uint32_t ThreadPool::CurrentNode() noexcept
+    {
+        return tls_node;
+    }
+
+    void ThreadPool::ParallelFor(uint32_t count, std::function<void(uint32_t index, uint32_t thread_index)> const& func)
+    {
+        impl_->ParallelFor(count, func);
+    }
+} // namespace GoldenSun
@@ -2,17 +2,22 @@
 
 #include <GoldenSun/Util.hpp>
 
+#include <cassert>
 #include <filesystem>
 
 namespace GoldenSun
 {
     std::string ExeDirectory()
     {
+#ifdef _WIN32
         char exe_file[MAX_PATH];
         uint32_t size = ::GetModuleFileNameA(nullptr, exe_file, static_cast<uint32_t>(std::size(exe_file)));
         Verify((size != 0) && (size != std::size(exe_file)));
 
         std::filesystem::path exe_path = exe_file;
+#else
+        std::filesystem::path exe_path = std::filesystem::read_symlink("/proc/self/exe");
+#endif
         return exe_path.parent_path().string() + '/';
     }
 
@@ -101,6 +106,7 @@ namespace GoldenSun
         }
     }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     D3D12_ROOT_PARAMETER CreateRootParameterAsDescriptorTable(
         const D3D12_DESCRIPTOR_RANGE* descriptor_ranges, uint32_t num_descriptor_ranges, D3D12_SHADER_VISIBILITY visibility) noexcept
     {
@@ -145,4 +151,5 @@ namespace GoldenSun
         ret.ShaderVisibility = visibility;
         return ret;
     }
+#endif
 } // namespace GoldenSun
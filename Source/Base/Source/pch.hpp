@@ -1,7 +1,10 @@
 #pragma once
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #define INITGUID
+#endif
 
+#ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -9,12 +12,19 @@
 #define NOMINMAX
 #endif
 #include <windows.h>
+#endif
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <dxgiformat.h>
+#else
+#include <GoldenSun/Format.hpp>
+#endif
 
 #include <DirectXMath.h>
 
 #include <GoldenSun/Base.hpp>
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <GoldenSun/ComPtr.hpp>
+#endif
@@ -0,0 +1,173 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "Host/HostBvh.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    // A bumpy sphere of 2 * Slices * (Stacks - 1) triangles, 1.05M. The ones around the poles are long and thin, what the spatial
+    // splits are for.
+    uint32_t constexpr Slices = 1024;
+    uint32_t constexpr Stacks = 512;
+    uint32_t constexpr Repeat = 3;
+
+    struct Triangle
+    {
+        XMFLOAT3 v[3];
+    };
+
+    std::vector<Triangle> MakeTriangles()
+    {
+        std::vector<XMFLOAT3> positions((Stacks + 1) * Slices);
+        for (uint32_t stack = 0; stack <= Stacks; ++stack)
+        {
+            float const theta = stack * XM_PI / Stacks;
+            for (uint32_t slice = 0; slice < Slices; ++slice)
+            {
+                float const phi = slice * XM_2PI / Slices;
+                float const radius = 1 + 0.05f * std::sin(theta * 37) * std::sin(phi * 23);
+                positions[stack * Slices + slice] = {
+                    radius * std::sin(theta) * std::cos(phi), radius * std::cos(theta), radius * std::sin(theta) * std::sin(phi)};
+            }
+        }
+
+        std::vector<Triangle> triangles;
+        triangles.reserve(2 * Slices * (Stacks - 1));
+        for (uint32_t stack = 0; stack < Stacks; ++stack)
+        {
+            for (uint32_t slice = 0; slice < Slices; ++slice)
+            {
+                uint32_t const next_slice = (slice + 1) % Slices;
+                XMFLOAT3 const& v00 = positions[stack * Slices + slice];
+                XMFLOAT3 const& v01 = positions[stack * Slices + next_slice];
+                XMFLOAT3 const& v10 = positions[(stack + 1) * Slices + slice];
+                XMFLOAT3 const& v11 = positions[(stack + 1) * Slices + next_slice];
+
+                // The rows at the poles collapse into fans
+                if (stack != 0)
+                {
+                    triangles.push_back({{v00, v01, v11}});
+                }
+                if (stack != Stacks - 1)
+                {
+                    triangles.push_back({{v00, v11, v10}});
+                }
+            }
+        }
+        return triangles;
+    }
+
+    // The same clipping as the bottom level acceleration structures do
+    void SplitTriangle(
+        Triangle const& triangle, HostAabb const& ref_bounds, uint32_t axis, float position, HostAabb& left, HostAabb& right) noexcept
+    {
+        left = HostAabb();
+        right = HostAabb();
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            XMFLOAT3 const& a = triangle.v[i];
+            XMFLOAT3 const& b = triangle.v[(i + 1) % 3];
+            float const a_pos = (&a.x)[axis];
+            float const b_pos = (&b.x)[axis];
+
+            if (a_pos <= position)
+            {
+                left.Grow(a);
+            }
+            if (a_pos >= position)
+            {
+                right.Grow(a);
+            }
+
+            if (((a_pos < position) && (position < b_pos)) || ((b_pos < position) && (position < a_pos)))
+            {
+                float const t = (position - a_pos) / (b_pos - a_pos);
+                XMFLOAT3 crossing;
+                XMStoreFloat3(&crossing, XMVectorLerp(XMLoadFloat3(&a), XMLoadFloat3(&b), t));
+                (&crossing.x)[axis] = position;
+                left.Grow(crossing);
+                right.Grow(crossing);
+            }
+        }
+
+        left.Intersect(ref_bounds);
+        right.Intersect(ref_bounds);
+    }
+
+    struct Builder
+    {
+        char const* name;
+        HostBvhBuildMode mode;
+    };
+
+    Builder const builders[] = {
+        {"Binned SAH", HostBvhBuildMode::PreferFastTrace},
+        {"LBVH", HostBvhBuildMode::PreferFastBuild},
+        {"SBVH", HostBvhBuildMode::PreferFastTraceSpatialSplits},
+    };
+} // namespace
+
+namespace GoldenSun
+{
+    void BvhBuildBenchmark()
+    {
+        std::vector<Triangle> const triangles = MakeTriangles();
+        std::vector<HostAabb> prim_bounds(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            for (auto const& vertex : triangles[i].v)
+            {
+                prim_bounds[i].Grow(vertex);
+            }
+        }
+        HostBvhPrimSplitter const split_prim = [&triangles](uint32_t prim, HostAabb const& ref_bounds, uint32_t axis, float position,
+                                                   HostAabb& left, HostAabb& right) {
+            SplitTriangle(triangles[prim], ref_bounds, axis, position, left, right);
+        };
+
+        // Powers of 2 up to all the hardware threads
+        uint32_t const max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+        std::vector<uint32_t> thread_counts;
+        for (uint32_t num_threads = 1; num_threads < max_threads; num_threads *= 2)
+        {
+            thread_counts.push_back(num_threads);
+        }
+        thread_counts.push_back(max_threads);
+
+        std::cout << triangles.size() << " triangles\n";
+        for (auto const& builder : builders)
+        {
+            double single_thread_ms = 0;
+            for (uint32_t const num_threads : thread_counts)
+            {
+                ThreadPool thread_pool(num_threads);
+
+                HostBvh bvh;
+                double const time_ms = BestTimeMs(Repeat, [&] {
+                    bvh.Build(thread_pool, prim_bounds.data(), static_cast<uint32_t>(prim_bounds.size()), builder.mode, split_prim);
+                });
+                if (num_threads == 1)
+                {
+                    single_thread_ms = time_ms;
+                }
+
+                std::cout << "  " << std::left << std::setw(12) << builder.name << std::right << std::setw(3) << num_threads
+                          << " threads " << std::fixed << std::setprecision(1) << std::setw(8) << time_ms << " ms, " << std::setprecision(2)
+                          << std::setw(5) << single_thread_ms / time_ms << "x, SAH cost " << std::setprecision(1) << bvh.SahCost() << '\n';
+            }
+        }
+    }
+} // namespace GoldenSun
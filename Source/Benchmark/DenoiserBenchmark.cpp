@@ -0,0 +1,126 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Host/HostCpu.hpp"
+#include "Host/HostDenoiser.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    uint32_t constexpr Width = 512;
+    uint32_t constexpr Height = 512;
+    uint32_t constexpr Repeat = 5;
+
+    // A floor and a wall, with a checker albedo, lit by a point light. The noisy version has every pixel scaled by a random factor
+    // of mean 1, like a path tracer at very few samples per pixel.
+    struct TestImage
+    {
+        std::vector<HostDenoiserFeatures> features;
+        std::vector<XMFLOAT4> reference;
+        std::vector<XMFLOAT4> noisy;
+    };
+
+    TestImage MakeTestImage()
+    {
+        std::mt19937 rng(1);
+        std::exponential_distribution<float> noise(1);
+
+        TestImage image;
+        image.features.resize(Width * Height);
+        image.reference.resize(Width * Height);
+        image.noisy.resize(Width * Height);
+        for (uint32_t y = 0; y < Height; ++y)
+        {
+            for (uint32_t x = 0; x < Width; ++x)
+            {
+                uint32_t const pixel = y * Width + x;
+                bool const floor = (y > Height / 2);
+                float const u = static_cast<float>(x) / Width;
+                float const v = floor ? static_cast<float>(y - Height / 2) / (Height / 2) : static_cast<float>(y) / (Height / 2);
+
+                bool const checker = ((static_cast<uint32_t>(u * 8) + static_cast<uint32_t>(v * 4)) % 2) != 0;
+                XMFLOAT3 const albedo = checker ? XMFLOAT3(0.8f, 0.7f, 0.6f) : XMFLOAT3(0.2f, 0.3f, 0.5f);
+                float const dist_sq = (u - 0.5f) * (u - 0.5f) + (v - 0.2f) * (v - 0.2f) + 0.05f;
+                float const irradiance = 0.2f / dist_sq;
+
+                auto& features = image.features[pixel];
+                features.albedo = albedo;
+                features.normal = floor ? XMFLOAT3(0, 1, 0) : XMFLOAT3(0, 0, -1);
+                features.depth = floor ? 2 + 6 * (1 - v) : 8;
+
+                image.reference[pixel] = {albedo.x * irradiance, albedo.y * irradiance, albedo.z * irradiance, 1};
+                float const scale = noise(rng);
+                image.noisy[pixel] = {
+                    image.reference[pixel].x * scale, image.reference[pixel].y * scale, image.reference[pixel].z * scale, 1};
+            }
+        }
+        return image;
+    }
+
+    double RootMeanSquareError(std::vector<XMFLOAT4> const& image, std::vector<XMFLOAT4> const& reference)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < image.size(); ++i)
+        {
+            double const diff_r = image[i].x - reference[i].x;
+            double const diff_g = image[i].y - reference[i].y;
+            double const diff_b = image[i].z - reference[i].z;
+            sum += diff_r * diff_r + diff_g * diff_g + diff_b * diff_b;
+        }
+        return std::sqrt(sum / (3 * image.size()));
+    }
+
+    // Returns the time in milliseconds. A baseline_ms of 0 means this run is the baseline.
+    double Run(char const* name, TestImage const& image, ThreadPool& thread_pool, HostAtrousRowFunc atrous_row, double baseline_ms)
+    {
+        HostDenoiser denoiser(atrous_row);
+        std::vector<XMFLOAT4> color;
+        double const time_ms = BestTimeMs(Repeat, [&] {
+            color = image.noisy;
+            denoiser.Denoise(thread_pool, Width, Height, image.features.data(), color.data());
+        });
+        if (baseline_ms == 0)
+        {
+            baseline_ms = time_ms;
+        }
+
+        std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+                  << time_ms << " ms, " << std::setw(5) << baseline_ms / time_ms << "x, RMSE " << std::setprecision(4)
+                  << RootMeanSquareError(color, image.reference) << '\n';
+        return time_ms;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void DenoiserBenchmark()
+    {
+        TestImage const image = MakeTestImage();
+        std::cout << Width << "x" << Height << " image, RMSE " << std::fixed << std::setprecision(4)
+                  << RootMeanSquareError(image.noisy, image.reference) << " before denoising\n";
+
+        ThreadPool single_thread(1);
+        ThreadPool all_threads;
+
+        double const scalar_ms = Run("Scalar, 1 thread", image, single_thread, AtrousRowScalar, 0);
+        if (SupportsSse4())
+        {
+            Run("SSE4.1, 1 thread", image, single_thread, AtrousRowSse4, scalar_ms);
+        }
+
+        std::string const name = "Best, " + std::to_string(all_threads.NumThreads()) + " threads";
+        Run(name.c_str(), image, all_threads, SelectAtrousRowFunc(), scalar_ms);
+    }
+} // namespace GoldenSun
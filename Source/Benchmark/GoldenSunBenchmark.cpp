@@ -0,0 +1,46 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    struct Benchmark
+    {
+        char const* name;
+        void (*func)();
+    };
+
+    Benchmark const benchmarks[] = {
+        {"BvhBuild", GoldenSun::BvhBuildBenchmark},
+        {"Denoiser", GoldenSun::DenoiserBenchmark},
+        {"LightShading", GoldenSun::LightShadingBenchmark},
+        {"Texture", GoldenSun::TextureBenchmark},
+        {"TextureScene", GoldenSun::TextureSceneBenchmark},
+        {"TriangleIntersection", GoldenSun::TriangleIntersectionBenchmark},
+    };
+} // namespace
+
+// Runs the benchmarks named on the command line, or all of them
+int main(int argc, char* argv[])
+{
+    for (auto const& benchmark : benchmarks)
+    {
+        bool selected = (argc <= 1);
+        for (int i = 1; i < argc; ++i)
+        {
+            selected |= (std::strcmp(argv[i], benchmark.name) == 0);
+        }
+
+        if (selected)
+        {
+            std::cout << "[" << benchmark.name << "]\n";
+            benchmark.func();
+            std::cout << '\n';
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace GoldenSun
+{
+    // Runs func repeat times, and returns the best time of one run in milliseconds. The best, not the average, is the least noisy.
+    template <typename Func>
+    double BestTimeMs(uint32_t repeat, Func&& func)
+    {
+        double best = 0;
+        for (uint32_t i = 0; i < repeat; ++i)
+        {
+            auto const start = std::chrono::high_resolution_clock::now();
+            func();
+            double const time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            if ((i == 0) || (time < best))
+            {
+                best = time;
+            }
+        }
+        return best;
+    }
+
+    void BvhBuildBenchmark();
+    void DenoiserBenchmark();
+    void LightShadingBenchmark();
+    void TextureBenchmark();
+    void TextureSceneBenchmark();
+    void TriangleIntersectionBenchmark();
+} // namespace GoldenSun
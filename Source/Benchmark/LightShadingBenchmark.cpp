@@ -0,0 +1,157 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Host/HostCpu.hpp"
+#include "Host/HostLightShading.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    uint32_t constexpr NumBatches = 16384;
+    uint32_t constexpr Repeat = 5;
+
+    struct Sample
+    {
+        XMFLOAT3 position;
+        XMFLOAT3 view_dir;
+        XMFLOAT3 normal;
+        XMFLOAT3 diffuse_color;
+        XMFLOAT3 specular_color;
+        float roughness;
+        float occlusion;
+        LightBuffer light;
+    };
+
+    float Dot3(FXMVECTOR lhs, FXMVECTOR rhs)
+    {
+        return XMVectorGetX(XMVector3Dot(lhs, rhs));
+    }
+
+    // One sample at a time on XMVECTORs, the way the light loop shaded before
+    XMVECTOR ShadeLightAos(Sample const& sample)
+    {
+        XMVECTOR const position = XMLoadFloat3(&sample.position);
+        XMVECTOR const view_dir = XMLoadFloat3(&sample.view_dir);
+        XMVECTOR const normal = XMLoadFloat3(&sample.normal);
+        XMVECTOR const light_pos = XMLoadFloat3(&sample.light.position);
+        XMVECTOR const light_dir = XMVector3Normalize(light_pos - position);
+
+        XMVECTOR const halfway = XMVector3Normalize(light_dir + view_dir);
+        float const n_dot_l = std::max(Dot3(light_dir, normal), 0.0f);
+        float const n_dot_v = Dot3(normal, view_dir);
+        float const n_dot_h = std::max(Dot3(normal, halfway), 0.0f);
+        float const l_dot_h = std::max(Dot3(light_dir, halfway), 0.0f);
+
+        XMVECTOR const to_light = light_pos - position;
+        float const d2 = Dot3(to_light, to_light);
+        float const attenuation = 1 / (sample.light.falloff.x + sample.light.falloff.y * std::sqrt(d2) + sample.light.falloff.z * d2);
+
+        float const a2 = sample.roughness * sample.roughness;
+        float const d = (n_dot_h * a2 - n_dot_h) * n_dot_h + 1;
+        float const k = a2 / 2;
+        float const g = 1 / (n_dot_v * (1 - k) + k) * (1 / (n_dot_l * (1 - k) + k)) / 4;
+        XMVECTOR const f0 = XMLoadFloat3(&sample.specular_color);
+        XMVECTOR const fresnel = f0 + (XMVectorReplicate(1) - f0) * std::exp2(-(5.55473f * l_dot_h + 6.98316f) * l_dot_h);
+
+        XMVECTOR const diffuse = XMLoadFloat3(&sample.diffuse_color) / XM_PI;
+        XMVECTOR const specular = a2 / (d * d * XM_PI) * g * fresnel;
+        return attenuation * sample.occlusion * XMVectorMax((diffuse + specular) * n_dot_l, XMVectorZero()) *
+               XMLoadFloat3(&sample.light.color);
+    }
+
+    void Report(char const* name, double time_ms, uint64_t num_samples, float sum, double baseline_ms)
+    {
+        std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+                  << time_ms * 1e6 / num_samples << " ns/sample, " << std::setw(5) << baseline_ms / time_ms << "x, sum "
+                  << std::setprecision(1) << sum << '\n';
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // The BRDF of the light loop on random points and lights, one sample at a time and 4 lanes at a time
+    void LightShadingBenchmark()
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(-1, 1);
+        std::uniform_real_distribution<float> unit(0, 1);
+        auto const random_dir = [&] { return XMVector3Normalize(XMVectorSet(dist(rng), dist(rng), dist(rng), 0)); };
+
+        std::vector<Sample> samples(NumBatches * HostLightSamples4::Width);
+        std::vector<HostLightSamples4> batches(NumBatches);
+        for (uint32_t i = 0; i < samples.size(); ++i)
+        {
+            Sample& sample = samples[i];
+            sample.position = {4 * dist(rng), 4 * dist(rng), 4 * dist(rng)};
+            XMStoreFloat3(&sample.view_dir, random_dir());
+            XMStoreFloat3(&sample.normal, random_dir());
+            sample.diffuse_color = {unit(rng), unit(rng), unit(rng)};
+            sample.specular_color = {0.04f, 0.04f, 0.04f};
+            sample.roughness = unit(rng);
+            sample.occlusion = 1;
+            sample.light.position = {4 * dist(rng), 4 * dist(rng), 4 * dist(rng)};
+            sample.light.color = {unit(rng), unit(rng), unit(rng)};
+            sample.light.falloff = {1, 0, 1};
+
+            SetLightSample(batches[i / HostLightSamples4::Width], i % HostLightSamples4::Width, XMLoadFloat3(&sample.position),
+                XMLoadFloat3(&sample.view_dir), XMLoadFloat3(&sample.normal), XMLoadFloat3(&sample.diffuse_color),
+                XMLoadFloat3(&sample.specular_color), sample.roughness, sample.occlusion, sample.light, 1);
+        }
+
+        std::cout << samples.size() << " light samples\n";
+
+        float sum = 0;
+        double const aos_ms = BestTimeMs(Repeat, [&] {
+            XMVECTOR total = XMVectorZero();
+            for (auto const& sample : samples)
+            {
+                total += ShadeLightAos(sample);
+            }
+            sum = XMVectorGetX(total) + XMVectorGetY(total) + XMVectorGetZ(total);
+        });
+        Report("XMVECTOR per sample", aos_ms, samples.size(), sum, aos_ms);
+
+        std::vector<HostLightResults4> results(NumBatches);
+        auto const run = [&](HostShadeLightsFunc shade_lights) {
+            return BestTimeMs(Repeat, [&] {
+                for (uint32_t i = 0; i < NumBatches; ++i)
+                {
+                    shade_lights(batches[i], results[i]);
+                }
+                sum = 0;
+                for (auto const& result : results)
+                {
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        for (uint32_t lane = 0; lane < HostLightSamples4::Width; ++lane)
+                        {
+                            sum += result.contribution[c][lane];
+                        }
+                    }
+                }
+            });
+        };
+
+        Report("SoA scalar", run(ShadeLightsScalar), samples.size(), sum, aos_ms);
+        if (SupportsSse4())
+        {
+            std::vector<HostLightResults4> const scalar_results = results;
+            Report("SoA SSE4.1", run(ShadeLightsSse4), samples.size(), sum, aos_ms);
+            if (std::memcmp(scalar_results.data(), results.data(), results.size() * sizeof(results[0])) != 0)
+            {
+                std::cout << "  The kernels give different results\n";
+            }
+        }
+    }
+} // namespace GoldenSun
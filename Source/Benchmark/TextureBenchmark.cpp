@@ -0,0 +1,144 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <GoldenSun/TextureHelper.hpp>
+#include <GoldenSun/Util.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Host/HostTexture.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    uint32_t constexpr ScreenDim = 1024;
+    uint32_t constexpr ScreenTileDim = 8;
+    uint32_t constexpr NumHits = ScreenDim * ScreenDim;
+    uint32_t constexpr Repeat = 5;
+    // Below 0.5, so SampleLevel filters the top mip bilinearly, the most expensive fetch
+    float constexpr BilinearLod = 0.25f;
+
+    struct TextureFile
+    {
+        char const* name;
+        DXGI_FORMAT format;
+    };
+
+    // The textures of the DamagedHelmet material, fetched at every hit like SampleSurface does
+    TextureFile const texture_files[] = {
+        {"Default_albedo.jpg", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB},
+        {"Default_metalRoughness.jpg", DXGI_FORMAT_R8G8B8A8_UNORM},
+        {"Default_AO.jpg", DXGI_FORMAT_R8G8B8A8_UNORM},
+        {"Default_normal.jpg", DXGI_FORMAT_R8G8B8A8_UNORM},
+        {"Default_emissive.jpg", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB},
+    };
+
+    // Texture coordinates of the hits. Random ones are what the bounces of a path tracer see. Coherent ones are the primary rays of
+    // a ScreenDim x ScreenDim image seeing the whole texture, traced tile by tile like RayGen does.
+    std::vector<XMFLOAT2> MakeHits(bool coherent)
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(0, 1);
+
+        std::vector<XMFLOAT2> hits(NumHits);
+        for (uint32_t i = 0; i < NumHits; ++i)
+        {
+            if (coherent)
+            {
+                uint32_t const tile = i / (ScreenTileDim * ScreenTileDim);
+                uint32_t const tiles_x = ScreenDim / ScreenTileDim;
+                uint32_t const x = (tile % tiles_x) * ScreenTileDim + i % ScreenTileDim;
+                uint32_t const y = (tile / tiles_x) * ScreenTileDim + (i / ScreenTileDim) % ScreenTileDim;
+                hits[i] = {(x + 0.5f) / ScreenDim, (y + 0.5f) / ScreenDim};
+            }
+            else
+            {
+                hits[i] = {dist(rng), dist(rng)};
+            }
+        }
+        return hits;
+    }
+
+    // Returns the time in milliseconds. A baseline_ms of 0 means this run is the baseline.
+    double Run(char const* name, std::vector<std::unique_ptr<HostTexture>> const& textures, std::vector<XMFLOAT2> const& hits, float lod,
+        double baseline_ms, XMFLOAT4& sum)
+    {
+        XMVECTOR total = XMVectorZero();
+        double const time_ms = BestTimeMs(Repeat, [&] {
+            total = XMVectorZero();
+            for (auto const& hit : hits)
+            {
+                for (auto const& texture : textures)
+                {
+                    total += texture->SampleLevel(hit, lod);
+                }
+            }
+        });
+        XMStoreFloat4(&sum, total);
+        if (baseline_ms == 0)
+        {
+            baseline_ms = time_ms;
+        }
+
+        std::cout << "  " << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+                  << time_ms << " ms, " << std::setw(5) << baseline_ms / time_ms << "x, " << std::setprecision(1)
+                  << hits.size() * textures.size() / (time_ms * 1000) << " M fetches/s\n";
+        return time_ms;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void TextureBenchmark()
+    {
+        std::string const asset_dir = ExeDirectory() + "Assets/DamagedHelmet/";
+
+        std::vector<std::unique_ptr<HostTexture>> row_major_textures;
+        std::vector<std::unique_ptr<HostTexture>> tiled_textures;
+        for (auto const& file : texture_files)
+        {
+            uint32_t width;
+            uint32_t height;
+            auto const texels = LoadTexture(asset_dir + file.name, width, height);
+            if (texels.empty())
+            {
+                std::cout << "Can't load " << asset_dir << file.name << '\n';
+                return;
+            }
+
+            row_major_textures.push_back(
+                std::make_unique<HostTexture>(width, height, file.format, texels.data(), HostTexture::Layout::RowMajor));
+            tiled_textures.push_back(std::make_unique<HostTexture>(width, height, file.format, texels.data(), HostTexture::Layout::Tiled));
+        }
+        std::cout << NumHits << " hits, " << std::size(texture_files) << " textures of " << row_major_textures[0]->Width() << "x"
+                  << row_major_textures[0]->Height() << '\n';
+
+        for (bool const coherent : {false, true})
+        {
+            std::vector<XMFLOAT2> const hits = MakeHits(coherent);
+            for (bool const bilinear : {false, true})
+            {
+                std::string const name = std::string(coherent ? "Coherent" : "Random") + (bilinear ? ", bilinear" : ", point");
+                float const lod = bilinear ? BilinearLod : 0;
+
+                XMFLOAT4 row_major_sum;
+                XMFLOAT4 tiled_sum;
+                double const row_major_ms = Run((name + ", row-major").c_str(), row_major_textures, hits, lod, 0, row_major_sum);
+                Run((name + ", tiled").c_str(), tiled_textures, hits, lod, row_major_ms, tiled_sum);
+                if ((row_major_sum.x != tiled_sum.x) || (row_major_sum.y != tiled_sum.y) || (row_major_sum.z != tiled_sum.z) ||
+                    (row_major_sum.w != tiled_sum.w))
+                {
+                    std::cout << "  The layouts give different texels\n";
+                }
+            }
+        }
+    }
+} // namespace GoldenSun
@@ -0,0 +1,161 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Host/HostTexture.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    uint32_t constexpr Width = 1024;
+    uint32_t constexpr Height = 768;
+    uint32_t constexpr TileDim = 8;
+    uint32_t constexpr TextureDim = 2048;
+    uint32_t constexpr NumTextures = 5;
+    uint32_t constexpr Repeat = 5;
+
+    float constexpr Fov = XMConvertToRadians(45);
+    float constexpr EyeHeight = 1;
+    // The textures repeat every meter of the ground
+    float constexpr TextureScale = 1;
+
+    // A hit on the ground plane of a camera looking at the horizon. The near part of the image magnifies the textures, the far part
+    // minifies them more and more, where every pixel lands on texels far from its neighbors'.
+    struct Hit
+    {
+        XMFLOAT2 tex_coord;
+        // log2 of the texels the pixel covers, what the ray cones pick
+        float lod;
+    };
+
+    // In the order RayGen traces them, tile by tile. Pixels above the horizon miss the ground.
+    std::vector<Hit> MakeHits()
+    {
+        float const pixel_spread_angle = std::atan(2 * std::tan(Fov / 2) / Height);
+        float const tan_half_fov = std::tan(Fov / 2);
+        float const aspect_ratio = static_cast<float>(Width) / Height;
+
+        std::vector<Hit> hits;
+        for (uint32_t tile_y = 0; tile_y < Height; tile_y += TileDim)
+        {
+            for (uint32_t tile_x = 0; tile_x < Width; tile_x += TileDim)
+            {
+                for (uint32_t y = tile_y; y < tile_y + TileDim; ++y)
+                {
+                    for (uint32_t x = tile_x; x < tile_x + TileDim; ++x)
+                    {
+                        float const ndc_x = ((x + 0.5f) / Width * 2 - 1) * tan_half_fov * aspect_ratio;
+                        float const ndc_y = (1 - (y + 0.5f) / Height * 2) * tan_half_fov;
+
+                        // Looking down by 0.4 of the field of view, so the horizon is in the top tenth of the image
+                        float const pitch = Fov * 0.4f;
+                        float const dir_y = ndc_y * std::cos(pitch) - std::sin(pitch);
+                        float const dir_z = ndc_y * std::sin(pitch) + std::cos(pitch);
+                        if (dir_y >= 0)
+                        {
+                            continue;
+                        }
+
+                        float const inv_len = 1 / std::sqrt(ndc_x * ndc_x + dir_y * dir_y + dir_z * dir_z);
+                        float const t = EyeHeight / -dir_y;
+                        float const cos_angle = -dir_y * inv_len;
+                        float const footprint = t / inv_len * pixel_spread_angle / cos_angle * TextureScale * TextureDim;
+
+                        Hit hit;
+                        hit.tex_coord = {ndc_x * t * TextureScale, dir_z * t * TextureScale};
+                        hit.lod = std::log2(std::max(footprint, 1e-6f));
+                        hits.push_back(hit);
+                    }
+                }
+            }
+        }
+        return hits;
+    }
+
+    // Random texels, so every mip has something to filter
+    std::vector<uint8_t> MakeTexels(uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> texels(TextureDim * TextureDim * 4);
+        for (auto& texel : texels)
+        {
+            texel = static_cast<uint8_t>(rng());
+        }
+        return texels;
+    }
+
+    double Run(char const* name, std::vector<std::unique_ptr<HostTexture>> const& textures, std::vector<Hit> const& hits, bool use_lod,
+        double baseline_ms, XMFLOAT4& sum)
+    {
+        XMVECTOR total = XMVectorZero();
+        double const time_ms = BestTimeMs(Repeat, [&] {
+            total = XMVectorZero();
+            for (auto const& hit : hits)
+            {
+                for (auto const& texture : textures)
+                {
+                    total += texture->SampleLevel(hit.tex_coord, use_lod ? hit.lod : 0.0f);
+                }
+            }
+        });
+        XMStoreFloat4(&sum, total);
+        if (baseline_ms == 0)
+        {
+            baseline_ms = time_ms;
+        }
+
+        std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+                  << time_ms << " ms, " << std::setw(5) << baseline_ms / time_ms << "x, " << std::setprecision(1)
+                  << hits.size() * textures.size() / (time_ms * 1000) << " M fetches/s\n";
+        return time_ms;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // Texture fetches of one frame of a textured ground plane, seen from eye height. Unlike TextureBenchmark, the hits follow the
+    // footprints of real pixels, so neighboring pixels fetch neighboring texels up close and scattered ones in the distance. The
+    // textures are procedural, 2048x2048 with their mips, about 110 MB for each layout, far past the caches.
+    void TextureSceneBenchmark()
+    {
+        std::vector<std::unique_ptr<HostTexture>> row_major_textures;
+        std::vector<std::unique_ptr<HostTexture>> tiled_textures;
+        for (uint32_t i = 0; i < NumTextures; ++i)
+        {
+            auto const texels = MakeTexels(i + 1);
+            row_major_textures.push_back(std::make_unique<HostTexture>(
+                TextureDim, TextureDim, DXGI_FORMAT_R8G8B8A8_UNORM, texels.data(), HostTexture::Layout::RowMajor));
+            tiled_textures.push_back(std::make_unique<HostTexture>(
+                TextureDim, TextureDim, DXGI_FORMAT_R8G8B8A8_UNORM, texels.data(), HostTexture::Layout::Tiled));
+        }
+
+        std::vector<Hit> const hits = MakeHits();
+        std::cout << hits.size() << " hits of a " << Width << "x" << Height << " frame, " << NumTextures << " textures of " << TextureDim
+                  << "x" << TextureDim << '\n';
+
+        for (bool const use_lod : {false, true})
+        {
+            std::string const name = use_lod ? "Ray cone LOD" : "Top mip";
+
+            XMFLOAT4 row_major_sum;
+            XMFLOAT4 tiled_sum;
+            double const row_major_ms = Run((name + ", row-major").c_str(), row_major_textures, hits, use_lod, 0, row_major_sum);
+            Run((name + ", tiled").c_str(), tiled_textures, hits, use_lod, row_major_ms, tiled_sum);
+            if ((row_major_sum.x != tiled_sum.x) || (row_major_sum.y != tiled_sum.y) || (row_major_sum.z != tiled_sum.z) ||
+                (row_major_sum.w != tiled_sum.w))
+            {
+                std::cout << "  The layouts give different texels\n";
+            }
+        }
+    }
+} // namespace GoldenSun
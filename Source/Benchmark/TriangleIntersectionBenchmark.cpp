@@ -0,0 +1,260 @@
+#include "pch.hpp"
+
+#include "GoldenSunBenchmark.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "Host/HostCpu.hpp"
+#include "Host/HostTriangleIntersection.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    uint32_t constexpr NumBlocks = 4096;
+    uint32_t constexpr NumRays = 256;
+    uint32_t constexpr Repeat = 5;
+    uint32_t constexpr GridSize = 64;
+
+    // AoS triangle with precomputed edges, the layout of the Moller-Trumbore test the host renderer used before
+    struct EdgeTriangle
+    {
+        XMFLOAT3 v0;
+        XMFLOAT3 e1;
+        XMFLOAT3 e2;
+    };
+
+    EdgeTriangle MakeEdgeTriangle(XMFLOAT3 const& v0, XMFLOAT3 const& v1, XMFLOAT3 const& v2)
+    {
+        return {v0, {v1.x - v0.x, v1.y - v0.y, v1.z - v0.z}, {v2.x - v0.x, v2.y - v0.y, v2.z - v0.z}};
+    }
+
+    // Scalar Moller-Trumbore, both faces
+    bool IntersectMollerTrumbore(EdgeTriangle const& triangle, HostRay const& ray, float& t, XMFLOAT2& barycentrics)
+    {
+        XMVECTOR const dir = XMLoadFloat3(&ray.direction);
+        XMVECTOR const e1 = XMLoadFloat3(&triangle.e1);
+        XMVECTOR const e2 = XMLoadFloat3(&triangle.e2);
+
+        XMVECTOR const p = XMVector3Cross(dir, e2);
+        float const det = XMVectorGetX(XMVector3Dot(e1, p));
+        if (det == 0)
+        {
+            return false;
+        }
+
+        float const inv_det = 1 / det;
+
+        XMVECTOR const s = XMLoadFloat3(&ray.origin) - XMLoadFloat3(&triangle.v0);
+        float const u = XMVectorGetX(XMVector3Dot(s, p)) * inv_det;
+        if ((u < 0) || (u > 1))
+        {
+            return false;
+        }
+
+        XMVECTOR const q = XMVector3Cross(s, e1);
+        float const v = XMVectorGetX(XMVector3Dot(dir, q)) * inv_det;
+        if ((v < 0) || (u + v > 1))
+        {
+            return false;
+        }
+
+        t = XMVectorGetX(XMVector3Dot(e2, q)) * inv_det;
+        if ((t < ray.t_min) || (t >= ray.t_max))
+        {
+            return false;
+        }
+
+        barycentrics = {u, v};
+        return true;
+    }
+
+    uint32_t CountBits(uint32_t mask)
+    {
+        uint32_t ret = 0;
+        for (; mask != 0; mask &= mask - 1)
+        {
+            ++ret;
+        }
+        return ret;
+    }
+
+    struct Triangles
+    {
+        std::vector<EdgeTriangle> edge_triangles;
+        std::vector<HostTriangle4> blocks;
+
+        void Add(XMFLOAT3 const& v0, XMFLOAT3 const& v1, XMFLOAT3 const& v2)
+        {
+            uint32_t const index = static_cast<uint32_t>(edge_triangles.size());
+            if (index % HostTriangle4::Width == 0)
+            {
+                blocks.emplace_back();
+            }
+            SetTriangle(blocks.back(), index % HostTriangle4::Width, v0, v1, v2);
+            edge_triangles.push_back(MakeEdgeTriangle(v0, v1, v2));
+        }
+    };
+
+    // Tests every ray against every triangle. Returns the number of hits, and the rays that hit nothing in num_missed_rays.
+    uint64_t TestAllMollerTrumbore(Triangles const& triangles, std::vector<HostRay> const& rays, uint32_t& num_missed_rays)
+    {
+        uint64_t num_hits = 0;
+        num_missed_rays = 0;
+        for (auto const& ray : rays)
+        {
+            uint64_t ray_hits = 0;
+            for (auto const& triangle : triangles.edge_triangles)
+            {
+                float t;
+                XMFLOAT2 barycentrics;
+                ray_hits += IntersectMollerTrumbore(triangle, ray, t, barycentrics) ? 1 : 0;
+            }
+            num_hits += ray_hits;
+            num_missed_rays += (ray_hits == 0) ? 1 : 0;
+        }
+        return num_hits;
+    }
+
+    uint64_t TestAllWatertight(Triangles const& triangles, std::vector<HostRay> const& rays, HostIntersectTrianglesFunc intersect,
+        uint32_t& num_missed_rays)
+    {
+        uint64_t num_hits = 0;
+        num_missed_rays = 0;
+        for (auto const& ray : rays)
+        {
+            HostWatertightRay const watertight_ray(ray);
+            uint64_t ray_hits = 0;
+            for (auto const& block : triangles.blocks)
+            {
+                HostTriangleHits4 hits;
+                ray_hits += CountBits(intersect(block, watertight_ray, ray.t_max, false, hits));
+            }
+            num_hits += ray_hits;
+            num_missed_rays += (ray_hits == 0) ? 1 : 0;
+        }
+        return num_hits;
+    }
+
+    void Report(char const* name, double time_ms, uint64_t num_tests, uint64_t num_hits, double baseline_ms)
+    {
+        std::cout << "  " << std::left << std::setw(24) << name << std::right << std::fixed << std::setprecision(2) << std::setw(8)
+                  << time_ms * 1e6 / num_tests << " ns/test, " << std::setw(5) << baseline_ms / time_ms << "x, " << num_hits
+                  << " hits\n";
+    }
+
+    // Small random triangles in a box, and rays crossing it
+    void Throughput()
+    {
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<float> dist(-1, 1);
+
+        Triangles triangles;
+        for (uint32_t i = 0; i < NumBlocks * HostTriangle4::Width; ++i)
+        {
+            XMFLOAT3 const center = {dist(rng), dist(rng), dist(rng)};
+            XMFLOAT3 const v1 = {center.x + 0.3f * dist(rng), center.y + 0.3f * dist(rng), center.z + 0.3f * dist(rng)};
+            XMFLOAT3 const v2 = {center.x + 0.3f * dist(rng), center.y + 0.3f * dist(rng), center.z + 0.3f * dist(rng)};
+            triangles.Add(center, v1, v2);
+        }
+
+        std::vector<HostRay> rays(NumRays);
+        for (auto& ray : rays)
+        {
+            ray = {{3 * dist(rng), 3 * dist(rng), -5}, 0, {0.2f * dist(rng), 0.2f * dist(rng), 1}, 100};
+        }
+
+        uint64_t const num_tests = static_cast<uint64_t>(NumRays) * triangles.edge_triangles.size();
+        uint32_t num_missed_rays;
+
+        uint64_t num_hits = 0;
+        double const mt_ms = BestTimeMs(Repeat, [&] { num_hits = TestAllMollerTrumbore(triangles, rays, num_missed_rays); });
+        std::cout << "1 ray vs " << HostTriangle4::Width << " triangles, " << num_tests << " tests\n";
+        Report("Moller-Trumbore scalar", mt_ms, num_tests, num_hits, mt_ms);
+
+        double const scalar_ms =
+            BestTimeMs(Repeat, [&] { num_hits = TestAllWatertight(triangles, rays, IntersectTrianglesScalar, num_missed_rays); });
+        Report("Watertight scalar", scalar_ms, num_tests, num_hits, mt_ms);
+
+        if (SupportsSse4())
+        {
+            double const sse4_ms =
+                BestTimeMs(Repeat, [&] { num_hits = TestAllWatertight(triangles, rays, IntersectTrianglesSse4, num_missed_rays); });
+            Report("Watertight SSE4.1", sse4_ms, num_tests, num_hits, mt_ms);
+        }
+    }
+
+    // A tilted, jittered grid, with rays aimed right at its inner vertices and edge midpoints. Every one of them should hit the grid.
+    void Cracks()
+    {
+        std::mt19937 rng(2);
+        std::uniform_real_distribution<float> dist(-0.3f, 0.3f);
+
+        std::vector<XMFLOAT3> vertices((GridSize + 1) * (GridSize + 1));
+        for (uint32_t y = 0; y <= GridSize; ++y)
+        {
+            for (uint32_t x = 0; x <= GridSize; ++x)
+            {
+                float const fx = (x + dist(rng)) / GridSize * 2 - 1;
+                float const fy = (y + dist(rng)) / GridSize * 2 - 1;
+                vertices[y * (GridSize + 1) + x] = {fx * 1.7f, fy * 0.9f + fx * 0.3f, 0.37f * fx + 0.61f * fy + 0.1f};
+            }
+        }
+
+        Triangles triangles;
+        for (uint32_t y = 0; y < GridSize; ++y)
+        {
+            for (uint32_t x = 0; x < GridSize; ++x)
+            {
+                XMFLOAT3 const& v00 = vertices[y * (GridSize + 1) + x];
+                XMFLOAT3 const& v10 = vertices[y * (GridSize + 1) + x + 1];
+                XMFLOAT3 const& v01 = vertices[(y + 1) * (GridSize + 1) + x];
+                XMFLOAT3 const& v11 = vertices[(y + 1) * (GridSize + 1) + x + 1];
+                triangles.Add(v00, v10, v11);
+                triangles.Add(v00, v11, v01);
+            }
+        }
+
+        XMFLOAT3 const origin = {0.3f, -0.2f, -4};
+        std::vector<HostRay> rays;
+        auto add_ray = [&rays, &origin](XMFLOAT3 const& target) {
+            rays.push_back({origin, 0, {target.x - origin.x, target.y - origin.y, target.z - origin.z}, 100});
+        };
+        for (uint32_t y = 1; y < GridSize; ++y)
+        {
+            for (uint32_t x = 1; x < GridSize; ++x)
+            {
+                XMFLOAT3 const& v = vertices[y * (GridSize + 1) + x];
+                XMFLOAT3 const& right = vertices[y * (GridSize + 1) + x + 1];
+                XMFLOAT3 const& up = vertices[(y + 1) * (GridSize + 1) + x];
+                XMFLOAT3 const& diagonal = vertices[(y + 1) * (GridSize + 1) + x + 1];
+                add_ray(v);
+                add_ray({(v.x + right.x) * 0.5f, (v.y + right.y) * 0.5f, (v.z + right.z) * 0.5f});
+                add_ray({(v.x + up.x) * 0.5f, (v.y + up.y) * 0.5f, (v.z + up.z) * 0.5f});
+                add_ray({(v.x + diagonal.x) * 0.5f, (v.y + diagonal.y) * 0.5f, (v.z + diagonal.z) * 0.5f});
+            }
+        }
+
+        std::cout << rays.size() << " rays at the vertices and edges of a " << triangles.edge_triangles.size() << " triangle grid\n";
+
+        uint32_t num_missed_rays;
+        TestAllMollerTrumbore(triangles, rays, num_missed_rays);
+        std::cout << "  " << std::left << std::setw(24) << "Moller-Trumbore scalar" << std::right << num_missed_rays << " missed\n";
+
+        TestAllWatertight(triangles, rays, SelectIntersectTrianglesFunc(), num_missed_rays);
+        std::cout << "  " << std::left << std::setw(24) << "Watertight" << std::right << num_missed_rays << " missed\n";
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void TriangleIntersectionBenchmark()
+    {
+        Throughput();
+        Cracks();
+    }
+} // namespace GoldenSun
@@ -3,13 +3,15 @@
 #include <string_view>
 #include <vector>
 
-#include <d3d12.h>
-
 #include <GoldenSun/Mesh.hpp>
 
 namespace GoldenSun
 {
     class GpuSystem;
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     std::vector<Mesh> LoadMesh(GpuSystem& gpu_system, std::string_view file_name);
+#endif
+    // Keeps primitives and textures in host memory, for the CPU renderer
+    std::vector<Mesh> LoadMesh(std::string_view file_name);
 } // namespace GoldenSun
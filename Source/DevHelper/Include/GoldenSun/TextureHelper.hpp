@@ -1,13 +1,43 @@
 #pragma once
 
+#include <string>
 #include <string_view>
+#include <vector>
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <d3d12.h>
 
 #include <GoldenSun/Gpu/GpuSystem.hpp>
+#endif
+#include <GoldenSun/Material.hpp>
 
 namespace GoldenSun
 {
-    GpuTexture2D LoadTexture(GpuSystem& gpu_system, std::string_view file_name, DXGI_FORMAT format);
+#ifndef GOLDEN_SUN_HOST_ONLY
+    // With mip_chain, every mip down to 1x1 is box filtered from the image, averaging sRGB formats in linear space
+    GpuTexture2D LoadTexture(GpuSystem& gpu_system, std::string_view file_name, DXGI_FORMAT format, bool mip_chain = false);
     void SaveTexture(GpuSystem& gpu_system, GpuTexture2D const& texture, std::string_view file_name);
+#endif
+
+    // Host versions. Texels are 8-bit RGBA. An empty vector means the file can't be loaded.
+    std::vector<uint8_t> LoadTexture(std::string_view file_name, uint32_t& width, uint32_t& height);
+    void SaveTexture(void const* data, uint32_t width, uint32_t height, DXGI_FORMAT format, std::string_view file_name);
+
+    // An image file decoded each time the texture cache reads it. Only its header is read up front, 0x0 if the file can't be loaded.
+    class FileTextureSource final : public TextureSource
+    {
+    public:
+        FileTextureSource(std::string_view file_name, DXGI_FORMAT format);
+
+        uint32_t Width() const noexcept override;
+        uint32_t Height() const noexcept override;
+        DXGI_FORMAT Format() const noexcept override;
+        bool Read(void* texels) override;
+
+    private:
+        std::string file_name_;
+        DXGI_FORMAT format_;
+        uint32_t width_ = 0;
+        uint32_t height_ = 0;
+    };
 } // namespace GoldenSun
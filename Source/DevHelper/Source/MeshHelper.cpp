@@ -3,12 +3,15 @@
 #include <GoldenSun/MeshHelper.hpp>
 #include <GoldenSun/TextureHelper.hpp>
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <GoldenSun/Gpu/GpuSystem.hpp>
+#endif
 #include <GoldenSun/Util.hpp>
 
 #include <filesystem>
 #include <iostream>
 #include <limits>
+#include <memory>
 
 #include <assimp/Importer.hpp>
 #include <assimp/pbrmaterial.h>
@@ -170,7 +173,27 @@ namespace
         }
     }
 
-    std::vector<PbrMaterial> BuildMaterials(GpuSystem& gpu_system, aiScene const* ai_scene, std::filesystem::path const& asset_path)
+    // A null gpu_system leaves the texture in its file, for the CPU renderer to read when a ray hits it
+    void LoadMaterialTexture([[maybe_unused]] GpuSystem* gpu_system, PbrMaterial& material, PbrMaterial::TextureSlot slot,
+        std::string const& file_name, DXGI_FORMAT format)
+    {
+#ifndef GOLDEN_SUN_HOST_ONLY
+        if (gpu_system != nullptr)
+        {
+            auto texture = LoadTexture(*gpu_system, file_name, format, true);
+            material.Texture(slot, texture.NativeHandle<D3D12Traits>());
+            return;
+        }
+#endif
+
+        auto source = std::make_unique<FileTextureSource>(file_name, format);
+        if (source->Width() > 0)
+        {
+            material.Texture(slot, source.release());
+        }
+    }
+
+    std::vector<PbrMaterial> BuildMaterials(GpuSystem* gpu_system, aiScene const* ai_scene, std::filesystem::path const& asset_path)
     {
         std::vector<PbrMaterial> materials;
 
@@ -266,8 +289,8 @@ namespace
             {
                 aiString str;
                 aiGetMaterialTexture(mtl, aiTextureType_DIFFUSE, 0, &str, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
-                auto texture = LoadTexture(gpu_system, (asset_path / str.C_Str()).string(), DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
-                material.Texture(PbrMaterial::TextureSlot::Albedo, texture.NativeHandle<D3D12Traits>());
+                LoadMaterialTexture(gpu_system, material, PbrMaterial::TextureSlot::Albedo, (asset_path / str.C_Str()).string(),
+                    DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
             }
 
             if (aiGetMaterialTextureCount(mtl, aiTextureType_UNKNOWN) > 0)
@@ -275,24 +298,24 @@ namespace
                 aiString str;
                 aiGetMaterialTexture(mtl, AI_MATKEY_GLTF_PBRMETALLICROUGHNESS_METALLICROUGHNESS_TEXTURE, &str, nullptr, nullptr, nullptr,
                     nullptr, nullptr, nullptr);
-                auto texture = LoadTexture(gpu_system, (asset_path / str.C_Str()).string(), DXGI_FORMAT_R8G8B8A8_UNORM);
-                material.Texture(PbrMaterial::TextureSlot::MetallicRoughness, texture.NativeHandle<D3D12Traits>());
+                LoadMaterialTexture(gpu_system, material, PbrMaterial::TextureSlot::MetallicRoughness, (asset_path / str.C_Str()).string(),
+                    DXGI_FORMAT_R8G8B8A8_UNORM);
             }
 
             if (aiGetMaterialTextureCount(mtl, aiTextureType_EMISSIVE) > 0)
             {
                 aiString str;
                 aiGetMaterialTexture(mtl, aiTextureType_EMISSIVE, 0, &str, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
-                auto texture = LoadTexture(gpu_system, (asset_path / str.C_Str()).string(), DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
-                material.Texture(PbrMaterial::TextureSlot::Emissive, texture.NativeHandle<D3D12Traits>());
+                LoadMaterialTexture(gpu_system, material, PbrMaterial::TextureSlot::Emissive, (asset_path / str.C_Str()).string(),
+                    DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
             }
 
             if (aiGetMaterialTextureCount(mtl, aiTextureType_NORMALS) > 0)
             {
                 aiString str;
                 aiGetMaterialTexture(mtl, aiTextureType_NORMALS, 0, &str, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
-                auto texture = LoadTexture(gpu_system, (asset_path / str.C_Str()).string(), DXGI_FORMAT_R8G8B8A8_UNORM);
-                material.Texture(PbrMaterial::TextureSlot::Normal, texture.NativeHandle<D3D12Traits>());
+                LoadMaterialTexture(gpu_system, material, PbrMaterial::TextureSlot::Normal, (asset_path / str.C_Str()).string(),
+                    DXGI_FORMAT_R8G8B8A8_UNORM);
 
                 aiGetMaterialFloat(mtl, AI_MATKEY_GLTF_TEXTURE_SCALE(aiTextureType_NORMALS, 0), &ai_normal_scale);
                 material.NormalScale() = ai_normal_scale;
@@ -302,8 +325,8 @@ namespace
             {
                 aiString str;
                 aiGetMaterialTexture(mtl, aiTextureType_LIGHTMAP, 0, &str, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
-                auto texture = LoadTexture(gpu_system, (asset_path / str.C_Str()).string(), DXGI_FORMAT_R8G8B8A8_UNORM);
-                material.Texture(PbrMaterial::TextureSlot::Occlusion, texture.NativeHandle<D3D12Traits>());
+                LoadMaterialTexture(gpu_system, material, PbrMaterial::TextureSlot::Occlusion, (asset_path / str.C_Str()).string(),
+                    DXGI_FORMAT_R8G8B8A8_UNORM);
 
                 aiGetMaterialFloat(mtl, AI_MATKEY_GLTF_TEXTURE_STRENGTH(aiTextureType_LIGHTMAP, 0), &ai_occlusion_strength);
                 material.OcclusionStrength() = ai_occlusion_strength;
@@ -313,7 +336,9 @@ namespace
         return materials;
     }
 
-    std::vector<Mesh> BuildMeshData(GpuSystem& gpu_system, aiScene const* ai_scene, std::vector<PbrMaterial> const& materials)
+    // A null gpu_system keeps the primitives in host memory
+    std::vector<Mesh> BuildMeshData(
+        [[maybe_unused]] GpuSystem* gpu_system, aiScene const* ai_scene, std::vector<PbrMaterial> const& materials)
     {
         std::vector<Mesh> meshes;
         for (uint32_t mi = 0; mi < ai_scene->mNumMeshes; ++mi)
@@ -406,11 +431,6 @@ namespace
                 XMStoreFloat4(&vertices[vi].tangent_quat, tangent_quat);
             }
 
-            auto vb = gpu_system.CreateUploadBuffer(vertices.data(), static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])),
-                (mesh_name_wide + L" Vertex Buffer").c_str());
-            auto ib = gpu_system.CreateUploadBuffer(
-                indices.data(), static_cast<uint32_t>(indices.size() * sizeof(indices[0])), (mesh_name_wide + L" Index Buffer").c_str());
-
             D3D12_RAYTRACING_GEOMETRY_FLAGS flags;
             if (materials[ai_mesh->mMaterialIndex].Transparent() || (materials[ai_mesh->mMaterialIndex].AlphaCutoff() > 0))
             {
@@ -421,16 +441,27 @@ namespace
                 flags = D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE;
             }
 
-            new_mesh.AddPrimitive(vb.NativeHandle<D3D12Traits>(), ib.NativeHandle<D3D12Traits>(), 0, flags);
+#ifndef GOLDEN_SUN_HOST_ONLY
+            if (gpu_system != nullptr)
+            {
+                auto vb = gpu_system->CreateUploadBuffer(vertices.data(), static_cast<uint32_t>(vertices.size() * sizeof(vertices[0])),
+                    (mesh_name_wide + L" Vertex Buffer").c_str());
+                auto ib = gpu_system->CreateUploadBuffer(indices.data(), static_cast<uint32_t>(indices.size() * sizeof(indices[0])),
+                    (mesh_name_wide + L" Index Buffer").c_str());
+
+                new_mesh.AddPrimitive(vb.NativeHandle<D3D12Traits>(), ib.NativeHandle<D3D12Traits>(), 0, flags);
+                continue;
+            }
+#endif
+
+            new_mesh.AddPrimitive(vertices.data(), static_cast<uint32_t>(vertices.size()), indices.data(),
+                static_cast<uint32_t>(indices.size()), 0, flags);
         }
 
         return meshes;
     }
-} // namespace
 
-namespace GoldenSun
-{
-    std::vector<Mesh> LoadMesh(GpuSystem& gpu_system, std::string_view file_name)
+    std::vector<Mesh> LoadMesh(GpuSystem* gpu_system, std::string_view file_name)
     {
         uint32_t const ppsteps = aiProcess_JoinIdenticalVertices      // join identical vertices/ optimize indexing
                                  | aiProcess_ValidateDataStructure    // perform a full validation of the loader's output
@@ -467,4 +498,19 @@ namespace GoldenSun
 
         return meshes;
     }
+} // namespace
+
+namespace GoldenSun
+{
+#ifndef GOLDEN_SUN_HOST_ONLY
+    std::vector<Mesh> LoadMesh(GpuSystem& gpu_system, std::string_view file_name)
+    {
+        return ::LoadMesh(&gpu_system, std::move(file_name));
+    }
+#endif
+
+    std::vector<Mesh> LoadMesh(std::string_view file_name)
+    {
+        return ::LoadMesh(nullptr, std::move(file_name));
+    }
 } // namespace GoldenSun
@@ -4,9 +4,14 @@
 
 #include <GoldenSun/Util.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <d3d12.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -16,9 +21,59 @@
 using namespace GoldenSun;
 using namespace std;
 
+namespace
+{
+    float SrgbToLinear(uint8_t value) noexcept
+    {
+        float const srgb = value / 255.0f;
+        return (srgb <= 0.04045f) ? srgb / 12.92f : std::pow((srgb + 0.055f) / 1.055f, 2.4f);
+    }
+
+    uint8_t LinearToSrgb(float value) noexcept
+    {
+        float const srgb = (value < 0.0031308f) ? value * 12.92f : (1.055f * std::pow(value, 1 / 2.4f) - 0.055f);
+        return static_cast<uint8_t>(std::clamp(srgb, 0.0f, 1.0f) * 255 + 0.5f);
+    }
+
+    // 2x2 box filter of 8-bit RGBA texels into the next mip. An odd last row or column is folded into its neighbor.
+    std::vector<uint8_t> DownsampleMip(uint8_t const* src, uint32_t src_width, uint32_t src_height, bool srgb)
+    {
+        uint32_t const dst_width = std::max(src_width / 2, 1U);
+        uint32_t const dst_height = std::max(src_height / 2, 1U);
+        std::vector<uint8_t> dst(dst_width * dst_height * 4);
+        for (uint32_t y = 0; y < dst_height; ++y)
+        {
+            uint32_t const src_ys[] = {std::min(y * 2, src_height - 1), std::min(y * 2 + 1, src_height - 1)};
+            for (uint32_t x = 0; x < dst_width; ++x)
+            {
+                uint32_t const src_xs[] = {std::min(x * 2, src_width - 1), std::min(x * 2 + 1, src_width - 1)};
+                for (uint32_t ch = 0; ch < 4; ++ch)
+                {
+                    bool const linearize = srgb && (ch < 3);
+                    float sum = 0;
+                    for (uint32_t const src_y : src_ys)
+                    {
+                        for (uint32_t const src_x : src_xs)
+                        {
+                            uint8_t const value = src[(src_y * src_width + src_x) * 4 + ch];
+                            sum += linearize ? SrgbToLinear(value) : value / 255.0f;
+                        }
+                    }
+
+                    float const average = sum / 4;
+                    dst[(y * dst_width + x) * 4 + ch] =
+                        linearize ? LinearToSrgb(average) : static_cast<uint8_t>(std::clamp(average, 0.0f, 1.0f) * 255 + 0.5f);
+                }
+            }
+        }
+        return dst;
+    }
+} // namespace
+
 namespace GoldenSun
 {
-    GpuTexture2D LoadTexture(GpuSystem& gpu_system, std::string_view file_name, DXGI_FORMAT format)
+#ifndef GOLDEN_SUN_HOST_ONLY
+    GpuTexture2D LoadTexture(GpuSystem& gpu_system, std::string_view file_name, DXGI_FORMAT format, bool mip_chain)
     {
         GpuTexture2D ret;
 
@@ -26,10 +81,18 @@ namespace GoldenSun
         uint8_t* data = stbi_load(std::string(file_name).c_str(), &width, &height, nullptr, 4);
         if (data != nullptr)
         {
+            uint32_t const mip_levels = mip_chain ? static_cast<uint32_t>(std::log2(std::max(width, height))) + 1 : 1;
             ret = gpu_system.CreateTexture2D(
-                width, height, 1, format, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_GENERIC_READ);
+                width, height, mip_levels, format, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_GENERIC_READ);
             auto cmd_list = gpu_system.CreateCommandList();
             ret.Upload(gpu_system, cmd_list, 0, data);
+            std::vector<uint8_t> mip_data;
+            for (uint32_t mip = 1; mip < mip_levels; ++mip)
+            {
+                uint8_t const* src = (mip == 1) ? data : mip_data.data();
+                mip_data = DownsampleMip(src, ret.Width(mip - 1), ret.Height(mip - 1), IsSrgbFormat(format));
+                ret.Upload(gpu_system, cmd_list, mip, mip_data.data());
+            }
             gpu_system.Execute(std::move(cmd_list));
 
             stbi_image_free(data);
@@ -54,4 +117,81 @@ namespace GoldenSun
         stbi_write_png(std::string(file_name).c_str(), static_cast<int>(width), static_cast<int>(height), 4, data.data(),
             static_cast<int>(width * format_size));
     }
+#endif
+
+    std::vector<uint8_t> LoadTexture(std::string_view file_name, uint32_t& width, uint32_t& height)
+    {
+        std::vector<uint8_t> ret;
+
+        int w, h;
+        uint8_t* data = stbi_load(std::string(file_name).c_str(), &w, &h, nullptr, 4);
+        if (data != nullptr)
+        {
+            width = static_cast<uint32_t>(w);
+            height = static_cast<uint32_t>(h);
+            ret.assign(data, data + width * height * 4);
+
+            stbi_image_free(data);
+        }
+        else
+        {
+            width = 0;
+            height = 0;
+        }
+
+        return ret;
+    }
+
+    void SaveTexture(void const* data, uint32_t width, uint32_t height, DXGI_FORMAT format, std::string_view file_name)
+    {
+        assert(data != nullptr);
+
+        uint32_t const format_size = FormatSize(format);
+        stbi_write_png(std::string(file_name).c_str(), static_cast<int>(width), static_cast<int>(height), 4, data,
+            static_cast<int>(width * format_size));
+    }
+
+    FileTextureSource::FileTextureSource(std::string_view file_name, DXGI_FORMAT format) : file_name_(file_name), format_(format)
+    {
+        int w, h;
+        if (stbi_info(file_name_.c_str(), &w, &h, nullptr))
+        {
+            width_ = static_cast<uint32_t>(w);
+            height_ = static_cast<uint32_t>(h);
+        }
+    }
+
+    uint32_t FileTextureSource::Width() const noexcept
+    {
+        return width_;
+    }
+
+    uint32_t FileTextureSource::Height() const noexcept
+    {
+        return height_;
+    }
+
+    DXGI_FORMAT FileTextureSource::Format() const noexcept
+    {
+        return format_;
+    }
+
+    bool FileTextureSource::Read(void* texels)
+    {
+        int w, h;
+        uint8_t* data = stbi_load(file_name_.c_str(), &w, &h, nullptr, 4);
+        if (data == nullptr)
+        {
+            return false;
+        }
+
+        // The file may have changed since its header was read
+        bool const same_size = (static_cast<uint32_t>(w) == width_) && (static_cast<uint32_t>(h) == height_);
+        if (same_size)
+        {
+            std::memcpy(texels, data, static_cast<size_t>(width_) * height_ * 4);
+        }
+        stbi_image_free(data);
+        return same_size;
+    }
 } // namespace GoldenSun
@@ -4,6 +4,7 @@
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
+#ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -11,8 +12,11 @@
 #define NOMINMAX
 #endif
 #include <windows.h>
+#endif
 
 #include <DirectXMath.h>
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <GoldenSun/ComPtr.hpp>
+#endif
 #include <GoldenSun/GoldenSun.hpp>
@@ -193,4 +193,12 @@ namespace GoldenSun
     {
         return impl_->FarPlane();
     }
+
+
+    bool EngineInternal::SameView(Camera const& lhs, Camera const& rhs) noexcept
+    {
+        auto const equal = [](XMFLOAT3 const& a, XMFLOAT3 const& b) { return (a.x == b.x) && (a.y == b.y) && (a.z == b.z); };
+        return equal(lhs.Eye(), rhs.Eye()) && equal(lhs.LookAt(), rhs.LookAt()) && equal(lhs.Up(), rhs.Up()) && (lhs.Fov() == rhs.Fov()) &&
+               (lhs.NearPlane() == rhs.NearPlane()) && (lhs.FarPlane() == rhs.FarPlane());
+    }
 } // namespace GoldenSun
@@ -9,6 +9,8 @@
 #include <GoldenSun/Util.hpp>
 
 #include <cassert>
+#include <cmath>
+#include <cstring>
 #include <iomanip>
 #include <list>
 #include <numeric>
@@ -20,24 +22,30 @@
 
 #include <DirectXMath.h>
 
-#include "AccelerationStructure.hpp"
+#include "EngineImpl.hpp"
 #include "EngineInternal.hpp"
+#include "Host/HostEngine.hpp"
+
+#ifndef GOLDEN_SUN_HOST_ONLY
+#include "AccelerationStructure.hpp"
 
 #include "CompiledShaders/RayTracing.h"
+#endif
 
 using namespace DirectX;
 using namespace GoldenSun;
 
 namespace
 {
-    static uint32_t constexpr MaxRayRecursionDepth = 3;
-
+#ifndef GOLDEN_SUN_HOST_ONLY
     struct RadianceRayPayload
     {
         XMFLOAT4 color;
         uint32_t recursion_depth;
+        // Width and spread angle of the ray cone
+        XMFLOAT2 cone;
     };
-    static_assert(sizeof(RadianceRayPayload) == sizeof(XMFLOAT4) + sizeof(uint32_t));
+    static_assert(sizeof(RadianceRayPayload) == sizeof(XMFLOAT4) + sizeof(uint32_t) + sizeof(XMFLOAT2));
 
     struct ShadowRayPayload
     {
@@ -563,6 +571,9 @@ namespace
         alignas(4) XMFLOAT4 bg_color;
         alignas(4) XMFLOAT3 camera_pos;
         alignas(4) uint32_t is_srgb_output;
+        alignas(4) XMFLOAT2 sample_position;
+        alignas(4) uint32_t sample_index;
+        alignas(4) float pixel_spread_angle;
     };
 
     struct PrimitiveConstantBuffer
@@ -604,17 +615,37 @@ namespace
     };
 
     uint32_t constexpr MaxNumBottomLevelInstances = 1000;
+#endif
+
+    float RadicalInverse(uint32_t base, uint32_t index) noexcept
+    {
+        float const inv_base = 1.0f / base;
+        float digit_weight = inv_base;
+        float ret = 0;
+        while (index > 0)
+        {
+            ret += (index % base) * digit_weight;
+            index /= base;
+            digit_weight *= inv_base;
+        }
+        return ret;
+    }
 } // namespace
 
 namespace GoldenSun
 {
-    class Engine::Impl
+    XMFLOAT2 SamplePosition(uint32_t sample_index) noexcept
     {
-        DISALLOW_COPY_AND_ASSIGN(Impl)
-        DISALLOW_COPY_MOVE_AND_ASSIGN(Impl)
+        float const x = 0.5f + RadicalInverse(2, sample_index);
+        float const y = 0.5f + RadicalInverse(3, sample_index);
+        return {x - std::floor(x), y - std::floor(y)};
+    }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
+    class Engine::Impl::Gpu final : public Engine::Impl
+    {
     public:
-        Impl(ID3D12Device5* device, ID3D12CommandQueue* cmd_queue)
+        Gpu(ID3D12Device5* device, ID3D12CommandQueue* cmd_queue)
             : gpu_system_(device, cmd_queue), per_frame_constants_(gpu_system_, GpuSystem::FrameCount(), L"Per Frame Constants"),
               descriptor_size_(gpu_system_.CbvSrvUavDescSize()), acceleration_structure_(gpu_system_, MaxNumBottomLevelInstances)
         {
@@ -637,13 +668,17 @@ namespace GoldenSun
             gpu_system_.Execute(std::move(cmd_list));
         }
 
-        ~Impl() noexcept
+        ~Gpu() noexcept override
         {
             this->ReleaseWindowSizeDependentResources();
         }
 
-        void RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format, XMFLOAT4 const& bg_color)
+        void RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format, XMFLOAT4 const& bg_color) override
         {
+            if ((bg_color.x != bg_color_.x) || (bg_color.y != bg_color_.y) || (bg_color.z != bg_color_.z) || (bg_color.w != bg_color_.w))
+            {
+                sample_count_ = 0;
+            }
             bg_color_ = bg_color;
 
             if ((width != width_) || (height != height_) || (format != format_))
@@ -653,6 +688,7 @@ namespace GoldenSun
                 format_ = format;
 
                 this->ReleaseWindowSizeDependentResources();
+                sample_count_ = 0;
 
                 if ((width_ > 0) && (height_ > 0))
                 {
@@ -662,8 +698,15 @@ namespace GoldenSun
             }
         }
 
-        void Meshes(Mesh const* meshes, uint32_t num_meshes)
+        void Meshes(Mesh const* meshes, uint32_t num_meshes, BuildPreference build_preference) override
         {
+            D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS build_flags =
+                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
+            if (build_preference == BuildPreference::FastBuild)
+            {
+                build_flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD;
+            }
+
             primitive_start_.assign(1, 0);
             material_start_.assign(1, 0);
             for (uint32_t i = 0; i < num_meshes; ++i)
@@ -693,14 +736,14 @@ namespace GoldenSun
                 gpu_system_.ReallocUploadMemBlock(material_mem_block_, num_materials * sizeof(PbrMaterialBuffer), Alignment);
                 auto* material_mem = material_mem_block_.CpuAddress<PbrMaterialBuffer>();
 
-                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS build_flags =
-                    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
                 for (uint32_t i = 0; i < num_meshes; ++i)
                 {
                     auto const& mesh = meshes[i];
 
                     for (uint32_t j = 0; j < mesh.NumPrimitives(); ++j)
                     {
+                        Verify((mesh.VertexBuffer(j) != nullptr) && (mesh.IndexBuffer(j) != nullptr));
+
                         mesh_buffers_.emplace_back(MeshBuffer{GpuBuffer(mesh.VertexBuffer(j), D3D12_RESOURCE_STATE_GENERIC_READ),
                             mesh.NumVertices(j), mesh.VertexStrideInBytes()});
                         mesh_buffers_.emplace_back(MeshBuffer{GpuBuffer(mesh.IndexBuffer(j), D3D12_RESOURCE_STATE_GENERIC_READ),
@@ -744,8 +787,6 @@ namespace GoldenSun
             }
 
             {
-                D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS build_flags =
-                    D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
                 bool allow_update = false;
                 bool perform_update_on_build = false;
                 acceleration_structure_.AssignTopLevelAS(
@@ -753,30 +794,129 @@ namespace GoldenSun
             }
 
             mesh_desc_dirty_ = true;
+            sample_count_ = 0;
         }
 
-        void Lights(PointLight const* lights, uint32_t num_lights)
+        void Lights(PointLight const* lights, uint32_t num_lights) override
         {
+            std::vector<LightBuffer> new_lights(num_lights);
+            for (uint32_t i = 0; i < num_lights; ++i)
+            {
+                new_lights[i] = EngineInternal::Buffer(lights[i]);
+            }
+            if ((new_lights.size() != lights_.size()) ||
+                (std::memcmp(new_lights.data(), lights_.data(), new_lights.size() * sizeof(LightBuffer)) != 0))
+            {
+                sample_count_ = 0;
+            }
+            lights_ = std::move(new_lights);
+
             uint32_t constexpr Alignment = std::lcm<uint32_t>(sizeof(LightBuffer), GpuMemoryAllocator::StructuredDataAligment);
             gpu_system_.ReallocUploadMemBlock(light_mem_block_, num_lights * sizeof(LightBuffer), Alignment);
             auto* light_mem = light_mem_block_.CpuAddress<LightBuffer>();
             for (uint32_t i = 0; i < num_lights; ++i)
             {
-                light_mem[i] = EngineInternal::Buffer(lights[i]);
+                light_mem[i] = lights_[i];
             }
 
             light_desc_dirty_ = true;
         }
 
-        void Camera(GoldenSun::Camera const& camera)
+        void Camera(GoldenSun::Camera const& camera) override
         {
+            if (!EngineInternal::SameView(camera, camera_))
+            {
+                sample_count_ = 0;
+            }
             camera_ = camera.Clone();
         }
 
-        void Render(ID3D12GraphicsCommandList4* d3d12_cmd_list)
+        void Accumulation(bool enable) override
+        {
+            if (enable != accumulation_)
+            {
+                sample_count_ = 0;
+            }
+            accumulation_ = enable;
+        }
+
+        uint32_t SampleCount() const noexcept override
+        {
+            return sample_count_;
+        }
+
+        // The variance estimate needs the samples on the CPU, so only the cap is applied here
+        void AdaptiveSampling(float /*error_threshold*/, uint32_t max_samples) override
+        {
+            max_samples_ = max_samples;
+        }
+
+        bool Converged() const noexcept override
+        {
+            return accumulation_ && (max_samples_ != 0) && (sample_count_ >= max_samples_);
+        }
+
+        // The denoiser works on host memory, there is none here
+        void Denoise(bool /*enable*/) override
+        {
+        }
+
+        // Shading happens in the closest hit shader, which recurses through TraceRay. A path loop would need it to return the hit
+        // instead.
+        void PathTracing(uint32_t /*max_bounces*/) override
+        {
+        }
+
+        // The closest hit shader loops over every light, and there is no light BVH on the GPU
+        void LightSampling(uint32_t /*num_samples*/) override
+        {
+        }
+
+        void TextureLod(bool enable) override
+        {
+            if (enable != texture_lod_)
+            {
+                sample_count_ = 0;
+            }
+            texture_lod_ = enable;
+        }
+
+        // Textures are D3D12 resources created by the application, nothing is read on demand
+        void TextureCacheBudget(uint64_t /*bytes*/) override
+        {
+        }
+
+        uint64_t TextureCacheHits() const noexcept override
+        {
+            return 0;
+        }
+
+        uint64_t TextureCacheMisses() const noexcept override
+        {
+            return 0;
+        }
+
+        void ScenePlacement(Placement /*placement*/) override
+        {
+        }
+
+        void Scissor(uint32_t /*left*/, uint32_t /*top*/, uint32_t /*right*/, uint32_t /*bottom*/) override
+        {
+        }
+
+        void Render(ID3D12GraphicsCommandList4* d3d12_cmd_list) override
         {
             GpuCommandList cmd_list(d3d12_cmd_list);
 
+            if (!accumulation_)
+            {
+                sample_count_ = 0;
+            }
+            else if (this->Converged())
+            {
+                return;
+            }
+
             uint32_t const frame_index = gpu_system_.FrameIndex();
 
             acceleration_structure_.Build(cmd_list, frame_index);
@@ -788,6 +928,10 @@ namespace GoldenSun
                 per_frame_constants_->bg_color = bg_color_;
                 per_frame_constants_->camera_pos = camera_.Eye();
                 per_frame_constants_->is_srgb_output = IsSrgbFormat(format_);
+                per_frame_constants_->sample_position = SamplePosition(sample_count_);
+                per_frame_constants_->sample_index = sample_count_;
+                per_frame_constants_->pixel_spread_angle =
+                    texture_lod_ ? std::atan(2 * std::tan(camera_.Fov() / 2) / height_) : 0;
 
                 auto const view =
                     XMMatrixLookAtLH(XMLoadFloat3(&camera_.Eye()), XMLoadFloat3(&camera_.LookAt()), XMLoadFloat3(&camera_.Up()));
@@ -830,18 +974,27 @@ namespace GoldenSun
 
             d3d12_cmd_list->SetPipelineState1(state_obj_.Get());
             d3d12_cmd_list->DispatchRays(&dispatch_desc);
+
+            ++sample_count_;
         }
 
-        ID3D12Resource* Output() const noexcept
+        ID3D12Resource* Output() const noexcept override
         {
             return ray_tracing_output_.NativeHandle<D3D12Traits>();
         }
 
+        void const* HostOutput() const noexcept override
+        {
+            return nullptr;
+        }
+
     private:
         void CreateWindowSizeDependentResources()
         {
             ray_tracing_output_ = gpu_system_.CreateTexture2D(width_, height_, 1, format_, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS,
                 D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"GoldenSun Output");
+            accumulation_target_ = gpu_system_.CreateTexture2D(width_, height_, 1, DXGI_FORMAT_R32G32B32A32_FLOAT,
+                D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"GoldenSun Accumulation");
 
             output_desc_dirty_ = true;
         }
@@ -849,6 +1002,7 @@ namespace GoldenSun
         void ReleaseWindowSizeDependentResources() noexcept
         {
             ray_tracing_output_.Reset();
+            accumulation_target_.Reset();
             output_desc_dirty_ = true;
         }
 
@@ -877,7 +1031,7 @@ namespace GoldenSun
         {
             {
                 D3D12_DESCRIPTOR_RANGE const ranges[] = {
-                    {D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}, // Output
+                    {D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 2, 0, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}, // Output and accumulation
                     {D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}, // Material
                     {D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2, 0, D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND}, // Light
                 };
@@ -992,7 +1146,7 @@ namespace GoldenSun
             {
                 if (output_desc_dirty_)
                 {
-                    gpu_system_.ReallocCbvSrvUavDescBlock(output_desc_block_, 1);
+                    gpu_system_.ReallocCbvSrvUavDescBlock(output_desc_block_, 2);
                 }
                 if (mesh_desc_dirty_)
                 {
@@ -1021,6 +1175,8 @@ namespace GoldenSun
             if (output_desc_dirty_)
             {
                 gpu_system_.CreateUnorderedAccessView(ray_tracing_output_, LinearFormatOf(format_), output_desc_block_.CpuHandle());
+                gpu_system_.CreateUnorderedAccessView(accumulation_target_, DXGI_FORMAT_R32G32B32A32_FLOAT,
+                    OffsetHandle(output_desc_block_.CpuHandle(), 1, descriptor_size_));
                 output_desc_dirty_ = false;
             }
 
@@ -1184,10 +1340,17 @@ namespace GoldenSun
         std::array<GpuTexture2D, std::to_underlying(PbrMaterial::TextureSlot::Num)> default_textures_;
 
         GpuMemoryBlock light_mem_block_;
+        std::vector<LightBuffer> lights_;
 
         RaytracingAccelerationStructureManager acceleration_structure_;
 
         GpuTexture2D ray_tracing_output_;
+        // Sum of the samples so far, in linear space
+        GpuTexture2D accumulation_target_;
+        bool accumulation_ = false;
+        uint32_t sample_count_ = 0;
+        uint32_t max_samples_ = 0;
+        bool texture_lod_ = false;
 
         enum class RayType : uint32_t
         {
@@ -1211,11 +1374,18 @@ namespace GoldenSun
 
         GoldenSun::Camera camera_;
     };
+#endif
 
 
     Engine::Engine() = default;
 
-    Engine::Engine(ID3D12Device5* device, ID3D12CommandQueue* cmd_queue) : impl_(new Impl(device, cmd_queue))
+#ifndef GOLDEN_SUN_HOST_ONLY
+    Engine::Engine(ID3D12Device5* device, ID3D12CommandQueue* cmd_queue) : impl_(new Impl::Gpu(device, cmd_queue))
+    {
+    }
+#endif
+
+    Engine::Engine(uint32_t num_threads) : impl_(new Impl::Host(num_threads))
     {
     }
 
@@ -1261,7 +1431,12 @@ namespace GoldenSun
 
     void Engine::Meshes(Mesh const* meshes, uint32_t num_meshes)
     {
-        return impl_->Meshes(meshes, num_meshes);
+        return impl_->Meshes(meshes, num_meshes, BuildPreference::FastTrace);
+    }
+
+    void Engine::Meshes(Mesh const* meshes, uint32_t num_meshes, BuildPreference build_preference)
+    {
+        return impl_->Meshes(meshes, num_meshes, build_preference);
     }
 
     void Engine::Lights(PointLight const* lights, uint32_t num_lights)
@@ -1274,6 +1449,71 @@ namespace GoldenSun
         return impl_->Camera(camera);
     }
 
+    void Engine::Accumulation(bool enable)
+    {
+        return impl_->Accumulation(enable);
+    }
+
+    uint32_t Engine::SampleCount() const noexcept
+    {
+        return impl_->SampleCount();
+    }
+
+    void Engine::AdaptiveSampling(float error_threshold, uint32_t max_samples)
+    {
+        return impl_->AdaptiveSampling(error_threshold, max_samples);
+    }
+
+    bool Engine::Converged() const noexcept
+    {
+        return impl_->Converged();
+    }
+
+    void Engine::Denoise(bool enable)
+    {
+        return impl_->Denoise(enable);
+    }
+
+    void Engine::PathTracing(uint32_t max_bounces)
+    {
+        return impl_->PathTracing(max_bounces);
+    }
+
+    void Engine::LightSampling(uint32_t num_samples)
+    {
+        return impl_->LightSampling(num_samples);
+    }
+
+    void Engine::TextureLod(bool enable)
+    {
+        return impl_->TextureLod(enable);
+    }
+
+    void Engine::TextureCacheBudget(uint64_t bytes)
+    {
+        return impl_->TextureCacheBudget(bytes);
+    }
+
+    uint64_t Engine::TextureCacheHits() const noexcept
+    {
+        return impl_->TextureCacheHits();
+    }
+
+    uint64_t Engine::TextureCacheMisses() const noexcept
+    {
+        return impl_->TextureCacheMisses();
+    }
+
+    void Engine::ScenePlacement(Placement placement)
+    {
+        return impl_->ScenePlacement(placement);
+    }
+
+    void Engine::Scissor(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+    {
+        return impl_->Scissor(left, top, right, bottom);
+    }
+
     void Engine::Render(ID3D12GraphicsCommandList4* cmd_list)
     {
         return impl_->Render(cmd_list);
@@ -1283,4 +1523,9 @@ namespace GoldenSun
     {
         return impl_->Output();
     }
+
+    void const* Engine::HostOutput() const noexcept
+    {
+        return impl_->HostOutput();
+    }
 } // namespace GoldenSun
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GoldenSun/Engine.hpp>
+
+#include <DirectXMath.h>
+
+namespace GoldenSun
+{
+    // Implemented by Engine::Impl::Gpu (DXR) and Engine::Impl::Host (CPU reference)
+    class Engine::Impl
+    {
+        DISALLOW_COPY_AND_ASSIGN(Impl)
+        DISALLOW_COPY_MOVE_AND_ASSIGN(Impl)
+
+    public:
+        class Gpu;
+        class Host;
+
+    public:
+        Impl() noexcept = default;
+        virtual ~Impl() noexcept = default;
+
+        virtual void RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format, DirectX::XMFLOAT4 const& bg_color) = 0;
+        virtual void Meshes(Mesh const* meshes, uint32_t num_meshes, BuildPreference build_preference) = 0;
+        virtual void Lights(PointLight const* lights, uint32_t num_lights) = 0;
+        virtual void Camera(GoldenSun::Camera const& camera) = 0;
+        virtual void Accumulation(bool enable) = 0;
+        virtual uint32_t SampleCount() const noexcept = 0;
+        virtual void AdaptiveSampling(float error_threshold, uint32_t max_samples) = 0;
+        virtual bool Converged() const noexcept = 0;
+        virtual void Denoise(bool enable) = 0;
+        virtual void PathTracing(uint32_t max_bounces) = 0;
+        virtual void LightSampling(uint32_t num_samples) = 0;
+        virtual void TextureLod(bool enable) = 0;
+        virtual void TextureCacheBudget(uint64_t bytes) = 0;
+        virtual uint64_t TextureCacheHits() const noexcept = 0;
+        virtual uint64_t TextureCacheMisses() const noexcept = 0;
+        virtual void ScenePlacement(Placement placement) = 0;
+        virtual void Scissor(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) = 0;
+
+        virtual void Render(ID3D12GraphicsCommandList4* cmd_list) = 0;
+
+        virtual ID3D12Resource* Output() const noexcept = 0;
+        virtual void const* HostOutput() const noexcept = 0;
+    };
+} // namespace GoldenSun
@@ -1,12 +1,23 @@
 #pragma once
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <d3d12.h>
+#endif
+#include <memory>
 #include <vector>
 
 namespace GoldenSun
 {
+    class HostTexture;
     class Mesh;
 
+    // Must match MaxRayRecursionDepth in shader
+    uint32_t constexpr MaxRayRecursionDepth = 3;
+
+    // Where a sample of progressive accumulation goes inside its pixel, in [0, 1). Halton (2, 3) shifted by half a pixel, so the first
+    // sample is at the center, as without accumulation.
+    DirectX::XMFLOAT2 SamplePosition(uint32_t sample_index) noexcept;
+
     // Must match PbrMaterial in shader
     struct PbrMaterialBuffer
     {
@@ -38,8 +49,17 @@ namespace GoldenSun
     class EngineInternal final
     {
     public:
+#ifndef GOLDEN_SUN_HOST_ONLY
         static std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> GeometryDescs(Mesh const& mesh);
+#endif
+        static D3D12_RAYTRACING_GEOMETRY_FLAGS GeometryFlags(Mesh const& mesh, uint32_t primitive_id) noexcept;
+        // Copies a primitive to host memory. Primitives backed by D3D12 buffers must be in an upload heap.
+        static void HostBuffers(Mesh const& mesh, uint32_t primitive_id, std::vector<Vertex>& vertices, std::vector<Index>& indices);
         static PbrMaterialBuffer const& Buffer(PbrMaterial const& material) noexcept;
+        static std::shared_ptr<HostTexture const> const& HostTextureOf(PbrMaterial const& material, PbrMaterial::TextureSlot slot) noexcept;
+        static std::shared_ptr<TextureSource> const& TextureSourceOf(PbrMaterial const& material, PbrMaterial::TextureSlot slot) noexcept;
         static LightBuffer const& Buffer(PointLight const& light) noexcept;
+        // Same view and projection
+        static bool SameView(Camera const& lhs, Camera const& rhs) noexcept;
     };
 } // namespace GoldenSun
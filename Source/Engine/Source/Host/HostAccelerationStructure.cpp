@@ -0,0 +1,369 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ErrorHandling.hpp>
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <algorithm>
+
+#include "HostAccelerationStructure.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+    using namespace GoldenSun;
+
+    uint32_t constexpr TrianglesPerTask = 4096;
+    uint32_t constexpr NodesPerTask = 1024;
+
+    XMFLOAT3 Float3(XMVECTOR v) noexcept
+    {
+        XMFLOAT3 ret;
+        XMStoreFloat3(&ret, v);
+        return ret;
+    }
+
+    HostAabb TransformAabb(HostAabb const& aabb, FXMMATRIX transform) noexcept
+    {
+        HostAabb ret;
+        if (aabb.Valid())
+        {
+            for (uint32_t i = 0; i < 8; ++i)
+            {
+                XMVECTOR const corner = XMVectorSet((i & 1) ? aabb.max.x : aabb.min.x, (i & 2) ? aabb.max.y : aabb.min.y,
+                    (i & 4) ? aabb.max.z : aabb.min.z, 1);
+                ret.Grow(Float3(XMVector3Transform(corner, transform)));
+            }
+        }
+        return ret;
+    }
+
+    // Clips the triangle against the plane, through its vertices and the points where its edges cross the plane
+    void SplitTriangle(
+        HostTriangle const& triangle, HostAabb const& ref_bounds, uint32_t axis, float position, HostAabb& left, HostAabb& right) noexcept
+    {
+        XMFLOAT3 const vertices[] = {triangle.v0, triangle.v1, triangle.v2};
+
+        left = HostAabb();
+        right = HostAabb();
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            XMFLOAT3 const& a = vertices[i];
+            XMFLOAT3 const& b = vertices[(i + 1) % 3];
+            float const a_pos = (&a.x)[axis];
+            float const b_pos = (&b.x)[axis];
+
+            if (a_pos <= position)
+            {
+                left.Grow(a);
+            }
+            if (a_pos >= position)
+            {
+                right.Grow(a);
+            }
+
+            if (((a_pos < position) && (position < b_pos)) || ((b_pos < position) && (position < a_pos)))
+            {
+                float const t = (position - a_pos) / (b_pos - a_pos);
+                XMFLOAT3 crossing = Float3(XMVectorLerp(XMLoadFloat3(&a), XMLoadFloat3(&b), t));
+                (&crossing.x)[axis] = position;
+                left.Grow(crossing);
+                right.Grow(crossing);
+            }
+        }
+
+        left.Intersect(ref_bounds);
+        right.Intersect(ref_bounds);
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    HostBottomLevelAccelerationStructure::HostBottomLevelAccelerationStructure(
+        ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries, HostBvhBuildMode build_mode, bool allow_update)
+        : build_mode_(build_mode), intersect_triangles_(SelectIntersectTrianglesFunc())
+    {
+        std::vector<HostAabb> const triangle_bounds = this->BuildTriangles(thread_pool, geometries, num_geometries);
+        this->BuildBvh(thread_pool, triangle_bounds, allow_update);
+    }
+
+    void HostBottomLevelAccelerationStructure::Update(ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries)
+    {
+        size_t num_triangles = 0;
+        for (uint32_t i = 0; i < num_geometries; ++i)
+        {
+            num_triangles += geometries[i].indices.size() / 3;
+        }
+        Verify(num_triangles == triangles_.size());
+
+        std::vector<HostAabb> const triangle_bounds = this->BuildTriangles(thread_pool, geometries, num_geometries);
+
+        bvh_.Refit(thread_pool, triangle_bounds.data());
+        if (bvh_.NeedsRebuild())
+        {
+            this->BuildBvh(thread_pool, triangle_bounds, true);
+        }
+        else
+        {
+            this->FillLeafTriangles(thread_pool);
+        }
+    }
+
+    void HostBottomLevelAccelerationStructure::BuildBvh(
+        ThreadPool& thread_pool, std::vector<HostAabb> const& triangle_bounds, bool allow_update)
+    {
+        HostBvh binary_bvh;
+        binary_bvh.Build(thread_pool, triangle_bounds.data(), static_cast<uint32_t>(triangle_bounds.size()), build_mode_,
+            [this](uint32_t triangle_index, HostAabb const& ref_bounds, uint32_t axis, float position, HostAabb& left, HostAabb& right) {
+                SplitTriangle(triangles_[triangle_index], ref_bounds, axis, position, left, right);
+            });
+        bvh_.Build(binary_bvh, allow_update);
+
+        // One SoA block per leaf, in the order the leaves are stored
+        auto const& nodes = bvh_.Nodes();
+        leaf_triangle_indices_.assign(bvh_.PrimRefs().size(), 0);
+        uint32_t num_leaves = 0;
+        for (auto const& node : nodes)
+        {
+            for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+            {
+                if (CompressedNumPrims(node, slot) > 0)
+                {
+                    leaf_triangle_indices_[CompressedChild(node, slot)] = num_leaves;
+                    ++num_leaves;
+                }
+            }
+        }
+        leaf_triangles_.resize(num_leaves);
+
+        this->FillLeafTriangles(thread_pool);
+    }
+
+    void HostBottomLevelAccelerationStructure::FillLeafTriangles(ThreadPool& thread_pool)
+    {
+        auto const& nodes = bvh_.Nodes();
+        auto const& prim_refs = bvh_.PrimRefs();
+        uint32_t const num_nodes = static_cast<uint32_t>(nodes.size());
+        uint32_t const num_tasks = (num_nodes + NodesPerTask - 1) / NodesPerTask;
+        thread_pool.ParallelFor(num_tasks, [this, &nodes, &prim_refs, num_nodes](uint32_t task, uint32_t /*thread_index*/) {
+            uint32_t const begin = task * NodesPerTask;
+            uint32_t const end = std::min(begin + NodesPerTask, num_nodes);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+                {
+                    uint32_t const num_prims = CompressedNumPrims(nodes[i], slot);
+                    if (num_prims == 0)
+                    {
+                        continue;
+                    }
+
+                    uint32_t const first_ref = CompressedChild(nodes[i], slot);
+                    auto& leaf_triangles = leaf_triangles_[leaf_triangle_indices_[first_ref]];
+                    leaf_triangles = HostTriangle4();
+                    for (uint32_t lane = 0; lane < num_prims; ++lane)
+                    {
+                        auto const& triangle = triangles_[prim_refs[first_ref + lane]];
+                        SetTriangle(leaf_triangles, lane, triangle.v0, triangle.v1, triangle.v2);
+                    }
+                }
+            }
+        });
+    }
+
+    // Object space triangles and their bounds, in the order of the geometries
+    std::vector<HostAabb> HostBottomLevelAccelerationStructure::BuildTriangles(
+        ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries)
+    {
+        std::vector<uint32_t> triangle_start(num_geometries + 1, 0);
+        for (uint32_t i = 0; i < num_geometries; ++i)
+        {
+            triangle_start[i + 1] = triangle_start[i] + static_cast<uint32_t>(geometries[i].indices.size() / 3);
+        }
+
+        uint32_t const num_triangles = triangle_start.back();
+        triangles_.resize(num_triangles);
+        std::vector<HostAabb> triangle_bounds(num_triangles);
+
+        uint32_t const num_tasks = (num_triangles + TrianglesPerTask - 1) / TrianglesPerTask;
+        thread_pool.ParallelFor(num_tasks, [this, geometries, num_triangles, &triangle_start, &triangle_bounds](
+                                               uint32_t task, uint32_t /*thread_index*/) {
+            uint32_t const begin = task * TrianglesPerTask;
+            uint32_t const end = std::min(begin + TrianglesPerTask, num_triangles);
+
+            uint32_t geometry_index =
+                static_cast<uint32_t>(std::upper_bound(triangle_start.begin(), triangle_start.end(), begin) - triangle_start.begin()) - 1;
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                while (i >= triangle_start[geometry_index + 1])
+                {
+                    ++geometry_index;
+                }
+
+                auto const& geometry = geometries[geometry_index];
+                uint32_t const primitive_id = i - triangle_start[geometry_index];
+
+                XMFLOAT3 const& p0 = geometry.vertices[geometry.indices[primitive_id * 3 + 0]].position;
+                XMFLOAT3 const& p1 = geometry.vertices[geometry.indices[primitive_id * 3 + 1]].position;
+                XMFLOAT3 const& p2 = geometry.vertices[geometry.indices[primitive_id * 3 + 2]].position;
+
+                auto& triangle = triangles_[i];
+                triangle.v0 = p0;
+                triangle.v1 = p1;
+                triangle.v2 = p2;
+                triangle.geometry_index = geometry_index;
+                triangle.primitive_id = primitive_id;
+                triangle.padding = 0;
+
+                auto& bounds = triangle_bounds[i];
+                bounds = HostAabb();
+                bounds.Grow(p0);
+                bounds.Grow(p1);
+                bounds.Grow(p2);
+            }
+        });
+
+        return triangle_bounds;
+    }
+
+    HostBottomLevelAccelerationStructure::HostBottomLevelAccelerationStructure(HostBottomLevelAccelerationStructure const& other) =
+        default;
+    HostBottomLevelAccelerationStructure::HostBottomLevelAccelerationStructure(HostBottomLevelAccelerationStructure&& other) noexcept =
+        default;
+    HostBottomLevelAccelerationStructure& HostBottomLevelAccelerationStructure::operator=(
+        HostBottomLevelAccelerationStructure&& other) noexcept = default;
+
+
+    HostRaytracingAccelerationStructureManager::HostRaytracingAccelerationStructureManager() noexcept = default;
+    HostRaytracingAccelerationStructureManager::HostRaytracingAccelerationStructureManager(
+        HostRaytracingAccelerationStructureManager const& other) = default;
+    HostRaytracingAccelerationStructureManager::HostRaytracingAccelerationStructureManager(
+        HostRaytracingAccelerationStructureManager&& other) noexcept = default;
+    HostRaytracingAccelerationStructureManager& HostRaytracingAccelerationStructureManager::operator=(
+        HostRaytracingAccelerationStructureManager&& other) noexcept = default;
+
+    void HostRaytracingAccelerationStructureManager::Clear() noexcept
+    {
+        bottom_level_as_.clear();
+        instances_.clear();
+        top_level_instances_.clear();
+        top_level_bvh_ = HostBvh8();
+    }
+
+    uint32_t HostRaytracingAccelerationStructureManager::AddBottomLevelAS(
+        ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries, HostBvhBuildMode build_mode, bool allow_update)
+    {
+        uint32_t const as_id = static_cast<uint32_t>(bottom_level_as_.size());
+        bottom_level_as_.emplace_back(thread_pool, geometries, num_geometries, build_mode, allow_update);
+        return as_id;
+    }
+
+    uint32_t HostRaytracingAccelerationStructureManager::AddBottomLevelASInstance(uint32_t index, FXMMATRIX transform)
+    {
+        uint32_t const instance_index = static_cast<uint32_t>(instances_.size());
+
+        auto& instance = instances_.emplace_back();
+        XMStoreFloat4x4(&instance.object_to_world, transform);
+        XMStoreFloat4x4(&instance.world_to_object, XMMatrixInverse(nullptr, transform));
+        instance.world_bounds = TransformAabb(bottom_level_as_[index].Bounds(), transform);
+        instance.bottom_level_as_index = index;
+
+        return instance_index;
+    }
+
+    void HostRaytracingAccelerationStructureManager::AssignTopLevelAS(
+        ThreadPool& thread_pool, HostBvhBuildMode build_mode, bool allow_update)
+    {
+        // Instances are never split. Duplicating one would only make rays traverse its bottom level AS twice.
+        top_level_build_mode_ =
+            (build_mode == HostBvhBuildMode::PreferFastTraceSpatialSplits) ? HostBvhBuildMode::PreferFastTrace : build_mode;
+
+        // Instances of empty bottom level ASs can't be hit, and their bounds would break the SAH
+        top_level_instances_.clear();
+        std::vector<HostAabb> instance_bounds;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(instances_.size()); ++i)
+        {
+            if (instances_[i].world_bounds.Valid())
+            {
+                top_level_instances_.push_back(i);
+                instance_bounds.push_back(instances_[i].world_bounds);
+            }
+        }
+
+        HostBvh binary_bvh;
+        binary_bvh.Build(thread_pool, instance_bounds.data(), static_cast<uint32_t>(instance_bounds.size()), top_level_build_mode_);
+        top_level_bvh_.Build(binary_bvh, allow_update);
+    }
+
+    void HostRaytracingAccelerationStructureManager::UpdateBottomLevelAS(
+        uint32_t index, ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries)
+    {
+        bottom_level_as_[index].Update(thread_pool, geometries, num_geometries);
+    }
+
+    void HostRaytracingAccelerationStructureManager::UpdateBottomLevelASInstance(uint32_t instance_index, FXMMATRIX transform)
+    {
+        auto& instance = instances_[instance_index];
+        XMStoreFloat4x4(&instance.object_to_world, transform);
+        XMStoreFloat4x4(&instance.world_to_object, XMMatrixInverse(nullptr, transform));
+    }
+
+    void HostRaytracingAccelerationStructureManager::UpdateTopLevelAS(ThreadPool& thread_pool)
+    {
+        // Bounds of the bottom level ASs might have changed too, so every instance is transformed again
+        std::vector<HostAabb> instance_bounds(top_level_instances_.size());
+        for (uint32_t i = 0; i < static_cast<uint32_t>(instances_.size()); ++i)
+        {
+            auto& instance = instances_[i];
+            instance.world_bounds =
+                TransformAabb(bottom_level_as_[instance.bottom_level_as_index].Bounds(), XMLoadFloat4x4(&instance.object_to_world));
+        }
+        for (uint32_t i = 0; i < static_cast<uint32_t>(top_level_instances_.size()); ++i)
+        {
+            instance_bounds[i] = instances_[top_level_instances_[i]].world_bounds;
+        }
+
+        top_level_bvh_.Refit(thread_pool, instance_bounds.data());
+        if (top_level_bvh_.NeedsRebuild())
+        {
+            HostBvh binary_bvh;
+            binary_bvh.Build(thread_pool, instance_bounds.data(), static_cast<uint32_t>(instance_bounds.size()), top_level_build_mode_);
+            top_level_bvh_.Build(binary_bvh, true);
+        }
+    }
+
+    // The direction is not normalized after the transform, so t means the same point in both spaces
+    HostRay HostRaytracingAccelerationStructureManager::ToObjectSpace(HostRay const& ray, XMFLOAT4X4 const& world_to_object) noexcept
+    {
+        XMMATRIX const transform = XMLoadFloat4x4(&world_to_object);
+
+        HostRay ret;
+        XMStoreFloat3(&ret.origin, XMVector3Transform(XMLoadFloat3(&ray.origin), transform));
+        XMStoreFloat3(&ret.direction, XMVector3TransformNormal(XMLoadFloat3(&ray.direction), transform));
+        ret.t_min = ray.t_min;
+        ret.t_max = ray.t_max;
+        return ret;
+    }
+
+    // An affine transform keeps the directions inside the cone of the transformed corners, so the frustum stays valid
+    void HostRaytracingAccelerationStructureManager::ToObjectSpace(
+        HostRayPacket const& packet, XMFLOAT4X4 const& world_to_object, HostRayPacket& object_packet) noexcept
+    {
+        XMMATRIX const transform = XMLoadFloat4x4(&world_to_object);
+
+        XMStoreFloat3(&object_packet.origin, XMVector3Transform(XMLoadFloat3(&packet.origin), transform));
+        object_packet.t_min = packet.t_min;
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            XMStoreFloat3(
+                &object_packet.corner_directions[i], XMVector3TransformNormal(XMLoadFloat3(&packet.corner_directions[i]), transform));
+        }
+
+        object_packet.num_rays = packet.num_rays;
+        for (uint32_t i = 0; i < packet.num_rays; ++i)
+        {
+            XMStoreFloat3(&object_packet.directions[i], XMVector3TransformNormal(XMLoadFloat3(&packet.directions[i]), transform));
+            object_packet.t_max[i] = packet.t_max[i];
+        }
+    }
+} // namespace GoldenSun
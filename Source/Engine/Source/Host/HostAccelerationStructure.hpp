@@ -0,0 +1,315 @@
+#pragma once
+
+#include <GoldenSun/Mesh.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "HostBvh.hpp"
+#include "HostBvh8.hpp"
+#include "HostRayPacket.hpp"
+#include "HostTriangleIntersection.hpp"
+
+namespace GoldenSun
+{
+    class ThreadPool;
+
+    struct HostGeometry
+    {
+        std::vector<Vertex> vertices;
+        std::vector<Index> indices;
+        uint32_t material_id;
+        bool opaque;
+    };
+
+    // Object space triangle
+    struct HostTriangle
+    {
+        DirectX::XMFLOAT3 v0;
+        DirectX::XMFLOAT3 v1;
+        DirectX::XMFLOAT3 v2;
+        // Index of the geometry inside the bottom level AS, like GeometryIndex() in the shader
+        uint32_t geometry_index;
+        uint32_t primitive_id;
+        uint32_t padding;
+    };
+    static_assert(sizeof(HostTriangle) == 48);
+    // Every leaf fits in one SoA block
+    static_assert(HostBvh::MaxLeafSize <= HostTriangle4::Width);
+
+    class HostBottomLevelAccelerationStructure final
+    {
+    public:
+        HostBottomLevelAccelerationStructure(ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries,
+            HostBvhBuildMode build_mode, bool allow_update = false);
+
+        // A copy is a replica, with its large arrays placed by the current HostPlacementScope
+        HostBottomLevelAccelerationStructure(HostBottomLevelAccelerationStructure const& other);
+        HostBottomLevelAccelerationStructure& operator=(HostBottomLevelAccelerationStructure const& other) = delete;
+        HostBottomLevelAccelerationStructure(HostBottomLevelAccelerationStructure&& other) noexcept;
+        HostBottomLevelAccelerationStructure& operator=(HostBottomLevelAccelerationStructure&& other) noexcept;
+
+        // Refits to new vertex positions. The geometries must have the same triangles as the ones it was built from. Rebuilds, with the
+        // original build mode, when the refitted tree got too loose.
+        void Update(ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries);
+
+        HostAabb const& Bounds() const noexcept
+        {
+            return bvh_.Bounds();
+        }
+
+        HostBvh8 const& Bvh() const noexcept
+        {
+            return bvh_;
+        }
+
+        // intersect(triangle, t, barycentrics, ray) is called on every triangle the ray hits closer than ray.t_max, and accepts the hit
+        // by shortening ray.t_max to t. Otherwise follows the contract of HostBvh::Traverse. The ray is in object space, so like in DXR
+        // a mirroring instance transform doesn't flip the facing.
+        template <typename Intersector>
+        bool Traverse(HostRay& ray, bool cull_back_facing, Intersector&& intersect) const
+        {
+            HostWatertightRay const watertight_ray(ray);
+            return bvh_.TraverseLeaves(ray, [this, cull_back_facing, &watertight_ray, &intersect](
+                                                uint32_t first_ref, uint32_t /*num_refs*/, HostRay& object_ray) {
+                HostTriangleHits4 hits;
+                uint32_t hit_mask = intersect_triangles_(
+                    leaf_triangles_[leaf_triangle_indices_[first_ref]], watertight_ray, object_ray.t_max, cull_back_facing, hits);
+                while (hit_mask != 0)
+                {
+                    uint32_t const lane = LowestBit(hit_mask);
+                    hit_mask &= hit_mask - 1;
+
+                    // An earlier lane might have been accepted in the meantime
+                    if (hits.t[lane] < object_ray.t_max)
+                    {
+                        auto const& triangle = triangles_[bvh_.PrimRefs()[first_ref + lane]];
+                        if (intersect(triangle, hits.t[lane], DirectX::XMFLOAT2(hits.u[lane], hits.v[lane]), object_ray))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                return false;
+            });
+        }
+
+        // intersect(triangle, barycentrics) is called on every triangle the ray hits, from both sides, and returns true when it
+        // occludes. Follows the contract of HostBvh8::TraverseAnyHit otherwise. The ray is in object space.
+        template <typename Intersector>
+        bool TraverseAnyHit(HostRay const& ray, Intersector&& intersect) const
+        {
+            HostWatertightRay const watertight_ray(ray);
+            return bvh_.TraverseLeavesAnyHit(ray, [this, &watertight_ray, &intersect](
+                                                      uint32_t first_ref, uint32_t /*num_refs*/, HostRay const& object_ray) {
+                HostTriangleHits4 hits;
+                uint32_t hit_mask =
+                    intersect_triangles_(leaf_triangles_[leaf_triangle_indices_[first_ref]], watertight_ray, object_ray.t_max, false, hits);
+                while (hit_mask != 0)
+                {
+                    uint32_t const lane = LowestBit(hit_mask);
+                    hit_mask &= hit_mask - 1;
+
+                    auto const& triangle = triangles_[bvh_.PrimRefs()[first_ref + lane]];
+                    if (intersect(triangle, DirectX::XMFLOAT2(hits.u[lane], hits.v[lane])))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
+
+        // Trace for the rays of a coherent packet that are in ray_mask. intersect(triangle, ray_index, t, barycentrics, packet) accepts a
+        // hit by shortening packet.t_max[ray_index] to t. Follows the contract of HostBvh8::TraversePacket otherwise. The packet is in
+        // object space.
+        template <typename Intersector>
+        void TraversePacket(HostRayPacket& packet, uint64_t ray_mask, bool cull_back_facing, Intersector&& intersect) const
+        {
+            // Only the rays in ray_mask are set up
+            HostWatertightRay watertight_rays[HostRayPacket::MaxRays];
+            for (uint64_t mask = ray_mask; mask != 0; mask &= mask - 1)
+            {
+                uint32_t const i = LowestBit(mask);
+                watertight_rays[i] = HostWatertightRay(packet.Ray(i));
+            }
+
+            bvh_.TraversePacketLeaves(packet, [this, ray_mask, cull_back_facing, &watertight_rays, &intersect](uint32_t first_ref,
+                                                  uint32_t /*num_refs*/, HostRayPacket& object_packet, uint64_t leaf_ray_mask) {
+                HostTriangle4 const& leaf_triangles = leaf_triangles_[leaf_triangle_indices_[first_ref]];
+                for (uint64_t mask = leaf_ray_mask & ray_mask; mask != 0; mask &= mask - 1)
+                {
+                    uint32_t const i = LowestBit(mask);
+
+                    HostTriangleHits4 hits;
+                    uint32_t hit_mask =
+                        intersect_triangles_(leaf_triangles, watertight_rays[i], object_packet.t_max[i], cull_back_facing, hits);
+                    while (hit_mask != 0)
+                    {
+                        uint32_t const lane = LowestBit(hit_mask);
+                        hit_mask &= hit_mask - 1;
+
+                        if (hits.t[lane] < object_packet.t_max[i])
+                        {
+                            auto const& triangle = triangles_[bvh_.PrimRefs()[first_ref + lane]];
+                            intersect(triangle, i, hits.t[lane], DirectX::XMFLOAT2(hits.u[lane], hits.v[lane]), object_packet);
+                        }
+                    }
+                }
+            });
+        }
+
+    private:
+        std::vector<HostAabb> BuildTriangles(ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries);
+        void BuildBvh(ThreadPool& thread_pool, std::vector<HostAabb> const& triangle_bounds, bool allow_update);
+        // Copies the triangles into the SoA blocks of the leaves. The blocks themselves are laid out by BuildBvh.
+        void FillLeafTriangles(ThreadPool& thread_pool);
+
+    private:
+        HostVector<HostTriangle> triangles_;
+        HostBvh8 bvh_;
+        HostBvhBuildMode build_mode_;
+
+        // The triangles of every leaf of bvh_ in SoA form, found through the first primitive reference of the leaf
+        HostVector<HostTriangle4> leaf_triangles_;
+        HostVector<uint32_t> leaf_triangle_indices_;
+        HostIntersectTrianglesFunc intersect_triangles_;
+    };
+
+    // Same as RaytracingAccelerationStructureManager, but on the host. Instances reference a shared bottom level AS, and rays are
+    // transformed into the object space of every instance they reach in the top level BVH.
+    class HostRaytracingAccelerationStructureManager final
+    {
+    public:
+        HostRaytracingAccelerationStructureManager() noexcept;
+
+        // A copy is a replica, with its large arrays placed by the current HostPlacementScope
+        HostRaytracingAccelerationStructureManager(HostRaytracingAccelerationStructureManager const& other);
+        HostRaytracingAccelerationStructureManager& operator=(HostRaytracingAccelerationStructureManager const& other) = delete;
+        HostRaytracingAccelerationStructureManager(HostRaytracingAccelerationStructureManager&& other) noexcept;
+        HostRaytracingAccelerationStructureManager& operator=(HostRaytracingAccelerationStructureManager&& other) noexcept;
+
+        void Clear() noexcept;
+
+        uint32_t AddBottomLevelAS(ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries,
+            HostBvhBuildMode build_mode, bool allow_update = false);
+        uint32_t AddBottomLevelASInstance(uint32_t index, DirectX::FXMMATRIX transform);
+
+        void AssignTopLevelAS(ThreadPool& thread_pool, HostBvhBuildMode build_mode, bool allow_update = false);
+
+        // The counterparts of PERFORM_UPDATE. Bottom level ASs and instances are updated first, and then the top level AS is refitted
+        // over the new instance bounds.
+        void UpdateBottomLevelAS(uint32_t index, ThreadPool& thread_pool, HostGeometry const* geometries, uint32_t num_geometries);
+        void UpdateBottomLevelASInstance(uint32_t instance_index, DirectX::FXMMATRIX transform);
+        void UpdateTopLevelAS(ThreadPool& thread_pool);
+
+        uint32_t NumBottomLevelsASs() const noexcept
+        {
+            return static_cast<uint32_t>(bottom_level_as_.size());
+        }
+
+        HostBottomLevelAccelerationStructure const& BottomLevelAS(uint32_t index) const noexcept
+        {
+            return bottom_level_as_[index];
+        }
+
+        uint32_t NumBottomLevelASInstances() const noexcept
+        {
+            return static_cast<uint32_t>(instances_.size());
+        }
+
+        // World space bounds of every instance
+        HostAabb const& Bounds() const noexcept
+        {
+            return top_level_bvh_.Bounds();
+        }
+
+        // intersect(instance_index, triangle, t, barycentrics, object_ray) follows the contract of
+        // HostBottomLevelAccelerationStructure::Traverse. The t of the object space ray is the same as the one of the world space ray,
+        // so it can be used directly.
+        template <typename Intersector>
+        bool Traverse(HostRay& ray, bool cull_back_facing, Intersector&& intersect) const
+        {
+            return top_level_bvh_.Traverse(ray, [this, cull_back_facing, &intersect](uint32_t top_level_index, HostRay& world_ray) {
+                uint32_t const instance_index = top_level_instances_[top_level_index];
+                auto const& instance = instances_[instance_index];
+
+                HostRay object_ray = ToObjectSpace(world_ray, instance.world_to_object);
+                bool const terminated = bottom_level_as_[instance.bottom_level_as_index].Traverse(object_ray, cull_back_facing,
+                    [instance_index, &intersect](
+                        HostTriangle const& triangle, float t, DirectX::XMFLOAT2 const& barycentrics, HostRay& traversal_ray) {
+                        return intersect(instance_index, triangle, t, barycentrics, traversal_ray);
+                    });
+
+                world_ray.t_max = object_ray.t_max;
+                return terminated;
+            });
+        }
+
+        // Occlusion query. intersect(instance_index, triangle, barycentrics) follows the contract of
+        // HostBottomLevelAccelerationStructure::TraverseAnyHit.
+        template <typename Intersector>
+        bool TraverseAnyHit(HostRay const& ray, Intersector&& intersect) const
+        {
+            return top_level_bvh_.TraverseAnyHit(ray, [this, &intersect](uint32_t top_level_index, HostRay const& world_ray) {
+                uint32_t const instance_index = top_level_instances_[top_level_index];
+                auto const& instance = instances_[instance_index];
+
+                HostRay const object_ray = ToObjectSpace(world_ray, instance.world_to_object);
+                return bottom_level_as_[instance.bottom_level_as_index].TraverseAnyHit(
+                    object_ray, [instance_index, &intersect](HostTriangle const& triangle, DirectX::XMFLOAT2 const& barycentrics) {
+                        return intersect(instance_index, triangle, barycentrics);
+                    });
+            });
+        }
+
+        // Closest hits of a coherent packet. intersect(instance_index, triangle, ray_index, t, barycentrics, object_packet) follows the
+        // contract of HostBottomLevelAccelerationStructure::TraversePacket.
+        template <typename Intersector>
+        void TraversePacket(HostRayPacket& packet, bool cull_back_facing, Intersector&& intersect) const
+        {
+            top_level_bvh_.TraversePacket(packet, [this, cull_back_facing, &intersect](
+                                                      uint32_t top_level_index, HostRayPacket& world_packet, uint64_t instance_ray_mask) {
+                uint32_t const instance_index = top_level_instances_[top_level_index];
+                auto const& instance = instances_[instance_index];
+
+                HostRayPacket object_packet;
+                ToObjectSpace(world_packet, instance.world_to_object, object_packet);
+                bottom_level_as_[instance.bottom_level_as_index].TraversePacket(object_packet, instance_ray_mask, cull_back_facing,
+                    [instance_index, &intersect](HostTriangle const& triangle, uint32_t ray_index, float t,
+                        DirectX::XMFLOAT2 const& barycentrics, HostRayPacket& traversal_packet) {
+                        intersect(instance_index, triangle, ray_index, t, barycentrics, traversal_packet);
+                    });
+
+                for (uint32_t i = 0; i < world_packet.num_rays; ++i)
+                {
+                    world_packet.t_max[i] = object_packet.t_max[i];
+                }
+            });
+        }
+
+    private:
+        struct Instance
+        {
+            DirectX::XMFLOAT4X4 object_to_world;
+            DirectX::XMFLOAT4X4 world_to_object;
+            HostAabb world_bounds;
+            uint32_t bottom_level_as_index;
+        };
+
+        static HostRay ToObjectSpace(HostRay const& ray, DirectX::XMFLOAT4X4 const& world_to_object) noexcept;
+        static void ToObjectSpace(
+            HostRayPacket const& packet, DirectX::XMFLOAT4X4 const& world_to_object, HostRayPacket& object_packet) noexcept;
+
+    private:
+        std::vector<HostBottomLevelAccelerationStructure> bottom_level_as_;
+        std::vector<Instance> instances_;
+
+        // Primitives of the top level BVH are indices into top_level_instances_
+        std::vector<uint32_t> top_level_instances_;
+        HostBvh8 top_level_bvh_;
+        HostBvhBuildMode top_level_build_mode_ = HostBvhBuildMode::PreferFastTrace;
+    };
+} // namespace GoldenSun
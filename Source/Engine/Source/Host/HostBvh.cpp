@@ -0,0 +1,1258 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <array>
+#include <numeric>
+
+#include "HostBvh.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+    using namespace GoldenSun;
+
+    float Component(XMFLOAT3 const& v, uint32_t axis) noexcept
+    {
+        return (&v.x)[axis];
+    }
+
+    uint32_t constexpr MinChunkSize = 4096;
+
+    uint32_t ChunkSize(ThreadPool const& thread_pool, uint32_t begin, uint32_t end) noexcept
+    {
+        uint32_t const max_chunks = thread_pool.NumThreads() * 4;
+        return std::max(MinChunkSize, (end - begin + max_chunks - 1) / max_chunks);
+    }
+
+    uint32_t NumChunks(ThreadPool const& thread_pool, uint32_t begin, uint32_t end) noexcept
+    {
+        uint32_t const chunk_size = ChunkSize(thread_pool, begin, end);
+        return (end - begin + chunk_size - 1) / chunk_size;
+    }
+
+    // func(chunk_begin, chunk_end, chunk_index) over [begin, end), in parallel
+    template <typename Func>
+    void ForEachChunk(ThreadPool& thread_pool, uint32_t begin, uint32_t end, Func const& func)
+    {
+        uint32_t const chunk_size = ChunkSize(thread_pool, begin, end);
+        thread_pool.ParallelFor(
+            NumChunks(thread_pool, begin, end), [begin, end, chunk_size, &func](uint32_t chunk, uint32_t /*thread_index*/) {
+                uint32_t const chunk_begin = begin + chunk * chunk_size;
+                func(chunk_begin, std::min(chunk_begin + chunk_size, end), chunk);
+            });
+    }
+
+    // The splitter of primitives that fill their bounds
+    void SplitAabb(uint32_t /*prim*/, HostAabb const& ref_bounds, uint32_t axis, float position, HostAabb& left, HostAabb& right) noexcept
+    {
+        left = ref_bounds;
+        right = ref_bounds;
+        (&left.max.x)[axis] = std::min(Component(ref_bounds.max, axis), position);
+        (&right.min.x)[axis] = std::max(Component(ref_bounds.min, axis), position);
+    }
+
+    // Binned SAH (Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies"). Ranges larger than the parallel threshold
+    // are split with data-parallel binning and partitioning, then the remaining subtrees are built independently, one per task.
+    //
+    // With a splitter, it becomes an SBVH (Stich et al., "Spatial Splits in Bounding Volume Hierarchies"). Where the children of the
+    // best object split overlap, spatial bins are tried too, and references straddling their plane are clipped into both children.
+    // Every range owns some free slots after its references for those duplicates, handed down to the children in proportion to their
+    // sizes. Once a range runs out of them, it only gets object splits, which caps the memory growth.
+    class BinnedSahBuilder
+    {
+        static uint32_t constexpr NumBins = 16;
+        static uint32_t constexpr MinParallelSize = 16384;
+        static float constexpr TraversalCost = 1;
+        static float constexpr IntersectionCost = 1;
+        // Extra references spatial splits can create, relative to the number of primitives
+        static float constexpr MaxReferenceGrowth = 0.25f;
+        // Spatial splits are only tried when the children of the object split overlap by more than this fraction of the root area
+        static float constexpr MinSpatialSplitOverlap = 1e-5f;
+
+        // Bounds travel with the reference, so partitioning streams through memory instead of gathering from prim_bounds
+        struct PrimRef
+        {
+            HostAabb bounds;
+            uint32_t prim;
+        };
+
+        struct RangeInfo
+        {
+            HostAabb bounds;
+            HostAabb center_bounds;
+
+            void Grow(RangeInfo const& rhs) noexcept
+            {
+                bounds.Grow(rhs.bounds);
+                center_bounds.Grow(rhs.center_bounds);
+            }
+        };
+
+        struct Task
+        {
+            uint32_t node_index;
+            uint32_t begin;
+            uint32_t end;
+            // [end, ext_end) are the free slots of the range
+            uint32_t ext_end;
+            uint32_t depth;
+            RangeInfo info;
+        };
+
+        struct Bin
+        {
+            RangeInfo info;
+            uint32_t count = 0;
+        };
+
+        struct Bins
+        {
+            Bin bins[3][NumBins];
+
+            void Merge(Bins const& rhs) noexcept
+            {
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    for (uint32_t i = 0; i < NumBins; ++i)
+                    {
+                        bins[axis][i].info.Grow(rhs.bins[axis][i].info);
+                        bins[axis][i].count += rhs.bins[axis][i].count;
+                    }
+                }
+            }
+        };
+
+        struct Split
+        {
+            uint32_t axis;
+            uint32_t bin;
+            float cost;
+            RangeInfo left_info;
+            RangeInfo right_info;
+        };
+
+        // References are counted in the bin they enter and the one they exit. The bounds are the ones of their clipped pieces.
+        struct SpatialBin
+        {
+            HostAabb bounds;
+            uint32_t entries = 0;
+            uint32_t exits = 0;
+        };
+
+        struct SpatialBins
+        {
+            SpatialBin bins[3][NumBins];
+
+            void Merge(SpatialBins const& rhs) noexcept
+            {
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    for (uint32_t i = 0; i < NumBins; ++i)
+                    {
+                        bins[axis][i].bounds.Grow(rhs.bins[axis][i].bounds);
+                        bins[axis][i].entries += rhs.bins[axis][i].entries;
+                        bins[axis][i].exits += rhs.bins[axis][i].exits;
+                    }
+                }
+            }
+        };
+
+        // Bins of equal width over the node bounds, instead of the center bounds
+        class SpatialBinner
+        {
+        public:
+            explicit SpatialBinner(HostAabb const& bounds) noexcept : offset_(bounds.min)
+            {
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    float const extent = Component(bounds.max, axis) - Component(bounds.min, axis);
+                    (&width_.x)[axis] = extent / NumBins;
+                    (&scale_.x)[axis] = (extent > 0) ? NumBins * 0.99999f / extent : 0.0f;
+                }
+            }
+
+            uint32_t BinIndex(float position, uint32_t axis) const noexcept
+            {
+                float const f = (position - Component(offset_, axis)) * Component(scale_, axis);
+                return std::min(static_cast<uint32_t>(std::max(f, 0.0f)), NumBins - 1);
+            }
+
+            // Left side of a bin
+            float Plane(uint32_t bin, uint32_t axis) const noexcept
+            {
+                return Component(offset_, axis) + bin * Component(width_, axis);
+            }
+
+            bool Splittable(uint32_t axis) const noexcept
+            {
+                return Component(scale_, axis) > 0;
+            }
+
+        private:
+            XMFLOAT3 offset_;
+            XMFLOAT3 width_{};
+            XMFLOAT3 scale_{};
+        };
+
+        struct SpatialSplit
+        {
+            uint32_t axis;
+            uint32_t bin;
+            float position;
+            float cost;
+        };
+
+        class Binner
+        {
+        public:
+            explicit Binner(HostAabb const& center_bounds) noexcept
+            {
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    float const extent = Component(center_bounds.max, axis) - Component(center_bounds.min, axis);
+                    (&offset_.x)[axis] = Component(center_bounds.min, axis);
+                    (&scale_.x)[axis] = (extent > 0) ? NumBins * 0.99999f / extent : 0.0f;
+                }
+            }
+
+            uint32_t BinIndex(XMFLOAT3 const& center, uint32_t axis) const noexcept
+            {
+                float const f = (Component(center, axis) - Component(offset_, axis)) * Component(scale_, axis);
+                return std::min(static_cast<uint32_t>(std::max(f, 0.0f)), NumBins - 1);
+            }
+
+            bool Splittable(uint32_t axis) const noexcept
+            {
+                return Component(scale_, axis) > 0;
+            }
+
+        private:
+            XMFLOAT3 offset_{};
+            XMFLOAT3 scale_{};
+        };
+
+    public:
+        // split_prim enables the spatial splits
+        BinnedSahBuilder(ThreadPool& thread_pool, HostAabb const* prim_bounds, uint32_t num_prims, std::vector<HostBvhNode>& nodes,
+            std::vector<uint32_t>& prim_refs, HostBvhPrimSplitter split_prim = {})
+            : thread_pool_(thread_pool), nodes_(nodes), prim_refs_(prim_refs), split_prim_(std::move(split_prim)), num_prims_(num_prims)
+        {
+            uint32_t const capacity = num_prims + (split_prim_ ? static_cast<uint32_t>(num_prims * MaxReferenceGrowth) : 0);
+            refs_.resize(capacity);
+            scratch_refs_.resize(capacity);
+
+            parallel_threshold_ = std::max(MinParallelSize, num_prims / (thread_pool_.NumThreads() * 8));
+
+            ForEachChunk(thread_pool_, 0, num_prims, [this, prim_bounds](uint32_t begin, uint32_t end, uint32_t /*chunk*/) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    refs_[i] = {prim_bounds[i], i};
+                }
+            });
+        }
+
+        void Build()
+        {
+            uint32_t const num_prims = num_prims_;
+            uint32_t const capacity = static_cast<uint32_t>(refs_.size());
+
+            nodes_.reserve(num_prims * 2 - 1);
+            nodes_.emplace_back();
+
+            std::vector<Task> pending_tasks;
+            pending_tasks.push_back({0, 0, num_prims, capacity, 0, this->RangeInfoOf(0, num_prims)});
+            root_half_area_ = pending_tasks[0].info.bounds.HalfArea();
+
+            // The top of the tree, split with all threads working on the same range
+            std::vector<Task> subtree_tasks;
+            while (!pending_tasks.empty())
+            {
+                Task const task = pending_tasks.back();
+                pending_tasks.pop_back();
+
+                if (task.end - task.begin <= parallel_threshold_)
+                {
+                    subtree_tasks.push_back(task);
+                    continue;
+                }
+
+                Task children[2];
+                if (this->SplitNode(task, nodes_, children))
+                {
+                    uint32_t const first_child = static_cast<uint32_t>(nodes_.size());
+                    nodes_.resize(nodes_.size() + 2);
+                    nodes_[task.node_index].offset = first_child;
+                    nodes_[task.node_index].num_prims = 0;
+
+                    for (uint32_t i = 0; i < 2; ++i)
+                    {
+                        children[i].node_index = first_child + i;
+                        pending_tasks.push_back(children[i]);
+                    }
+                }
+            }
+
+            // Big subtrees first, so the last ones to start are the cheap ones
+            std::sort(subtree_tasks.begin(), subtree_tasks.end(),
+                [](Task const& lhs, Task const& rhs) { return (lhs.end - lhs.begin) > (rhs.end - rhs.begin); });
+
+            std::vector<std::vector<HostBvhNode>> subtree_nodes(subtree_tasks.size());
+            thread_pool_.ParallelFor(static_cast<uint32_t>(subtree_tasks.size()),
+                [this, &subtree_tasks, &subtree_nodes](uint32_t index, uint32_t /*thread_index*/) {
+                    auto& local_nodes = subtree_nodes[index];
+                    local_nodes.reserve((subtree_tasks[index].end - subtree_tasks[index].begin) * 2 - 1);
+                    local_nodes.emplace_back();
+
+                    Task task = subtree_tasks[index];
+                    task.node_index = 0;
+                    this->BuildSubtree(task, local_nodes);
+                });
+
+            // Stitch the subtrees into nodes_. The local root replaces the placeholder node, the rest is appended.
+            std::vector<uint32_t> subtree_bases(subtree_tasks.size() + 1);
+            subtree_bases[0] = static_cast<uint32_t>(nodes_.size());
+            for (size_t i = 0; i < subtree_tasks.size(); ++i)
+            {
+                subtree_bases[i + 1] = subtree_bases[i] + static_cast<uint32_t>(subtree_nodes[i].size()) - 1;
+            }
+            nodes_.resize(subtree_bases.back());
+
+            thread_pool_.ParallelFor(static_cast<uint32_t>(subtree_tasks.size()),
+                [this, &subtree_tasks, &subtree_nodes, &subtree_bases](uint32_t index, uint32_t /*thread_index*/) {
+                    auto const& local_nodes = subtree_nodes[index];
+                    uint32_t const base = subtree_bases[index];
+                    auto const relocate = [base](HostBvhNode node) {
+                        if (node.num_prims == 0)
+                        {
+                            node.offset = base + node.offset - 1;
+                        }
+                        return node;
+                    };
+
+                    nodes_[subtree_tasks[index].node_index] = relocate(local_nodes[0]);
+                    for (size_t i = 1; i < local_nodes.size(); ++i)
+                    {
+                        nodes_[base + i - 1] = relocate(local_nodes[i]);
+                    }
+                });
+
+            // Free slots left over from the spatial splits are copied along. No leaf points to them.
+            prim_refs_.resize(capacity);
+            ForEachChunk(thread_pool_, 0, capacity, [this](uint32_t begin, uint32_t end, uint32_t /*chunk*/) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    prim_refs_[i] = refs_[i].prim;
+                }
+            });
+        }
+
+    private:
+        void BuildSubtree(Task const& task, std::vector<HostBvhNode>& local_nodes)
+        {
+            Task children[2];
+            if (this->SplitNode(task, local_nodes, children))
+            {
+                uint32_t const first_child = static_cast<uint32_t>(local_nodes.size());
+                local_nodes.resize(local_nodes.size() + 2);
+                local_nodes[task.node_index].offset = first_child;
+                local_nodes[task.node_index].num_prims = 0;
+
+                for (uint32_t i = 0; i < 2; ++i)
+                {
+                    children[i].node_index = first_child + i;
+                    this->BuildSubtree(children[i], local_nodes);
+                }
+            }
+        }
+
+        // Returns false when the task becomes a leaf. Otherwise the range is partitioned and the children are filled, except for their
+        // node_index. The node of the task gets its bounds either way.
+        bool SplitNode(Task const& task, std::vector<HostBvhNode>& nodes, Task children[2])
+        {
+            uint32_t const count = task.end - task.begin;
+            Binner const binner(task.info.center_bounds);
+
+            Split split;
+            bool const found = this->FindSplit(task, binner, split);
+
+            float const leaf_cost = IntersectionCost * count;
+            if ((count <= HostBvh::MaxLeafSize) && (!found || (leaf_cost <= split.cost)))
+            {
+                MakeLeaf(task, nodes[task.node_index]);
+                return false;
+            }
+
+            nodes[task.node_index].bounds = task.info.bounds;
+            children[0].depth = children[1].depth = task.depth + 1;
+
+            bool const sah_allowed = task.depth + 32 < HostBvh::MaxDepth;
+            if (sah_allowed && split_prim_ && (task.ext_end > task.end) && (!found || this->ChildrenOverlap(split)))
+            {
+                SpatialBinner const spatial_binner(task.info.bounds);
+                SpatialSplit spatial_split;
+                if (this->FindSpatialSplit(task, spatial_binner, found ? split.cost : std::numeric_limits<float>::max(), spatial_split) &&
+                    this->SpatialPartition(task, spatial_binner, spatial_split, children))
+                {
+                    return true;
+                }
+            }
+
+            uint32_t mid;
+            // SAH while there is depth budget left, then object median, which bounds the depth by log2(count)
+            if (found && sah_allowed)
+            {
+                mid = this->Partition(task.begin, task.end,
+                    [&binner, &split](PrimRef const& ref) { return binner.BinIndex(ref.bounds.Center(), split.axis) < split.bin; });
+                children[0].info = split.left_info;
+                children[1].info = split.right_info;
+            }
+            else
+            {
+                uint32_t axis = 0;
+                for (uint32_t i = 1; i < 3; ++i)
+                {
+                    if (Component(task.info.center_bounds.max, i) - Component(task.info.center_bounds.min, i) >
+                        Component(task.info.center_bounds.max, axis) - Component(task.info.center_bounds.min, axis))
+                    {
+                        axis = i;
+                    }
+                }
+
+                mid = task.begin + count / 2;
+                std::nth_element(refs_.begin() + task.begin, refs_.begin() + mid, refs_.begin() + task.end,
+                    [axis](PrimRef const& lhs, PrimRef const& rhs) {
+                        return Component(lhs.bounds.min, axis) + Component(lhs.bounds.max, axis) <
+                               Component(rhs.bounds.min, axis) + Component(rhs.bounds.max, axis);
+                    });
+                children[0].info = this->RangeInfoOf(task.begin, mid);
+                children[1].info = this->RangeInfoOf(mid, task.end);
+            }
+
+            if ((mid == task.begin) || (mid == task.end))
+            {
+                // Can only happen with NaN in the input. Don't loop forever on it.
+                MakeLeaf(task, nodes[task.node_index]);
+                return false;
+            }
+
+            // Without spatial splits there are no free slots, and nothing moves
+            uint32_t const left_slack = this->LeftSlack(task, mid - task.begin, task.end - mid);
+            if (left_slack > 0)
+            {
+                std::copy_backward(refs_.begin() + mid, refs_.begin() + task.end, refs_.begin() + task.end + left_slack);
+            }
+
+            children[0].begin = task.begin;
+            children[0].end = mid;
+            children[0].ext_end = mid + left_slack;
+            children[1].begin = mid + left_slack;
+            children[1].end = task.end + left_slack;
+            children[1].ext_end = task.ext_end;
+            return true;
+        }
+
+        bool ChildrenOverlap(Split const& split) const noexcept
+        {
+            HostAabb overlap = split.left_info.bounds;
+            overlap.Intersect(split.right_info.bounds);
+            return overlap.Valid() && (overlap.HalfArea() > MinSpatialSplitOverlap * root_half_area_);
+        }
+
+        // The share of the free slots for the left child of a split into num_left and num_right references
+        static uint32_t LeftSlack(Task const& task, uint32_t num_left, uint32_t num_right) noexcept
+        {
+            uint64_t const slack = (task.ext_end - task.begin) - (num_left + num_right);
+            return static_cast<uint32_t>(slack * num_left / (num_left + num_right));
+        }
+
+        // Returns false if no spatial split is cheaper than max_cost, or if it needs more free slots than the range has
+        bool FindSpatialSplit(Task const& task, SpatialBinner const& binner, float max_cost, SpatialSplit& split)
+        {
+            SpatialBins bins;
+            if (task.end - task.begin > parallel_threshold_)
+            {
+                std::vector<SpatialBins> chunk_bins(NumChunks(thread_pool_, task.begin, task.end));
+                ForEachChunk(thread_pool_, task.begin, task.end,
+                    [this, &binner, &chunk_bins](uint32_t begin, uint32_t end, uint32_t chunk) {
+                        this->BinSpatially(begin, end, binner, chunk_bins[chunk]);
+                    });
+                for (auto const& b : chunk_bins)
+                {
+                    bins.Merge(b);
+                }
+            }
+            else
+            {
+                this->BinSpatially(task.begin, task.end, binner, bins);
+            }
+
+            uint32_t const count = task.end - task.begin;
+            uint32_t const max_duplicates = task.ext_end - task.end;
+            float const inv_parent_area = 1 / std::max(task.info.bounds.HalfArea(), std::numeric_limits<float>::min());
+
+            split.cost = max_cost;
+            bool found = false;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                if (!binner.Splittable(axis))
+                {
+                    continue;
+                }
+
+                float right_costs[NumBins];
+                uint32_t right_counts[NumBins];
+                HostAabb accum;
+                uint32_t accum_count = 0;
+                for (uint32_t i = NumBins - 1; i > 0; --i)
+                {
+                    accum.Grow(bins.bins[axis][i].bounds);
+                    accum_count += bins.bins[axis][i].exits;
+                    right_counts[i] = accum_count;
+                    right_costs[i] = (accum_count > 0) ? accum.HalfArea() * accum_count : 0.0f;
+                }
+
+                accum = HostAabb();
+                accum_count = 0;
+                for (uint32_t i = 1; i < NumBins; ++i)
+                {
+                    accum.Grow(bins.bins[axis][i - 1].bounds);
+                    accum_count += bins.bins[axis][i - 1].entries;
+                    if ((accum_count == 0) || (right_counts[i] == 0) || (accum_count + right_counts[i] - count > max_duplicates))
+                    {
+                        continue;
+                    }
+
+                    float const cost =
+                        TraversalCost + IntersectionCost * (accum.HalfArea() * accum_count + right_costs[i]) * inv_parent_area;
+                    if (cost < split.cost)
+                    {
+                        split.axis = axis;
+                        split.bin = i;
+                        split.position = binner.Plane(i, axis);
+                        split.cost = cost;
+                        found = true;
+                    }
+                }
+            }
+
+            return found;
+        }
+
+        void BinSpatially(uint32_t begin, uint32_t end, SpatialBinner const& binner, SpatialBins& bins) const
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                auto const& ref = refs_[i];
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    if (!binner.Splittable(axis))
+                    {
+                        continue;
+                    }
+
+                    auto* axis_bins = bins.bins[axis];
+                    uint32_t const first_bin = binner.BinIndex(Component(ref.bounds.min, axis), axis);
+                    uint32_t const last_bin = binner.BinIndex(Component(ref.bounds.max, axis), axis);
+                    ++axis_bins[first_bin].entries;
+                    ++axis_bins[last_bin].exits;
+
+                    // Chop the reference from left to right, one bin at a time
+                    HostAabb rest = ref.bounds;
+                    for (uint32_t bin = first_bin; bin < last_bin; ++bin)
+                    {
+                        HostAabb left;
+                        HostAabb right;
+                        split_prim_(ref.prim, rest, axis, binner.Plane(bin + 1, axis), left, right);
+                        if (left.Valid())
+                        {
+                            axis_bins[bin].bounds.Grow(left);
+                        }
+                        rest = right;
+                    }
+                    if (rest.Valid())
+                    {
+                        axis_bins[last_bin].bounds.Grow(rest);
+                    }
+                }
+            }
+        }
+
+        // Classifies the references by the same bins FindSpatialSplit used, and writes both sides back into the range, with the free
+        // slots split between them. Returns false, leaving the range untouched, if clipping emptied one side. The sides are gathered in
+        // the range's own part of scratch_refs_, which no other task touches, so subtrees partition concurrently without allocating.
+        bool SpatialPartition(Task const& task, SpatialBinner const& binner, SpatialSplit const& split, Task children[2])
+        {
+            uint32_t const capacity = task.ext_end - task.begin;
+            uint32_t num_left;
+            uint32_t num_right;
+            uint32_t right_begin;
+            if (task.end - task.begin > parallel_threshold_)
+            {
+                // Count, scatter into the scratch buffer, copy back. The straddling references are clipped in both passes.
+                uint32_t const num_chunks = NumChunks(thread_pool_, task.begin, task.end);
+                std::vector<std::array<uint32_t, 2>> chunk_counts(num_chunks);
+                ForEachChunk(thread_pool_, task.begin, task.end,
+                    [this, &binner, &split, &chunk_counts](uint32_t chunk_begin, uint32_t chunk_end, uint32_t chunk) {
+                        auto& counts = chunk_counts[chunk];
+                        counts = {0, 0};
+                        for (uint32_t i = chunk_begin; i < chunk_end; ++i)
+                        {
+                            this->ClassifySpatially(
+                                refs_[i], binner, split, [&counts](uint32_t side, PrimRef const& /*ref*/) { ++counts[side]; });
+                        }
+                    });
+
+                num_left = 0;
+                num_right = 0;
+                for (auto const& counts : chunk_counts)
+                {
+                    num_left += counts[0];
+                    num_right += counts[1];
+                }
+                if ((num_left == 0) || (num_right == 0) || (num_left + num_right > capacity))
+                {
+                    return false;
+                }
+                right_begin = task.begin + num_left + this->LeftSlack(task, num_left, num_right);
+
+                std::vector<std::array<uint32_t, 2>> chunk_offsets(num_chunks);
+                uint32_t left_offset = task.begin;
+                uint32_t right_offset = right_begin;
+                for (uint32_t chunk = 0; chunk < num_chunks; ++chunk)
+                {
+                    chunk_offsets[chunk] = {left_offset, right_offset};
+                    left_offset += chunk_counts[chunk][0];
+                    right_offset += chunk_counts[chunk][1];
+                }
+
+                ForEachChunk(thread_pool_, task.begin, task.end,
+                    [this, &binner, &split, &chunk_offsets](uint32_t chunk_begin, uint32_t chunk_end, uint32_t chunk) {
+                        auto offsets = chunk_offsets[chunk];
+                        for (uint32_t i = chunk_begin; i < chunk_end; ++i)
+                        {
+                            this->ClassifySpatially(refs_[i], binner, split, [this, &offsets](uint32_t side, PrimRef const& ref) {
+                                scratch_refs_[offsets[side]] = ref;
+                                ++offsets[side];
+                            });
+                        }
+                    });
+                ForEachChunk(thread_pool_, task.begin, task.ext_end, [this](uint32_t chunk_begin, uint32_t chunk_end, uint32_t /*chunk*/) {
+                    std::copy(scratch_refs_.begin() + chunk_begin, scratch_refs_.begin() + chunk_end, refs_.begin() + chunk_begin);
+                });
+            }
+            else
+            {
+                // The left side grows from the front, the right side from the back, until they meet
+                uint32_t left = task.begin;
+                uint32_t right = task.ext_end;
+                bool overflow = false;
+                for (uint32_t i = task.begin; (i < task.end) && !overflow; ++i)
+                {
+                    this->ClassifySpatially(refs_[i], binner, split, [this, &left, &right, &overflow](uint32_t side, PrimRef const& ref) {
+                        if (left == right)
+                        {
+                            overflow = true;
+                        }
+                        else if (side == 0)
+                        {
+                            scratch_refs_[left] = ref;
+                            ++left;
+                        }
+                        else
+                        {
+                            --right;
+                            scratch_refs_[right] = ref;
+                        }
+                    });
+                }
+
+                num_left = left - task.begin;
+                num_right = task.ext_end - right;
+                if (overflow || (num_left == 0) || (num_right == 0))
+                {
+                    return false;
+                }
+                right_begin = task.begin + num_left + this->LeftSlack(task, num_left, num_right);
+
+                std::copy(scratch_refs_.begin() + task.begin, scratch_refs_.begin() + left, refs_.begin() + task.begin);
+                std::reverse_copy(scratch_refs_.begin() + right, scratch_refs_.begin() + task.ext_end, refs_.begin() + right_begin);
+            }
+
+            children[0].begin = task.begin;
+            children[0].end = task.begin + num_left;
+            children[0].ext_end = right_begin;
+            children[0].info = this->RangeInfoOf(children[0].begin, children[0].end);
+            children[1].begin = right_begin;
+            children[1].end = right_begin + num_right;
+            children[1].ext_end = task.ext_end;
+            children[1].info = this->RangeInfoOf(children[1].begin, children[1].end);
+            return true;
+        }
+
+        // emit(side, ref) for every side of the split the reference lands on, 0 for left and 1 for right, clipped if it straddles it
+        template <typename Emit>
+        void ClassifySpatially(PrimRef const& ref, SpatialBinner const& binner, SpatialSplit const& split, Emit const& emit) const
+        {
+            uint32_t const first_bin = binner.BinIndex(Component(ref.bounds.min, split.axis), split.axis);
+            uint32_t const last_bin = binner.BinIndex(Component(ref.bounds.max, split.axis), split.axis);
+            if (last_bin < split.bin)
+            {
+                emit(0, ref);
+            }
+            else if (first_bin >= split.bin)
+            {
+                emit(1, ref);
+            }
+            else
+            {
+                PrimRef left{{}, ref.prim};
+                PrimRef right{{}, ref.prim};
+                split_prim_(ref.prim, ref.bounds, split.axis, split.position, left.bounds, right.bounds);
+                if (left.bounds.Valid())
+                {
+                    emit(0, left);
+                }
+                if (right.bounds.Valid())
+                {
+                    emit(1, right);
+                }
+                if (!left.bounds.Valid() && !right.bounds.Valid())
+                {
+                    // Lost to rounding while clipping. The reference must survive somewhere.
+                    emit((Component(ref.bounds.Center(), split.axis) < split.position) ? 0 : 1, ref);
+                }
+            }
+        }
+
+        bool FindSplit(Task const& task, Binner const& binner, Split& split)
+        {
+            Bins bins;
+            if (task.end - task.begin > parallel_threshold_)
+            {
+                std::vector<Bins> chunk_bins(NumChunks(thread_pool_, task.begin, task.end));
+                ForEachChunk(thread_pool_, task.begin, task.end,
+                    [this, &binner, &chunk_bins](uint32_t begin, uint32_t end, uint32_t chunk) {
+                        this->BinPrims(begin, end, binner, chunk_bins[chunk]);
+                    });
+                for (auto const& b : chunk_bins)
+                {
+                    bins.Merge(b);
+                }
+            }
+            else
+            {
+                this->BinPrims(task.begin, task.end, binner, bins);
+            }
+
+            float const inv_parent_area = 1 / std::max(task.info.bounds.HalfArea(), std::numeric_limits<float>::min());
+
+            split.cost = std::numeric_limits<float>::max();
+            bool found = false;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                if (!binner.Splittable(axis))
+                {
+                    continue;
+                }
+
+                // Sweep from the right to get the cost of the right side of every plane, then from the left to evaluate them
+                RangeInfo right_infos[NumBins];
+                float right_costs[NumBins];
+                RangeInfo accum;
+                uint32_t accum_count = 0;
+                for (uint32_t i = NumBins - 1; i > 0; --i)
+                {
+                    accum.Grow(bins.bins[axis][i].info);
+                    accum_count += bins.bins[axis][i].count;
+                    right_infos[i] = accum;
+                    right_costs[i] = (accum_count > 0) ? accum.bounds.HalfArea() * accum_count : 0.0f;
+                }
+
+                accum = RangeInfo();
+                accum_count = 0;
+                for (uint32_t i = 1; i < NumBins; ++i)
+                {
+                    accum.Grow(bins.bins[axis][i - 1].info);
+                    accum_count += bins.bins[axis][i - 1].count;
+                    if ((accum_count == 0) || (accum_count == task.end - task.begin))
+                    {
+                        continue;
+                    }
+
+                    float const cost =
+                        TraversalCost + IntersectionCost * (accum.bounds.HalfArea() * accum_count + right_costs[i]) * inv_parent_area;
+                    if (cost < split.cost)
+                    {
+                        split.axis = axis;
+                        split.bin = i;
+                        split.cost = cost;
+                        split.left_info = accum;
+                        split.right_info = right_infos[i];
+                        found = true;
+                    }
+                }
+            }
+
+            return found;
+        }
+
+        void BinPrims(uint32_t begin, uint32_t end, Binner const& binner, Bins& bins) const noexcept
+        {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                auto const& ref = refs_[i];
+                XMFLOAT3 const center = ref.bounds.Center();
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    auto& bin = bins.bins[axis][binner.BinIndex(center, axis)];
+                    bin.info.bounds.Grow(ref.bounds);
+                    bin.info.center_bounds.Grow(center);
+                    ++bin.count;
+                }
+            }
+        }
+
+        template <typename Predicate>
+        uint32_t Partition(uint32_t begin, uint32_t end, Predicate const& pred)
+        {
+            if (end - begin <= parallel_threshold_)
+            {
+                return static_cast<uint32_t>(std::partition(refs_.begin() + begin, refs_.begin() + end, pred) - refs_.begin());
+            }
+
+            // Count, scatter into the scratch buffer, copy back. Each side keeps the original order.
+            uint32_t const num_chunks = NumChunks(thread_pool_, begin, end);
+            std::vector<uint32_t> left_counts(num_chunks);
+            ForEachChunk(thread_pool_, begin, end, [this, &pred, &left_counts](uint32_t chunk_begin, uint32_t chunk_end, uint32_t chunk) {
+                left_counts[chunk] = static_cast<uint32_t>(std::count_if(refs_.begin() + chunk_begin, refs_.begin() + chunk_end, pred));
+            });
+
+            std::vector<uint32_t> left_offsets(num_chunks);
+            std::vector<uint32_t> right_offsets(num_chunks);
+            uint32_t const num_left = std::accumulate(left_counts.begin(), left_counts.end(), 0U);
+            uint32_t left_offset = begin;
+            uint32_t right_offset = begin + num_left;
+            for (uint32_t chunk = 0; chunk < num_chunks; ++chunk)
+            {
+                uint32_t const chunk_begin = begin + chunk * ChunkSize(thread_pool_, begin, end);
+                uint32_t const chunk_end = std::min(chunk_begin + ChunkSize(thread_pool_, begin, end), end);
+
+                left_offsets[chunk] = left_offset;
+                right_offsets[chunk] = right_offset;
+                left_offset += left_counts[chunk];
+                right_offset += (chunk_end - chunk_begin) - left_counts[chunk];
+            }
+
+            ForEachChunk(thread_pool_, begin, end,
+                [this, &pred, &left_offsets, &right_offsets](uint32_t chunk_begin, uint32_t chunk_end, uint32_t chunk) {
+                    uint32_t left = left_offsets[chunk];
+                    uint32_t right = right_offsets[chunk];
+                    for (uint32_t i = chunk_begin; i < chunk_end; ++i)
+                    {
+                        auto const& ref = refs_[i];
+                        if (pred(ref))
+                        {
+                            scratch_refs_[left] = ref;
+                            ++left;
+                        }
+                        else
+                        {
+                            scratch_refs_[right] = ref;
+                            ++right;
+                        }
+                    }
+                });
+            ForEachChunk(thread_pool_, begin, end, [this](uint32_t chunk_begin, uint32_t chunk_end, uint32_t /*chunk*/) {
+                std::copy(scratch_refs_.begin() + chunk_begin, scratch_refs_.begin() + chunk_end, refs_.begin() + chunk_begin);
+            });
+
+            return begin + num_left;
+        }
+
+        RangeInfo RangeInfoOf(uint32_t begin, uint32_t end)
+        {
+            auto const grow = [this](uint32_t range_begin, uint32_t range_end, RangeInfo& info) {
+                for (uint32_t i = range_begin; i < range_end; ++i)
+                {
+                    info.bounds.Grow(refs_[i].bounds);
+                    info.center_bounds.Grow(refs_[i].bounds.Center());
+                }
+            };
+
+            RangeInfo info;
+            if (end - begin > parallel_threshold_)
+            {
+                std::vector<RangeInfo> chunk_infos(NumChunks(thread_pool_, begin, end));
+                ForEachChunk(thread_pool_, begin, end, [&grow, &chunk_infos](uint32_t chunk_begin, uint32_t chunk_end, uint32_t chunk) {
+                    grow(chunk_begin, chunk_end, chunk_infos[chunk]);
+                });
+                for (auto const& chunk_info : chunk_infos)
+                {
+                    info.Grow(chunk_info);
+                }
+            }
+            else
+            {
+                grow(begin, end, info);
+            }
+            return info;
+        }
+
+        static void MakeLeaf(Task const& task, HostBvhNode& node) noexcept
+        {
+            node.bounds = task.info.bounds;
+            node.offset = task.begin;
+            node.num_prims = task.end - task.begin;
+        }
+
+    private:
+        ThreadPool& thread_pool_;
+        std::vector<HostBvhNode>& nodes_;
+        std::vector<uint32_t>& prim_refs_;
+        HostBvhPrimSplitter const split_prim_;
+        uint32_t const num_prims_;
+        std::vector<PrimRef> refs_;
+        std::vector<PrimRef> scratch_refs_;
+        uint32_t parallel_threshold_;
+        float root_half_area_ = 0;
+    };
+
+    // LBVH (Lauterbach et al., "Fast BVH Construction on GPUs"). Primitives are sorted along the Morton curve of their centers with a
+    // parallel radix sort, then every range is split where the highest differing bit of its codes flips, down to leaves of up to
+    // HostBvh::MaxLeafSize primitives. The top of the tree is split serially, the subtrees below it are built in parallel.
+    class LinearBuilder
+    {
+        static uint32_t constexpr RadixBits = 8;
+        static uint32_t constexpr NumBuckets = 1U << RadixBits;
+        // 10 bits per axis until there are enough primitives to crowd a 1024^3 grid, then 21
+        static uint32_t constexpr MaxPrimsFor30BitCodes = 1U << 20;
+        static uint32_t constexpr MinParallelSize = 16384;
+
+        struct Task
+        {
+            uint32_t node_index;
+            uint32_t begin;
+            uint32_t end;
+            uint32_t depth;
+        };
+
+    public:
+        LinearBuilder(ThreadPool& thread_pool, HostAabb const* prim_bounds, uint32_t num_prims, std::vector<HostBvhNode>& nodes,
+            std::vector<uint32_t>& prim_refs)
+            : thread_pool_(thread_pool), prim_bounds_(prim_bounds), nodes_(nodes), prim_refs_(prim_refs), codes_(num_prims),
+              scratch_codes_(num_prims), scratch_refs_(num_prims)
+        {
+            parallel_threshold_ = std::max(MinParallelSize, num_prims / (thread_pool_.NumThreads() * 8));
+            code_bits_ = (num_prims <= MaxPrimsFor30BitCodes) ? 30 : 63;
+        }
+
+        void Build()
+        {
+            uint32_t const num_prims = static_cast<uint32_t>(codes_.size());
+
+            this->ComputeCodes();
+            this->SortCodes();
+
+            nodes_.reserve(num_prims * 2 - 1);
+            nodes_.emplace_back();
+
+            // The top of the tree is split serially. Its nodes get their bounds after the subtrees below them are done.
+            std::vector<Task> pending_tasks;
+            pending_tasks.push_back({0, 0, num_prims, 0});
+
+            std::vector<Task> top_tasks;
+            std::vector<Task> subtree_tasks;
+            while (!pending_tasks.empty())
+            {
+                Task const task = pending_tasks.back();
+                pending_tasks.pop_back();
+
+                if (task.end - task.begin <= parallel_threshold_)
+                {
+                    subtree_tasks.push_back(task);
+                    continue;
+                }
+
+                Task children[2];
+                this->SplitNode(task, nodes_, children);
+                top_tasks.push_back(task);
+                pending_tasks.push_back(children[0]);
+                pending_tasks.push_back(children[1]);
+            }
+
+            // Leaves take up to HostBvh::MaxLeafSize primitives, so the size of a subtree isn't known up front. Same as in the binned
+            // SAH builder, every subtree is built into nodes of its own, then stitched into nodes_.
+            std::vector<std::vector<HostBvhNode>> subtree_nodes(subtree_tasks.size());
+            thread_pool_.ParallelFor(static_cast<uint32_t>(subtree_tasks.size()),
+                [this, &subtree_tasks, &subtree_nodes](uint32_t index, uint32_t /*thread_index*/) {
+                    auto& local_nodes = subtree_nodes[index];
+                    local_nodes.reserve((subtree_tasks[index].end - subtree_tasks[index].begin) * 2 - 1);
+                    local_nodes.emplace_back();
+
+                    Task task = subtree_tasks[index];
+                    task.node_index = 0;
+                    this->BuildSubtree(task, local_nodes);
+                });
+
+            std::vector<uint32_t> subtree_bases(subtree_tasks.size() + 1);
+            subtree_bases[0] = static_cast<uint32_t>(nodes_.size());
+            for (size_t i = 0; i < subtree_tasks.size(); ++i)
+            {
+                subtree_bases[i + 1] = subtree_bases[i] + static_cast<uint32_t>(subtree_nodes[i].size()) - 1;
+            }
+            nodes_.resize(subtree_bases.back());
+
+            thread_pool_.ParallelFor(static_cast<uint32_t>(subtree_tasks.size()),
+                [this, &subtree_tasks, &subtree_nodes, &subtree_bases](uint32_t index, uint32_t /*thread_index*/) {
+                    auto const& local_nodes = subtree_nodes[index];
+                    uint32_t const base = subtree_bases[index];
+                    auto const relocate = [base](HostBvhNode node) {
+                        if (node.num_prims == 0)
+                        {
+                            node.offset = base + node.offset - 1;
+                        }
+                        return node;
+                    };
+
+                    nodes_[subtree_tasks[index].node_index] = relocate(local_nodes[0]);
+                    for (size_t i = 1; i < local_nodes.size(); ++i)
+                    {
+                        nodes_[base + i - 1] = relocate(local_nodes[i]);
+                    }
+                });
+
+            // Children are always pushed after their parent
+            for (auto iter = top_tasks.rbegin(); iter != top_tasks.rend(); ++iter)
+            {
+                auto& node = nodes_[iter->node_index];
+                node.bounds = nodes_[node.offset + 0].bounds;
+                node.bounds.Grow(nodes_[node.offset + 1].bounds);
+            }
+        }
+
+    private:
+        void ComputeCodes()
+        {
+            uint32_t const num_prims = static_cast<uint32_t>(codes_.size());
+
+            std::vector<HostAabb> chunk_center_bounds(NumChunks(thread_pool_, 0, num_prims));
+            ForEachChunk(thread_pool_, 0, num_prims, [this, &chunk_center_bounds](uint32_t begin, uint32_t end, uint32_t chunk) {
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    chunk_center_bounds[chunk].Grow(prim_bounds_[i].Center());
+                }
+            });
+            HostAabb center_bounds;
+            for (auto const& bounds : chunk_center_bounds)
+            {
+                center_bounds.Grow(bounds);
+            }
+
+            uint32_t const max_cell = (1U << (code_bits_ / 3)) - 1;
+            XMFLOAT3 scale;
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                float const extent = Component(center_bounds.max, axis) - Component(center_bounds.min, axis);
+                (&scale.x)[axis] = (extent > 0) ? static_cast<float>(max_cell + 1) / extent : 0.0f;
+            }
+
+            ForEachChunk(thread_pool_, 0, num_prims,
+                [this, &center_bounds, &scale, max_cell](uint32_t begin, uint32_t end, uint32_t /*chunk*/) {
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        XMFLOAT3 const center = prim_bounds_[i].Center();
+
+                        uint64_t code = 0;
+                        for (uint32_t axis = 0; axis < 3; ++axis)
+                        {
+                            // Also maps NaN to 0
+                            float const f = (Component(center, axis) - Component(center_bounds.min, axis)) * Component(scale, axis);
+                            uint32_t const cell = (f > 0) ? std::min(static_cast<uint32_t>(f), max_cell) : 0;
+                            code |= SpreadBits(cell) << (2 - axis);
+                        }
+                        codes_[i] = code;
+                    }
+                });
+        }
+
+        // Inserts 2 zero bits after each of the lowest 21 bits
+        static uint64_t SpreadBits(uint32_t value) noexcept
+        {
+            uint64_t x = value & 0x1FFFFFU;
+            x = (x | (x << 32)) & 0x001F00000000FFFFULL;
+            x = (x | (x << 16)) & 0x001F0000FF0000FFULL;
+            x = (x | (x << 8)) & 0x100F00F00F00F00FULL;
+            x = (x | (x << 4)) & 0x10C30C30C30C30C3ULL;
+            x = (x | (x << 2)) & 0x1249249249249249ULL;
+            return x;
+        }
+
+        // LSD radix sort of (code, prim) pairs. Every chunk scatters its own elements in order, which keeps each pass stable no matter
+        // how many threads there are.
+        void SortCodes()
+        {
+            uint32_t const num_prims = static_cast<uint32_t>(codes_.size());
+            uint32_t const num_chunks = NumChunks(thread_pool_, 0, num_prims);
+
+            std::vector<std::array<uint32_t, NumBuckets>> chunk_offsets(num_chunks);
+            for (uint32_t shift = 0; shift < code_bits_; shift += RadixBits)
+            {
+                ForEachChunk(thread_pool_, 0, num_prims, [this, &chunk_offsets, shift](uint32_t begin, uint32_t end, uint32_t chunk) {
+                    auto& counts = chunk_offsets[chunk];
+                    counts.fill(0);
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        ++counts[(codes_[i] >> shift) & (NumBuckets - 1)];
+                    }
+                });
+
+                // Turn the counts into the first destination of every bucket in every chunk, bucket major
+                uint32_t offset = 0;
+                bool single_bucket = false;
+                for (uint32_t bucket = 0; bucket < NumBuckets; ++bucket)
+                {
+                    uint32_t const bucket_begin = offset;
+                    for (auto& offsets : chunk_offsets)
+                    {
+                        uint32_t const count = offsets[bucket];
+                        offsets[bucket] = offset;
+                        offset += count;
+                    }
+                    single_bucket = single_bucket || (offset - bucket_begin == num_prims);
+                }
+                if (single_bucket)
+                {
+                    // All codes have the same digit, the pass would be a copy
+                    continue;
+                }
+
+                ForEachChunk(thread_pool_, 0, num_prims, [this, &chunk_offsets, shift](uint32_t begin, uint32_t end, uint32_t chunk) {
+                    auto& offsets = chunk_offsets[chunk];
+                    for (uint32_t i = begin; i < end; ++i)
+                    {
+                        uint32_t const dst = offsets[(codes_[i] >> shift) & (NumBuckets - 1)]++;
+                        scratch_codes_[dst] = codes_[i];
+                        scratch_refs_[dst] = prim_refs_[i];
+                    }
+                });
+                codes_.swap(scratch_codes_);
+                prim_refs_.swap(scratch_refs_);
+            }
+        }
+
+        // Appends the children of the task to nodes, links its node to them, and fills the children tasks
+        void SplitNode(Task const& task, std::vector<HostBvhNode>& nodes, Task children[2]) const
+        {
+            uint32_t mid;
+            uint64_t const first_code = codes_[task.begin];
+            uint64_t const last_code = codes_[task.end - 1];
+            // Same as the binned SAH builder, object median once the depth budget runs low. Also used on runs of identical codes.
+            if ((first_code != last_code) && (task.depth + 32 < HostBvh::MaxDepth))
+            {
+                uint64_t const split_bit = 1ULL << HighestBit(first_code ^ last_code);
+                mid = static_cast<uint32_t>(std::partition_point(codes_.begin() + task.begin, codes_.begin() + task.end,
+                                                [split_bit](uint64_t code) { return (code & split_bit) == 0; }) -
+                                            codes_.begin());
+            }
+            else
+            {
+                mid = task.begin + (task.end - task.begin) / 2;
+            }
+
+            uint32_t const first_child = static_cast<uint32_t>(nodes.size());
+            nodes.resize(nodes.size() + 2);
+            nodes[task.node_index].offset = first_child;
+            nodes[task.node_index].num_prims = 0;
+
+            children[0] = {first_child + 0, task.begin, mid, task.depth + 1};
+            children[1] = {first_child + 1, mid, task.end, task.depth + 1};
+        }
+
+        void BuildSubtree(Task const& task, std::vector<HostBvhNode>& nodes)
+        {
+            // Like the binned SAH builder, ranges that fit in a leaf stop there
+            uint32_t const count = task.end - task.begin;
+            if (count <= HostBvh::MaxLeafSize)
+            {
+                auto& node = nodes[task.node_index];
+                node.bounds = HostAabb();
+                for (uint32_t i = task.begin; i < task.end; ++i)
+                {
+                    node.bounds.Grow(prim_bounds_[prim_refs_[i]]);
+                }
+                node.offset = task.begin;
+                node.num_prims = count;
+                return;
+            }
+
+            Task children[2];
+            this->SplitNode(task, nodes, children);
+            this->BuildSubtree(children[0], nodes);
+            this->BuildSubtree(children[1], nodes);
+
+            auto& node = nodes[task.node_index];
+            node.bounds = nodes[node.offset + 0].bounds;
+            node.bounds.Grow(nodes[node.offset + 1].bounds);
+        }
+
+    private:
+        ThreadPool& thread_pool_;
+        HostAabb const* prim_bounds_;
+        std::vector<HostBvhNode>& nodes_;
+        std::vector<uint32_t>& prim_refs_;
+        std::vector<uint64_t> codes_;
+        std::vector<uint64_t> scratch_codes_;
+        std::vector<uint32_t> scratch_refs_;
+        uint32_t parallel_threshold_;
+        uint32_t code_bits_;
+    };
+} // namespace
+
+namespace GoldenSun
+{
+    void HostBvh::Build(ThreadPool& thread_pool, HostAabb const* prim_bounds, uint32_t num_prims, HostBvhBuildMode mode,
+        HostBvhPrimSplitter const& split_prim)
+    {
+        nodes_.clear();
+        prim_refs_.resize(num_prims);
+        std::iota(prim_refs_.begin(), prim_refs_.end(), 0U);
+
+        if (num_prims == 0)
+        {
+            return;
+        }
+
+        if (mode == HostBvhBuildMode::PreferFastBuild)
+        {
+            LinearBuilder builder(thread_pool, prim_bounds, num_prims, nodes_, prim_refs_);
+            builder.Build();
+        }
+        else if (mode == HostBvhBuildMode::PreferFastTraceSpatialSplits)
+        {
+            BinnedSahBuilder builder(thread_pool, prim_bounds, num_prims, nodes_, prim_refs_, split_prim ? split_prim : SplitAabb);
+            builder.Build();
+        }
+        else
+        {
+            BinnedSahBuilder builder(thread_pool, prim_bounds, num_prims, nodes_, prim_refs_);
+            builder.Build();
+        }
+    }
+
+    float HostBvh::SahCost() const noexcept
+    {
+        if (nodes_.empty())
+        {
+            return 0;
+        }
+
+        float cost = 0;
+        for (auto const& node : nodes_)
+        {
+            cost += node.bounds.HalfArea() * ((node.num_prims > 0) ? node.num_prims : 1.0f);
+        }
+        return cost / nodes_[0].bounds.HalfArea();
+    }
+} // namespace GoldenSun
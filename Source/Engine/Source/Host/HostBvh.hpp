@@ -0,0 +1,258 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include <limits>
+#include <vector>
+
+namespace GoldenSun
+{
+    class ThreadPool;
+
+    struct HostAabb
+    {
+        DirectX::XMFLOAT3 min{
+            std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+        DirectX::XMFLOAT3 max{
+            std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+        void Grow(DirectX::XMFLOAT3 const& point) noexcept
+        {
+            min = {std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z)};
+            max = {std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z)};
+        }
+
+        void Grow(HostAabb const& aabb) noexcept
+        {
+            min = {std::min(min.x, aabb.min.x), std::min(min.y, aabb.min.y), std::min(min.z, aabb.min.z)};
+            max = {std::max(max.x, aabb.max.x), std::max(max.y, aabb.max.y), std::max(max.z, aabb.max.z)};
+        }
+
+        // Becomes invalid if they don't overlap
+        void Intersect(HostAabb const& aabb) noexcept
+        {
+            min = {std::max(min.x, aabb.min.x), std::max(min.y, aabb.min.y), std::max(min.z, aabb.min.z)};
+            max = {std::min(max.x, aabb.max.x), std::min(max.y, aabb.max.y), std::min(max.z, aabb.max.z)};
+        }
+
+        bool Valid() const noexcept
+        {
+            return (min.x <= max.x) && (min.y <= max.y) && (min.z <= max.z);
+        }
+
+        DirectX::XMFLOAT3 Center() const noexcept
+        {
+            return {(min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, (min.z + max.z) * 0.5f};
+        }
+
+        float HalfArea() const noexcept
+        {
+            float const dx = max.x - min.x;
+            float const dy = max.y - min.y;
+            float const dz = max.z - min.z;
+            return dx * dy + dy * dz + dz * dx;
+        }
+    };
+
+    inline uint32_t LowestBit(uint32_t mask) noexcept
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return index;
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    inline uint32_t LowestBit(uint64_t mask) noexcept
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, mask);
+        return index;
+#else
+        return __builtin_ctzll(mask);
+#endif
+    }
+
+    inline uint32_t HighestBit(uint64_t mask) noexcept
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, mask);
+        return index;
+#else
+        return 63 - __builtin_clzll(mask);
+#endif
+    }
+
+    struct HostRay
+    {
+        DirectX::XMFLOAT3 origin;
+        float t_min;
+        DirectX::XMFLOAT3 direction;
+        float t_max;
+    };
+
+    // Reciprocal of the ray direction, with zero components nudged so that the slab test never computes 0 * inf
+    inline DirectX::XMFLOAT3 InvDirection(DirectX::XMFLOAT3 const& direction) noexcept
+    {
+        float constexpr Epsilon = 1e-20f;
+        auto const safe_inv = [](float d) { return 1 / ((std::abs(d) < Epsilon) ? std::copysign(Epsilon, d) : d); };
+        return {safe_inv(direction.x), safe_inv(direction.y), safe_inv(direction.z)};
+    }
+
+    inline bool IntersectAabb(HostAabb const& aabb, HostRay const& ray, DirectX::XMFLOAT3 const& inv_dir, float& t_entry) noexcept
+    {
+        float const tx0 = (aabb.min.x - ray.origin.x) * inv_dir.x;
+        float const tx1 = (aabb.max.x - ray.origin.x) * inv_dir.x;
+        float const ty0 = (aabb.min.y - ray.origin.y) * inv_dir.y;
+        float const ty1 = (aabb.max.y - ray.origin.y) * inv_dir.y;
+        float const tz0 = (aabb.min.z - ray.origin.z) * inv_dir.z;
+        float const tz1 = (aabb.max.z - ray.origin.z) * inv_dir.z;
+
+        float const t_near = std::max({ray.t_min, std::min(tx0, tx1), std::min(ty0, ty1), std::min(tz0, tz1)});
+        float const t_far = std::min({ray.t_max, std::max(tx0, tx1), std::max(ty0, ty1), std::max(tz0, tz1)});
+
+        t_entry = t_near;
+        return t_near <= t_far;
+    }
+
+    struct HostBvhNode
+    {
+        HostAabb bounds;
+        // Interior node: index of the first child, the second one follows it. Leaf: offset into the primitive references.
+        uint32_t offset;
+        // 0 for interior nodes
+        uint32_t num_prims;
+    };
+    static_assert(sizeof(HostBvhNode) == 32);
+
+    // The host counterparts of D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE and PREFER_FAST_BUILD
+    enum class HostBvhBuildMode : uint32_t
+    {
+        // Binned SAH
+        PreferFastTrace,
+        // LBVH over Morton codes. Several times faster to build, but the trees are worse.
+        PreferFastBuild,
+        // Binned SAH with spatial splits. Slower to build than PreferFastTrace, and references long thin primitives from several
+        // leaves, but their nodes overlap much less.
+        PreferFastTraceSpatialSplits,
+    };
+
+    // Clips the part of a primitive inside ref_bounds at the plane where the axis coordinate is position, for the spatial splits.
+    // left and right are the bounds of what is on either side, inside ref_bounds, and invalid where nothing is.
+    using HostBvhPrimSplitter = std::function<void(
+        uint32_t prim, HostAabb const& ref_bounds, uint32_t axis, float position, HostAabb& left, HostAabb& right)>;
+
+    class HostBvh final
+    {
+    public:
+        static uint32_t constexpr MaxLeafSize = 4;
+        static uint32_t constexpr MaxDepth = 64;
+
+    public:
+        // split_prim is only used by PreferFastTraceSpatialSplits. Without it, primitives are treated as the boxes of their bounds.
+        void Build(ThreadPool& thread_pool, HostAabb const* prim_bounds, uint32_t num_prims,
+            HostBvhBuildMode mode = HostBvhBuildMode::PreferFastTrace, HostBvhPrimSplitter const& split_prim = {});
+
+        // Expected cost of a random ray through the root, with unit traversal and intersection costs. For comparing builders.
+        float SahCost() const noexcept;
+
+        bool Empty() const noexcept
+        {
+            return nodes_.empty();
+        }
+
+        HostAabb const& Bounds() const noexcept
+        {
+            return nodes_[0].bounds;
+        }
+
+        std::vector<HostBvhNode> const& Nodes() const noexcept
+        {
+            return nodes_;
+        }
+
+        // With spatial splits, a primitive can be in several leaves, and some entries are in none
+        std::vector<uint32_t> const& PrimRefs() const noexcept
+        {
+            return prim_refs_;
+        }
+
+        // intersect(prim_id, ray) tests one primitive, shrinks ray.t_max on a hit, and returns true to terminate the traversal.
+        // Returns whether the traversal is terminated.
+        template <typename Intersector>
+        bool Traverse(HostRay& ray, Intersector&& intersect) const
+        {
+            if (nodes_.empty())
+            {
+                return false;
+            }
+
+            DirectX::XMFLOAT3 const inv_dir = InvDirection(ray.direction);
+
+            float t_entry;
+            if (!IntersectAabb(nodes_[0].bounds, ray, inv_dir, t_entry))
+            {
+                return false;
+            }
+
+            uint32_t stack[MaxDepth * 2];
+            uint32_t stack_size = 0;
+            uint32_t node_index = 0;
+            for (;;)
+            {
+                auto const& node = nodes_[node_index];
+                if (node.num_prims > 0)
+                {
+                    for (uint32_t i = 0; i < node.num_prims; ++i)
+                    {
+                        if (intersect(prim_refs_[node.offset + i], ray))
+                        {
+                            return true;
+                        }
+                    }
+                }
+                else
+                {
+                    float t_entries[2];
+                    bool const hit_first = IntersectAabb(nodes_[node.offset + 0].bounds, ray, inv_dir, t_entries[0]);
+                    bool const hit_second = IntersectAabb(nodes_[node.offset + 1].bounds, ray, inv_dir, t_entries[1]);
+                    if (hit_first && hit_second)
+                    {
+                        uint32_t const near_child = (t_entries[1] < t_entries[0]) ? 1 : 0;
+                        stack[stack_size] = node.offset + (near_child ^ 1);
+                        ++stack_size;
+                        node_index = node.offset + near_child;
+                        continue;
+                    }
+                    if (hit_first || hit_second)
+                    {
+                        node_index = node.offset + (hit_first ? 0 : 1);
+                        continue;
+                    }
+                }
+
+                if (stack_size == 0)
+                {
+                    return false;
+                }
+                --stack_size;
+                node_index = stack[stack_size];
+            }
+        }
+
+    private:
+        std::vector<HostBvhNode> nodes_;
+        std::vector<uint32_t> prim_refs_;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,537 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ErrorHandling.hpp>
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "HostBvh8.hpp"
+#include "HostCpu.hpp"
+
+namespace
+{
+    using namespace GoldenSun;
+
+    void SetChild(HostBvh8Node& node, uint32_t slot, HostAabb const& bounds, uint32_t child, uint32_t num_prims) noexcept
+    {
+        node.min_x[slot] = bounds.min.x;
+        node.max_x[slot] = bounds.max.x;
+        node.min_y[slot] = bounds.min.y;
+        node.max_y[slot] = bounds.max.y;
+        node.min_z[slot] = bounds.min.z;
+        node.max_z[slot] = bounds.max.z;
+        node.children[slot] = child;
+        node.num_prims[slot] = num_prims;
+    }
+
+    void ClearNode(HostBvh8Node& node) noexcept
+    {
+        float constexpr Inf = std::numeric_limits<float>::infinity();
+
+        HostAabb empty;
+        empty.min = {Inf, Inf, Inf};
+        empty.max = {Inf, Inf, Inf};
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            SetChild(node, slot, empty, 0, 0);
+        }
+    }
+
+    // Smallest power of 2 grid on which 255 steps from origin cover max_value
+    int8_t QuantizationExponent(float origin, float max_value) noexcept
+    {
+        int32_t constexpr MinExponent = -126;
+        int32_t constexpr MaxExponent = 127;
+
+        float const extent = max_value - origin;
+        int32_t exponent = MinExponent;
+        if (extent > 0)
+        {
+            exponent = std::clamp(static_cast<int32_t>(std::ceil(std::log2(extent / 255))), MinExponent, MaxExponent);
+        }
+        while ((exponent < MaxExponent) && (Dequantize(origin, QuantizationScale(static_cast<int8_t>(exponent)), 255) < max_value))
+        {
+            ++exponent;
+        }
+        return static_cast<int8_t>(exponent);
+    }
+
+    // Rounds outwards, and then fixes up any rounding of the dequantization, so the decoded range always contains [min_value, max_value]
+    void Quantize(float origin, int8_t exponent, float min_value, float max_value, uint8_t& q_min, uint8_t& q_max) noexcept
+    {
+        float const scale = QuantizationScale(exponent);
+
+        int32_t lo = std::clamp(static_cast<int32_t>(std::floor((min_value - origin) / scale)), 0, 255);
+        while ((lo > 0) && (Dequantize(origin, scale, static_cast<uint8_t>(lo)) > min_value))
+        {
+            --lo;
+        }
+        int32_t hi = std::clamp(static_cast<int32_t>(std::ceil((max_value - origin) / scale)), 0, 255);
+        while ((hi < 255) && (Dequantize(origin, scale, static_cast<uint8_t>(hi)) < max_value))
+        {
+            ++hi;
+        }
+
+        q_min = static_cast<uint8_t>(lo);
+        q_max = static_cast<uint8_t>(hi);
+    }
+
+    bool EmptySlot(HostBvh8CompressedNode const& compressed, uint32_t slot) noexcept
+    {
+        return ((compressed.interior_mask & (1U << slot)) == 0) && (compressed.meta[slot] == 0);
+    }
+
+    // Sets the grid of the node from the exact child boxes. The meta data must be there already, it tells which slots are empty.
+    // Returns the exact bounds of the node.
+    HostAabb QuantizeChildren(HostBvh8CompressedNode& compressed, HostAabb const child_bounds[HostBvh8::Width]) noexcept
+    {
+        HostAabb bounds;
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            if (!EmptySlot(compressed, slot))
+            {
+                bounds.Grow(child_bounds[slot]);
+            }
+        }
+
+        compressed.origin = bounds.min;
+        compressed.exponents[0] = QuantizationExponent(bounds.min.x, bounds.max.x);
+        compressed.exponents[1] = QuantizationExponent(bounds.min.y, bounds.max.y);
+        compressed.exponents[2] = QuantizationExponent(bounds.min.z, bounds.max.z);
+
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            if (EmptySlot(compressed, slot))
+            {
+                compressed.q_min_x[slot] = compressed.q_min_y[slot] = compressed.q_min_z[slot] = 0;
+                compressed.q_max_x[slot] = compressed.q_max_y[slot] = compressed.q_max_z[slot] = 0;
+                continue;
+            }
+
+            auto const& child = child_bounds[slot];
+            Quantize(bounds.min.x, compressed.exponents[0], child.min.x, child.max.x, compressed.q_min_x[slot], compressed.q_max_x[slot]);
+            Quantize(bounds.min.y, compressed.exponents[1], child.min.y, child.max.y, compressed.q_min_y[slot], compressed.q_max_y[slot]);
+            Quantize(bounds.min.z, compressed.exponents[2], child.min.z, child.max.z, compressed.q_min_z[slot], compressed.q_max_z[slot]);
+        }
+
+        return bounds;
+    }
+
+    // Also moves the primitive references of the leaf children together, in the order of the compressed nodes
+    HostAabb CompressNode(HostBvh8Node const& node, std::vector<uint32_t> const& prim_refs, HostBvh8CompressedNode& compressed,
+        HostVector<uint32_t>& compressed_prim_refs)
+    {
+        compressed.interior_mask = 0;
+        compressed.child_base = 0;
+        compressed.prim_base = static_cast<uint32_t>(compressed_prim_refs.size());
+
+        HostAabb child_bounds[HostBvh8::Width];
+        bool first_interior = true;
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            if (node.min_x[slot] == std::numeric_limits<float>::infinity())
+            {
+                compressed.meta[slot] = 0;
+                continue;
+            }
+
+            child_bounds[slot].min = {node.min_x[slot], node.min_y[slot], node.min_z[slot]};
+            child_bounds[slot].max = {node.max_x[slot], node.max_y[slot], node.max_z[slot]};
+
+            if (node.num_prims[slot] == 0)
+            {
+                // CollapseNode allocates the interior children of a node next to each other
+                if (first_interior)
+                {
+                    compressed.child_base = node.children[slot];
+                    first_interior = false;
+                }
+                compressed.interior_mask |= static_cast<uint8_t>(1U << slot);
+                compressed.meta[slot] = static_cast<uint8_t>(node.children[slot] - compressed.child_base);
+            }
+            else
+            {
+                uint32_t const offset = static_cast<uint32_t>(compressed_prim_refs.size()) - compressed.prim_base;
+                compressed.meta[slot] = static_cast<uint8_t>((node.num_prims[slot] << 5) | offset);
+                compressed_prim_refs.insert(compressed_prim_refs.end(), prim_refs.begin() + node.children[slot],
+                    prim_refs.begin() + node.children[slot] + node.num_prims[slot]);
+            }
+        }
+
+        return QuantizeChildren(compressed, child_bounds);
+    }
+
+    // Proportional to the SAH traversal cost of the interior nodes
+    float SumOfHalfAreas(std::vector<HostAabb> const& node_bounds) noexcept
+    {
+        float sum = 0;
+        for (auto const& bounds : node_bounds)
+        {
+            sum += bounds.HalfArea();
+        }
+        return sum;
+    }
+
+    // Opens the binary children with the largest area, until 8 of them are found or all of them are leaves
+    void CollapseNode(HostBvh const& bvh, uint32_t binary_index, uint32_t wide_index, std::vector<HostBvh8Node>& wide_nodes)
+    {
+        auto const& binary_nodes = bvh.Nodes();
+
+        uint32_t slots[HostBvh8::Width];
+        uint32_t num_slots = 0;
+        if (binary_nodes[binary_index].num_prims > 0)
+        {
+            // Only happens on the root
+            slots[0] = binary_index;
+            num_slots = 1;
+        }
+        else
+        {
+            slots[0] = binary_nodes[binary_index].offset + 0;
+            slots[1] = binary_nodes[binary_index].offset + 1;
+            num_slots = 2;
+        }
+
+        while (num_slots < HostBvh8::Width)
+        {
+            uint32_t open_slot = HostBvh8::Width;
+            float max_area = -1;
+            for (uint32_t i = 0; i < num_slots; ++i)
+            {
+                auto const& node = binary_nodes[slots[i]];
+                if ((node.num_prims == 0) && (node.bounds.HalfArea() > max_area))
+                {
+                    open_slot = i;
+                    max_area = node.bounds.HalfArea();
+                }
+            }
+            if (open_slot == HostBvh8::Width)
+            {
+                break;
+            }
+
+            uint32_t const first_child = binary_nodes[slots[open_slot]].offset;
+            slots[open_slot] = first_child + 0;
+            slots[num_slots] = first_child + 1;
+            ++num_slots;
+        }
+
+        ClearNode(wide_nodes[wide_index]);
+
+        uint32_t interior_children[HostBvh8::Width];
+        uint32_t interior_slots[HostBvh8::Width];
+        uint32_t num_interior_children = 0;
+        for (uint32_t i = 0; i < num_slots; ++i)
+        {
+            auto const& binary_node = binary_nodes[slots[i]];
+            if (binary_node.num_prims > 0)
+            {
+                SetChild(wide_nodes[wide_index], i, binary_node.bounds, binary_node.offset, binary_node.num_prims);
+            }
+            else
+            {
+                uint32_t const child_index = static_cast<uint32_t>(wide_nodes.size());
+                wide_nodes.emplace_back();
+                SetChild(wide_nodes[wide_index], i, binary_node.bounds, child_index, 0);
+
+                interior_children[num_interior_children] = child_index;
+                interior_slots[num_interior_children] = slots[i];
+                ++num_interior_children;
+            }
+        }
+
+        for (uint32_t i = 0; i < num_interior_children; ++i)
+        {
+            CollapseNode(bvh, interior_slots[i], interior_children[i], wide_nodes);
+        }
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void DecodeNode(HostBvh8CompressedNode const& compressed, HostBvh8Node& node) noexcept
+    {
+        float constexpr Inf = std::numeric_limits<float>::infinity();
+
+        float const scale_x = QuantizationScale(compressed.exponents[0]);
+        float const scale_y = QuantizationScale(compressed.exponents[1]);
+        float const scale_z = QuantizationScale(compressed.exponents[2]);
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            uint32_t const meta = compressed.meta[slot];
+            bool const interior = (compressed.interior_mask & (1U << slot)) != 0;
+            bool const empty = !interior && (meta == 0);
+
+            node.min_x[slot] = empty ? Inf : Dequantize(compressed.origin.x, scale_x, compressed.q_min_x[slot]);
+            node.max_x[slot] = empty ? Inf : Dequantize(compressed.origin.x, scale_x, compressed.q_max_x[slot]);
+            node.min_y[slot] = empty ? Inf : Dequantize(compressed.origin.y, scale_y, compressed.q_min_y[slot]);
+            node.max_y[slot] = empty ? Inf : Dequantize(compressed.origin.y, scale_y, compressed.q_max_y[slot]);
+            node.min_z[slot] = empty ? Inf : Dequantize(compressed.origin.z, scale_z, compressed.q_min_z[slot]);
+            node.max_z[slot] = empty ? Inf : Dequantize(compressed.origin.z, scale_z, compressed.q_max_z[slot]);
+
+            node.children[slot] = interior ? compressed.child_base + meta : compressed.prim_base + (meta & 0x1F);
+            node.num_prims[slot] = interior ? 0 : (meta >> 5);
+        }
+    }
+
+    HostAabb DecodeChildBounds(HostBvh8CompressedNode const& compressed, uint32_t slot) noexcept
+    {
+        float const scale_x = QuantizationScale(compressed.exponents[0]);
+        float const scale_y = QuantizationScale(compressed.exponents[1]);
+        float const scale_z = QuantizationScale(compressed.exponents[2]);
+
+        HostAabb bounds;
+        bounds.min = {Dequantize(compressed.origin.x, scale_x, compressed.q_min_x[slot]),
+            Dequantize(compressed.origin.y, scale_y, compressed.q_min_y[slot]),
+            Dequantize(compressed.origin.z, scale_z, compressed.q_min_z[slot])};
+        bounds.max = {Dequantize(compressed.origin.x, scale_x, compressed.q_max_x[slot]),
+            Dequantize(compressed.origin.y, scale_y, compressed.q_max_y[slot]),
+            Dequantize(compressed.origin.z, scale_z, compressed.q_max_z[slot])};
+        return bounds;
+    }
+
+    uint32_t IntersectChildrenScalar(HostBvh8CompressedNode const& compressed, HostBvh8Ray const& ray, float t_entries[8]) noexcept
+    {
+        HostBvh8Node node;
+        DecodeNode(compressed, node);
+
+        uint32_t hit_mask = 0;
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            float const tx0 = (node.min_x[slot] - ray.origin[0]) * ray.inv_dir[0];
+            float const tx1 = (node.max_x[slot] - ray.origin[0]) * ray.inv_dir[0];
+            float const ty0 = (node.min_y[slot] - ray.origin[1]) * ray.inv_dir[1];
+            float const ty1 = (node.max_y[slot] - ray.origin[1]) * ray.inv_dir[1];
+            float const tz0 = (node.min_z[slot] - ray.origin[2]) * ray.inv_dir[2];
+            float const tz1 = (node.max_z[slot] - ray.origin[2]) * ray.inv_dir[2];
+
+            float const t_near = std::max({ray.t_min, std::min(tx0, tx1), std::min(ty0, ty1), std::min(tz0, tz1)});
+            float const t_far = std::min({ray.t_max, std::max(tx0, tx1), std::max(ty0, ty1), std::max(tz0, tz1)});
+
+            t_entries[slot] = t_near;
+            hit_mask |= (t_near <= t_far) ? (1U << slot) : 0;
+        }
+        return hit_mask;
+    }
+
+    uint32_t CullChildren(HostBvh8Node const& node, HostFrustum const& frustum, float max_distance_sq, float distances_sq[8]) noexcept
+    {
+        // Scaled by how far the box is from the origin, so rays on the boundary of the frustum never lose a box to rounding
+        float constexpr PlaneEpsilon = 1e-4f;
+
+        float const ox = frustum.origin.x;
+        float const oy = frustum.origin.y;
+        float const oz = frustum.origin.z;
+
+        uint32_t hit_mask = 0;
+        for (uint32_t slot = 0; slot < HostBvh8::Width; ++slot)
+        {
+            float const min_x = node.min_x[slot] - ox;
+            float const max_x = node.max_x[slot] - ox;
+            float const min_y = node.min_y[slot] - oy;
+            float const max_y = node.max_y[slot] - oy;
+            float const min_z = node.min_z[slot] - oz;
+            float const max_z = node.max_z[slot] - oz;
+
+            // Closest point of the box to the origin
+            float const dx = std::max({min_x, -max_x, 0.0f});
+            float const dy = std::max({min_y, -max_y, 0.0f});
+            float const dz = std::max({min_z, -max_z, 0.0f});
+            distances_sq[slot] = dx * dx + dy * dy + dz * dz;
+
+            // Empty slots are at infinity, and fail here even when some of the plane tests produce NaN
+            bool inside = distances_sq[slot] <= max_distance_sq;
+
+            float const extent = std::max({std::abs(min_x), std::abs(max_x), std::abs(min_y), std::abs(max_y), std::abs(min_z),
+                std::abs(max_z)});
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                // The corner of the box farthest along the plane normal
+                auto const& normal = frustum.normals[i];
+                float const px = normal.x >= 0 ? max_x : min_x;
+                float const py = normal.y >= 0 ? max_y : min_y;
+                float const pz = normal.z >= 0 ? max_z : min_z;
+                inside = inside && !(normal.x * px + normal.y * py + normal.z * pz < -PlaneEpsilon * extent);
+            }
+
+            hit_mask |= inside ? (1U << slot) : 0;
+        }
+        return hit_mask;
+    }
+
+    uint64_t IntersectChildRays(HostAabb const& bounds, HostBvh8Packet const& wide_packet, HostRayPacket const& packet) noexcept
+    {
+        float const min_x = bounds.min.x - wide_packet.origin[0];
+        float const max_x = bounds.max.x - wide_packet.origin[0];
+        float const min_y = bounds.min.y - wide_packet.origin[1];
+        float const max_y = bounds.max.y - wide_packet.origin[1];
+        float const min_z = bounds.min.z - wide_packet.origin[2];
+        float const max_z = bounds.max.z - wide_packet.origin[2];
+
+        uint64_t ray_mask = 0;
+        for (uint32_t i = 0; i < packet.num_rays; ++i)
+        {
+            float const tx0 = min_x * wide_packet.inv_dir_x[i];
+            float const tx1 = max_x * wide_packet.inv_dir_x[i];
+            float const ty0 = min_y * wide_packet.inv_dir_y[i];
+            float const ty1 = max_y * wide_packet.inv_dir_y[i];
+            float const tz0 = min_z * wide_packet.inv_dir_z[i];
+            float const tz1 = max_z * wide_packet.inv_dir_z[i];
+
+            float const t_near = std::max({wide_packet.t_min, std::min(tx0, tx1), std::min(ty0, ty1), std::min(tz0, tz1)});
+            float const t_far = std::min({packet.t_max[i], std::max(tx0, tx1), std::max(ty0, ty1), std::max(tz0, tz1)});
+
+            ray_mask |= (t_near <= t_far) ? (1ULL << i) : 0;
+        }
+        return ray_mask;
+    }
+
+    HostBvh8IntersectChildrenFunc SelectIntersectChildrenFunc() noexcept
+    {
+        static HostBvh8IntersectChildrenFunc const func = [] {
+            if (SupportsAvx2())
+            {
+                return &IntersectChildrenAvx2;
+            }
+            if (SupportsSse4())
+            {
+                return &IntersectChildrenSse4;
+            }
+            return &IntersectChildrenScalar;
+        }();
+        return func;
+    }
+
+
+    HostBvh8::HostBvh8() noexcept : intersect_children_(SelectIntersectChildrenFunc())
+    {
+    }
+
+    void HostBvh8::Build(HostBvh const& bvh, bool allow_update)
+    {
+        nodes_.clear();
+        prim_refs_.clear();
+        bounds_ = HostAabb();
+        allow_update_ = allow_update;
+        node_bounds_.clear();
+        built_area_ = 0;
+        refitted_area_ = 0;
+        refit_order_.clear();
+        refit_level_starts_.clear();
+
+        if (bvh.Empty())
+        {
+            return;
+        }
+
+        bounds_ = bvh.Bounds();
+
+        std::vector<HostBvh8Node> wide_nodes;
+        wide_nodes.reserve(bvh.Nodes().size() / 4 + 1);
+        wide_nodes.emplace_back();
+        CollapseNode(bvh, 0, 0, wide_nodes);
+
+        nodes_.resize(wide_nodes.size());
+        prim_refs_.reserve(bvh.PrimRefs().size());
+        if (allow_update_)
+        {
+            node_bounds_.resize(wide_nodes.size());
+        }
+        for (size_t i = 0; i < wide_nodes.size(); ++i)
+        {
+            HostAabb const node_bounds = CompressNode(wide_nodes[i], bvh.PrimRefs(), nodes_[i], prim_refs_);
+            if (allow_update_)
+            {
+                node_bounds_[i] = node_bounds;
+            }
+        }
+
+        if (allow_update_)
+        {
+            built_area_ = SumOfHalfAreas(node_bounds_);
+            refitted_area_ = built_area_;
+
+            // Breadth first, so all the nodes of a level can be refitted in parallel once the level below is done
+            refit_order_.reserve(nodes_.size());
+            refit_order_.push_back(0);
+            refit_level_starts_.push_back(0);
+            while (refit_level_starts_.back() < refit_order_.size())
+            {
+                uint32_t const level_begin = refit_level_starts_.back();
+                uint32_t const level_end = static_cast<uint32_t>(refit_order_.size());
+                for (uint32_t i = level_begin; i < level_end; ++i)
+                {
+                    auto const& node = nodes_[refit_order_[i]];
+                    for (uint32_t slot = 0; slot < Width; ++slot)
+                    {
+                        if (node.interior_mask & (1U << slot))
+                        {
+                            refit_order_.push_back(node.child_base + node.meta[slot]);
+                        }
+                    }
+                }
+                refit_level_starts_.push_back(level_end);
+            }
+        }
+    }
+
+    // Keeps the topology, only the boxes change. Deepest level first, every level in parallel.
+    void HostBvh8::Refit(ThreadPool& thread_pool, HostAabb const* prim_bounds)
+    {
+        Verify(allow_update_);
+
+        if (nodes_.empty())
+        {
+            return;
+        }
+
+        uint32_t constexpr NodesPerTask = 256;
+
+        for (size_t level = refit_level_starts_.size() - 1; level > 0; --level)
+        {
+            uint32_t const level_begin = refit_level_starts_[level - 1];
+            uint32_t const level_end = refit_level_starts_[level];
+            uint32_t const num_tasks = (level_end - level_begin + NodesPerTask - 1) / NodesPerTask;
+            thread_pool.ParallelFor(num_tasks, [this, prim_bounds, level_begin, level_end](uint32_t task, uint32_t /*thread_index*/) {
+                uint32_t const begin = level_begin + task * NodesPerTask;
+                uint32_t const end = std::min(begin + NodesPerTask, level_end);
+                for (uint32_t i = begin; i < end; ++i)
+                {
+                    uint32_t const node_index = refit_order_[i];
+                    auto& node = nodes_[node_index];
+
+                    HostAabb child_bounds[Width];
+                    for (uint32_t slot = 0; slot < Width; ++slot)
+                    {
+                        if (node.interior_mask & (1U << slot))
+                        {
+                            child_bounds[slot] = node_bounds_[node.child_base + node.meta[slot]];
+                        }
+                        else
+                        {
+                            uint32_t const first_prim = CompressedChild(node, slot);
+                            for (uint32_t j = 0; j < CompressedNumPrims(node, slot); ++j)
+                            {
+                                child_bounds[slot].Grow(prim_bounds[prim_refs_[first_prim + j]]);
+                            }
+                        }
+                    }
+
+                    node_bounds_[node_index] = QuantizeChildren(node, child_bounds);
+                }
+            });
+        }
+
+        bounds_ = node_bounds_[0];
+        refitted_area_ = SumOfHalfAreas(node_bounds_);
+    }
+
+    bool HostBvh8::NeedsRebuild() const noexcept
+    {
+        float constexpr MaxAreaGrowth = 2;
+        return refitted_area_ > built_area_ * MaxAreaGrowth;
+    }
+} // namespace GoldenSun
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "HostBvh.hpp"
+#include "HostPlacement.hpp"
+#include "HostRayPacket.hpp"
+
+namespace GoldenSun
+{
+    // 8 children per node, with the child boxes in SoA form. Full precision form of a node, used while building and by the packet
+    // tests. Unused slots have min = max = +inf on all axes, which no ray can hit.
+    struct alignas(32) HostBvh8Node
+    {
+        float min_x[8];
+        float max_x[8];
+        float min_y[8];
+        float max_y[8];
+        float min_z[8];
+        float max_z[8];
+        // Interior child: index of the child node. Leaf child: offset into the primitive references.
+        uint32_t children[8];
+        // 0 for interior children
+        uint32_t num_prims[8];
+    };
+    static_assert(sizeof(HostBvh8Node) == 256);
+
+    // Storage form of HostBvh8Node, under a third of the size. Child boxes are 8-bit offsets on a per axis power of 2 grid, anchored
+    // at the min corner of the node. Interior children are consecutive nodes from child_base, and the primitives of all the leaf
+    // children are consecutive references from prim_base.
+    struct HostBvh8CompressedNode
+    {
+        DirectX::XMFLOAT3 origin;
+        int8_t exponents[3];
+        // Bit per interior child
+        uint8_t interior_mask;
+        uint32_t child_base;
+        uint32_t prim_base;
+        // Interior child: index relative to child_base. Leaf child: number of primitives in the top 3 bits, and offset relative to
+        // prim_base in the low 5 bits. 0 for empty slots.
+        uint8_t meta[8];
+        uint8_t q_min_x[8];
+        uint8_t q_max_x[8];
+        uint8_t q_min_y[8];
+        uint8_t q_max_y[8];
+        uint8_t q_min_z[8];
+        uint8_t q_max_z[8];
+    };
+    static_assert(sizeof(HostBvh8CompressedNode) == 80);
+
+    // Grid step of one axis. Straight from the bits, the exponents stay in the normal float range.
+    inline float QuantizationScale(int8_t exponent) noexcept
+    {
+        uint32_t const bits = static_cast<uint32_t>(exponent + 127) << 23;
+        float ret;
+        std::memcpy(&ret, &bits, sizeof(ret));
+        return ret;
+    }
+
+    // Exact, since q * 2^e only shifts the exponent of q. The FMA of the SIMD decoders gives the same result.
+    inline float Dequantize(float origin, float scale, uint8_t q) noexcept
+    {
+        return origin + q * scale;
+    }
+
+    inline uint32_t CompressedChild(HostBvh8CompressedNode const& compressed, uint32_t slot) noexcept
+    {
+        return (compressed.interior_mask & (1U << slot)) ? compressed.child_base + compressed.meta[slot]
+                                                         : compressed.prim_base + (compressed.meta[slot] & 0x1FU);
+    }
+
+    inline uint32_t CompressedNumPrims(HostBvh8CompressedNode const& compressed, uint32_t slot) noexcept
+    {
+        return (compressed.interior_mask & (1U << slot)) ? 0 : (compressed.meta[slot] >> 5U);
+    }
+
+    // The decoded boxes are never smaller than the ones that were encoded
+    void DecodeNode(HostBvh8CompressedNode const& compressed, HostBvh8Node& node) noexcept;
+    HostAabb DecodeChildBounds(HostBvh8CompressedNode const& compressed, uint32_t slot) noexcept;
+
+    // Ray data shared by all the node tests of one traversal. Same slab test as IntersectAabb, so both BVHs agree on the hits.
+    struct HostBvh8Ray
+    {
+        float origin[3];
+        float t_min;
+        float inv_dir[3];
+        float t_max;
+    };
+
+    // Decodes the 8 child boxes and tests the ray against them. Returns a bit mask of the hit children, and their entry distances in
+    // t_entries.
+    using HostBvh8IntersectChildrenFunc = uint32_t (*)(HostBvh8CompressedNode const& node, HostBvh8Ray const& ray, float t_entries[8]);
+
+    uint32_t IntersectChildrenScalar(HostBvh8CompressedNode const& node, HostBvh8Ray const& ray, float t_entries[8]) noexcept;
+    uint32_t IntersectChildrenSse4(HostBvh8CompressedNode const& node, HostBvh8Ray const& ray, float t_entries[8]) noexcept;
+    uint32_t IntersectChildrenAvx2(HostBvh8CompressedNode const& node, HostBvh8Ray const& ray, float t_entries[8]) noexcept;
+
+    // Chosen once from the ISA of the CPU. AVX2, SSE4.1, or plain C++.
+    HostBvh8IntersectChildrenFunc SelectIntersectChildrenFunc() noexcept;
+
+    // Packet data shared by all the leaf tests of one traversal
+    struct HostBvh8Packet
+    {
+        float origin[3];
+        float t_min;
+        float inv_dir_x[HostRayPacket::MaxRays];
+        float inv_dir_y[HostRayPacket::MaxRays];
+        float inv_dir_z[HostRayPacket::MaxRays];
+    };
+
+    // Conservative packet test. Returns a bit mask of the children that overlap the frustum and are not farther than max_distance_sq
+    // from its origin, and their squared distances in distances_sq.
+    uint32_t CullChildren(HostBvh8Node const& node, HostFrustum const& frustum, float max_distance_sq, float distances_sq[8]) noexcept;
+    // Per ray test of one box, the same one IntersectChildrenScalar does. Returns a bit mask of the rays that hit it.
+    uint64_t IntersectChildRays(HostAabb const& bounds, HostBvh8Packet const& wide_packet, HostRayPacket const& packet) noexcept;
+
+    // Wide BVH collapsed from a binary one, stored compressed. The binary BVH is only needed during the build.
+    class HostBvh8 final
+    {
+    public:
+        static uint32_t constexpr Width = 8;
+        // Every level of the wide BVH consumes at least one level of the binary one
+        static uint32_t constexpr MaxStackSize = HostBvh::MaxDepth * (Width - 1) + 1;
+
+    public:
+        HostBvh8() noexcept;
+
+        // allow_update keeps what Refit needs, like ALLOW_UPDATE on the GPU acceleration structures
+        void Build(HostBvh const& bvh, bool allow_update = false);
+        // Like PERFORM_UPDATE. Recomputes the boxes from new primitive bounds, indexed like the ones the binary BVH was built from.
+        void Refit(ThreadPool& thread_pool, HostAabb const* prim_bounds);
+        // Refits keep the topology of the build, so the tree degrades when primitives move far. True when the boxes have grown so much
+        // that a rebuild would pay off.
+        bool NeedsRebuild() const noexcept;
+
+        bool Empty() const noexcept
+        {
+            return nodes_.empty();
+        }
+
+        HostAabb const& Bounds() const noexcept
+        {
+            return bounds_;
+        }
+
+        HostVector<HostBvh8CompressedNode> const& Nodes() const noexcept
+        {
+            return nodes_;
+        }
+
+        HostVector<uint32_t> const& PrimRefs() const noexcept
+        {
+            return prim_refs_;
+        }
+
+        // Same contract as HostBvh::Traverse
+        template <typename Intersector>
+        bool Traverse(HostRay& ray, Intersector&& intersect) const
+        {
+            return this->TraverseLeaves(ray, [this, &intersect](uint32_t first_ref, uint32_t num_refs, HostRay& leaf_ray) {
+                for (uint32_t i = 0; i < num_refs; ++i)
+                {
+                    if (intersect(prim_refs_[first_ref + i], leaf_ray))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
+
+        // Traverse a leaf at a time, for intersectors that test all the primitives of a leaf together. intersect(first_ref, num_refs,
+        // ray) gets the range of the leaf in PrimRefs(), and otherwise follows the contract of HostBvh::Traverse.
+        template <typename LeafIntersector>
+        bool TraverseLeaves(HostRay& ray, LeafIntersector&& intersect) const
+        {
+            if (nodes_.empty())
+            {
+                return false;
+            }
+
+            DirectX::XMFLOAT3 const inv_dir = InvDirection(ray.direction);
+
+            HostBvh8Ray wide_ray;
+            wide_ray.origin[0] = ray.origin.x;
+            wide_ray.origin[1] = ray.origin.y;
+            wide_ray.origin[2] = ray.origin.z;
+            wide_ray.t_min = ray.t_min;
+            wide_ray.inv_dir[0] = inv_dir.x;
+            wide_ray.inv_dir[1] = inv_dir.y;
+            wide_ray.inv_dir[2] = inv_dir.z;
+            wide_ray.t_max = ray.t_max;
+
+            struct StackEntry
+            {
+                uint32_t child;
+                uint32_t num_prims;
+                float t_entry;
+            };
+            StackEntry stack[MaxStackSize];
+            uint32_t stack_size = 0;
+            stack[stack_size] = {0, 0, ray.t_min};
+            ++stack_size;
+
+            while (stack_size > 0)
+            {
+                --stack_size;
+                StackEntry const entry = stack[stack_size];
+                if (entry.t_entry > ray.t_max)
+                {
+                    continue;
+                }
+
+                if (entry.num_prims > 0)
+                {
+                    if (intersect(entry.child, entry.num_prims, ray))
+                    {
+                        return true;
+                    }
+                    continue;
+                }
+
+                auto const& node = nodes_[entry.child];
+                wide_ray.t_max = ray.t_max;
+                float t_entries[Width];
+                uint32_t hit_mask = intersect_children_(node, wide_ray, t_entries);
+
+                // Sort the hit children far to near, so the nearest one is popped first
+                uint32_t const stack_base = stack_size;
+                while (hit_mask != 0)
+                {
+                    uint32_t const slot = LowestBit(hit_mask);
+                    hit_mask &= hit_mask - 1;
+
+                    StackEntry const child_entry = {CompressedChild(node, slot), CompressedNumPrims(node, slot), t_entries[slot]};
+                    uint32_t pos = stack_size;
+                    while ((pos > stack_base) && (stack[pos - 1].t_entry < child_entry.t_entry))
+                    {
+                        stack[pos] = stack[pos - 1];
+                        --pos;
+                    }
+                    stack[pos] = child_entry;
+                    ++stack_size;
+                }
+            }
+
+            return false;
+        }
+
+        // Occlusion query of a shadow ray. intersect(prim_id, ray) returns true on an occluding hit, which ends the traversal. The hit
+        // children are not sorted by distance, only the first hit matters. Leaves are tested as soon as they are reached, and interior
+        // children are visited largest first, since big boxes are the likeliest to hold an occluder.
+        template <typename Intersector>
+        bool TraverseAnyHit(HostRay const& ray, Intersector&& intersect) const
+        {
+            return this->TraverseLeavesAnyHit(ray, [this, &intersect](uint32_t first_ref, uint32_t num_refs, HostRay const& leaf_ray) {
+                for (uint32_t i = 0; i < num_refs; ++i)
+                {
+                    if (intersect(prim_refs_[first_ref + i], leaf_ray))
+                    {
+                        return true;
+                    }
+                }
+                return false;
+            });
+        }
+
+        // TraverseAnyHit a leaf at a time. intersect(first_ref, num_refs, ray) returns true when any primitive of the leaf occludes.
+        template <typename LeafIntersector>
+        bool TraverseLeavesAnyHit(HostRay const& ray, LeafIntersector&& intersect) const
+        {
+            if (nodes_.empty())
+            {
+                return false;
+            }
+
+            DirectX::XMFLOAT3 const inv_dir = InvDirection(ray.direction);
+
+            HostBvh8Ray wide_ray;
+            wide_ray.origin[0] = ray.origin.x;
+            wide_ray.origin[1] = ray.origin.y;
+            wide_ray.origin[2] = ray.origin.z;
+            wide_ray.t_min = ray.t_min;
+            wide_ray.inv_dir[0] = inv_dir.x;
+            wide_ray.inv_dir[1] = inv_dir.y;
+            wide_ray.inv_dir[2] = inv_dir.z;
+            wide_ray.t_max = ray.t_max;
+
+            struct StackEntry
+            {
+                uint32_t node;
+                float half_area;
+            };
+            StackEntry stack[MaxStackSize];
+            uint32_t stack_size = 0;
+            stack[stack_size] = {0, 0};
+            ++stack_size;
+
+            while (stack_size > 0)
+            {
+                --stack_size;
+                auto const& node = nodes_[stack[stack_size].node];
+
+                float t_entries[Width];
+                uint32_t hit_mask = intersect_children_(node, wide_ray, t_entries);
+
+                uint32_t const stack_base = stack_size;
+                while (hit_mask != 0)
+                {
+                    uint32_t const slot = LowestBit(hit_mask);
+                    hit_mask &= hit_mask - 1;
+
+                    uint32_t const num_prims = CompressedNumPrims(node, slot);
+                    if (num_prims > 0)
+                    {
+                        if (intersect(CompressedChild(node, slot), num_prims, ray))
+                        {
+                            return true;
+                        }
+                        continue;
+                    }
+
+                    // Straight from the quantized extents, good enough for ordering
+                    float const dx = QuantizationScale(node.exponents[0]) * (node.q_max_x[slot] - node.q_min_x[slot]);
+                    float const dy = QuantizationScale(node.exponents[1]) * (node.q_max_y[slot] - node.q_min_y[slot]);
+                    float const dz = QuantizationScale(node.exponents[2]) * (node.q_max_z[slot] - node.q_min_z[slot]);
+                    StackEntry const child_entry = {CompressedChild(node, slot), dx * dy + dy * dz + dz * dx};
+                    uint32_t pos = stack_size;
+                    while ((pos > stack_base) && (stack[pos - 1].half_area > child_entry.half_area))
+                    {
+                        stack[pos] = stack[pos - 1];
+                        --pos;
+                    }
+                    stack[pos] = child_entry;
+                    ++stack_size;
+                }
+            }
+
+            return false;
+        }
+
+        // Visits every leaf the packet frustum reaches, nearest first. intersect(prim_id, packet, ray_mask) tests the rays in ray_mask,
+        // the ones that hit the box of the leaf, and shortens their t_max. There is no early termination, packets only look for the
+        // closest hits.
+        template <typename Intersector>
+        void TraversePacket(HostRayPacket& packet, Intersector&& intersect) const
+        {
+            this->TraversePacketLeaves(
+                packet, [this, &intersect](uint32_t first_ref, uint32_t num_refs, HostRayPacket& leaf_packet, uint64_t ray_mask) {
+                    for (uint32_t i = 0; i < num_refs; ++i)
+                    {
+                        intersect(prim_refs_[first_ref + i], leaf_packet, ray_mask);
+                    }
+                });
+        }
+
+        // TraversePacket a leaf at a time. intersect(first_ref, num_refs, packet, ray_mask) tests the whole leaf.
+        template <typename LeafIntersector>
+        void TraversePacketLeaves(HostRayPacket& packet, LeafIntersector&& intersect) const
+        {
+            if (nodes_.empty())
+            {
+                return;
+            }
+
+            HostFrustum const frustum(packet);
+            float max_distance_sq = packet.MaxDistanceSq();
+
+            HostBvh8Packet wide_packet;
+            wide_packet.origin[0] = packet.origin.x;
+            wide_packet.origin[1] = packet.origin.y;
+            wide_packet.origin[2] = packet.origin.z;
+            wide_packet.t_min = packet.t_min;
+            for (uint32_t i = 0; i < packet.num_rays; ++i)
+            {
+                DirectX::XMFLOAT3 const inv_dir = InvDirection(packet.directions[i]);
+                wide_packet.inv_dir_x[i] = inv_dir.x;
+                wide_packet.inv_dir_y[i] = inv_dir.y;
+                wide_packet.inv_dir_z[i] = inv_dir.z;
+            }
+
+            struct StackEntry
+            {
+                uint32_t child;
+                uint32_t num_prims;
+                float distance_sq;
+                // Leaves only, where the box of the leaf is stored
+                uint32_t parent;
+                uint32_t slot;
+            };
+            StackEntry stack[MaxStackSize];
+            uint32_t stack_size = 0;
+            stack[stack_size] = {0, 0, 0, 0, 0};
+            ++stack_size;
+
+            while (stack_size > 0)
+            {
+                --stack_size;
+                StackEntry const entry = stack[stack_size];
+                if (entry.distance_sq > max_distance_sq)
+                {
+                    continue;
+                }
+
+                if (entry.num_prims > 0)
+                {
+                    uint64_t const ray_mask = IntersectChildRays(DecodeChildBounds(nodes_[entry.parent], entry.slot), wide_packet, packet);
+                    if (ray_mask != 0)
+                    {
+                        intersect(entry.child, entry.num_prims, packet, ray_mask);
+                        max_distance_sq = packet.MaxDistanceSq();
+                    }
+                    continue;
+                }
+
+                HostBvh8Node node;
+                DecodeNode(nodes_[entry.child], node);
+                float distances_sq[Width];
+                uint32_t hit_mask = CullChildren(node, frustum, max_distance_sq, distances_sq);
+
+                uint32_t const stack_base = stack_size;
+                while (hit_mask != 0)
+                {
+                    uint32_t const slot = LowestBit(hit_mask);
+                    hit_mask &= hit_mask - 1;
+
+                    StackEntry const child_entry = {node.children[slot], node.num_prims[slot], distances_sq[slot], entry.child, slot};
+                    uint32_t pos = stack_size;
+                    while ((pos > stack_base) && (stack[pos - 1].distance_sq < child_entry.distance_sq))
+                    {
+                        stack[pos] = stack[pos - 1];
+                        --pos;
+                    }
+                    stack[pos] = child_entry;
+                    ++stack_size;
+                }
+            }
+        }
+
+    private:
+        HostVector<HostBvh8CompressedNode> nodes_;
+        HostVector<uint32_t> prim_refs_;
+        HostAabb bounds_;
+
+        bool allow_update_ = false;
+        // Exact bounds of the nodes, the compressed ones are only conservative
+        std::vector<HostAabb> node_bounds_;
+        float built_area_ = 0;
+        float refitted_area_ = 0;
+        // Nodes in breadth first order, and where every level starts in it
+        std::vector<uint32_t> refit_order_;
+        std::vector<uint32_t> refit_level_starts_;
+
+        HostBvh8IntersectChildrenFunc intersect_children_;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,57 @@
+#include "../pch.hpp"
+
+#include <immintrin.h>
+
+#include "HostBvh8.hpp"
+
+namespace
+{
+    using namespace GoldenSun;
+
+    __m256 Dequantize8(uint8_t const q[8], __m256 origin, __m256 scale) noexcept
+    {
+        __m256i const q_int = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(q)));
+        return _mm256_fmadd_ps(_mm256_cvtepi32_ps(q_int), scale, origin);
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // All 8 children in one pass. Only called when the CPU supports AVX2.
+    uint32_t IntersectChildrenAvx2(HostBvh8CompressedNode const& node, HostBvh8Ray const& ray, float t_entries[8]) noexcept
+    {
+        __m256 const origin_x = _mm256_set1_ps(ray.origin[0]);
+        __m256 const origin_y = _mm256_set1_ps(ray.origin[1]);
+        __m256 const origin_z = _mm256_set1_ps(ray.origin[2]);
+        __m256 const inv_dir_x = _mm256_set1_ps(ray.inv_dir[0]);
+        __m256 const inv_dir_y = _mm256_set1_ps(ray.inv_dir[1]);
+        __m256 const inv_dir_z = _mm256_set1_ps(ray.inv_dir[2]);
+
+        __m256 const node_origin_x = _mm256_set1_ps(node.origin.x);
+        __m256 const node_origin_y = _mm256_set1_ps(node.origin.y);
+        __m256 const node_origin_z = _mm256_set1_ps(node.origin.z);
+        __m256 const scale_x = _mm256_set1_ps(QuantizationScale(node.exponents[0]));
+        __m256 const scale_y = _mm256_set1_ps(QuantizationScale(node.exponents[1]));
+        __m256 const scale_z = _mm256_set1_ps(QuantizationScale(node.exponents[2]));
+
+        __m256 const tx0 = _mm256_mul_ps(_mm256_sub_ps(Dequantize8(node.q_min_x, node_origin_x, scale_x), origin_x), inv_dir_x);
+        __m256 const tx1 = _mm256_mul_ps(_mm256_sub_ps(Dequantize8(node.q_max_x, node_origin_x, scale_x), origin_x), inv_dir_x);
+        __m256 const ty0 = _mm256_mul_ps(_mm256_sub_ps(Dequantize8(node.q_min_y, node_origin_y, scale_y), origin_y), inv_dir_y);
+        __m256 const ty1 = _mm256_mul_ps(_mm256_sub_ps(Dequantize8(node.q_max_y, node_origin_y, scale_y), origin_y), inv_dir_y);
+        __m256 const tz0 = _mm256_mul_ps(_mm256_sub_ps(Dequantize8(node.q_min_z, node_origin_z, scale_z), origin_z), inv_dir_z);
+        __m256 const tz1 = _mm256_mul_ps(_mm256_sub_ps(Dequantize8(node.q_max_z, node_origin_z, scale_z), origin_z), inv_dir_z);
+
+        __m256 const t_near = _mm256_max_ps(_mm256_max_ps(_mm256_set1_ps(ray.t_min), _mm256_min_ps(tx0, tx1)),
+            _mm256_max_ps(_mm256_min_ps(ty0, ty1), _mm256_min_ps(tz0, tz1)));
+        __m256 const t_far = _mm256_min_ps(_mm256_min_ps(_mm256_set1_ps(ray.t_max), _mm256_max_ps(tx0, tx1)),
+            _mm256_min_ps(_mm256_max_ps(ty0, ty1), _mm256_max_ps(tz0, tz1)));
+
+        // Empty slots decode to a point at the origin of the node
+        uint32_t const empty_meta_mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(node.meta)), _mm_setzero_si128())));
+        uint32_t const empty_mask = empty_meta_mask & ~static_cast<uint32_t>(node.interior_mask) & 0xFFU;
+
+        _mm256_storeu_ps(t_entries, t_near);
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(t_near, t_far, _CMP_LE_OQ))) & ~empty_mask;
+    }
+} // namespace GoldenSun
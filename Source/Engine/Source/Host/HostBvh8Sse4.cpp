@@ -0,0 +1,71 @@
+#include "../pch.hpp"
+
+#include <cstring>
+
+#include <smmintrin.h>
+
+#include "HostBvh8.hpp"
+
+namespace
+{
+    using namespace GoldenSun;
+
+    __m128 Dequantize4(uint8_t const q[4], __m128 origin, __m128 scale) noexcept
+    {
+        int32_t q4;
+        std::memcpy(&q4, q, sizeof(q4));
+        __m128i const q_int = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(q4));
+        return _mm_add_ps(origin, _mm_mul_ps(_mm_cvtepi32_ps(q_int), scale));
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // Two halves of 4 children each
+    uint32_t IntersectChildrenSse4(HostBvh8CompressedNode const& node, HostBvh8Ray const& ray, float t_entries[8]) noexcept
+    {
+        __m128 const origin_x = _mm_set1_ps(ray.origin[0]);
+        __m128 const origin_y = _mm_set1_ps(ray.origin[1]);
+        __m128 const origin_z = _mm_set1_ps(ray.origin[2]);
+        __m128 const inv_dir_x = _mm_set1_ps(ray.inv_dir[0]);
+        __m128 const inv_dir_y = _mm_set1_ps(ray.inv_dir[1]);
+        __m128 const inv_dir_z = _mm_set1_ps(ray.inv_dir[2]);
+        __m128 const t_min = _mm_set1_ps(ray.t_min);
+        __m128 const t_max = _mm_set1_ps(ray.t_max);
+
+        __m128 const node_origin_x = _mm_set1_ps(node.origin.x);
+        __m128 const node_origin_y = _mm_set1_ps(node.origin.y);
+        __m128 const node_origin_z = _mm_set1_ps(node.origin.z);
+        __m128 const scale_x = _mm_set1_ps(QuantizationScale(node.exponents[0]));
+        __m128 const scale_y = _mm_set1_ps(QuantizationScale(node.exponents[1]));
+        __m128 const scale_z = _mm_set1_ps(QuantizationScale(node.exponents[2]));
+
+        uint32_t hit_mask = 0;
+        for (uint32_t half = 0; half < 2; ++half)
+        {
+            uint32_t const base = half * 4;
+
+            __m128 const tx0 = _mm_mul_ps(_mm_sub_ps(Dequantize4(&node.q_min_x[base], node_origin_x, scale_x), origin_x), inv_dir_x);
+            __m128 const tx1 = _mm_mul_ps(_mm_sub_ps(Dequantize4(&node.q_max_x[base], node_origin_x, scale_x), origin_x), inv_dir_x);
+            __m128 const ty0 = _mm_mul_ps(_mm_sub_ps(Dequantize4(&node.q_min_y[base], node_origin_y, scale_y), origin_y), inv_dir_y);
+            __m128 const ty1 = _mm_mul_ps(_mm_sub_ps(Dequantize4(&node.q_max_y[base], node_origin_y, scale_y), origin_y), inv_dir_y);
+            __m128 const tz0 = _mm_mul_ps(_mm_sub_ps(Dequantize4(&node.q_min_z[base], node_origin_z, scale_z), origin_z), inv_dir_z);
+            __m128 const tz1 = _mm_mul_ps(_mm_sub_ps(Dequantize4(&node.q_max_z[base], node_origin_z, scale_z), origin_z), inv_dir_z);
+
+            __m128 const t_near = _mm_max_ps(
+                _mm_max_ps(t_min, _mm_min_ps(tx0, tx1)), _mm_max_ps(_mm_min_ps(ty0, ty1), _mm_min_ps(tz0, tz1)));
+            __m128 const t_far = _mm_min_ps(
+                _mm_min_ps(t_max, _mm_max_ps(tx0, tx1)), _mm_min_ps(_mm_max_ps(ty0, ty1), _mm_max_ps(tz0, tz1)));
+
+            _mm_storeu_ps(&t_entries[base], t_near);
+            hit_mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(t_near, t_far))) << base;
+        }
+
+        // Empty slots decode to a point at the origin of the node
+        uint32_t const empty_meta_mask = static_cast<uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(node.meta)), _mm_setzero_si128())));
+        uint32_t const empty_mask = empty_meta_mask & ~static_cast<uint32_t>(node.interior_mask) & 0xFFU;
+
+        return hit_mask & ~empty_mask;
+    }
+} // namespace GoldenSun
@@ -0,0 +1,76 @@
+#include "../pch.hpp"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+#include "HostCpu.hpp"
+
+namespace
+{
+    void CpuId(uint32_t leaf, uint32_t sub_leaf, uint32_t regs[4]) noexcept
+    {
+#ifdef _MSC_VER
+        int int_regs[4];
+        __cpuidex(int_regs, static_cast<int>(leaf), static_cast<int>(sub_leaf));
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            regs[i] = static_cast<uint32_t>(int_regs[i]);
+        }
+#else
+        __cpuid_count(leaf, sub_leaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    uint64_t XGetBv() noexcept
+    {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        uint32_t eax;
+        uint32_t edx;
+        __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    bool SupportsSse4() noexcept
+    {
+        uint32_t regs[4];
+        CpuId(1, 0, regs);
+        return (regs[2] & (1U << 19)) != 0;
+    }
+
+    bool SupportsAvx2() noexcept
+    {
+        uint32_t regs[4];
+        CpuId(0, 0, regs);
+        if (regs[0] < 7)
+        {
+            return false;
+        }
+
+        CpuId(1, 0, regs);
+        bool const fma = (regs[2] & (1U << 12)) != 0;
+        bool const os_xsave = (regs[2] & (1U << 27)) != 0;
+        bool const avx = (regs[2] & (1U << 28)) != 0;
+        if (!(fma && os_xsave && avx))
+        {
+            return false;
+        }
+
+        // The OS must save the YMM registers on context switches
+        if ((XGetBv() & 0x6) != 0x6)
+        {
+            return false;
+        }
+
+        CpuId(7, 0, regs);
+        return (regs[1] & (1U << 5)) != 0;
+    }
+} // namespace GoldenSun
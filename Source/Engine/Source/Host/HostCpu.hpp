@@ -0,0 +1,9 @@
+#pragma once
+
+namespace GoldenSun
+{
+    // ISA checks of the CPU, for picking the SIMD kernels at runtime
+    bool SupportsSse4() noexcept;
+    // Also checks FMA, and that the OS saves the YMM registers
+    bool SupportsAvx2() noexcept;
+} // namespace GoldenSun
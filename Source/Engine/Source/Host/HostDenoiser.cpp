@@ -0,0 +1,210 @@
+#include "../pch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "HostCpu.hpp"
+#include "HostDenoiser.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    uint32_t constexpr NumPasses = 5;
+    uint32_t constexpr NumPlanes = 14;
+
+    // Edge-stopping sigmas. The color one is relative to the luminance of the center pixel, and halves every pass, so the wide passes
+    // only average what the narrow ones already made similar. The depth one is relative to the depth, per pixel of distance.
+    float constexpr SigmaColor = 8.0f;
+    float constexpr SigmaAlbedo = 0.1f;
+    float constexpr SigmaNormal = 0.3f;
+    float constexpr SigmaDepth = 0.02f;
+
+    // Below it the illumination is not divided by the albedo, it would only blow up the noise
+    float constexpr MinDemodulationAlbedo = 0.01f;
+    float constexpr MinDepth = 1e-6f;
+
+    float DemodulationAlbedo(float albedo) noexcept
+    {
+        return std::max(albedo, MinDemodulationAlbedo);
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void AtrousPixelsScalar(HostAtrousPass const& pass, uint32_t y, uint32_t x_begin, uint32_t x_end) noexcept
+    {
+        int32_t const width = static_cast<int32_t>(pass.width);
+        int32_t const height = static_cast<int32_t>(pass.height);
+        int32_t const step = static_cast<int32_t>(pass.step);
+
+        for (uint32_t x = x_begin; x < x_end; ++x)
+        {
+            size_t const center = static_cast<size_t>(y) * pass.width + x;
+            float const center_r = pass.src[0][center];
+            float const center_g = pass.src[1][center];
+            float const center_b = pass.src[2][center];
+            float const center_luminance = AtrousLuminance(center_r, center_g, center_b);
+            float const color_weight = pass.color_weight / (center_luminance * center_luminance + AtrousMinLuminanceSq);
+
+            float sum_weight = 0;
+            float sum_r = 0;
+            float sum_g = 0;
+            float sum_b = 0;
+            for (int32_t dy = -2; dy <= 2; ++dy)
+            {
+                int32_t const tap_y = static_cast<int32_t>(y) + dy * step;
+                if ((tap_y < 0) || (tap_y >= height))
+                {
+                    continue;
+                }
+
+                for (int32_t dx = -2; dx <= 2; ++dx)
+                {
+                    int32_t const tap_x = static_cast<int32_t>(x) + dx * step;
+                    if ((tap_x < 0) || (tap_x >= width))
+                    {
+                        continue;
+                    }
+
+                    size_t const tap = static_cast<size_t>(tap_y) * pass.width + tap_x;
+                    float const tap_r = pass.src[0][tap];
+                    float const tap_g = pass.src[1][tap];
+                    float const tap_b = pass.src[2][tap];
+
+                    float const diff_r = tap_r - center_r;
+                    float const diff_g = tap_g - center_g;
+                    float const diff_b = tap_b - center_b;
+                    float const diff_albedo_r = pass.albedo[0][tap] - pass.albedo[0][center];
+                    float const diff_albedo_g = pass.albedo[1][tap] - pass.albedo[1][center];
+                    float const diff_albedo_b = pass.albedo[2][tap] - pass.albedo[2][center];
+                    float const diff_normal_x = pass.normal[0][tap] - pass.normal[0][center];
+                    float const diff_normal_y = pass.normal[1][tap] - pass.normal[1][center];
+                    float const diff_normal_z = pass.normal[2][tap] - pass.normal[2][center];
+                    float const diff_depth = (pass.depth[tap] - pass.depth[center]) * pass.inv_depth[center];
+
+                    float const color_dist = diff_r * diff_r + diff_g * diff_g + diff_b * diff_b;
+                    float const albedo_dist = diff_albedo_r * diff_albedo_r + diff_albedo_g * diff_albedo_g + diff_albedo_b * diff_albedo_b;
+                    float const normal_dist = diff_normal_x * diff_normal_x + diff_normal_y * diff_normal_y + diff_normal_z * diff_normal_z;
+                    float const depth_dist = diff_depth * diff_depth;
+
+                    float const exponent = color_dist * color_weight + albedo_dist * pass.albedo_weight + normal_dist * pass.normal_weight +
+                                           depth_dist * pass.depth_weight;
+                    float const weight = AtrousKernel[dy + 2] * AtrousKernel[dx + 2] * AtrousExpNegative(exponent);
+
+                    sum_weight += weight;
+                    sum_r += weight * tap_r;
+                    sum_g += weight * tap_g;
+                    sum_b += weight * tap_b;
+                }
+            }
+
+            // The center tap always has a weight of 1 before the kernel, so the sum is never 0
+            float const inv_sum_weight = 1 / sum_weight;
+            pass.dst[0][center] = sum_r * inv_sum_weight;
+            pass.dst[1][center] = sum_g * inv_sum_weight;
+            pass.dst[2][center] = sum_b * inv_sum_weight;
+        }
+    }
+
+    void AtrousRowScalar(HostAtrousPass const& pass, uint32_t y) noexcept
+    {
+        AtrousPixelsScalar(pass, y, 0, pass.width);
+    }
+
+    HostAtrousRowFunc SelectAtrousRowFunc() noexcept
+    {
+        static HostAtrousRowFunc const func = SupportsSse4() ? &AtrousRowSse4 : &AtrousRowScalar;
+        return func;
+    }
+
+    HostDenoiser::HostDenoiser() : HostDenoiser(SelectAtrousRowFunc())
+    {
+    }
+
+    HostDenoiser::HostDenoiser(HostAtrousRowFunc atrous_row) : atrous_row_(atrous_row)
+    {
+    }
+
+    void HostDenoiser::Denoise(
+        ThreadPool& thread_pool, uint32_t width, uint32_t height, HostDenoiserFeatures const* features, XMFLOAT4* color)
+    {
+        size_t const num_pixels = static_cast<size_t>(width) * height;
+        planes_.resize(NumPlanes * num_pixels);
+
+        float* illumination[2][3];
+        float* albedo[3];
+        float* normal[3];
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            illumination[0][i] = &planes_[(0 + i) * num_pixels];
+            illumination[1][i] = &planes_[(3 + i) * num_pixels];
+            albedo[i] = &planes_[(6 + i) * num_pixels];
+            normal[i] = &planes_[(9 + i) * num_pixels];
+        }
+        float* depth = &planes_[12 * num_pixels];
+        float* inv_depth = &planes_[13 * num_pixels];
+
+        // To SoA, with the albedo divided out
+        thread_pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread_index*/) {
+            for (size_t pixel = static_cast<size_t>(y) * width; pixel < static_cast<size_t>(y + 1) * width; ++pixel)
+            {
+                auto const& feature = features[pixel];
+                albedo[0][pixel] = feature.albedo.x;
+                albedo[1][pixel] = feature.albedo.y;
+                albedo[2][pixel] = feature.albedo.z;
+                normal[0][pixel] = feature.normal.x;
+                normal[1][pixel] = feature.normal.y;
+                normal[2][pixel] = feature.normal.z;
+                depth[pixel] = feature.depth;
+                inv_depth[pixel] = 1 / std::max(feature.depth, MinDepth);
+                illumination[0][0][pixel] = color[pixel].x / DemodulationAlbedo(feature.albedo.x);
+                illumination[0][1][pixel] = color[pixel].y / DemodulationAlbedo(feature.albedo.y);
+                illumination[0][2][pixel] = color[pixel].z / DemodulationAlbedo(feature.albedo.z);
+            }
+        });
+
+        HostAtrousPass pass;
+        pass.width = width;
+        pass.height = height;
+        pass.depth = depth;
+        pass.inv_depth = inv_depth;
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            pass.albedo[i] = albedo[i];
+            pass.normal[i] = normal[i];
+        }
+        pass.albedo_weight = 1 / (SigmaAlbedo * SigmaAlbedo);
+        pass.normal_weight = 1 / (SigmaNormal * SigmaNormal);
+
+        uint32_t src = 0;
+        for (uint32_t pass_index = 0; pass_index < NumPasses; ++pass_index)
+        {
+            pass.step = 1U << pass_index;
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                pass.src[i] = illumination[src][i];
+                pass.dst[i] = illumination[src ^ 1][i];
+            }
+
+            float const sigma_color = SigmaColor / pass.step;
+            float const sigma_depth = SigmaDepth * pass.step;
+            pass.color_weight = 1 / (sigma_color * sigma_color);
+            pass.depth_weight = 1 / (sigma_depth * sigma_depth);
+
+            thread_pool.ParallelFor(height, [this, &pass](uint32_t y, uint32_t /*thread_index*/) { atrous_row_(pass, y); });
+
+            src ^= 1;
+        }
+
+        thread_pool.ParallelFor(height, [&](uint32_t y, uint32_t /*thread_index*/) {
+            for (size_t pixel = static_cast<size_t>(y) * width; pixel < static_cast<size_t>(y + 1) * width; ++pixel)
+            {
+                color[pixel].x = illumination[src][0][pixel] * DemodulationAlbedo(albedo[0][pixel]);
+                color[pixel].y = illumination[src][1][pixel] * DemodulationAlbedo(albedo[1][pixel]);
+                color[pixel].z = illumination[src][2][pixel] * DemodulationAlbedo(albedo[2][pixel]);
+            }
+        });
+    }
+} // namespace GoldenSun
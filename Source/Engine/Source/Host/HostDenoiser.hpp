@@ -0,0 +1,102 @@
+#pragma once
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <DirectXMath.h>
+
+namespace GoldenSun
+{
+    // Guide of one pixel, the first hit of its samples averaged
+    struct HostDenoiserFeatures
+    {
+        DirectX::XMFLOAT3 albedo;
+        DirectX::XMFLOAT3 normal;
+        // Distance to the eye
+        float depth;
+    };
+
+    // One a-trous pass. Every plane is width * height floats in rows.
+    struct HostAtrousPass
+    {
+        uint32_t width;
+        uint32_t height;
+        uint32_t step;
+
+        float const* src[3];
+        float* dst[3];
+        float const* albedo[3];
+        float const* normal[3];
+        // Distance to the eye, and its inverse
+        float const* depth;
+        float const* inv_depth;
+
+        // 1 / sigma^2 of each edge-stopping term
+        float color_weight;
+        float albedo_weight;
+        float normal_weight;
+        float depth_weight;
+    };
+
+    // B3 spline, the 1D kernel of every pass
+    float constexpr AtrousKernel[] = {1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16};
+    // Keeps the relative color distance of near black pixels finite
+    float constexpr AtrousMinLuminanceSq = 1e-4f;
+
+    inline float AtrousLuminance(float r, float g, float b) noexcept
+    {
+        return 0.2126f * r + 0.7152f * g + 0.0722f * b;
+    }
+
+    // exp(-x) for x >= 0, to about 1e-4 relative. 2^(-x * log2(e)) split into the exponent bits and a polynomial of the fraction.
+    // Stops at 2^-100, far from the denormals, which are slow and would not change the weighted sums anyway. The SSE4.1 kernel runs
+    // the same operations, so it stays bit identical.
+    inline float AtrousExpNegative(float x) noexcept
+    {
+        float const t = std::max(-x * 1.44269504f, -100.0f);
+        float const i = std::floor(t);
+        float const f = t - i;
+        float const p = ((((0.00133335581f * f + 0.00961812911f) * f + 0.0555041087f) * f + 0.240226507f) * f + 0.693147181f) * f + 1;
+        int32_t const exponent_bits = (static_cast<int32_t>(i) + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &exponent_bits, sizeof(scale));
+        return p * scale;
+    }
+
+    // Filters row y of the pass. Taps outside the image are skipped.
+    using HostAtrousRowFunc = void (*)(HostAtrousPass const& pass, uint32_t y);
+
+    void AtrousRowScalar(HostAtrousPass const& pass, uint32_t y) noexcept;
+    // The scalar kernel on [x_begin, x_end) of a row. The SIMD kernel uses it on the borders, where taps fall outside the image.
+    void AtrousPixelsScalar(HostAtrousPass const& pass, uint32_t y, uint32_t x_begin, uint32_t x_end) noexcept;
+    void AtrousRowSse4(HostAtrousPass const& pass, uint32_t y) noexcept;
+
+    // Chosen once from the ISA of the CPU. SSE4.1, or plain C++. Both give the same results bit for bit.
+    HostAtrousRowFunc SelectAtrousRowFunc() noexcept;
+
+    // Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010). Five passes of a 5x5 B3 spline kernel, with holes of 1, 2, 4, 8 and
+    // 16 pixels, whose taps are weighted down across edges of the color, albedo, normal and depth. The color is divided by the albedo
+    // before filtering and multiplied back after, so textures stay sharp and only the lighting is smoothed.
+    class HostDenoiser final
+    {
+    public:
+        HostDenoiser();
+        // With a given kernel, for comparing them
+        explicit HostDenoiser(HostAtrousRowFunc atrous_row);
+
+        // color and features are width * height, in rows. color is filtered in place, its alpha is kept.
+        void Denoise(ThreadPool& thread_pool, uint32_t width, uint32_t height, HostDenoiserFeatures const* features,
+            DirectX::XMFLOAT4* color);
+
+    private:
+        HostAtrousRowFunc atrous_row_;
+
+        // Planes: illumination r, g, b twice for ping-pong, albedo r, g, b, normal x, y, z, depth, and the inverse depth
+        std::vector<float> planes_;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,125 @@
+#include "../pch.hpp"
+
+#include <smmintrin.h>
+
+#include "HostDenoiser.hpp"
+
+namespace
+{
+    // AtrousExpNegative on 4 lanes
+    __m128 ExpNegative(__m128 x) noexcept
+    {
+        __m128 const t = _mm_max_ps(_mm_mul_ps(_mm_xor_ps(x, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.44269504f)), _mm_set1_ps(-100.0f));
+        __m128 const i = _mm_floor_ps(t);
+        __m128 const f = _mm_sub_ps(t, i);
+        __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.00133335581f), f), _mm_set1_ps(0.00961812911f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0555041087f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.240226507f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.693147181f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+        __m128i const exponent_bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(i), _mm_set1_epi32(127)), 23);
+        return _mm_mul_ps(p, _mm_castsi128_ps(exponent_bits));
+    }
+
+    __m128 SquaredDistance(__m128 x, __m128 y, __m128 z) noexcept
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // 4 pixels of a row at a time, in the middle of the row where every tap is inside the image. Only called when the CPU supports
+    // SSE4.1.
+    void AtrousRowSse4(HostAtrousPass const& pass, uint32_t y) noexcept
+    {
+        uint32_t const border = 2 * pass.step;
+        if (pass.width < 2 * border + 4)
+        {
+            AtrousPixelsScalar(pass, y, 0, pass.width);
+            return;
+        }
+
+        AtrousPixelsScalar(pass, y, 0, border);
+
+        int32_t const height = static_cast<int32_t>(pass.height);
+        int32_t const step = static_cast<int32_t>(pass.step);
+
+        __m128 const albedo_weight = _mm_set1_ps(pass.albedo_weight);
+        __m128 const normal_weight = _mm_set1_ps(pass.normal_weight);
+        __m128 const depth_weight = _mm_set1_ps(pass.depth_weight);
+
+        uint32_t x = border;
+        for (; x + 4 + border <= pass.width; x += 4)
+        {
+            size_t const center = static_cast<size_t>(y) * pass.width + x;
+            __m128 const center_r = _mm_loadu_ps(&pass.src[0][center]);
+            __m128 const center_g = _mm_loadu_ps(&pass.src[1][center]);
+            __m128 const center_b = _mm_loadu_ps(&pass.src[2][center]);
+            __m128 const center_albedo_r = _mm_loadu_ps(&pass.albedo[0][center]);
+            __m128 const center_albedo_g = _mm_loadu_ps(&pass.albedo[1][center]);
+            __m128 const center_albedo_b = _mm_loadu_ps(&pass.albedo[2][center]);
+            __m128 const center_normal_x = _mm_loadu_ps(&pass.normal[0][center]);
+            __m128 const center_normal_y = _mm_loadu_ps(&pass.normal[1][center]);
+            __m128 const center_normal_z = _mm_loadu_ps(&pass.normal[2][center]);
+            __m128 const center_depth = _mm_loadu_ps(&pass.depth[center]);
+            __m128 const center_inv_depth = _mm_loadu_ps(&pass.inv_depth[center]);
+
+            __m128 const center_luminance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.2126f), center_r), _mm_mul_ps(_mm_set1_ps(0.7152f), center_g)),
+                _mm_mul_ps(_mm_set1_ps(0.0722f), center_b));
+            __m128 const color_weight = _mm_div_ps(_mm_set1_ps(pass.color_weight),
+                _mm_add_ps(_mm_mul_ps(center_luminance, center_luminance), _mm_set1_ps(AtrousMinLuminanceSq)));
+
+            __m128 sum_weight = _mm_setzero_ps();
+            __m128 sum_r = _mm_setzero_ps();
+            __m128 sum_g = _mm_setzero_ps();
+            __m128 sum_b = _mm_setzero_ps();
+            for (int32_t dy = -2; dy <= 2; ++dy)
+            {
+                int32_t const tap_y = static_cast<int32_t>(y) + dy * step;
+                if ((tap_y < 0) || (tap_y >= height))
+                {
+                    continue;
+                }
+
+                for (int32_t dx = -2; dx <= 2; ++dx)
+                {
+                    size_t const tap = static_cast<size_t>(tap_y) * pass.width + x + dx * step;
+                    __m128 const tap_r = _mm_loadu_ps(&pass.src[0][tap]);
+                    __m128 const tap_g = _mm_loadu_ps(&pass.src[1][tap]);
+                    __m128 const tap_b = _mm_loadu_ps(&pass.src[2][tap]);
+
+                    __m128 const color_dist =
+                        SquaredDistance(_mm_sub_ps(tap_r, center_r), _mm_sub_ps(tap_g, center_g), _mm_sub_ps(tap_b, center_b));
+                    __m128 const albedo_dist = SquaredDistance(_mm_sub_ps(_mm_loadu_ps(&pass.albedo[0][tap]), center_albedo_r),
+                        _mm_sub_ps(_mm_loadu_ps(&pass.albedo[1][tap]), center_albedo_g),
+                        _mm_sub_ps(_mm_loadu_ps(&pass.albedo[2][tap]), center_albedo_b));
+                    __m128 const normal_dist = SquaredDistance(_mm_sub_ps(_mm_loadu_ps(&pass.normal[0][tap]), center_normal_x),
+                        _mm_sub_ps(_mm_loadu_ps(&pass.normal[1][tap]), center_normal_y),
+                        _mm_sub_ps(_mm_loadu_ps(&pass.normal[2][tap]), center_normal_z));
+                    __m128 const diff_depth = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&pass.depth[tap]), center_depth), center_inv_depth);
+                    __m128 const depth_dist = _mm_mul_ps(diff_depth, diff_depth);
+
+                    __m128 const exponent =
+                        _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(color_dist, color_weight), _mm_mul_ps(albedo_dist, albedo_weight)),
+                                       _mm_mul_ps(normal_dist, normal_weight)),
+                            _mm_mul_ps(depth_dist, depth_weight));
+                    __m128 const weight = _mm_mul_ps(_mm_set1_ps(AtrousKernel[dy + 2] * AtrousKernel[dx + 2]), ExpNegative(exponent));
+
+                    sum_weight = _mm_add_ps(sum_weight, weight);
+                    sum_r = _mm_add_ps(sum_r, _mm_mul_ps(weight, tap_r));
+                    sum_g = _mm_add_ps(sum_g, _mm_mul_ps(weight, tap_g));
+                    sum_b = _mm_add_ps(sum_b, _mm_mul_ps(weight, tap_b));
+                }
+            }
+
+            __m128 const inv_sum_weight = _mm_div_ps(_mm_set1_ps(1.0f), sum_weight);
+            _mm_storeu_ps(&pass.dst[0][center], _mm_mul_ps(sum_r, inv_sum_weight));
+            _mm_storeu_ps(&pass.dst[1][center], _mm_mul_ps(sum_g, inv_sum_weight));
+            _mm_storeu_ps(&pass.dst[2][center], _mm_mul_ps(sum_b, inv_sum_weight));
+        }
+
+        AtrousPixelsScalar(pass, y, x, pass.width);
+    }
+} // namespace GoldenSun
@@ -0,0 +1,1243 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ErrorHandling.hpp>
+#include <GoldenSun/Light.hpp>
+#include <GoldenSun/Material.hpp>
+#include <GoldenSun/Util.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "HostEngine.hpp"
+#include "HostLightShading.hpp"
+#include "HostShading.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+    // One tile is traced as one ray packet
+    uint32_t constexpr TileSize = 8;
+    static_assert(TileSize * TileSize <= GoldenSun::HostRayPacket::MaxRays);
+
+    // Tiles whose paths are in flight together in the wavefront path tracer. Enough paths for every chunk of every thread, few
+    // enough that their states stay in the caches between the stages as much as possible.
+    uint32_t constexpr WaveTiles = 256;
+    uint32_t constexpr MaxWavePaths = WaveTiles * TileSize * TileSize;
+    // Paths or shadow rays a thread takes at a time from a queue
+    uint32_t constexpr QueueChunkSize = 256;
+    // Smaller queues are extended in the order they are in. Their few rays are spread over the whole scene, sorted or not, so the
+    // sort costs more than it can save. Measured on a scene whose BVH is past the LLC, where the sort started to pay at 1024 paths.
+    uint32_t constexpr MinSortedPaths = 1024;
+
+    // Fewer samples give a variance estimate too noisy to stop on
+    uint32_t constexpr MinAdaptiveSamples = 4;
+    // Keeps the relative error of near black pixels finite
+    float constexpr MinErrorLuminance = 0.01f;
+
+    // Paths always get this many bounces before Russian roulette may end them
+    uint32_t constexpr MinRouletteBounces = 2;
+    // Even bright paths end sometimes, so a path between two bright surfaces can't run for long
+    float constexpr MaxRouletteSurvival = 0.95f;
+
+    // LOD of every sample while texture LOD is off. Far enough below 0 that no texture size brings it to a mip other than the top.
+    float constexpr NoTextureLod = -128.0f;
+
+    uint32_t NumChunks(uint32_t queue_size) noexcept
+    {
+        return (queue_size + QueueChunkSize - 1) / QueueChunkSize;
+    }
+
+    float Luminance(DirectX::XMFLOAT4 const& color) noexcept
+    {
+        return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+    }
+
+    uint8_t FloatToUnorm8(float value) noexcept
+    {
+        return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255 + 0.5f);
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    Engine::Impl::Host::Host(uint32_t num_threads)
+        : thread_pool_(num_threads), frame_placement_(HostPlacement::Block(thread_pool_)), shade_lights_(SelectShadeLightsFunc())
+    {
+        paths_.Resize(MaxWavePaths);
+        light_sample_queues_.resize(thread_pool_.NumThreads());
+        shadow_queues_.resize(thread_pool_.NumThreads());
+        scene_.Placement(thread_pool_, HostScenePlacement::Interleaved);
+    }
+
+    void Engine::Impl::Host::RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format, XMFLOAT4 const& bg_color)
+    {
+        Verify(FormatSize(format) == 4);
+
+        if ((width != width_) || (height != height_) || (format != format_) || (bg_color.x != bg_color_.x) ||
+            (bg_color.y != bg_color_.y) || (bg_color.z != bg_color_.z) || (bg_color.w != bg_color_.w))
+        {
+            sample_count_ = 0;
+        }
+
+        bg_color_ = bg_color;
+
+        width_ = width;
+        height_ = height;
+        format_ = format;
+        if ((width_ > 0) && (height_ > 0))
+        {
+            aspect_ratio_ = static_cast<float>(width) / height;
+        }
+
+        size_t const num_pixels = static_cast<size_t>(width_) * height_;
+        if (accumulation_buffer_.size() != num_pixels)
+        {
+            // Exactly the size of the frame, so the blocks of the nodes line up with the rows
+            HostPlacementScope scope(frame_placement_);
+            output_ = HostVector<uint8_t>(num_pixels * FormatSize(format_));
+            accumulation_buffer_ = HostVector<XMFLOAT4>(num_pixels);
+            luminance_sq_sum_ = HostVector<float>(num_pixels);
+            feature_sum_ = HostVector<HostDenoiserFeatures>(num_pixels);
+        }
+        else
+        {
+            std::fill(output_.begin(), output_.end(), static_cast<uint8_t>(0));
+        }
+
+        num_tiles_x_ = (width_ + TileSize - 1) / TileSize;
+        num_tiles_y_ = (height_ + TileSize - 1) / TileSize;
+        tile_sample_counts_.resize(num_tiles_x_ * num_tiles_y_);
+        tile_errors_.resize(num_tiles_x_ * num_tiles_y_);
+    }
+
+    void Engine::Impl::Host::Meshes(Mesh const* meshes, uint32_t num_meshes, BuildPreference build_preference)
+    {
+        HostBvhBuildMode build_mode;
+        switch (build_preference)
+        {
+        case BuildPreference::FastBuild:
+            build_mode = HostBvhBuildMode::PreferFastBuild;
+            break;
+        case BuildPreference::FastTraceSpatialSplits:
+            build_mode = HostBvhBuildMode::PreferFastTraceSpatialSplits;
+            break;
+        default:
+            build_mode = HostBvhBuildMode::PreferFastTrace;
+            break;
+        }
+
+        scene_.Meshes(thread_pool_, meshes, num_meshes, build_mode);
+        sample_count_ = 0;
+    }
+
+    void Engine::Impl::Host::Lights(PointLight const* lights, uint32_t num_lights)
+    {
+        std::vector<LightBuffer> new_lights(num_lights);
+        for (uint32_t i = 0; i < num_lights; ++i)
+        {
+            new_lights[i] = EngineInternal::Buffer(lights[i]);
+        }
+        if ((new_lights.size() != lights_.size()) ||
+            (std::memcmp(new_lights.data(), lights_.data(), new_lights.size() * sizeof(LightBuffer)) != 0))
+        {
+            sample_count_ = 0;
+        }
+        lights_ = std::move(new_lights);
+        light_bvh_.Build(lights_.data(), static_cast<uint32_t>(lights_.size()));
+        light_grid_.Build(lights_.data(), static_cast<uint32_t>(lights_.size()));
+    }
+
+    void Engine::Impl::Host::Camera(GoldenSun::Camera const& camera)
+    {
+        if (!EngineInternal::SameView(camera, camera_))
+        {
+            sample_count_ = 0;
+        }
+        camera_ = camera.Clone();
+    }
+
+    // Each sample is at a different position inside the pixels. Without accumulation, every Render overwrites the output with one
+    // sample at the pixel centers.
+    void Engine::Impl::Host::Accumulation(bool enable)
+    {
+        if (enable != accumulation_)
+        {
+            sample_count_ = 0;
+        }
+        accumulation_ = enable;
+    }
+
+    uint32_t Engine::Impl::Host::SampleCount() const noexcept
+    {
+        return sample_count_;
+    }
+
+    // The error of a tile is the estimated relative error of its pixels, see TileError
+    void Engine::Impl::Host::AdaptiveSampling(float error_threshold, uint32_t max_samples)
+    {
+        error_threshold_ = error_threshold;
+        max_samples_ = max_samples;
+    }
+
+    bool Engine::Impl::Host::Converged() const noexcept
+    {
+        if (!accumulation_ || (sample_count_ == 0))
+        {
+            return false;
+        }
+
+        for (uint32_t tile = 0; tile < num_tiles_x_ * num_tiles_y_; ++tile)
+        {
+            if (!this->TileConverged(tile))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // An edge-avoiding filter, guided by the albedo, normal and depth of the first hits
+    void Engine::Impl::Host::Denoise(bool enable)
+    {
+        denoise_ = enable;
+    }
+
+    // Paths are lit by the point lights at every vertex and by the background where they escape, and Russian roulette ends the ones
+    // that carry little light. Replaces the ambient term, and blends transparent surfaces stochastically. Noisy, so it goes with
+    // accumulation.
+    void Engine::Impl::Host::PathTracing(uint32_t max_bounces)
+    {
+        if (max_bounces != max_bounces_)
+        {
+            sample_count_ = 0;
+        }
+        max_bounces_ = max_bounces;
+    }
+
+    // The lights are picked from light_bvh_, more likely the ones that give the point more light. For scenes with thousands of
+    // lights. Noisy, so it goes with accumulation.
+    void Engine::Impl::Host::LightSampling(uint32_t num_samples)
+    {
+        if (num_samples != light_samples_)
+        {
+            sample_count_ = 0;
+        }
+        light_samples_ = num_samples;
+    }
+
+    // The mip matches the footprint of the pixel on the hit, wider for distant surfaces, grazing angles and the hits of secondary
+    // rays. Less aliasing, and fewer cache misses on large textures.
+    void Engine::Impl::Host::TextureLod(bool enable)
+    {
+        if (enable != texture_lod_)
+        {
+            sample_count_ = 0;
+        }
+        texture_lod_ = enable;
+    }
+
+    // The textures of PbrMaterial::Texture with a TextureSource. Past the budget, the least recently used ones are dropped, and read
+    // again when a ray hits them.
+    void Engine::Impl::Host::TextureCacheBudget(uint64_t bytes)
+    {
+        scene_.TextureCache().Budget(bytes);
+    }
+
+    uint64_t Engine::Impl::Host::TextureCacheHits() const noexcept
+    {
+        return scene_.TextureCache().Hits();
+    }
+
+    uint64_t Engine::Impl::Host::TextureCacheMisses() const noexcept
+    {
+        return scene_.TextureCache().Misses();
+    }
+
+    // Textures read on demand are interleaved either way. The frame buffer always has the rows each node renders first on that
+    // node, and the threads stay on the node they start on. Nothing changes on a machine with a single node.
+    void Engine::Impl::Host::ScenePlacement(Placement placement)
+    {
+        scene_.Placement(
+            thread_pool_, (placement == Placement::Replicated) ? HostScenePlacement::Replicated : HostScenePlacement::Interleaved);
+    }
+
+    // The rest of the output keeps its pixels and their samples, moving the rectangle doesn't restart the accumulation, and
+    // Converged only looks at the tiles inside it. Every pixel draws the same samples as in a render of the whole frame, so parts
+    // rendered apart, even by different processes, put together into the same image, as long as they aren't denoised.
+    void Engine::Impl::Host::Scissor(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom)
+    {
+        if ((left < right) && (top < bottom))
+        {
+            // Rounded out to whole tiles. A tile's sample count and error cover all its pixels, a tile cut by an edge would be
+            // counted by both sides of it.
+            uint32_t constexpr MaxEdge = ~0U - (TileSize - 1);
+            scissor_left_ = left / TileSize * TileSize;
+            scissor_top_ = top / TileSize * TileSize;
+            scissor_right_ = Align<TileSize>(std::min(right, MaxEdge));
+            scissor_bottom_ = Align<TileSize>(std::min(bottom, MaxEdge));
+        }
+        else
+        {
+            scissor_left_ = 0;
+            scissor_top_ = 0;
+            scissor_right_ = ~0U;
+            scissor_bottom_ = ~0U;
+        }
+    }
+
+    void Engine::Impl::Host::Render(ID3D12GraphicsCommandList4* /*cmd_list*/)
+    {
+        if ((width_ == 0) || (height_ == 0))
+        {
+            return;
+        }
+
+        if (!accumulation_)
+        {
+            sample_count_ = 0;
+        }
+        if (sample_count_ == 0)
+        {
+            std::fill(tile_sample_counts_.begin(), tile_sample_counts_.end(), 0);
+        }
+        else if (this->Converged())
+        {
+            if (output_denoised_ != denoise_)
+            {
+                this->ResolveOutput();
+            }
+            return;
+        }
+
+        auto const view = XMMatrixLookAtLH(XMLoadFloat3(&camera_.Eye()), XMLoadFloat3(&camera_.LookAt()), XMLoadFloat3(&camera_.Up()));
+        auto const proj = XMMatrixPerspectiveFovLH(camera_.Fov(), aspect_ratio_, camera_.NearPlane(), camera_.FarPlane());
+        XMMATRIX const inv_view_proj = XMMatrixInverse(nullptr, view * proj);
+        pixel_spread_angle_ = texture_lod_ ? std::atan(2 * std::tan(camera_.Fov() / 2) / height_) : 0;
+
+        // Converged tiles keep their pixels. Direct lighting traces and shades a tile at a time, path tracing goes through the stages
+        // of RenderPaths.
+        if (max_bounces_ == 0)
+        {
+            thread_pool_.ParallelFor(num_tiles_x_ * num_tiles_y_, [this, &inv_view_proj](uint32_t tile, uint32_t /*thread_index*/) {
+                if (this->TileConverged(tile))
+                {
+                    return;
+                }
+
+                uint32_t x_begin;
+                uint32_t y_begin;
+                uint32_t x_end;
+                uint32_t y_end;
+                this->TileBounds(tile, x_begin, y_begin, x_end, y_end);
+                this->RayGen(x_begin, y_begin, x_end, y_end, tile_sample_counts_[tile], inv_view_proj);
+
+                uint32_t const num_samples = ++tile_sample_counts_[tile];
+                if ((error_threshold_ > 0) && (num_samples >= MinAdaptiveSamples))
+                {
+                    tile_errors_[tile] = this->TileError(x_begin, y_begin, x_end, y_end, num_samples);
+                }
+            });
+        }
+        else
+        {
+            std::vector<uint32_t> tiles;
+            for (uint32_t tile = 0; tile < num_tiles_x_ * num_tiles_y_; ++tile)
+            {
+                if (!this->TileConverged(tile))
+                {
+                    tiles.push_back(tile);
+                }
+            }
+            this->RenderPaths(tiles, inv_view_proj);
+        }
+
+        sample_count_ = *std::max_element(tile_sample_counts_.begin(), tile_sample_counts_.end());
+
+        // Without denoising, StorePixel already wrote the traced tiles. The others have to be rewritten if they were denoised.
+        if (denoise_ || output_denoised_)
+        {
+            this->ResolveOutput();
+        }
+    }
+
+    ID3D12Resource* Engine::Impl::Host::Output() const noexcept
+    {
+        return nullptr;
+    }
+
+    void const* Engine::Impl::Host::HostOutput() const noexcept
+    {
+        return output_.data();
+    }
+
+    XMVECTOR Engine::Impl::Host::PrimaryRayDirection(
+        uint32_t x, uint32_t y, XMFLOAT2 const& sample_position, FXMMATRIX inv_view_proj) const
+    {
+        float const pos_ss_x = (x + sample_position.x) / width_ * 2 - 1;
+        float const pos_ss_y = -((y + sample_position.y) / height_ * 2 - 1);
+
+        XMVECTOR pos_ws = XMVector4Transform(XMVectorSet(pos_ss_x, pos_ss_y, 0, 1), inv_view_proj);
+        pos_ws /= XMVectorSplatW(pos_ws);
+
+        return XMVector3Normalize(pos_ws - XMLoadFloat3(&camera_.Eye()));
+    }
+
+    void Engine::Impl::Host::TracePrimaryRays(uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, uint32_t sample_index,
+        FXMMATRIX inv_view_proj, HostRayPacket& packet, HostHit* hits, bool* found) const
+    {
+        XMFLOAT2 const sample_position = SamplePosition(sample_index);
+
+        packet.origin = camera_.Eye();
+        packet.t_min = 0.001f;
+
+        // In order around the tile, so consecutive corners span the side planes of the frustum
+        XMStoreFloat3(&packet.corner_directions[0], this->PrimaryRayDirection(x_begin, y_begin, sample_position, inv_view_proj));
+        XMStoreFloat3(&packet.corner_directions[1], this->PrimaryRayDirection(x_end - 1, y_begin, sample_position, inv_view_proj));
+        XMStoreFloat3(&packet.corner_directions[2], this->PrimaryRayDirection(x_end - 1, y_end - 1, sample_position, inv_view_proj));
+        XMStoreFloat3(&packet.corner_directions[3], this->PrimaryRayDirection(x_begin, y_end - 1, sample_position, inv_view_proj));
+
+        packet.num_rays = 0;
+        for (uint32_t y = y_begin; y < y_end; ++y)
+        {
+            for (uint32_t x = x_begin; x < x_end; ++x)
+            {
+                XMStoreFloat3(&packet.directions[packet.num_rays], this->PrimaryRayDirection(x, y, sample_position, inv_view_proj));
+                packet.t_max[packet.num_rays] = 10000.0f;
+                ++packet.num_rays;
+            }
+        }
+
+        scene_.TracePacket(packet, true, hits, found);
+    }
+
+    // Shading, and every ray it spawns, stays on the single ray path
+    void Engine::Impl::Host::RayGen(
+        uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, uint32_t sample_index, FXMMATRIX inv_view_proj)
+    {
+        HostRayPacket packet;
+        HostHit hits[HostRayPacket::MaxRays];
+        bool found[HostRayPacket::MaxRays];
+        this->TracePrimaryRays(x_begin, y_begin, x_end, y_end, sample_index, inv_view_proj, packet, hits, found);
+
+        uint32_t const curr_recursion_depth = 0;
+        uint32_t ray_index = 0;
+        for (uint32_t y = y_begin; y < y_end; ++y)
+        {
+            for (uint32_t x = x_begin; x < x_end; ++x)
+            {
+                XMVECTOR color;
+                HostDenoiserFeatures features;
+                if (found[ray_index])
+                {
+                    HostRandom random(y * width_ + x, sample_index);
+                    RayCone const cone = {0, pixel_spread_angle_};
+                    color =
+                        this->ClosestHit(packet.Ray(ray_index), hits[ray_index], cone, curr_recursion_depth + 1, random, &features);
+                    features.depth = hits[ray_index].t;
+                }
+                else
+                {
+                    color = XMLoadFloat4(&bg_color_);
+                    // The background is not modulated, and is as far away as rays go
+                    features = {{1, 1, 1}, {0, 0, 0}, packet.t_max[ray_index]};
+                }
+                this->StorePixel(x, y, sample_index, color, features);
+                ++ray_index;
+            }
+        }
+    }
+
+    XMVECTOR Engine::Impl::Host::TraceRadianceRay(
+        FXMVECTOR origin, FXMVECTOR direction, RayCone const& cone, uint32_t curr_recursion_depth, HostRandom& random) const
+    {
+        if (curr_recursion_depth >= MaxRayRecursionDepth)
+        {
+            return XMVectorZero();
+        }
+
+        HostRay ray;
+        XMStoreFloat3(&ray.origin, origin);
+        XMStoreFloat3(&ray.direction, direction);
+        ray.t_min = 0.001f;
+        ray.t_max = 10000.0f;
+
+        HostHit hit;
+        if (scene_.Trace(ray, true, hit))
+        {
+            return this->ClosestHit(ray, hit, cone, curr_recursion_depth + 1, random, nullptr);
+        }
+        else
+        {
+            return XMLoadFloat4(&bg_color_);
+        }
+    }
+
+    bool Engine::Impl::Host::TraceShadowRay(FXMVECTOR origin, FXMVECTOR direction, uint32_t curr_recursion_depth) const
+    {
+        if (curr_recursion_depth >= MaxRayRecursionDepth)
+        {
+            return false;
+        }
+
+        HostRay ray;
+        XMStoreFloat3(&ray.origin, origin);
+        XMStoreFloat3(&ray.direction, direction);
+        ray.t_min = 0.03f;
+        ray.t_max = 10000.0f;
+
+        return scene_.Occluded(ray);
+    }
+
+    XMVECTOR Engine::Impl::Host::ClosestHit(HostRay const& ray, HostHit const& hit, RayCone const& cone, uint32_t recursion_depth,
+        HostRandom& random, HostDenoiserFeatures* features) const
+    {
+        HitPoint const point = this->Interpolate(ray, hit, cone);
+        return this->CalcLighting(point.position, XMLoadFloat3(&ray.direction), point.tangent_frame, point.tex_coord, point.tex_lod,
+            *point.material, point.cone, recursion_depth, random, features);
+    }
+
+    XMVECTOR Engine::Impl::Host::CalcLighting(FXMVECTOR position, FXMVECTOR ray_direction, XMVECTOR const tangent_frame[3],
+        XMFLOAT2 const& tex_coord, float tex_lod, HostMaterial const& material, RayCone const& cone, uint32_t recursion_depth,
+        HostRandom& random, HostDenoiserFeatures* features) const
+    {
+        float const ambient_factor = 0.02f;
+
+        SurfacePoint const surface = this->SampleSurface(tangent_frame, tex_coord, tex_lod, this->BindMaterial(material));
+        if (features != nullptr)
+        {
+            XMStoreFloat3(&features->albedo, surface.albedo);
+            XMStoreFloat3(&features->normal, surface.normal);
+        }
+
+        XMVECTOR const view_dir = XMVector3Normalize(XMLoadFloat3(&camera_.Eye()) - position);
+        XMVECTOR const shading = this->DirectLighting(position, view_dir, surface, recursion_depth, random);
+
+        XMVECTOR const ambient = ambient_factor * surface.albedo;
+
+        XMVECTOR color = ambient + surface.emissive + shading;
+        if (surface.transparent && (surface.opacity < 1.0f - 0.5f / 255.0f))
+        {
+            color = XMVectorLerp(this->TraceRadianceRay(position, ray_direction, cone, recursion_depth, random), color, surface.opacity);
+        }
+
+        return XMVectorSetW(color, 1);
+    }
+
+    Engine::Impl::Host::HitPoint Engine::Impl::Host::Interpolate(HostRay const& ray, HostHit const& hit, RayCone const& cone) const
+    {
+        auto const& instance = scene_.Instance(hit.instance_id);
+        auto const& geometry = scene_.Geometry(hit.geometry_id);
+
+        XMVECTOR const x_axis = XMVectorSet(1, 0, 0, 0);
+        XMVECTOR const y_axis = XMVectorSet(0, 1, 0, 0);
+        XMVECTOR const z_axis = XMVectorSet(0, 0, 1, 0);
+
+        XMVECTOR vertex_tangents[3];
+        XMVECTOR vertex_bitangents[3];
+        XMVECTOR vertex_normals[3];
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            XMVECTOR const tangent_quat = XMLoadFloat4(&geometry.vertices[geometry.indices[hit.primitive_id * 3 + i]].tangent_quat);
+            vertex_tangents[i] = TransformQuat(x_axis, tangent_quat);
+            vertex_bitangents[i] = TransformQuat(y_axis, tangent_quat);
+            vertex_normals[i] = TransformQuat(z_axis, tangent_quat);
+        }
+
+        float const bary_x = hit.barycentrics.x;
+        float const bary_y = hit.barycentrics.y;
+        XMVECTOR const tangent = vertex_tangents[0] + bary_x * (vertex_tangents[1] - vertex_tangents[0]) +
+                                 bary_y * (vertex_tangents[2] - vertex_tangents[0]);
+        XMVECTOR const bitangent = vertex_bitangents[0] + bary_x * (vertex_bitangents[1] - vertex_bitangents[0]) +
+                                   bary_y * (vertex_bitangents[2] - vertex_bitangents[0]);
+        XMVECTOR const normal =
+            vertex_normals[0] + bary_x * (vertex_normals[1] - vertex_normals[0]) + bary_y * (vertex_normals[2] - vertex_normals[0]);
+
+        XMMATRIX const model_matrix = XMLoadFloat4x4(&instance.object_to_world);
+        XMMATRIX const model_matrix_it = XMMatrixTranspose(XMLoadFloat4x4(&instance.world_to_object));
+
+        HitPoint point;
+        point.position = XMLoadFloat3(&ray.origin) + hit.t * XMLoadFloat3(&ray.direction);
+        point.tangent_frame[0] = XMVector3Normalize(XMVector3TransformNormal(XMVector3Normalize(tangent), model_matrix));
+        point.tangent_frame[1] = XMVector3Normalize(XMVector3TransformNormal(XMVector3Normalize(bitangent), model_matrix));
+        point.tangent_frame[2] = XMVector3Normalize(XMVector3TransformNormal(XMVector3Normalize(normal), model_matrix_it));
+        point.tex_coord = scene_.TexCoord(geometry, hit.primitive_id, hit.barycentrics);
+        point.material = &scene_.Material(geometry.material_id);
+
+        // Texture LOD from the ray cone (Akenine-Moller et al. 2019). The footprint of the cone, scaled from world space to uv space
+        // by the ratio of the triangle areas, and stretched by the angle it hits the triangle at.
+        point.cone = {cone.width + cone.spread_angle * hit.t, cone.spread_angle};
+        point.tex_lod = NoTextureLod;
+        if (cone.spread_angle > 0)
+        {
+            XMVECTOR positions[3];
+            XMFLOAT2 tex_coords[3];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                auto const& vertex = geometry.vertices[geometry.indices[hit.primitive_id * 3 + i]];
+                positions[i] = XMVector3TransformCoord(XMLoadFloat3(&vertex.position), model_matrix);
+                tex_coords[i] = vertex.tex_coord;
+            }
+
+            XMVECTOR const geometric_normal = XMVector3Cross(positions[1] - positions[0], positions[2] - positions[0]);
+            float const world_area = XMVectorGetX(XMVector3Length(geometric_normal));
+            float const uv_area = std::abs((tex_coords[1].x - tex_coords[0].x) * (tex_coords[2].y - tex_coords[0].y) -
+                                           (tex_coords[2].x - tex_coords[0].x) * (tex_coords[1].y - tex_coords[0].y));
+            float const cos_angle = (world_area > 0) ? std::abs(Dot3(geometric_normal, XMLoadFloat3(&ray.direction))) / world_area : 0;
+            if ((uv_area > 0) && (cos_angle > 0))
+            {
+                point.tex_lod = 0.5f * std::log2(uv_area / world_area) + std::log2(std::abs(point.cone.width) / cos_angle);
+            }
+        }
+
+        return point;
+    }
+
+    Engine::Impl::Host::BoundMaterial Engine::Impl::Host::BindMaterial(HostMaterial const& material) const
+    {
+        BoundMaterial bound;
+        bound.material = &material;
+        for (uint32_t slot = 0; slot < bound.textures.size(); ++slot)
+        {
+            bound.textures[slot] = &scene_.Texture(material, static_cast<PbrMaterial::TextureSlot>(slot), bound.pinned[slot]);
+        }
+        return bound;
+    }
+
+    Engine::Impl::Host::SurfacePoint Engine::Impl::Host::SampleSurface(
+        XMVECTOR const tangent_frame[3], XMFLOAT2 const& tex_coord, float tex_lod, BoundMaterial const& material) const
+    {
+        auto const& mtl = material.material->buffer;
+
+        // tex_lod is for a single texel, each texture adds the log2 of its size
+        auto const sample = [&material, &tex_coord, tex_lod](PbrMaterial::TextureSlot slot) {
+            HostTexture const& texture = *material.textures[std::to_underlying(slot)];
+            return texture.SampleLevel(tex_coord, tex_lod + 0.5f * std::log2(static_cast<float>(texture.Width()) * texture.Height()));
+        };
+
+        SurfacePoint surface;
+
+        XMVECTOR const albedo_data = sample(PbrMaterial::TextureSlot::Albedo);
+        surface.albedo = XMLoadFloat3(&mtl.albedo) * albedo_data;
+        surface.opacity = mtl.opacity * XMVectorGetW(albedo_data);
+        surface.transparent = mtl.transparent;
+
+        XMVECTOR const metallic_roughness = sample(PbrMaterial::TextureSlot::MetallicRoughness);
+        surface.metallic = std::clamp(mtl.metallic * XMVectorGetZ(metallic_roughness), 0.0f, 1.0f);
+        surface.roughness = std::clamp(mtl.roughness * XMVectorGetY(metallic_roughness), 0.0f, 1.0f);
+
+        surface.occlusion = mtl.occlusion_strength * XMVectorGetX(sample(PbrMaterial::TextureSlot::Occlusion));
+
+        XMVECTOR const normal_data = sample(PbrMaterial::TextureSlot::Normal) * 2 - XMVectorReplicate(1);
+        surface.normal = XMVector3Normalize(XMVectorGetX(normal_data) * mtl.normal_scale * tangent_frame[0] +
+                                            XMVectorGetY(normal_data) * mtl.normal_scale * tangent_frame[1] +
+                                            XMVectorGetZ(normal_data) * tangent_frame[2]);
+
+        surface.emissive = XMLoadFloat3(&mtl.emissive) * sample(PbrMaterial::TextureSlot::Emissive);
+
+        return surface;
+    }
+
+    template <typename Func>
+    void Engine::Impl::Host::SampleLights(FXMVECTOR position, FXMVECTOR normal, HostRandom& random, Func&& func) const
+    {
+        if (light_samples_ == 0)
+        {
+            // The lights the grid drops add less than half a step of 8-bit output, so direct lighting stays within the tolerance of
+            // the GPU renderer, which shades every light
+            light_grid_.ForEachLight(position, [&func](uint32_t light_index) { func(light_index, 1.0f); });
+        }
+        else
+        {
+            for (uint32_t i = 0; i < light_samples_; ++i)
+            {
+                uint32_t light_index;
+                float pdf;
+                if (light_bvh_.Sample(position, normal, random.NextFloat(), light_index, pdf))
+                {
+                    func(light_index, pdf * light_samples_);
+                }
+            }
+        }
+    }
+
+    // The samples are shaded 4 at a time, and summed in the order SampleLights draws them
+    XMVECTOR Engine::Impl::Host::DirectLighting(
+        FXMVECTOR position, FXMVECTOR view_dir, SurfacePoint const& surface, uint32_t recursion_depth, HostRandom& random) const
+    {
+        XMVECTOR const diffuse_color = DiffuseColor(surface.albedo, surface.metallic);
+        XMVECTOR const specular_color = SpecularColor(surface.albedo, surface.metallic);
+
+        HostLightSamples4 samples{};
+        HostLightResults4 results;
+        uint32_t sample_lights[HostLightSamples4::Width];
+        uint32_t num_samples = 0;
+        XMVECTOR shading = XMVectorZero();
+        auto const shade_samples = [&] {
+            shade_lights_(samples, results);
+            for (uint32_t lane = 0; lane < num_samples; ++lane)
+            {
+                // Adding nothing needs no shadow ray
+                XMVECTOR const contribution = LightContribution(results, lane);
+                if (XMVector3Equal(contribution, XMVectorZero()))
+                {
+                    continue;
+                }
+
+                bool in_shadow = false;
+                if (lights_[sample_lights[lane]].shadowing)
+                {
+                    in_shadow = this->TraceShadowRay(position, LightDirection(results, lane), recursion_depth);
+                }
+
+                if (!in_shadow)
+                {
+                    shading += contribution;
+                }
+            }
+            num_samples = 0;
+        };
+
+        this->SampleLights(position, surface.normal, random, [&](uint32_t light_index, float weight) {
+            SetLightSample(samples, num_samples, position, view_dir, surface.normal, diffuse_color, specular_color, surface.roughness,
+                surface.occlusion, lights_[light_index], weight);
+            sample_lights[num_samples] = light_index;
+            ++num_samples;
+            if (num_samples == HostLightSamples4::Width)
+            {
+                shade_samples();
+            }
+        });
+        if (num_samples > 0)
+        {
+            shade_samples();
+        }
+
+        return shading;
+    }
+
+    void Engine::Impl::Host::RenderPaths(std::vector<uint32_t> const& tiles, FXMMATRIX inv_view_proj)
+    {
+        for (uint32_t wave_begin = 0; wave_begin < tiles.size(); wave_begin += WaveTiles)
+        {
+            uint32_t const num_wave_tiles = std::min(static_cast<uint32_t>(tiles.size()) - wave_begin, WaveTiles);
+            uint32_t const* wave_tiles = &tiles[wave_begin];
+
+            this->GeneratePaths(wave_tiles, num_wave_tiles, inv_view_proj);
+            while (!active_paths_.empty())
+            {
+                this->SortPathsByMaterial();
+                this->ShadePaths();
+                this->ConnectPaths();
+                this->AccumulatePaths();
+                if (active_paths_.size() >= MinSortedPaths)
+                {
+                    this->SortPathsByRay();
+                }
+                this->ExtendPaths();
+            }
+
+            thread_pool_.ParallelFor(num_wave_tiles, [this, wave_tiles](uint32_t i, uint32_t /*thread_index*/) {
+                uint32_t const tile = wave_tiles[i];
+                uint32_t const num_samples = ++tile_sample_counts_[tile];
+                if ((error_threshold_ > 0) && (num_samples >= MinAdaptiveSamples))
+                {
+                    uint32_t x_begin;
+                    uint32_t y_begin;
+                    uint32_t x_end;
+                    uint32_t y_end;
+                    this->TileBounds(tile, x_begin, y_begin, x_end, y_end);
+                    tile_errors_[tile] = this->TileError(x_begin, y_begin, x_end, y_end, num_samples);
+                }
+            });
+        }
+    }
+
+    // Tile i of the wave owns the slots [i * TileSize * TileSize, (i + 1) * TileSize * TileSize). The primary rays that miss store
+    // the background right away.
+    void Engine::Impl::Host::GeneratePaths(uint32_t const* tiles, uint32_t num_tiles, FXMMATRIX inv_view_proj)
+    {
+        thread_pool_.ParallelFor(num_tiles, [this, tiles, &inv_view_proj](uint32_t i, uint32_t /*thread_index*/) {
+            uint32_t const tile = tiles[i];
+            uint32_t x_begin;
+            uint32_t y_begin;
+            uint32_t x_end;
+            uint32_t y_end;
+            this->TileBounds(tile, x_begin, y_begin, x_end, y_end);
+            uint32_t const sample_index = tile_sample_counts_[tile];
+
+            HostRayPacket packet;
+            HostHit hits[HostRayPacket::MaxRays];
+            bool found[HostRayPacket::MaxRays];
+            this->TracePrimaryRays(x_begin, y_begin, x_end, y_end, sample_index, inv_view_proj, packet, hits, found);
+
+            uint32_t path = i * TileSize * TileSize;
+            uint32_t ray_index = 0;
+            for (uint32_t y = y_begin; y < y_end; ++y)
+            {
+                for (uint32_t x = x_begin; x < x_end; ++x)
+                {
+                    uint32_t const pixel = y * width_ + x;
+                    paths_.continues[path] = found[ray_index];
+                    if (found[ray_index])
+                    {
+                        paths_.pixels[path] = pixel;
+                        paths_.sample_indices[path] = sample_index;
+                        paths_.randoms[path] = HostRandom(pixel, sample_index);
+                        paths_.origins[path] = packet.origin;
+                        paths_.directions[path] = packet.directions[ray_index];
+                        paths_.cones[path] = {0, pixel_spread_angle_};
+                        paths_.hits[path] = hits[ray_index];
+                        paths_.throughputs[path] = {1, 1, 1};
+                        paths_.radiances[path] = {0, 0, 0, 0};
+                        paths_.bounces[path] = 0;
+                        paths_.features[path].depth = hits[ray_index].t;
+                    }
+                    else
+                    {
+                        // The background is not modulated, and is as far away as rays go
+                        HostDenoiserFeatures const features = {{1, 1, 1}, {0, 0, 0}, packet.t_max[ray_index]};
+                        this->StorePixel(x, y, sample_index, XMLoadFloat4(&bg_color_), features);
+                    }
+                    ++path;
+                    ++ray_index;
+                }
+            }
+            for (; ray_index < TileSize * TileSize; ++ray_index)
+            {
+                paths_.continues[path] = false;
+                ++path;
+            }
+        });
+
+        active_paths_.clear();
+        for (uint32_t path = 0; path < num_tiles * TileSize * TileSize; ++path)
+        {
+            if (paths_.continues[path])
+            {
+                active_paths_.push_back(path);
+            }
+        }
+    }
+
+    // Hits on the same material fetch the same textures. The sort is stable, so within a material the hits stay in the order of
+    // their rays.
+    void Engine::Impl::Host::SortPathsByMaterial()
+    {
+        uint32_t const num_paths = static_cast<uint32_t>(active_paths_.size());
+        path_keys_.resize(num_paths);
+        thread_pool_.ParallelFor(NumChunks(num_paths), [this, num_paths](uint32_t chunk, uint32_t /*thread_index*/) {
+            for (uint32_t i = chunk * QueueChunkSize; i < std::min((chunk + 1) * QueueChunkSize, num_paths); ++i)
+            {
+                path_keys_[i] = scene_.Geometry(paths_.hits[active_paths_[i]].geometry_id).material_id;
+            }
+        });
+        path_sorter_.Sort(active_paths_, path_keys_);
+
+        material_chunks_.clear();
+        for (uint32_t begin = 0; begin < num_paths;)
+        {
+            uint32_t const material_id = path_keys_[begin];
+            uint32_t end = begin + 1;
+            while ((end < num_paths) && (end - begin < QueueChunkSize) && (path_keys_[end] == material_id))
+            {
+                ++end;
+            }
+            material_chunks_.push_back({material_id, begin, end});
+            begin = end;
+        }
+    }
+
+    // After the first bounce, neighboring paths go in unrelated directions. Sorted, consecutive rays reach the same nodes and
+    // triangles while they are still in the caches.
+    void Engine::Impl::Host::SortPathsByRay()
+    {
+        HostAabb const& bounds = scene_.Bounds();
+        uint32_t const num_paths = static_cast<uint32_t>(active_paths_.size());
+        path_keys_.resize(num_paths);
+        thread_pool_.ParallelFor(NumChunks(num_paths), [this, num_paths, &bounds](uint32_t chunk, uint32_t /*thread_index*/) {
+            for (uint32_t i = chunk * QueueChunkSize; i < std::min((chunk + 1) * QueueChunkSize, num_paths); ++i)
+            {
+                uint32_t const path = active_paths_[i];
+                path_keys_[i] = RaySortKey(paths_.origins[path], paths_.directions[path], bounds);
+            }
+        });
+        path_sorter_.Sort(active_paths_, path_keys_);
+    }
+
+    // Path tracing with next event estimation. Every vertex adds its emission and the direct light of the point lights, weighted by
+    // the throughput of the path so far, then bounces to a cosine weighted direction. The throughput picks up the diffuse color on
+    // every bounce, and after MinRouletteBounces, Russian roulette ends the path with a probability that grows as the throughput
+    // falls, dividing the survivors by the probability to stay unbiased. The background is the light of the sky.
+    // The ray cone keeps spreading from bounce to bounce, so textures seen through more bounces are filtered more.
+    // A chunk is one material, whose textures are looked up once. Its light samples are gathered first and shaded 4 at a time, then
+    // go to the shadow queues, connect and accumulate finish the vertex.
+    void Engine::Impl::Host::ShadePaths()
+    {
+        for (auto& shadow_queue : shadow_queues_)
+        {
+            shadow_queue.Clear();
+        }
+
+        thread_pool_.ParallelFor(static_cast<uint32_t>(material_chunks_.size()), [this](uint32_t chunk_index, uint32_t thread_index) {
+            MaterialChunk const& chunk = material_chunks_[chunk_index];
+            BoundMaterial const material = this->BindMaterial(scene_.Material(chunk.material_id));
+
+            auto& light_sample_queue = light_sample_queues_[thread_index];
+            light_sample_queue.Clear();
+            for (uint32_t i = chunk.begin; i < chunk.end; ++i)
+            {
+                uint32_t const path = active_paths_[i];
+                auto& random = paths_.randoms[path];
+
+                HostRay const ray = {paths_.origins[path], 0.001f, paths_.directions[path], 10000.0f};
+                XMVECTOR const ray_direction = XMLoadFloat3(&ray.direction);
+                RayCone const cone = {paths_.cones[path].x, paths_.cones[path].y};
+                HitPoint const point = this->Interpolate(ray, paths_.hits[path], cone);
+                SurfacePoint const surface = this->SampleSurface(point.tangent_frame, point.tex_coord, point.tex_lod, material);
+                paths_.cones[path] = {point.cone.width, point.cone.spread_angle};
+
+                uint32_t bounce = paths_.bounces[path];
+                if (bounce == 0)
+                {
+                    XMStoreFloat3(&paths_.features[path].albedo, surface.albedo);
+                    XMStoreFloat3(&paths_.features[path].normal, surface.normal);
+                }
+
+                // A transparent surface is either shaded or passed through, with its opacity as the probability of the former, instead
+                // of blending both
+                bool const shaded = !surface.transparent || (random.NextFloat() < surface.opacity);
+                paths_.shaded[path] = shaded;
+                XMVECTOR const diffuse_color = DiffuseColor(surface.albedo, surface.metallic);
+                if (shaded)
+                {
+                    paths_.vertex_throughputs[path] = paths_.throughputs[path];
+                    XMStoreFloat3(&paths_.vertex_emissions[path], surface.emissive);
+                    paths_.vertex_direct[path] = {0, 0, 0};
+
+                    XMVECTOR const specular_color = SpecularColor(surface.albedo, surface.metallic);
+                    this->SampleLights(point.position, surface.normal, random, [&](uint32_t light_index, float weight) {
+                        uint32_t lane;
+                        HostLightSamples4& samples = light_sample_queue.Push(path, light_index, lane);
+                        SetLightSample(samples, lane, point.position, -ray_direction, surface.normal, diffuse_color, specular_color,
+                            surface.roughness, surface.occlusion, lights_[light_index], weight);
+                    });
+                }
+
+                paths_.continues[path] = false;
+                if (bounce == max_bounces_)
+                {
+                    continue;
+                }
+                ++bounce;
+                paths_.bounces[path] = bounce;
+
+                XMVECTOR direction = ray_direction;
+                if (shaded)
+                {
+                    XMVECTOR throughput = XMLoadFloat3(&paths_.throughputs[path]) * diffuse_color;
+                    if (bounce > MinRouletteBounces)
+                    {
+                        XMFLOAT3 path_throughput;
+                        XMStoreFloat3(&path_throughput, throughput);
+                        float const survival =
+                            std::min(std::max({path_throughput.x, path_throughput.y, path_throughput.z}), MaxRouletteSurvival);
+                        if (random.NextFloat() >= survival)
+                        {
+                            continue;
+                        }
+                        throughput /= survival;
+                    }
+                    XMStoreFloat3(&paths_.throughputs[path], throughput);
+
+                    // Both sides of a surface reflect
+                    XMVECTOR const normal = (Dot3(surface.normal, ray_direction) > 0) ? -surface.normal : surface.normal;
+                    float const u0 = random.NextFloat();
+                    float const u1 = random.NextFloat();
+                    direction = XMVector3Normalize(CosineSampleHemisphere(normal, u0, u1));
+                }
+
+                XMStoreFloat3(&paths_.origins[path], point.position);
+                XMStoreFloat3(&paths_.directions[path], direction);
+                paths_.continues[path] = true;
+            }
+
+            light_sample_queue.Shade(shade_lights_);
+
+            auto& shadow_queue = shadow_queues_[thread_index];
+            for (uint32_t i = 0; i < light_sample_queue.Size(); ++i)
+            {
+                uint32_t const batch = i / HostLightSamples4::Width;
+                uint32_t const lane = i % HostLightSamples4::Width;
+
+                // Adding nothing needs no shadow ray
+                XMVECTOR const contribution = LightContribution(light_sample_queue.results[batch], lane);
+                if (!XMVector3Equal(contribution, XMVectorZero()))
+                {
+                    HostLightSamples4 const& samples = light_sample_queue.batches[batch];
+                    XMVECTOR const origin = XMVectorSet(samples.position[0][lane], samples.position[1][lane], samples.position[2][lane], 0);
+                    shadow_queue.Push(light_sample_queue.paths[i], origin, LightDirection(light_sample_queue.results[batch], lane),
+                        contribution, lights_[light_sample_queue.lights[i]].shadowing);
+                }
+            }
+        });
+    }
+
+    void Engine::Impl::Host::ConnectPaths()
+    {
+        // Chunks of the queue of every thread, one after another
+        uint32_t num_chunks = 0;
+        for (auto const& shadow_queue : shadow_queues_)
+        {
+            num_chunks += NumChunks(shadow_queue.Size());
+        }
+
+        thread_pool_.ParallelFor(num_chunks, [this](uint32_t chunk, uint32_t /*thread_index*/) {
+            uint32_t queue_index = 0;
+            while (chunk >= NumChunks(shadow_queues_[queue_index].Size()))
+            {
+                chunk -= NumChunks(shadow_queues_[queue_index].Size());
+                ++queue_index;
+            }
+
+            auto& shadow_queue = shadow_queues_[queue_index];
+            for (uint32_t i = chunk * QueueChunkSize; i < std::min((chunk + 1) * QueueChunkSize, shadow_queue.Size()); ++i)
+            {
+                if (shadow_queue.shadowing[i])
+                {
+                    HostRay const ray = {shadow_queue.origins[i], 0.03f, shadow_queue.directions[i], 10000.0f};
+                    shadow_queue.occluded[i] = scene_.Occluded(ray);
+                }
+            }
+        });
+    }
+
+    void Engine::Impl::Host::AccumulatePaths()
+    {
+        // The shadow rays of a path are all in the same queue, so the queues can be summed in parallel
+        thread_pool_.ParallelFor(static_cast<uint32_t>(shadow_queues_.size()), [this](uint32_t queue_index, uint32_t /*thread_index*/) {
+            auto const& shadow_queue = shadow_queues_[queue_index];
+            for (uint32_t i = 0; i < shadow_queue.Size(); ++i)
+            {
+                if (!shadow_queue.occluded[i])
+                {
+                    auto& direct = paths_.vertex_direct[shadow_queue.paths[i]];
+                    XMStoreFloat3(&direct, XMLoadFloat3(&direct) + XMLoadFloat3(&shadow_queue.contributions[i]));
+                }
+            }
+        });
+
+        uint32_t const num_paths = static_cast<uint32_t>(active_paths_.size());
+        thread_pool_.ParallelFor(NumChunks(num_paths), [this, num_paths](uint32_t chunk, uint32_t /*thread_index*/) {
+            for (uint32_t i = chunk * QueueChunkSize; i < std::min((chunk + 1) * QueueChunkSize, num_paths); ++i)
+            {
+                uint32_t const path = active_paths_[i];
+                XMVECTOR radiance = XMLoadFloat4(&paths_.radiances[path]);
+                if (paths_.shaded[path])
+                {
+                    radiance += XMLoadFloat3(&paths_.vertex_throughputs[path]) *
+                                (XMLoadFloat3(&paths_.vertex_emissions[path]) + XMLoadFloat3(&paths_.vertex_direct[path]));
+                    XMStoreFloat4(&paths_.radiances[path], radiance);
+                }
+
+                if (!paths_.continues[path])
+                {
+                    uint32_t const pixel = paths_.pixels[path];
+                    this->StorePixel(
+                        pixel % width_, pixel / width_, paths_.sample_indices[path], XMVectorSetW(radiance, 1), paths_.features[path]);
+                }
+            }
+        });
+
+        active_paths_.erase(std::remove_if(active_paths_.begin(), active_paths_.end(),
+                                [this](uint32_t path) { return !paths_.continues[path]; }),
+            active_paths_.end());
+    }
+
+    // The paths that miss add the background and end
+    void Engine::Impl::Host::ExtendPaths()
+    {
+        uint32_t const num_paths = static_cast<uint32_t>(active_paths_.size());
+        thread_pool_.ParallelFor(NumChunks(num_paths), [this, num_paths](uint32_t chunk, uint32_t /*thread_index*/) {
+            for (uint32_t i = chunk * QueueChunkSize; i < std::min((chunk + 1) * QueueChunkSize, num_paths); ++i)
+            {
+                uint32_t const path = active_paths_[i];
+                HostRay const ray = {paths_.origins[path], 0.001f, paths_.directions[path], 10000.0f};
+                if (!scene_.Trace(ray, true, paths_.hits[path]))
+                {
+                    paths_.continues[path] = false;
+
+                    XMVECTOR const radiance =
+                        XMLoadFloat4(&paths_.radiances[path]) + XMLoadFloat3(&paths_.throughputs[path]) * XMLoadFloat4(&bg_color_);
+                    uint32_t const pixel = paths_.pixels[path];
+                    this->StorePixel(
+                        pixel % width_, pixel / width_, paths_.sample_indices[path], XMVectorSetW(radiance, 1), paths_.features[path]);
+                }
+            }
+        });
+
+        active_paths_.erase(std::remove_if(active_paths_.begin(), active_paths_.end(),
+                                [this](uint32_t path) { return !paths_.continues[path]; }),
+            active_paths_.end());
+    }
+
+    void Engine::Impl::Host::StorePixel(
+        uint32_t x, uint32_t y, uint32_t sample_index, FXMVECTOR color, HostDenoiserFeatures const& features) noexcept
+    {
+        size_t const pixel = static_cast<size_t>(y) * width_ + x;
+        XMFLOAT4& sum = accumulation_buffer_[pixel];
+        HostDenoiserFeatures& feature_sum = feature_sum_[pixel];
+        XMFLOAT4 sample;
+        XMStoreFloat4(&sample, color);
+        float const luminance = Luminance(sample);
+        if (sample_index == 0)
+        {
+            sum = sample;
+            luminance_sq_sum_[pixel] = luminance * luminance;
+            feature_sum = features;
+        }
+        else
+        {
+            XMStoreFloat4(&sum, XMLoadFloat4(&sum) + color);
+            luminance_sq_sum_[pixel] += luminance * luminance;
+            XMStoreFloat3(&feature_sum.albedo, XMLoadFloat3(&feature_sum.albedo) + XMLoadFloat3(&features.albedo));
+            XMStoreFloat3(&feature_sum.normal, XMLoadFloat3(&feature_sum.normal) + XMLoadFloat3(&features.normal));
+            feature_sum.depth += features.depth;
+        }
+
+        if (!denoise_)
+        {
+            XMFLOAT4 rgba;
+            XMStoreFloat4(&rgba, XMLoadFloat4(&sum) / static_cast<float>(sample_index + 1));
+            this->StoreOutput(pixel, rgba);
+        }
+    }
+
+    void Engine::Impl::Host::StoreOutput(size_t pixel, XMFLOAT4 rgba) noexcept
+    {
+        if (IsSrgbFormat(format_))
+        {
+            rgba.x = LinearToSrgb(rgba.x);
+            rgba.y = LinearToSrgb(rgba.y);
+            rgba.z = LinearToSrgb(rgba.z);
+        }
+
+        uint8_t* texel = &output_[pixel * 4];
+        bool const bgra = (LinearFormatOf(format_) != DXGI_FORMAT_R8G8B8A8_UNORM);
+        texel[0] = FloatToUnorm8(bgra ? rgba.z : rgba.x);
+        texel[1] = FloatToUnorm8(rgba.y);
+        texel[2] = FloatToUnorm8(bgra ? rgba.x : rgba.z);
+        texel[3] = FloatToUnorm8(rgba.w);
+    }
+
+    void Engine::Impl::Host::ResolveOutput()
+    {
+        size_t const num_pixels = static_cast<size_t>(width_) * height_;
+        if (denoise_)
+        {
+            denoiser_features_.resize(num_pixels);
+            denoiser_color_.resize(num_pixels);
+        }
+
+        thread_pool_.ParallelFor(height_, [this](uint32_t y, uint32_t /*thread_index*/) {
+            for (uint32_t x = 0; x < width_; ++x)
+            {
+                size_t const pixel = static_cast<size_t>(y) * width_ + x;
+                float const num_samples = static_cast<float>(tile_sample_counts_[(y / TileSize) * num_tiles_x_ + x / TileSize]);
+                if (num_samples == 0)
+                {
+                    // Outside every scissor rectangle so far. Black to the denoiser, and the output keeps what it has.
+                    if (denoise_)
+                    {
+                        denoiser_features_[pixel] = {};
+                        denoiser_color_[pixel] = {0, 0, 0, 0};
+                    }
+                    continue;
+                }
+
+                XMFLOAT4 rgba;
+                XMStoreFloat4(&rgba, XMLoadFloat4(&accumulation_buffer_[pixel]) / num_samples);
+                if (denoise_)
+                {
+                    auto const& feature_sum = feature_sum_[pixel];
+                    auto& features = denoiser_features_[pixel];
+                    XMStoreFloat3(&features.albedo, XMLoadFloat3(&feature_sum.albedo) / num_samples);
+                    XMStoreFloat3(&features.normal, XMLoadFloat3(&feature_sum.normal) / num_samples);
+                    features.depth = feature_sum.depth / num_samples;
+                    denoiser_color_[pixel] = rgba;
+                }
+                else
+                {
+                    this->StoreOutput(pixel, rgba);
+                }
+            }
+        });
+
+        if (denoise_)
+        {
+            denoiser_.Denoise(thread_pool_, width_, height_, denoiser_features_.data(), denoiser_color_.data());
+
+            thread_pool_.ParallelFor(height_, [this](uint32_t y, uint32_t /*thread_index*/) {
+                for (size_t pixel = static_cast<size_t>(y) * width_; pixel < static_cast<size_t>(y + 1) * width_; ++pixel)
+                {
+                    this->StoreOutput(pixel, denoiser_color_[pixel]);
+                }
+            });
+        }
+
+        output_denoised_ = denoise_;
+    }
+
+    bool Engine::Impl::Host::TileBounds(
+        uint32_t tile, uint32_t& x_begin, uint32_t& y_begin, uint32_t& x_end, uint32_t& y_end) const noexcept
+    {
+        uint32_t const tile_x = (tile % num_tiles_x_) * TileSize;
+        uint32_t const tile_y = (tile / num_tiles_x_) * TileSize;
+        x_begin = std::max(tile_x, scissor_left_);
+        y_begin = std::max(tile_y, scissor_top_);
+        x_end = std::min({tile_x + TileSize, width_, scissor_right_});
+        y_end = std::min({tile_y + TileSize, height_, scissor_bottom_});
+        return (x_begin < x_end) && (y_begin < y_end);
+    }
+
+    bool Engine::Impl::Host::TileConverged(uint32_t tile) const noexcept
+    {
+        uint32_t x_begin;
+        uint32_t y_begin;
+        uint32_t x_end;
+        uint32_t y_end;
+        if (!this->TileBounds(tile, x_begin, y_begin, x_end, y_end))
+        {
+            return true;
+        }
+
+        uint32_t const num_samples = tile_sample_counts_[tile];
+        if ((max_samples_ != 0) && (num_samples >= max_samples_))
+        {
+            return true;
+        }
+        return (error_threshold_ > 0) && (num_samples >= MinAdaptiveSamples) && (tile_errors_[tile] < error_threshold_);
+    }
+
+    // RMS over the tile of the standard error of each pixel's mean luminance, relative to that mean
+    float Engine::Impl::Host::TileError(
+        uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, uint32_t num_samples) const noexcept
+    {
+        float const inv_num_samples = 1.0f / num_samples;
+        float sum_sq_error = 0;
+        for (uint32_t y = y_begin; y < y_end; ++y)
+        {
+            for (uint32_t x = x_begin; x < x_end; ++x)
+            {
+                size_t const pixel = static_cast<size_t>(y) * width_ + x;
+                float const mean = Luminance(accumulation_buffer_[pixel]) * inv_num_samples;
+                float const variance = std::max(luminance_sq_sum_[pixel] - mean * mean * num_samples, 0.0f) / (num_samples - 1);
+                float const error_scale = std::max(mean, MinErrorLuminance);
+                sum_sq_error += variance * inv_num_samples / (error_scale * error_scale);
+            }
+        }
+        return std::sqrt(sum_sq_error / ((x_end - x_begin) * (y_end - y_begin)));
+    }
+} // namespace GoldenSun
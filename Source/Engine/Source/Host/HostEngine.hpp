@@ -0,0 +1,229 @@
+#pragma once
+
+#include <GoldenSun/Camera.hpp>
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "../EngineImpl.hpp"
+#include "../EngineInternal.hpp"
+#include "HostDenoiser.hpp"
+#include "HostLightBvh.hpp"
+#include "HostLightGrid.hpp"
+#include "HostLightShading.hpp"
+#include "HostPlacement.hpp"
+#include "HostSampling.hpp"
+#include "HostScene.hpp"
+#include "HostWavefront.hpp"
+
+namespace GoldenSun
+{
+    // CPU reference of the DXR pipeline. RayGenShader, ClosestHitShader, AnyHitShader and CalcLighting are mirrored one to one.
+    class Engine::Impl::Host final : public Engine::Impl
+    {
+    public:
+        explicit Host(uint32_t num_threads);
+
+        void RenderTarget(uint32_t width, uint32_t height, DXGI_FORMAT format, DirectX::XMFLOAT4 const& bg_color) override;
+        void Meshes(Mesh const* meshes, uint32_t num_meshes, BuildPreference build_preference) override;
+        void Lights(PointLight const* lights, uint32_t num_lights) override;
+        void Camera(GoldenSun::Camera const& camera) override;
+
+        void Accumulation(bool enable) override;
+        uint32_t SampleCount() const noexcept override;
+        void AdaptiveSampling(float error_threshold, uint32_t max_samples) override;
+        bool Converged() const noexcept override;
+        void Denoise(bool enable) override;
+        void PathTracing(uint32_t max_bounces) override;
+        void LightSampling(uint32_t num_samples) override;
+        void TextureLod(bool enable) override;
+        void TextureCacheBudget(uint64_t bytes) override;
+        uint64_t TextureCacheHits() const noexcept override;
+        uint64_t TextureCacheMisses() const noexcept override;
+        void ScenePlacement(Placement placement) override;
+        void Scissor(uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) override;
+
+        void Render(ID3D12GraphicsCommandList4* cmd_list) override;
+
+        ID3D12Resource* Output() const noexcept override;
+        void const* HostOutput() const noexcept override;
+
+    private:
+        // Ray cone (Akenine-Moller et al. 2019), for picking texture mips. The width at the origin of a ray, and the angle it grows by.
+        struct RayCone
+        {
+            float width;
+            float spread_angle;
+        };
+
+        // What ClosestHitShader interpolates at a hit, before CalcLighting
+        struct HitPoint
+        {
+            DirectX::XMVECTOR position;
+            DirectX::XMVECTOR tangent_frame[3];
+            DirectX::XMFLOAT2 tex_coord;
+            // Mip of a texture with a single texel. Add half the log2 of the texel count for the mip of a real one.
+            float tex_lod;
+            // The cone of the ray, with its width at the hit
+            RayCone cone;
+            HostMaterial const* material;
+        };
+
+        // A material with the textures of its slots looked up, the ones read on demand pinned in the texture cache
+        struct BoundMaterial
+        {
+            HostMaterial const* material;
+            std::array<std::shared_ptr<HostTexture const>, std::to_underlying(PbrMaterial::TextureSlot::Num)> pinned;
+            std::array<HostTexture const*, std::to_underlying(PbrMaterial::TextureSlot::Num)> textures;
+        };
+
+        // The material at a hit, with its textures sampled
+        struct SurfacePoint
+        {
+            DirectX::XMVECTOR albedo;
+            DirectX::XMVECTOR normal;
+            DirectX::XMVECTOR emissive;
+            float opacity;
+            float metallic;
+            float roughness;
+            float occlusion;
+            bool transparent;
+        };
+
+        // Entries [begin, end) of the shade queue, all on one material
+        struct MaterialChunk
+        {
+            uint32_t material_id;
+            uint32_t begin;
+            uint32_t end;
+        };
+
+    private:
+        DirectX::XMVECTOR PrimaryRayDirection(
+            uint32_t x, uint32_t y, DirectX::XMFLOAT2 const& sample_position, DirectX::FXMMATRIX inv_view_proj) const;
+        // The primary rays of a tile all start at the eye, so they are traced together as one packet. hits and found are in the order
+        // of the pixels, row by row.
+        void TracePrimaryRays(uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, uint32_t sample_index,
+            DirectX::FXMMATRIX inv_view_proj, HostRayPacket& packet, HostHit* hits, bool* found) const;
+        void RayGen(
+            uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, uint32_t sample_index, DirectX::FXMMATRIX inv_view_proj);
+        DirectX::XMVECTOR TraceRadianceRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, RayCone const& cone,
+            uint32_t curr_recursion_depth, HostRandom& random) const;
+        bool TraceShadowRay(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, uint32_t curr_recursion_depth) const;
+        // features, if not nullptr, gets the albedo and normal of the hit for the denoiser
+        DirectX::XMVECTOR ClosestHit(HostRay const& ray, HostHit const& hit, RayCone const& cone, uint32_t recursion_depth,
+            HostRandom& random, HostDenoiserFeatures* features) const;
+        DirectX::XMVECTOR CalcLighting(DirectX::FXMVECTOR position, DirectX::FXMVECTOR ray_direction,
+            DirectX::XMVECTOR const tangent_frame[3], DirectX::XMFLOAT2 const& tex_coord, float tex_lod, HostMaterial const& material,
+            RayCone const& cone, uint32_t recursion_depth, HostRandom& random, HostDenoiserFeatures* features) const;
+        HitPoint Interpolate(HostRay const& ray, HostHit const& hit, RayCone const& cone) const;
+        BoundMaterial BindMaterial(HostMaterial const& material) const;
+        SurfacePoint SampleSurface(DirectX::XMVECTOR const tangent_frame[3], DirectX::XMFLOAT2 const& tex_coord, float tex_lod,
+            BoundMaterial const& material) const;
+        // Point lights only, without the ambient and emissive terms. Either the lights whose sphere in light_grid_ reaches the point,
+        // or light_samples_ of them from the light BVH.
+        DirectX::XMVECTOR DirectLighting(DirectX::FXMVECTOR position, DirectX::FXMVECTOR view_dir, SurfacePoint const& surface,
+            uint32_t recursion_depth, HostRandom& random) const;
+        // Calls func(light_index, weight) for each light DirectLighting sums, weight being what its shading is divided by
+        template <typename Func>
+        void SampleLights(DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal, HostRandom& random, Func&& func) const;
+
+        // Wavefront path tracer, when max_bounces_ is not 0. The paths of a batch of tiles go through the stages together: generate
+        // traces the primary rays, shade samples the surfaces and the lights of the hits and picks the next rays, connect traces the
+        // shadow rays, accumulate adds the shaded vertices and stores the paths that ended, and extend traces the next rays. Each
+        // stage is a loop over a queue, split into chunks for the thread pool. Shade runs on the hits grouped by material, a chunk of
+        // one material at a time, and its light samples go through shade_lights_ 4 at a time. Extending sees the rays sorted by
+        // RaySortKey, when there are enough of them.
+        // Direct lighting, max_bounces_ of 0, doesn't go through here. RayGen shades each hit in one call, like the shaders, blending
+        // transparent surfaces with the radiance traced behind them.
+        void RenderPaths(std::vector<uint32_t> const& tiles, DirectX::FXMMATRIX inv_view_proj);
+        void GeneratePaths(uint32_t const* tiles, uint32_t num_tiles, DirectX::FXMMATRIX inv_view_proj);
+        void SortPathsByMaterial();
+        void SortPathsByRay();
+        void ShadePaths();
+        void ConnectPaths();
+        void AccumulatePaths();
+        void ExtendPaths();
+
+        void StorePixel(
+            uint32_t x, uint32_t y, uint32_t sample_index, DirectX::FXMVECTOR color, HostDenoiserFeatures const& features) noexcept;
+        void StoreOutput(size_t pixel, DirectX::XMFLOAT4 rgba) noexcept;
+        // Writes every pixel of the output from the accumulated samples, denoised if asked
+        void ResolveOutput();
+
+        // The pixels of a tile, clipped to the frame. False for the tiles outside the scissor rectangle.
+        bool TileBounds(uint32_t tile, uint32_t& x_begin, uint32_t& y_begin, uint32_t& x_end, uint32_t& y_end) const noexcept;
+        // True for the tiles TileBounds skips, they get no samples
+        bool TileConverged(uint32_t tile) const noexcept;
+        float TileError(uint32_t x_begin, uint32_t y_begin, uint32_t x_end, uint32_t y_end, uint32_t num_samples) const noexcept;
+
+    private:
+        ThreadPool thread_pool_;
+        // Of the frame buffer arrays, one block of rows per node. Contiguous tiles start on the threads of one node, in node order.
+        HostPlacement frame_placement_;
+
+        uint32_t width_ = 0;
+        uint32_t height_ = 0;
+        float aspect_ratio_ = 0;
+        DXGI_FORMAT format_ = DXGI_FORMAT_UNKNOWN;
+        DirectX::XMFLOAT4 bg_color_{};
+        HostVector<uint8_t> output_;
+
+        bool accumulation_ = false;
+        uint32_t sample_count_ = 0;
+        // Sum of the samples so far, in linear space
+        HostVector<DirectX::XMFLOAT4> accumulation_buffer_;
+        // Sum of the squared luminance of the samples, for the variance
+        HostVector<float> luminance_sq_sum_;
+
+        float error_threshold_ = 0;
+        uint32_t max_samples_ = 0;
+        uint32_t num_tiles_x_ = 0;
+        uint32_t num_tiles_y_ = 0;
+        std::vector<uint32_t> tile_sample_counts_;
+        std::vector<float> tile_errors_;
+        // On tile edges, or past the frame by default, which TileBounds clamps
+        uint32_t scissor_left_ = 0;
+        uint32_t scissor_top_ = 0;
+        uint32_t scissor_right_ = ~0U;
+        uint32_t scissor_bottom_ = ~0U;
+
+        bool denoise_ = false;
+        bool output_denoised_ = false;
+        HostDenoiser denoiser_;
+        // Sum of the first hit features of the samples
+        HostVector<HostDenoiserFeatures> feature_sum_;
+        std::vector<HostDenoiserFeatures> denoiser_features_;
+        std::vector<DirectX::XMFLOAT4> denoiser_color_;
+
+        // Diffuse bounces after the first hit. 0 is direct lighting only, the same as the DXR pipeline.
+        uint32_t max_bounces_ = 0;
+        // Lights picked per shading point. 0 is every light that reaches it.
+        uint32_t light_samples_ = 0;
+        bool texture_lod_ = false;
+        // Angle between the primary rays of neighboring pixels, set each frame. 0 while texture LOD is off.
+        float pixel_spread_angle_ = 0;
+
+        HostScene scene_;
+        std::vector<LightBuffer> lights_;
+        HostShadeLightsFunc shade_lights_;
+        HostLightBvh light_bvh_;
+        HostLightGrid light_grid_;
+        GoldenSun::Camera camera_;
+
+        HostPathStates paths_;
+        // Slots of the paths still bouncing, in the order they were generated
+        std::vector<uint32_t> active_paths_;
+        // One per thread, filled by the shade stage
+        std::vector<HostLightSampleQueue> light_sample_queues_;
+        std::vector<HostShadowQueue> shadow_queues_;
+        HostQueueSorter path_sorter_;
+        std::vector<uint32_t> path_keys_;
+        // Of active_paths_, after SortPathsByMaterial
+        std::vector<MaterialChunk> material_chunks_;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,155 @@
+#include "../pch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include "HostBvh.hpp"
+#include "HostLightBvh.hpp"
+#include "HostShading.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    // Lights with no falloff at all would have an infinite importance
+    float constexpr MinAttenuationDenominator = 1e-6f;
+    // Keeps u below 1 after rescaling it for the next level
+    float constexpr OneMinusEpsilon = 0x1.fffffep-1f;
+
+    float Luminance(XMFLOAT3 const& color) noexcept
+    {
+        return 0.2126f * color.x + 0.7152f * color.y + 0.0722f * color.z;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void HostLightBvh::Build(LightBuffer const* lights, uint32_t num_lights)
+    {
+        nodes_.clear();
+        if (num_lights == 0)
+        {
+            return;
+        }
+
+        std::vector<uint32_t> light_indices(num_lights);
+        std::iota(light_indices.begin(), light_indices.end(), 0);
+
+        nodes_.reserve(2 * num_lights - 1);
+        this->BuildNode(lights, light_indices.data(), light_indices.data() + num_lights);
+    }
+
+    // Median split on the longest axis of the positions. The tree is balanced, so the depth is log2 of the number of lights.
+    uint32_t HostLightBvh::BuildNode(LightBuffer const* lights, uint32_t* begin, uint32_t* end)
+    {
+        uint32_t const node_index = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+
+        if (end - begin == 1)
+        {
+            auto const& light = lights[*begin];
+            auto& node = nodes_[node_index];
+            node.center = light.position;
+            node.radius = 0;
+            node.min_falloff = light.falloff;
+            node.power = Luminance(light.color);
+            node.right_child = 0;
+            node.light_index = *begin;
+            return node_index;
+        }
+
+        HostAabb bounds;
+        for (uint32_t const* iter = begin; iter != end; ++iter)
+        {
+            bounds.Grow(lights[*iter].position);
+        }
+        float const extents[] = {bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z};
+        uint32_t const axis = static_cast<uint32_t>(std::max_element(std::begin(extents), std::end(extents)) - std::begin(extents));
+
+        uint32_t* const middle = begin + (end - begin) / 2;
+        std::nth_element(begin, middle, end, [lights, axis](uint32_t lhs, uint32_t rhs) {
+            return (&lights[lhs].position.x)[axis] < (&lights[rhs].position.x)[axis];
+        });
+
+        uint32_t const left_child = this->BuildNode(lights, begin, middle);
+        uint32_t const right_child = this->BuildNode(lights, middle, end);
+
+        auto const& left = nodes_[left_child];
+        auto const& right = nodes_[right_child];
+        auto& node = nodes_[node_index];
+        node.center = bounds.Center();
+        node.radius = std::sqrt(extents[0] * extents[0] + extents[1] * extents[1] + extents[2] * extents[2]) / 2;
+        node.min_falloff = {std::min(left.min_falloff.x, right.min_falloff.x), std::min(left.min_falloff.y, right.min_falloff.y),
+            std::min(left.min_falloff.z, right.min_falloff.z)};
+        node.power = left.power + right.power;
+        node.right_child = right_child;
+        node.light_index = 0;
+        return node_index;
+    }
+
+    // The power over the attenuation at the distance to the center, clamped to the radius so a point inside a node doesn't blow it up.
+    // With the smallest falloff factors, it overestimates every light in the node. A node entirely behind the surface gets nothing, a
+    // single light gets the cosine too.
+    float HostLightBvh::Importance(Node const& node, FXMVECTOR position, FXMVECTOR normal) const noexcept
+    {
+        XMVECTOR const to_center = XMLoadFloat3(&node.center) - position;
+        float const dist = std::sqrt(Dot3(to_center, to_center));
+        float const n_dot_c = Dot3(normal, to_center);
+        if (n_dot_c < -node.radius)
+        {
+            return 0;
+        }
+
+        float const d = std::max(dist, node.radius);
+        float const attenuation = node.min_falloff.x + node.min_falloff.y * d + node.min_falloff.z * d * d;
+        float importance = node.power / std::max(attenuation, MinAttenuationDenominator);
+        if (node.right_child == 0)
+        {
+            importance *= std::max(n_dot_c / std::max(dist, MinAttenuationDenominator), 0.0f);
+        }
+        return importance;
+    }
+
+    bool HostLightBvh::Sample(FXMVECTOR position, FXMVECTOR normal, float u, uint32_t& light_index, float& pdf) const noexcept
+    {
+        if (nodes_.empty())
+        {
+            return false;
+        }
+
+        uint32_t node_index = 0;
+        pdf = 1;
+        while (nodes_[node_index].right_child != 0)
+        {
+            uint32_t const left_child = node_index + 1;
+            uint32_t const right_child = nodes_[node_index].right_child;
+            float const left_importance = this->Importance(nodes_[left_child], position, normal);
+            float const right_importance = this->Importance(nodes_[right_child], position, normal);
+            float const total_importance = left_importance + right_importance;
+            if (!(total_importance > 0))
+            {
+                return false;
+            }
+
+            // The choice uses up part of u, the rest is stretched back to [0, 1) for the levels below
+            float const left_prob = left_importance / total_importance;
+            if (u < left_prob)
+            {
+                u = std::min(u / left_prob, OneMinusEpsilon);
+                pdf *= left_prob;
+                node_index = left_child;
+            }
+            else
+            {
+                u = std::min((u - left_prob) / (1 - left_prob), OneMinusEpsilon);
+                pdf *= 1 - left_prob;
+                node_index = right_child;
+            }
+        }
+
+        light_index = nodes_[node_index].light_index;
+        return true;
+    }
+} // namespace GoldenSun
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "../EngineInternal.hpp"
+
+namespace GoldenSun
+{
+    // Binary tree over the point lights, for picking a few of many lights per shading point (Conty Estevez and Kulla 2018). Each
+    // node keeps the total power of its lights, a bounding sphere of their positions and the smallest falloff factors among them.
+    // Sampling walks down from the root, choosing a child with a probability proportional to an estimate of how much light it
+    // gives the point.
+    class HostLightBvh final
+    {
+    public:
+        void Build(LightBuffer const* lights, uint32_t num_lights);
+
+        bool Empty() const noexcept
+        {
+            return nodes_.empty();
+        }
+
+        // Picks a light for a point on a surface, u is uniform in [0, 1). pdf is the probability of picking it. False if no light
+        // is in front of the surface.
+        bool Sample(DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal, float u, uint32_t& light_index, float& pdf) const noexcept;
+
+    private:
+        struct Node
+        {
+            DirectX::XMFLOAT3 center;
+            float radius;
+            DirectX::XMFLOAT3 min_falloff;
+            // Luminance of the sum of the colors
+            float power;
+            // 0 for a leaf. The left child is the next node.
+            uint32_t right_child;
+            uint32_t light_index;
+        };
+
+    private:
+        uint32_t BuildNode(LightBuffer const* lights, uint32_t* begin, uint32_t* end);
+        float Importance(Node const& node, DirectX::FXMVECTOR position, DirectX::FXMVECTOR normal) const noexcept;
+
+    private:
+        std::vector<Node> nodes_;
+    };
+} // namespace GoldenSun
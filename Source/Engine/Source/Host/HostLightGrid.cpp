@@ -0,0 +1,163 @@
+#include "../pch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "HostLightGrid.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    // Half a step of 8-bit sRGB at black, in linear. The diffuse BRDF and the cosine only make a light darker than its color.
+    float constexpr MinLightIntensity = 0.5f / 255 / 12.92f;
+    uint32_t constexpr MaxGridDim = 64;
+
+    // Where the brightest channel of the attenuated color reaches MinLightIntensity. Negative if it never gets that bright, infinity
+    // if it never gets that dark.
+    float InfluenceRadius(LightBuffer const& light) noexcept
+    {
+        float const intensity = std::max({light.color.x, light.color.y, light.color.z}) / MinLightIntensity;
+        float const c = light.falloff.x - intensity;
+        float const b = light.falloff.y;
+        float const a = light.falloff.z;
+        if (a > 0)
+        {
+            return (-b + std::sqrt(std::max(b * b - 4 * a * c, 0.0f))) / (2 * a);
+        }
+        if (b > 0)
+        {
+            return -c / b;
+        }
+        return (c < 0) ? std::numeric_limits<float>::infinity() : -1.0f;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    void HostLightGrid::Build(LightBuffer const* lights, uint32_t num_lights)
+    {
+        bounds_ = HostAabb();
+        spheres_.assign(num_lights, XMFLOAT4(0, 0, 0, -1));
+        unbounded_lights_.clear();
+
+        uint32_t num_bounded = 0;
+        float sum_radius = 0;
+        for (uint32_t i = 0; i < num_lights; ++i)
+        {
+            auto const& light = lights[i];
+            float const radius = InfluenceRadius(light);
+            if (std::isinf(radius))
+            {
+                unbounded_lights_.push_back(i);
+            }
+            else if (radius > 0)
+            {
+                spheres_[i] = {light.position.x, light.position.y, light.position.z, radius * radius};
+                bounds_.Grow(XMFLOAT3(light.position.x - radius, light.position.y - radius, light.position.z - radius));
+                bounds_.Grow(XMFLOAT3(light.position.x + radius, light.position.y + radius, light.position.z + radius));
+                ++num_bounded;
+                sum_radius += radius;
+            }
+        }
+
+        if (num_bounded == 0)
+        {
+            dims_[0] = dims_[1] = dims_[2] = 0;
+            cell_offsets_.assign(1, 0);
+            cell_lights_.clear();
+            return;
+        }
+
+        // About one cell per light, but no smaller than a typical light, which would only copy each light into more cells
+        float const extents[] = {bounds_.max.x - bounds_.min.x, bounds_.max.y - bounds_.min.y, bounds_.max.z - bounds_.min.z};
+        float const max_extent = std::max({extents[0], extents[1], extents[2]});
+        float const cell_size = std::max({std::cbrt(extents[0] * extents[1] * extents[2] / num_bounded), sum_radius / num_bounded,
+            max_extent / MaxGridDim});
+        inv_cell_size_ = 1 / cell_size;
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            dims_[axis] = std::clamp(static_cast<uint32_t>(std::ceil(extents[axis] * inv_cell_size_)), 1U, MaxGridDim);
+        }
+
+        // Counting sort of the (cell, light) pairs. Lights go in order, so each cell keeps the order of the lights.
+        uint32_t const num_cells = dims_[0] * dims_[1] * dims_[2];
+        cell_offsets_.assign(num_cells + 1, 0);
+        for (uint32_t pass = 0; pass < 2; ++pass)
+        {
+            for (uint32_t i = 0; i < num_lights; ++i)
+            {
+                auto const& sphere = spheres_[i];
+                if (sphere.w < 0)
+                {
+                    continue;
+                }
+
+                float const radius = std::sqrt(sphere.w);
+                uint32_t cell_min[3];
+                uint32_t cell_max[3];
+                for (uint32_t axis = 0; axis < 3; ++axis)
+                {
+                    float const center = (&sphere.x)[axis] - (&bounds_.min.x)[axis];
+                    cell_min[axis] = std::min(static_cast<uint32_t>(std::max((center - radius) * inv_cell_size_, 0.0f)), dims_[axis] - 1);
+                    cell_max[axis] = std::min(static_cast<uint32_t>(std::max((center + radius) * inv_cell_size_, 0.0f)), dims_[axis] - 1);
+                }
+
+                for (uint32_t z = cell_min[2]; z <= cell_max[2]; ++z)
+                {
+                    for (uint32_t y = cell_min[1]; y <= cell_max[1]; ++y)
+                    {
+                        for (uint32_t x = cell_min[0]; x <= cell_max[0]; ++x)
+                        {
+                            uint32_t const cell = (z * dims_[1] + y) * dims_[0] + x;
+                            if (pass == 0)
+                            {
+                                ++cell_offsets_[cell + 1];
+                            }
+                            else
+                            {
+                                cell_lights_[cell_offsets_[cell]] = i;
+                                ++cell_offsets_[cell];
+                            }
+                        }
+                    }
+                }
+            }
+
+            if (pass == 0)
+            {
+                for (uint32_t cell = 0; cell < num_cells; ++cell)
+                {
+                    cell_offsets_[cell + 1] += cell_offsets_[cell];
+                }
+                cell_lights_.resize(cell_offsets_[num_cells]);
+            }
+            else
+            {
+                // The fill moved every offset to the end of its cell, the beginning of the next
+                for (uint32_t cell = num_cells; cell > 0; --cell)
+                {
+                    cell_offsets_[cell] = cell_offsets_[cell - 1];
+                }
+                cell_offsets_[0] = 0;
+            }
+        }
+    }
+
+    bool HostLightGrid::Cell(XMFLOAT3 const& pos, uint32_t& cell) const noexcept
+    {
+        if ((dims_[0] == 0) || (pos.x < bounds_.min.x) || (pos.y < bounds_.min.y) || (pos.z < bounds_.min.z) ||
+            (pos.x > bounds_.max.x) || (pos.y > bounds_.max.y) || (pos.z > bounds_.max.z))
+        {
+            return false;
+        }
+
+        uint32_t const x = std::min(static_cast<uint32_t>((pos.x - bounds_.min.x) * inv_cell_size_), dims_[0] - 1);
+        uint32_t const y = std::min(static_cast<uint32_t>((pos.y - bounds_.min.y) * inv_cell_size_), dims_[1] - 1);
+        uint32_t const z = std::min(static_cast<uint32_t>((pos.z - bounds_.min.z) * inv_cell_size_), dims_[2] - 1);
+        cell = (z * dims_[1] + y) * dims_[0] + x;
+        return true;
+    }
+} // namespace GoldenSun
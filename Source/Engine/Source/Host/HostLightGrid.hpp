@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "../EngineInternal.hpp"
+#include "HostBvh.hpp"
+
+namespace GoldenSun
+{
+    // Uniform grid over the spheres of influence of the point lights. A light's radius is where its attenuated color drops below
+    // half a step of an 8-bit sRGB output, so shading a point only needs the lights listed in its cell. Lights that never fall that
+    // low, with no linear or quadratic falloff, are kept aside and reach every point.
+    class HostLightGrid final
+    {
+    public:
+        void Build(LightBuffer const* lights, uint32_t num_lights);
+
+        // Calls func(light_index) for every light whose sphere covers position, in the order of the lights within the cell first,
+        // then for every light without a radius
+        template <typename Func>
+        void ForEachLight(DirectX::FXMVECTOR position, Func&& func) const
+        {
+            DirectX::XMFLOAT3 pos;
+            DirectX::XMStoreFloat3(&pos, position);
+
+            uint32_t cell;
+            if (this->Cell(pos, cell))
+            {
+                for (uint32_t i = cell_offsets_[cell]; i < cell_offsets_[cell + 1]; ++i)
+                {
+                    uint32_t const light_index = cell_lights_[i];
+                    auto const& sphere = spheres_[light_index];
+                    float const dx = pos.x - sphere.x;
+                    float const dy = pos.y - sphere.y;
+                    float const dz = pos.z - sphere.z;
+                    if (dx * dx + dy * dy + dz * dz <= sphere.w)
+                    {
+                        func(light_index);
+                    }
+                }
+            }
+
+            for (uint32_t const light_index : unbounded_lights_)
+            {
+                func(light_index);
+            }
+        }
+
+    private:
+        bool Cell(DirectX::XMFLOAT3 const& pos, uint32_t& cell) const noexcept;
+
+    private:
+        HostAabb bounds_;
+        float inv_cell_size_ = 0;
+        uint32_t dims_[3]{};
+
+        // Center and squared radius of every light. Unused for the unbounded ones.
+        std::vector<DirectX::XMFLOAT4> spheres_;
+        // Lights of cell i are cell_lights_[cell_offsets_[i], cell_offsets_[i + 1])
+        std::vector<uint32_t> cell_offsets_;
+        std::vector<uint32_t> cell_lights_;
+        std::vector<uint32_t> unbounded_lights_;
+    };
+} // namespace GoldenSun
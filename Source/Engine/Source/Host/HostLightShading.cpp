@@ -0,0 +1,147 @@
+#include "../pch.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "HostCpu.hpp"
+#include "HostLightShading.hpp"
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    // _mm_max_ps(x, 0), which is 0 for a NaN
+    float MaxZero(float x) noexcept
+    {
+        return (x > 0) ? x : 0.0f;
+    }
+
+    // 2^x for x <= 0, to about 1e-4 relative, enough for the Fresnel term. Split into the exponent bits and a polynomial of the
+    // fraction, like AtrousExpNegative. Stops at 2^-126, where the float stops being normal.
+    float Exp2NonPositive(float x) noexcept
+    {
+        float const t = (x > -126.0f) ? x : -126.0f;
+        float const i = std::floor(t);
+        float const f = t - i;
+        float const p = ((((0.00133335581f * f + 0.00961812911f) * f + 0.0555041087f) * f + 0.240226507f) * f + 0.693147181f) * f + 1;
+        int32_t const exponent_bits = (static_cast<int32_t>(i) + 127) << 23;
+        float scale;
+        std::memcpy(&scale, &exponent_bits, sizeof(scale));
+        return p * scale;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // The BRDF of CalcLighting in RayTracing.hlsl. The same operations in the same order as ShadeLightsSse4, lane by lane.
+    void ShadeLightsScalar(HostLightSamples4 const& samples, HostLightResults4& results) noexcept
+    {
+        for (uint32_t lane = 0; lane < HostLightSamples4::Width; ++lane)
+        {
+            float const to_light_x = samples.light_position[0][lane] - samples.position[0][lane];
+            float const to_light_y = samples.light_position[1][lane] - samples.position[1][lane];
+            float const to_light_z = samples.light_position[2][lane] - samples.position[2][lane];
+            float const dist_sq = to_light_x * to_light_x + to_light_y * to_light_y + to_light_z * to_light_z;
+            float const dist = std::sqrt(dist_sq);
+            float const light_dir_x = to_light_x / dist;
+            float const light_dir_y = to_light_y / dist;
+            float const light_dir_z = to_light_z / dist;
+
+            float const view_dir_x = samples.view_dir[0][lane];
+            float const view_dir_y = samples.view_dir[1][lane];
+            float const view_dir_z = samples.view_dir[2][lane];
+            float const halfway_x = light_dir_x + view_dir_x;
+            float const halfway_y = light_dir_y + view_dir_y;
+            float const halfway_z = light_dir_z + view_dir_z;
+            float const halfway_len = std::sqrt(halfway_x * halfway_x + halfway_y * halfway_y + halfway_z * halfway_z);
+            float const halfway_dir_x = halfway_x / halfway_len;
+            float const halfway_dir_y = halfway_y / halfway_len;
+            float const halfway_dir_z = halfway_z / halfway_len;
+
+            float const normal_x = samples.normal[0][lane];
+            float const normal_y = samples.normal[1][lane];
+            float const normal_z = samples.normal[2][lane];
+            float const n_dot_l = MaxZero(normal_x * light_dir_x + normal_y * light_dir_y + normal_z * light_dir_z);
+            float const n_dot_v = normal_x * view_dir_x + normal_y * view_dir_y + normal_z * view_dir_z;
+            float const n_dot_h = MaxZero(normal_x * halfway_dir_x + normal_y * halfway_dir_y + normal_z * halfway_dir_z);
+            float const l_dot_h = MaxZero(light_dir_x * halfway_dir_x + light_dir_y * halfway_dir_y + light_dir_z * halfway_dir_z);
+
+            float const attenuation =
+                1 / (samples.falloff[0][lane] + samples.falloff[1][lane] * dist + samples.falloff[2][lane] * dist_sq);
+
+            // GGX distribution and Schlick masking
+            float const roughness = samples.roughness[lane];
+            float const a2 = roughness * roughness;
+            float const d = (n_dot_h * a2 - n_dot_h) * n_dot_h + 1;
+            float const distribution = a2 / (d * d * XM_PI);
+            float const k = a2 * 0.5f;
+            float const g_v = 1 / (n_dot_v * (1 - k) + k);
+            float const g_l = 1 / (n_dot_l * (1 - k) + k);
+            float const masking = g_v * g_l * 0.25f;
+            float const fresnel_weight = Exp2NonPositive(-(5.55473f * l_dot_h + 6.98316f) * l_dot_h);
+
+            float const scale = attenuation * samples.occlusion[lane];
+            for (uint32_t i = 0; i < 3; ++i)
+            {
+                float const c_spec = samples.specular_color[i][lane];
+                float const fresnel = c_spec + (1 - c_spec) * fresnel_weight;
+                float const diffuse = samples.diffuse_color[i][lane] / XM_PI;
+                float const specular = distribution * masking * fresnel;
+                results.contribution[i][lane] =
+                    scale * MaxZero((diffuse + specular) * n_dot_l) * samples.light_color[i][lane] / samples.weight[lane];
+            }
+            results.light_dir[0][lane] = light_dir_x;
+            results.light_dir[1][lane] = light_dir_y;
+            results.light_dir[2][lane] = light_dir_z;
+        }
+    }
+
+    HostShadeLightsFunc SelectShadeLightsFunc() noexcept
+    {
+        static HostShadeLightsFunc const func = SupportsSse4() ? &ShadeLightsSse4 : &ShadeLightsScalar;
+        return func;
+    }
+
+    void SetLightSample(HostLightSamples4& samples, uint32_t lane, FXMVECTOR position, FXMVECTOR view_dir, FXMVECTOR normal,
+        GXMVECTOR diffuse_color, HXMVECTOR specular_color, float roughness, float occlusion, LightBuffer const& light,
+        float weight) noexcept
+    {
+        XMFLOAT3 point_data[5];
+        XMStoreFloat3(&point_data[0], position);
+        XMStoreFloat3(&point_data[1], view_dir);
+        XMStoreFloat3(&point_data[2], normal);
+        XMStoreFloat3(&point_data[3], diffuse_color);
+        XMStoreFloat3(&point_data[4], specular_color);
+        float(*const point_fields[])[HostLightSamples4::Width] = {
+            samples.position, samples.view_dir, samples.normal, samples.diffuse_color, samples.specular_color};
+        for (uint32_t field = 0; field < 5; ++field)
+        {
+            point_fields[field][0][lane] = point_data[field].x;
+            point_fields[field][1][lane] = point_data[field].y;
+            point_fields[field][2][lane] = point_data[field].z;
+        }
+        samples.roughness[lane] = roughness;
+        samples.occlusion[lane] = occlusion;
+
+        XMFLOAT3 const* const light_data[] = {&light.position, &light.color, &light.falloff};
+        float(*const light_fields[])[HostLightSamples4::Width] = {samples.light_position, samples.light_color, samples.falloff};
+        for (uint32_t field = 0; field < 3; ++field)
+        {
+            light_fields[field][0][lane] = light_data[field]->x;
+            light_fields[field][1][lane] = light_data[field]->y;
+            light_fields[field][2][lane] = light_data[field]->z;
+        }
+        samples.weight[lane] = weight;
+    }
+
+    XMVECTOR LightDirection(HostLightResults4 const& results, uint32_t lane) noexcept
+    {
+        return XMVectorSet(results.light_dir[0][lane], results.light_dir[1][lane], results.light_dir[2][lane], 0);
+    }
+
+    XMVECTOR LightContribution(HostLightResults4 const& results, uint32_t lane) noexcept
+    {
+        return XMVectorSet(results.contribution[0][lane], results.contribution[1][lane], results.contribution[2][lane], 0);
+    }
+} // namespace GoldenSun
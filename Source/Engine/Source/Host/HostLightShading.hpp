@@ -0,0 +1,55 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+#include "../EngineInternal.hpp"
+
+namespace GoldenSun
+{
+    // Light samples in SoA form, [component][lane], a shading point and one of its lights in each lane, so the light loop of
+    // CalcLighting runs on 4 samples at a time. The lanes may belong to different points.
+    struct alignas(16) HostLightSamples4
+    {
+        static uint32_t constexpr Width = 4;
+
+        float position[3][Width];
+        float view_dir[3][Width];
+        float normal[3][Width];
+        float diffuse_color[3][Width];
+        float specular_color[3][Width];
+        float roughness[Width];
+        float occlusion[Width];
+
+        float light_position[3][Width];
+        float light_color[3][Width];
+        float falloff[3][Width];
+        // The pdf of the sample times the number of samples, 1 when every light is summed
+        float weight[Width];
+    };
+
+    struct alignas(16) HostLightResults4
+    {
+        float light_dir[3][HostLightSamples4::Width];
+        // What the sample adds if the light is not in shadow
+        float contribution[3][HostLightSamples4::Width];
+    };
+
+    // Shades every lane, the used ones or not
+    using HostShadeLightsFunc = void (*)(HostLightSamples4 const& samples, HostLightResults4& results);
+
+    void ShadeLightsScalar(HostLightSamples4 const& samples, HostLightResults4& results) noexcept;
+    void ShadeLightsSse4(HostLightSamples4 const& samples, HostLightResults4& results) noexcept;
+
+    // Chosen once from the ISA of the CPU. SSE4.1, or plain C++. Both give the same results bit for bit.
+    HostShadeLightsFunc SelectShadeLightsFunc() noexcept;
+
+    // Stores a point and one of its lights into a lane
+    void SetLightSample(HostLightSamples4& samples, uint32_t lane, DirectX::FXMVECTOR position, DirectX::FXMVECTOR view_dir,
+        DirectX::FXMVECTOR normal, DirectX::GXMVECTOR diffuse_color, DirectX::HXMVECTOR specular_color, float roughness, float occlusion,
+        LightBuffer const& light, float weight) noexcept;
+
+    DirectX::XMVECTOR LightDirection(HostLightResults4 const& results, uint32_t lane) noexcept;
+    DirectX::XMVECTOR LightContribution(HostLightResults4 const& results, uint32_t lane) noexcept;
+} // namespace GoldenSun
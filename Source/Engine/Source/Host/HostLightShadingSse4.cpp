@@ -0,0 +1,101 @@
+#include "../pch.hpp"
+
+#include <smmintrin.h>
+
+#include "HostLightShading.hpp"
+
+namespace
+{
+    __m128 Dot(__m128 a_x, __m128 a_y, __m128 a_z, __m128 b_x, __m128 b_y, __m128 b_z) noexcept
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a_x, b_x), _mm_mul_ps(a_y, b_y)), _mm_mul_ps(a_z, b_z));
+    }
+
+    // Exp2NonPositive on 4 lanes
+    __m128 Exp2NonPositive(__m128 x) noexcept
+    {
+        __m128 const t = _mm_max_ps(x, _mm_set1_ps(-126.0f));
+        __m128 const i = _mm_floor_ps(t);
+        __m128 const f = _mm_sub_ps(t, i);
+        __m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(0.00133335581f), f), _mm_set1_ps(0.00961812911f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0555041087f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.240226507f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.693147181f));
+        p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+        __m128i const exponent_bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(i), _mm_set1_epi32(127)), 23);
+        return _mm_mul_ps(p, _mm_castsi128_ps(exponent_bits));
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    // Only called when the CPU supports SSE4.1
+    void ShadeLightsSse4(HostLightSamples4 const& samples, HostLightResults4& results) noexcept
+    {
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const one = _mm_set1_ps(1.0f);
+        __m128 const pi = _mm_set1_ps(DirectX::XM_PI);
+
+        __m128 const to_light_x = _mm_sub_ps(_mm_load_ps(samples.light_position[0]), _mm_load_ps(samples.position[0]));
+        __m128 const to_light_y = _mm_sub_ps(_mm_load_ps(samples.light_position[1]), _mm_load_ps(samples.position[1]));
+        __m128 const to_light_z = _mm_sub_ps(_mm_load_ps(samples.light_position[2]), _mm_load_ps(samples.position[2]));
+        __m128 const dist_sq = Dot(to_light_x, to_light_y, to_light_z, to_light_x, to_light_y, to_light_z);
+        __m128 const dist = _mm_sqrt_ps(dist_sq);
+        __m128 const light_dir_x = _mm_div_ps(to_light_x, dist);
+        __m128 const light_dir_y = _mm_div_ps(to_light_y, dist);
+        __m128 const light_dir_z = _mm_div_ps(to_light_z, dist);
+
+        __m128 const view_dir_x = _mm_load_ps(samples.view_dir[0]);
+        __m128 const view_dir_y = _mm_load_ps(samples.view_dir[1]);
+        __m128 const view_dir_z = _mm_load_ps(samples.view_dir[2]);
+        __m128 const halfway_x = _mm_add_ps(light_dir_x, view_dir_x);
+        __m128 const halfway_y = _mm_add_ps(light_dir_y, view_dir_y);
+        __m128 const halfway_z = _mm_add_ps(light_dir_z, view_dir_z);
+        __m128 const halfway_len = _mm_sqrt_ps(Dot(halfway_x, halfway_y, halfway_z, halfway_x, halfway_y, halfway_z));
+        __m128 const halfway_dir_x = _mm_div_ps(halfway_x, halfway_len);
+        __m128 const halfway_dir_y = _mm_div_ps(halfway_y, halfway_len);
+        __m128 const halfway_dir_z = _mm_div_ps(halfway_z, halfway_len);
+
+        __m128 const normal_x = _mm_load_ps(samples.normal[0]);
+        __m128 const normal_y = _mm_load_ps(samples.normal[1]);
+        __m128 const normal_z = _mm_load_ps(samples.normal[2]);
+        __m128 const n_dot_l = _mm_max_ps(Dot(normal_x, normal_y, normal_z, light_dir_x, light_dir_y, light_dir_z), zero);
+        __m128 const n_dot_v = Dot(normal_x, normal_y, normal_z, view_dir_x, view_dir_y, view_dir_z);
+        __m128 const n_dot_h = _mm_max_ps(Dot(normal_x, normal_y, normal_z, halfway_dir_x, halfway_dir_y, halfway_dir_z), zero);
+        __m128 const l_dot_h = _mm_max_ps(Dot(light_dir_x, light_dir_y, light_dir_z, halfway_dir_x, halfway_dir_y, halfway_dir_z), zero);
+
+        __m128 const attenuation = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(_mm_load_ps(samples.falloff[0]),
+                                                                  _mm_mul_ps(_mm_load_ps(samples.falloff[1]), dist)),
+                                                       _mm_mul_ps(_mm_load_ps(samples.falloff[2]), dist_sq)));
+
+        __m128 const roughness = _mm_load_ps(samples.roughness);
+        __m128 const a2 = _mm_mul_ps(roughness, roughness);
+        __m128 const d = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_mul_ps(n_dot_h, a2), n_dot_h), n_dot_h), one);
+        __m128 const distribution = _mm_div_ps(a2, _mm_mul_ps(_mm_mul_ps(d, d), pi));
+        __m128 const k = _mm_mul_ps(a2, _mm_set1_ps(0.5f));
+        __m128 const one_minus_k = _mm_sub_ps(one, k);
+        __m128 const g_v = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(n_dot_v, one_minus_k), k));
+        __m128 const g_l = _mm_div_ps(one, _mm_add_ps(_mm_mul_ps(n_dot_l, one_minus_k), k));
+        __m128 const masking = _mm_mul_ps(_mm_mul_ps(g_v, g_l), _mm_set1_ps(0.25f));
+        __m128 const fresnel_weight = Exp2NonPositive(
+            _mm_mul_ps(_mm_xor_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(5.55473f), l_dot_h), _mm_set1_ps(6.98316f)), _mm_set1_ps(-0.0f)),
+                l_dot_h));
+
+        __m128 const scale = _mm_mul_ps(attenuation, _mm_load_ps(samples.occlusion));
+        __m128 const specular_factor = _mm_mul_ps(distribution, masking);
+        __m128 const weight = _mm_load_ps(samples.weight);
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            __m128 const c_spec = _mm_load_ps(samples.specular_color[i]);
+            __m128 const fresnel = _mm_add_ps(c_spec, _mm_mul_ps(_mm_sub_ps(one, c_spec), fresnel_weight));
+            __m128 const diffuse = _mm_div_ps(_mm_load_ps(samples.diffuse_color[i]), pi);
+            __m128 const specular = _mm_mul_ps(specular_factor, fresnel);
+            __m128 const lit = _mm_max_ps(_mm_mul_ps(_mm_add_ps(diffuse, specular), n_dot_l), zero);
+            _mm_store_ps(results.contribution[i],
+                _mm_div_ps(_mm_mul_ps(_mm_mul_ps(scale, lit), _mm_load_ps(samples.light_color[i])), weight));
+        }
+        _mm_store_ps(results.light_dir[0], light_dir_x);
+        _mm_store_ps(results.light_dir[1], light_dir_y);
+        _mm_store_ps(results.light_dir[2], light_dir_z);
+    }
+} // namespace GoldenSun
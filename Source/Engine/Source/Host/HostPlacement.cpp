@@ -0,0 +1,206 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <algorithm>
+#include <new>
+
+#ifndef _WIN32
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "HostPlacement.hpp"
+
+namespace
+{
+    using namespace GoldenSun;
+
+    thread_local HostPlacement const* tls_placement = nullptr;
+
+    // Granularity of the interleaving, and of the blocks. A multiple of the page size, coarse enough to keep the number of commits
+    // low.
+    size_t constexpr PlacementChunkSize = 64 * 1024;
+
+#ifdef _WIN32
+    void* ReservePages(size_t bytes, bool commit)
+    {
+        void* ptr = VirtualAlloc(nullptr, bytes, commit ? MEM_RESERVE | MEM_COMMIT : MEM_RESERVE, PAGE_READWRITE);
+        if (ptr == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    void ReleasePages(void* ptr, [[maybe_unused]] size_t bytes) noexcept
+    {
+        VirtualFree(ptr, 0, MEM_RELEASE);
+    }
+
+    void CommitOnNode(uint8_t* ptr, size_t bytes, uint32_t node)
+    {
+        if (VirtualAllocExNuma(GetCurrentProcess(), ptr, bytes, MEM_COMMIT, PAGE_READWRITE, node) == nullptr)
+        {
+            // Only a preference in the first place. Leave the pages to the OS if the node can't take them.
+            if (VirtualAlloc(ptr, bytes, MEM_COMMIT, PAGE_READWRITE) == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+        }
+    }
+#else
+    // Pages of a mapping only come into being on their first touch, so a reservation and a commit are the same thing
+    void* ReservePages(size_t bytes, [[maybe_unused]] bool commit)
+    {
+        void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+    void ReleasePages(void* ptr, size_t bytes) noexcept
+    {
+        munmap(ptr, bytes);
+    }
+
+    void CommitOnNode(uint8_t* ptr, size_t bytes, uint32_t node)
+    {
+        // Only a preference in the first place, so a failed or impossible mbind leaves the pages to the first touch. The syscall
+        // directly, not to depend on libnuma.
+        if (node < 64)
+        {
+            unsigned long const mask = 1UL << node;
+            // One more than the bits of the mask, the kernel drops the last
+            syscall(SYS_mbind, ptr, bytes, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0U);
+        }
+    }
+#endif
+} // namespace
+
+namespace GoldenSun
+{
+    HostPlacement HostPlacement::OnNode(ThreadPool const& thread_pool, uint32_t node)
+    {
+        HostPlacement placement;
+        if (thread_pool.NumNodes() > 1)
+        {
+            placement.nodes.push_back(thread_pool.NodeNumber(node));
+        }
+        return placement;
+    }
+
+    HostPlacement HostPlacement::Interleave(ThreadPool const& thread_pool)
+    {
+        HostPlacement placement;
+        if (thread_pool.NumNodes() > 1)
+        {
+            for (uint32_t node = 0; node < thread_pool.NumNodes(); ++node)
+            {
+                placement.nodes.push_back(thread_pool.NodeNumber(node));
+            }
+        }
+        return placement;
+    }
+
+    HostPlacement HostPlacement::Block(ThreadPool const& thread_pool)
+    {
+        HostPlacement placement = Interleave(thread_pool);
+        placement.policy = Policy::Blocked;
+        return placement;
+    }
+
+
+    HostPlacementScope::HostPlacementScope(HostPlacement const& placement) noexcept : prev_(tls_placement)
+    {
+        tls_placement = &placement;
+    }
+
+    HostPlacementScope::~HostPlacementScope() noexcept
+    {
+        tls_placement = prev_;
+    }
+
+    HostPlacement const* HostPlacementScope::Current() noexcept
+    {
+        return tls_placement;
+    }
+
+
+    void* AllocatePlaced(size_t bytes, size_t alignment)
+    {
+        if (bytes < MinPlacedBytes)
+        {
+            if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            {
+                return ::operator new(bytes, std::align_val_t(alignment));
+            }
+            return ::operator new(bytes);
+        }
+
+        // Page aligned, more than any alignof
+        HostPlacement const* placement = tls_placement;
+        if ((placement == nullptr) || placement->nodes.empty())
+        {
+            return ReservePages(bytes, true);
+        }
+
+        auto* ptr = static_cast<uint8_t*>(ReservePages(bytes, false));
+
+        try
+        {
+            size_t const num_chunks = (bytes + PlacementChunkSize - 1) / PlacementChunkSize;
+            size_t const num_nodes = placement->nodes.size();
+            if (placement->policy == HostPlacement::Policy::Blocked)
+            {
+                for (size_t i = 0; i < num_nodes; ++i)
+                {
+                    size_t const begin = num_chunks * i / num_nodes * PlacementChunkSize;
+                    size_t const end = std::min(num_chunks * (i + 1) / num_nodes * PlacementChunkSize, bytes);
+                    if (begin < end)
+                    {
+                        CommitOnNode(ptr + begin, end - begin, placement->nodes[i]);
+                    }
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < num_chunks; ++i)
+                {
+                    size_t const begin = i * PlacementChunkSize;
+                    CommitOnNode(ptr + begin, std::min(PlacementChunkSize, bytes - begin), placement->nodes[i % num_nodes]);
+                }
+            }
+        }
+        catch (...)
+        {
+            ReleasePages(ptr, bytes);
+            throw;
+        }
+
+        return ptr;
+    }
+
+    void FreePlaced(void* ptr, size_t bytes, size_t alignment) noexcept
+    {
+        if (bytes < MinPlacedBytes)
+        {
+            if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            {
+                ::operator delete(ptr, std::align_val_t(alignment));
+            }
+            else
+            {
+                ::operator delete(ptr);
+            }
+        }
+        else
+        {
+            ReleasePages(ptr, bytes);
+        }
+    }
+} // namespace GoldenSun
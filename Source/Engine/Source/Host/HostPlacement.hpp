@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace GoldenSun
+{
+    class ThreadPool;
+
+    // Which NUMA nodes the pages of an allocation come from
+    struct HostPlacement
+    {
+        enum class Policy : uint32_t
+        {
+            // Chunks of pages go to the nodes in turn, so every node serves its share of the reads
+            Interleaved,
+            // The allocation is cut into one block per node, in node order. Suits arrays split the same way between the threads of the
+            // nodes, like the rows of the frame buffer.
+            Blocked,
+        };
+
+        Policy policy = Policy::Interleaved;
+        // OS numbers of the nodes. Empty is no placement at all.
+        std::vector<uint32_t> nodes;
+
+        static HostPlacement OnNode(ThreadPool const& thread_pool, uint32_t node);
+        static HostPlacement Interleave(ThreadPool const& thread_pool);
+        static HostPlacement Block(ThreadPool const& thread_pool);
+    };
+
+    // Makes a placement current on the calling thread while it lives. The large allocations of HostAllocator made in it follow the
+    // placement, the ones outside any scope take their pages from wherever the OS sees fit. Scopes nest.
+    class HostPlacementScope final
+    {
+        DISALLOW_COPY_AND_ASSIGN(HostPlacementScope)
+        DISALLOW_COPY_MOVE_AND_ASSIGN(HostPlacementScope)
+
+    public:
+        explicit HostPlacementScope(HostPlacement const& placement) noexcept;
+        ~HostPlacementScope() noexcept;
+
+        // nullptr outside of any scope
+        static HostPlacement const* Current() noexcept;
+
+    private:
+        HostPlacement const* prev_;
+    };
+
+    // Allocations below this come from the heap and can't be placed. They share pages with other allocations, and mostly stay in the
+    // caches anyway.
+    size_t constexpr MinPlacedBytes = 1024 * 1024;
+
+    // Straight from the OS at MinPlacedBytes and up, following the current placement. Whether memory came from the OS only depends
+    // on its size, so it can be freed outside the scope it was allocated in.
+    void* AllocatePlaced(size_t bytes, size_t alignment);
+    void FreePlaced(void* ptr, size_t bytes, size_t alignment) noexcept;
+
+    // Stateless, so containers of it move and swap like the ones of std::allocator. Only where their memory comes from differs.
+    template <typename T>
+    class HostAllocator
+    {
+    public:
+        using value_type = T;
+        using is_always_equal = std::true_type;
+
+    public:
+        HostAllocator() noexcept = default;
+
+        template <typename U>
+        HostAllocator(HostAllocator<U> const& /*other*/) noexcept
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            if (n > static_cast<size_t>(-1) / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+            return static_cast<T*>(AllocatePlaced(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* ptr, size_t n) noexcept
+        {
+            FreePlaced(ptr, n * sizeof(T), alignof(T));
+        }
+
+        template <typename U>
+        bool operator==(HostAllocator<U> const& /*other*/) const noexcept
+        {
+            return true;
+        }
+
+        template <typename U>
+        bool operator!=(HostAllocator<U> const& /*other*/) const noexcept
+        {
+            return false;
+        }
+    };
+
+    // For the large arrays worth placing, the read-mostly scene data and the frame buffer
+    template <typename T>
+    using HostVector = std::vector<T, HostAllocator<T>>;
+} // namespace GoldenSun
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "HostBvh.hpp"
+
+namespace GoldenSun
+{
+    // Coherent rays from one origin, such as the primary rays of an 8x8 pixel tile. Every direction must be inside the cone spanned by
+    // corner_directions, which is what lets the traversal cull nodes against the frustum of the packet instead of every ray.
+    struct HostRayPacket
+    {
+        static uint32_t constexpr MaxRays = 64;
+
+        DirectX::XMFLOAT3 origin;
+        float t_min;
+        DirectX::XMFLOAT3 corner_directions[4];
+        uint32_t num_rays;
+        DirectX::XMFLOAT3 directions[MaxRays];
+        float t_max[MaxRays];
+
+        HostRay Ray(uint32_t index) const noexcept
+        {
+            return {origin, t_min, directions[index], t_max[index]};
+        }
+
+        // Square of the farthest distance any ray of the packet can still reach
+        float MaxDistanceSq() const noexcept
+        {
+            float ret = 0;
+            for (uint32_t i = 0; i < num_rays; ++i)
+            {
+                auto const& dir = directions[i];
+                ret = std::max(ret, (dir.x * dir.x + dir.y * dir.y + dir.z * dir.z) * t_max[i] * t_max[i]);
+            }
+            return ret;
+        }
+    };
+
+    // Side planes of a packet, through its origin with the normals pointing inwards
+    struct HostFrustum
+    {
+        DirectX::XMFLOAT3 origin;
+        DirectX::XMFLOAT3 normals[4];
+
+        explicit HostFrustum(HostRayPacket const& packet) noexcept : origin(packet.origin)
+        {
+            DirectX::XMVECTOR corners[4];
+            DirectX::XMVECTOR center = DirectX::XMVectorZero();
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                corners[i] = DirectX::XMLoadFloat3(&packet.corner_directions[i]);
+                center += corners[i];
+            }
+
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                // Zero when two corners are the same, as in 1 pixel wide tiles. Such a plane never culls anything.
+                DirectX::XMVECTOR normal = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(corners[i], corners[(i + 1) % 4]));
+                if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, center)) < 0)
+                {
+                    normal = -normal;
+                }
+                DirectX::XMStoreFloat3(&normals[i], normal);
+            }
+        }
+    };
+} // namespace GoldenSun
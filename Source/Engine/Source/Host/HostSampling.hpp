@@ -0,0 +1,60 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace GoldenSun
+{
+    // PCG32 (O'Neill 2014). Seeded from the pixel and the sample, so a path draws the same numbers whichever thread traces it.
+    class HostRandom final
+    {
+    public:
+        HostRandom(uint32_t pixel, uint32_t sample_index) noexcept : inc_((static_cast<uint64_t>(pixel) << 1) | 1)
+        {
+            this->NextUint();
+            state_ += 0x853C49E6748FEA9BULL ^ (static_cast<uint64_t>(sample_index) * 0x9E3779B97F4A7C15ULL);
+            this->NextUint();
+        }
+
+        uint32_t NextUint() noexcept
+        {
+            uint64_t const old_state = state_;
+            state_ = old_state * 6364136223846793005ULL + inc_;
+            uint32_t const xor_shifted = static_cast<uint32_t>(((old_state >> 18) ^ old_state) >> 27);
+            uint32_t const rot = static_cast<uint32_t>(old_state >> 59);
+            return (xor_shifted >> rot) | (xor_shifted << ((32 - rot) & 31));
+        }
+
+        // In [0, 1)
+        float NextFloat() noexcept
+        {
+            return (this->NextUint() >> 8) * (1.0f / (1U << 24));
+        }
+
+    private:
+        uint64_t state_ = 0;
+        uint64_t inc_;
+    };
+
+    // Cosine weighted direction around normal, from two uniform numbers in [0, 1). The pdf is cos(theta) / pi, which cancels the
+    // cosine and the 1 / pi of a Lambertian BRDF.
+    inline DirectX::XMVECTOR CosineSampleHemisphere(DirectX::FXMVECTOR normal, float u0, float u1) noexcept
+    {
+        // Orthonormal basis without a branch on the axis (Duff et al. 2017)
+        DirectX::XMFLOAT3 n;
+        DirectX::XMStoreFloat3(&n, normal);
+        float const sign = std::copysign(1.0f, n.z);
+        float const a = -1 / (sign + n.z);
+        float const b = n.x * n.y * a;
+        DirectX::XMVECTOR const tangent = DirectX::XMVectorSet(1 + sign * n.x * n.x * a, sign * b, -sign * n.x, 0);
+        DirectX::XMVECTOR const bitangent = DirectX::XMVectorSet(b, sign + n.y * n.y * a, -n.y, 0);
+
+        float const r = std::sqrt(u0);
+        float const phi = 2 * DirectX::XM_PI * u1;
+        float const z = std::sqrt(std::max(1 - u0, 0.0f));
+        return r * std::cos(phi) * tangent + r * std::sin(phi) * bitangent + z * normal;
+    }
+} // namespace GoldenSun
@@ -0,0 +1,328 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ThreadPool.hpp>
+
+#include <cstring>
+
+#include "HostScene.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+    using namespace GoldenSun;
+
+    std::shared_ptr<HostTexture const> CreateSolidColorTexture(uint32_t fill_color_rgba)
+    {
+        return std::make_shared<HostTexture const>(1, 1, DXGI_FORMAT_R8G8B8A8_UNORM, &fill_color_rgba);
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    HostScene::HostScene()
+    {
+        default_textures_[std::to_underlying(PbrMaterial::TextureSlot::Albedo)] = CreateSolidColorTexture(0xFFFFFFFFU);
+        default_textures_[std::to_underlying(PbrMaterial::TextureSlot::MetallicRoughness)] = CreateSolidColorTexture(0x0000FF00U);
+        default_textures_[std::to_underlying(PbrMaterial::TextureSlot::Emissive)] = CreateSolidColorTexture(0x00000000U);
+        default_textures_[std::to_underlying(PbrMaterial::TextureSlot::Normal)] = CreateSolidColorTexture(0x00FF8080U);
+        default_textures_[std::to_underlying(PbrMaterial::TextureSlot::Occlusion)] = CreateSolidColorTexture(0xFFFFFFFFU);
+    }
+
+    // Meshes with the same triangles as last time only get their vertices and transforms updated. Their acceleration structures are
+    // refitted, like PERFORM_UPDATE, instead of rebuilt. Changing the build mode always rebuilds.
+    void HostScene::Meshes(ThreadPool& thread_pool, Mesh const* meshes, uint32_t num_meshes, HostBvhBuildMode build_mode)
+    {
+        std::vector<HostGeometry> geometries;
+        std::vector<MeshRange> mesh_ranges(num_meshes);
+        uint32_t num_instances = 0;
+        uint32_t num_materials = 0;
+        for (uint32_t i = 0; i < num_meshes; ++i)
+        {
+            auto const& mesh = meshes[i];
+
+            auto& range = mesh_ranges[i];
+            range.geometry_start = static_cast<uint32_t>(geometries.size());
+            range.num_geometries = mesh.NumPrimitives();
+            range.instance_start = num_instances;
+            range.num_instances = mesh.NumInstances();
+
+            for (uint32_t j = 0; j < mesh.NumPrimitives(); ++j)
+            {
+                auto& geometry = geometries.emplace_back();
+                EngineInternal::HostBuffers(mesh, j, geometry.vertices, geometry.indices);
+                geometry.material_id = num_materials + mesh.MaterialId(j);
+                geometry.opaque = (EngineInternal::GeometryFlags(mesh, j) & D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE) != 0;
+            }
+
+            num_instances += mesh.NumInstances();
+            num_materials += mesh.NumMaterials();
+        }
+
+        bool const refit = (build_mode == build_mode_) && this->SameTopology(geometries, mesh_ranges);
+
+        std::vector<bool> deformed(num_meshes, false);
+        if (refit)
+        {
+            for (uint32_t i = 0; i < num_meshes; ++i)
+            {
+                auto const& range = mesh_ranges[i];
+                for (uint32_t j = range.geometry_start; j < range.geometry_start + range.num_geometries; ++j)
+                {
+                    auto const& old_vertices = geometries_[j].vertices;
+                    auto const& new_vertices = geometries[j].vertices;
+                    for (size_t k = 0; (k < new_vertices.size()) && !deformed[i]; ++k)
+                    {
+                        deformed[i] = std::memcmp(&old_vertices[k].position, &new_vertices[k].position, sizeof(XMFLOAT3)) != 0;
+                    }
+                }
+            }
+        }
+        else
+        {
+            acceleration_structure_.Clear();
+        }
+
+        geometries_ = std::move(geometries);
+        mesh_ranges_ = std::move(mesh_ranges);
+        build_mode_ = build_mode;
+        instances_.clear();
+        materials_.clear();
+
+        bool const allow_update = true;
+        for (uint32_t i = 0; i < num_meshes; ++i)
+        {
+            auto const& mesh = meshes[i];
+            auto const& range = mesh_ranges_[i];
+
+            for (uint32_t j = 0; j < mesh.NumMaterials(); ++j)
+            {
+                auto const& material = mesh.Material(j);
+
+                auto& host_material = materials_.emplace_back();
+                host_material.buffer = EngineInternal::Buffer(material);
+                for (uint32_t k = 0; k < std::to_underlying(PbrMaterial::TextureSlot::Num); ++k)
+                {
+                    auto const slot = static_cast<PbrMaterial::TextureSlot>(k);
+                    auto const& texture = EngineInternal::HostTextureOf(material, slot);
+                    auto const& source = EngineInternal::TextureSourceOf(material, slot);
+                    host_material.textures[k] = texture ? texture : default_textures_[k];
+                    host_material.paged_textures[k] = source ? texture_cache_.Add(source) : HostTextureCache::InvalidId;
+                }
+            }
+
+            // One bottom level AS per mesh, shared by all of its instances
+            if (!refit)
+            {
+                acceleration_structure_.AddBottomLevelAS(
+                    thread_pool, &geometries_[range.geometry_start], range.num_geometries, build_mode_, allow_update);
+            }
+            else if (deformed[i])
+            {
+                acceleration_structure_.UpdateBottomLevelAS(i, thread_pool, &geometries_[range.geometry_start], range.num_geometries);
+            }
+
+            for (uint32_t j = 0; j < mesh.NumInstances(); ++j)
+            {
+                XMMATRIX const transform = XMLoadFloat4x4(&mesh.Instance(j).transform);
+
+                auto& instance = instances_.emplace_back();
+                instance.object_to_world = mesh.Instance(j).transform;
+                XMStoreFloat4x4(&instance.world_to_object, XMMatrixInverse(nullptr, transform));
+                instance.geometry_start = range.geometry_start;
+                instance.num_geometries = range.num_geometries;
+
+                if (refit)
+                {
+                    acceleration_structure_.UpdateBottomLevelASInstance(range.instance_start + j, transform);
+                }
+                else
+                {
+                    acceleration_structure_.AddBottomLevelASInstance(i, transform);
+                }
+            }
+        }
+
+        if (refit)
+        {
+            acceleration_structure_.UpdateTopLevelAS(thread_pool);
+        }
+        else
+        {
+            acceleration_structure_.AssignTopLevelAS(thread_pool, build_mode_, allow_update);
+        }
+
+        this->PlaceAccelerationStructures(thread_pool);
+    }
+
+    void HostScene::Placement(ThreadPool const& thread_pool, HostScenePlacement placement)
+    {
+        texture_cache_.Placement(HostPlacement::Interleave(thread_pool));
+
+        if (placement != placement_)
+        {
+            placement_ = placement;
+            this->PlaceAccelerationStructures(thread_pool);
+        }
+    }
+
+    bool HostScene::SameTopology(std::vector<HostGeometry> const& geometries, std::vector<MeshRange> const& mesh_ranges) const noexcept
+    {
+        if ((mesh_ranges.size() != mesh_ranges_.size()) || (geometries.size() != geometries_.size()))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < mesh_ranges.size(); ++i)
+        {
+            if ((mesh_ranges[i].num_geometries != mesh_ranges_[i].num_geometries) ||
+                (mesh_ranges[i].num_instances != mesh_ranges_[i].num_instances))
+            {
+                return false;
+            }
+        }
+
+        for (size_t i = 0; i < geometries.size(); ++i)
+        {
+            if ((geometries[i].vertices.size() != geometries_[i].vertices.size()) || (geometries[i].indices != geometries_[i].indices))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    // The builds allocate on all the threads of the pool, so where their pages end up is left to chance. Copying on one thread in a
+    // placement scope puts them where they belong.
+    void HostScene::PlaceAccelerationStructures(ThreadPool const& thread_pool)
+    {
+        replicas_.clear();
+
+        uint32_t const num_nodes = thread_pool.NumNodes();
+        if (num_nodes == 1)
+        {
+            return;
+        }
+
+        if (placement_ == HostScenePlacement::Replicated)
+        {
+            replicas_.reserve(num_nodes - 1);
+            for (uint32_t node = 0; node < num_nodes; ++node)
+            {
+                HostPlacement const on_node = HostPlacement::OnNode(thread_pool, node);
+                HostPlacementScope scope(on_node);
+                if (node == 0)
+                {
+                    acceleration_structure_ = HostRaytracingAccelerationStructureManager(acceleration_structure_);
+                }
+                else
+                {
+                    replicas_.emplace_back(acceleration_structure_);
+                }
+            }
+        }
+        else
+        {
+            HostPlacement const interleaved = HostPlacement::Interleave(thread_pool);
+            HostPlacementScope scope(interleaved);
+            acceleration_structure_ = HostRaytracingAccelerationStructureManager(acceleration_structure_);
+        }
+    }
+
+    bool HostScene::Trace(HostRay ray, bool cull_back_facing, HostHit& hit) const
+    {
+        bool found = false;
+        this->AccelerationStructure().Traverse(ray, cull_back_facing,
+            [this, &hit, &found](
+                uint32_t instance_id, HostTriangle const& triangle, float t, XMFLOAT2 const& barycentrics, HostRay& object_ray) {
+                uint32_t const geometry_id = instances_[instance_id].geometry_start + triangle.geometry_index;
+                auto const& geometry = geometries_[geometry_id];
+                if (geometry.opaque || this->AlphaTest(geometry, triangle.primitive_id, barycentrics))
+                {
+                    object_ray.t_max = t;
+
+                    hit.t = t;
+                    hit.barycentrics = barycentrics;
+                    hit.instance_id = instance_id;
+                    hit.geometry_id = geometry_id;
+                    hit.primitive_id = triangle.primitive_id;
+                    found = true;
+                }
+                return false;
+            });
+
+        return found;
+    }
+
+    void HostScene::TracePacket(HostRayPacket packet, bool cull_back_facing, HostHit* hits, bool* found) const
+    {
+        for (uint32_t i = 0; i < packet.num_rays; ++i)
+        {
+            found[i] = false;
+        }
+
+        this->AccelerationStructure().TraversePacket(packet, cull_back_facing,
+            [this, hits, found](uint32_t instance_id, HostTriangle const& triangle, uint32_t ray_index, float t,
+                XMFLOAT2 const& barycentrics, HostRayPacket& object_packet) {
+                uint32_t const geometry_id = instances_[instance_id].geometry_start + triangle.geometry_index;
+                auto const& geometry = geometries_[geometry_id];
+                if (geometry.opaque || this->AlphaTest(geometry, triangle.primitive_id, barycentrics))
+                {
+                    object_packet.t_max[ray_index] = t;
+
+                    auto& hit = hits[ray_index];
+                    hit.t = t;
+                    hit.barycentrics = barycentrics;
+                    hit.instance_id = instance_id;
+                    hit.geometry_id = geometry_id;
+                    hit.primitive_id = triangle.primitive_id;
+                    found[ray_index] = true;
+                }
+            });
+    }
+
+    bool HostScene::Occluded(HostRay ray) const
+    {
+        return this->AccelerationStructure().TraverseAnyHit(
+            ray, [this](uint32_t instance_id, HostTriangle const& triangle, XMFLOAT2 const& barycentrics) {
+                auto const& geometry = geometries_[instances_[instance_id].geometry_start + triangle.geometry_index];
+                return geometry.opaque || this->AlphaTest(geometry, triangle.primitive_id, barycentrics);
+            });
+    }
+
+    XMFLOAT2 HostScene::TexCoord(HostGeometry const& geometry, uint32_t primitive_id, XMFLOAT2 const& barycentrics) const noexcept
+    {
+        XMFLOAT2 const& tc0 = geometry.vertices[geometry.indices[primitive_id * 3 + 0]].tex_coord;
+        XMFLOAT2 const& tc1 = geometry.vertices[geometry.indices[primitive_id * 3 + 1]].tex_coord;
+        XMFLOAT2 const& tc2 = geometry.vertices[geometry.indices[primitive_id * 3 + 2]].tex_coord;
+        return {tc0.x + barycentrics.x * (tc1.x - tc0.x) + barycentrics.y * (tc2.x - tc0.x),
+            tc0.y + barycentrics.x * (tc1.y - tc0.y) + barycentrics.y * (tc2.y - tc0.y)};
+    }
+
+    HostTexture const& HostScene::Texture(
+        HostMaterial const& material, PbrMaterial::TextureSlot slot, std::shared_ptr<HostTexture const>& pinned) const
+    {
+        uint32_t const paged_id = material.paged_textures[std::to_underlying(slot)];
+        if (paged_id != HostTextureCache::InvalidId)
+        {
+            pinned = texture_cache_.Acquire(paged_id);
+            if (pinned)
+            {
+                return *pinned;
+            }
+        }
+        return material.Texture(slot);
+    }
+
+    bool HostScene::AlphaTest(HostGeometry const& geometry, uint32_t primitive_id, XMFLOAT2 const& barycentrics) const
+    {
+        auto const& material = materials_[geometry.material_id];
+
+        XMFLOAT2 const tex_coord = this->TexCoord(geometry, primitive_id, barycentrics);
+        std::shared_ptr<HostTexture const> pinned;
+        HostTexture const& albedo_texture = this->Texture(material, PbrMaterial::TextureSlot::Albedo, pinned);
+        float const opacity = material.buffer.opacity * XMVectorGetW(albedo_texture.Sample(tex_coord));
+        return !(opacity < material.buffer.alpha_cutoff);
+    }
+} // namespace GoldenSun
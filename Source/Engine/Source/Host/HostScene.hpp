@@ -0,0 +1,160 @@
+#pragma once
+
+#include <GoldenSun/Material.hpp>
+#include <GoldenSun/Mesh.hpp>
+#include <GoldenSun/ThreadPool.hpp>
+#include <GoldenSun/Util.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "../EngineInternal.hpp"
+#include "HostAccelerationStructure.hpp"
+#include "HostBvh.hpp"
+#include "HostRayPacket.hpp"
+#include "HostTexture.hpp"
+#include "HostTextureCache.hpp"
+
+namespace GoldenSun
+{
+    struct HostInstance
+    {
+        DirectX::XMFLOAT4X4 object_to_world;
+        DirectX::XMFLOAT4X4 world_to_object;
+        uint32_t geometry_start;
+        uint32_t num_geometries;
+    };
+
+    struct HostMaterial
+    {
+        PbrMaterialBuffer buffer;
+        std::array<std::shared_ptr<HostTexture const>, std::to_underlying(PbrMaterial::TextureSlot::Num)> textures;
+        // Ids in the texture cache of the slots read on demand, HostTextureCache::InvalidId for the others. textures has the default
+        // texture of such a slot, for when its source can't be read.
+        std::array<uint32_t, std::to_underlying(PbrMaterial::TextureSlot::Num)> paged_textures;
+
+        HostTexture const& Texture(PbrMaterial::TextureSlot slot) const noexcept
+        {
+            return *textures[std::to_underlying(slot)];
+        }
+    };
+
+    // Where the read-mostly scene data goes on a machine with several NUMA nodes
+    enum class HostScenePlacement : uint32_t
+    {
+        // One copy of the acceleration structures per node, each thread traces the one of its own node
+        Replicated,
+        // The pages of the acceleration structures are spread over the nodes
+        Interleaved,
+    };
+
+    // Same as BuiltInTriangleIntersectionAttributes plus the system values a closest hit shader reads
+    struct HostHit
+    {
+        float t;
+        DirectX::XMFLOAT2 barycentrics;
+        uint32_t instance_id;
+        uint32_t geometry_id;
+        uint32_t primitive_id;
+    };
+
+    class HostScene final
+    {
+        DISALLOW_COPY_AND_ASSIGN(HostScene)
+
+    public:
+        HostScene();
+
+        void Meshes(ThreadPool& thread_pool, Mesh const* meshes, uint32_t num_meshes, HostBvhBuildMode build_mode);
+        // Places the current acceleration structures right away, and the ones of later Meshes calls. Textures read on demand are
+        // always interleaved, a copy per node would multiply the largest part of the scene.
+        void Placement(ThreadPool const& thread_pool, HostScenePlacement placement);
+
+        // Closest hit of a radiance ray, running the alpha test of non-opaque geometries like AnyHitShader does
+        bool Trace(HostRay ray, bool cull_back_facing, HostHit& hit) const;
+        // Same as Trace, for every ray of a coherent packet. found[i] tells whether hits[i] is valid.
+        void TracePacket(HostRayPacket packet, bool cull_back_facing, HostHit* hits, bool* found) const;
+        // Any hit of a shadow ray, ending on the first occluder
+        bool Occluded(HostRay ray) const;
+
+        HostGeometry const& Geometry(uint32_t geometry_id) const noexcept
+        {
+            return geometries_[geometry_id];
+        }
+
+        HostInstance const& Instance(uint32_t instance_id) const noexcept
+        {
+            return instances_[instance_id];
+        }
+
+        HostMaterial const& Material(uint32_t material_id) const noexcept
+        {
+            return materials_[material_id];
+        }
+
+        HostAabb const& Bounds() const noexcept
+        {
+            return acceleration_structure_.Bounds();
+        }
+
+        DirectX::XMFLOAT2 TexCoord(
+            HostGeometry const& geometry, uint32_t primitive_id, DirectX::XMFLOAT2 const& barycentrics) const noexcept;
+
+        // The texture in a slot of a material, going through the texture cache if the slot is read on demand. pinned keeps such a
+        // texture alive while it's used.
+        HostTexture const& Texture(
+            HostMaterial const& material, PbrMaterial::TextureSlot slot, std::shared_ptr<HostTexture const>& pinned) const;
+
+        HostTextureCache& TextureCache() noexcept
+        {
+            return texture_cache_;
+        }
+
+        HostTextureCache const& TextureCache() const noexcept
+        {
+            return texture_cache_;
+        }
+
+    private:
+        struct MeshRange
+        {
+            uint32_t geometry_start;
+            uint32_t num_geometries;
+            uint32_t instance_start;
+            uint32_t num_instances;
+        };
+
+        // Same meshes, primitives, instances and triangles as the current ones, so the acceleration structures can be refitted
+        bool SameTopology(std::vector<HostGeometry> const& geometries, std::vector<MeshRange> const& mesh_ranges) const noexcept;
+
+        bool AlphaTest(HostGeometry const& geometry, uint32_t primitive_id, DirectX::XMFLOAT2 const& barycentrics) const;
+
+        // Copies the acceleration structures to where placement_ wants them
+        void PlaceAccelerationStructures(ThreadPool const& thread_pool);
+        // The replica of the node of the calling thread
+        HostRaytracingAccelerationStructureManager const& AccelerationStructure() const noexcept
+        {
+            uint32_t const node = ThreadPool::CurrentNode();
+            return ((node == 0) || (node > replicas_.size())) ? acceleration_structure_ : replicas_[node - 1];
+        }
+
+    private:
+        std::vector<HostGeometry> geometries_;
+        std::vector<MeshRange> mesh_ranges_;
+        HostBvhBuildMode build_mode_ = HostBvhBuildMode::PreferFastTrace;
+        std::vector<HostInstance> instances_;
+        std::vector<HostMaterial> materials_;
+        std::array<std::shared_ptr<HostTexture const>, std::to_underlying(PbrMaterial::TextureSlot::Num)> default_textures_;
+        // Acquiring a texture updates the cache, shading only sees the scene as const
+        mutable HostTextureCache texture_cache_;
+
+        HostRaytracingAccelerationStructureManager acceleration_structure_;
+        HostScenePlacement placement_ = HostScenePlacement::Interleaved;
+        // With Replicated on several nodes, the copies for the nodes after the first. acceleration_structure_ is the one of node 0,
+        // and the one that gets updated.
+        std::vector<HostRaytracingAccelerationStructureManager> replicas_;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <algorithm>
+#include <cmath>
+
+// Host versions of the shading functions in RayTracing.hlsl. Keep them in sync. The BRDF of the light loop is in
+// HostLightShading.cpp.
+
+namespace GoldenSun
+{
+    inline float Dot3(DirectX::XMVECTOR lhs, DirectX::XMVECTOR rhs) noexcept
+    {
+        return DirectX::XMVectorGetX(DirectX::XMVector3Dot(lhs, rhs));
+    }
+
+    inline DirectX::XMVECTOR DiffuseColor(DirectX::XMVECTOR albedo, float metallic) noexcept
+    {
+        return albedo * (1 - metallic);
+    }
+
+    inline DirectX::XMVECTOR SpecularColor(DirectX::XMVECTOR albedo, float metallic) noexcept
+    {
+        return DirectX::XMVectorLerp(DirectX::XMVectorReplicate(0.04f), albedo, metallic);
+    }
+
+    inline DirectX::XMVECTOR TransformQuat(DirectX::XMVECTOR v, DirectX::XMVECTOR quat) noexcept
+    {
+        DirectX::XMVECTOR const w = DirectX::XMVectorSplatW(quat);
+        return v + DirectX::XMVector3Cross(quat, DirectX::XMVector3Cross(quat, v) + w * v) * 2;
+    }
+
+    inline float LinearToSrgb(float color) noexcept
+    {
+        float constexpr Alpha = 0.055f;
+        return (color < 0.0031308f) ? color * 12.92f : ((1 + Alpha) * std::pow(color, 1 / 2.4f) - Alpha);
+    }
+} // namespace GoldenSun
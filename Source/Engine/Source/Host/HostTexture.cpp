@@ -0,0 +1,225 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/ErrorHandling.hpp>
+#include <GoldenSun/Util.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "HostTexture.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+    std::array<float, 256> const& SrgbToLinearTable()
+    {
+        static std::array<float, 256> const table = [] {
+            std::array<float, 256> ret;
+            for (uint32_t i = 0; i < ret.size(); ++i)
+            {
+                float const c = i / 255.0f;
+                ret[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return ret;
+        }();
+        return table;
+    }
+
+    // Interleaves the bits of the 2-bit coordinates within a tile
+    uint32_t MortonCode4x4(uint32_t x, uint32_t y) noexcept
+    {
+        return (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2);
+    }
+    static_assert(GoldenSun::HostTexture::TileDim == 4);
+
+    uint8_t LinearToSrgb8(float value) noexcept
+    {
+        float const srgb = (value < 0.0031308f) ? value * 12.92f : (1.055f * std::pow(value, 1 / 2.4f) - 0.055f);
+        return static_cast<uint8_t>(std::clamp(srgb, 0.0f, 1.0f) * 255 + 0.5f);
+    }
+
+    // 2x2 box filter of a level into the next. sRGB color channels are averaged in linear space. An odd last row or column is
+    // folded into its neighbor, the same texel counted twice.
+    void DownsampleMip(uint32_t const* src, uint32_t src_width, uint32_t src_height, uint32_t* dst, uint32_t dst_width,
+        uint32_t dst_height, bool srgb) noexcept
+    {
+        auto const& table = SrgbToLinearTable();
+        for (uint32_t y = 0; y < dst_height; ++y)
+        {
+            uint32_t const src_ys[] = {std::min(y * 2, src_height - 1), std::min(y * 2 + 1, src_height - 1)};
+            for (uint32_t x = 0; x < dst_width; ++x)
+            {
+                uint32_t const src_xs[] = {std::min(x * 2, src_width - 1), std::min(x * 2 + 1, src_width - 1)};
+
+                float sums[4]{};
+                for (uint32_t const src_y : src_ys)
+                {
+                    for (uint32_t const src_x : src_xs)
+                    {
+                        uint32_t const texel = src[src_y * src_width + src_x];
+                        for (uint32_t i = 0; i < 4; ++i)
+                        {
+                            uint32_t const channel = (texel >> (i * 8)) & 0xFF;
+                            sums[i] += (srgb && (i < 3)) ? table[channel] : channel / 255.0f;
+                        }
+                    }
+                }
+
+                uint32_t texel = 0;
+                for (uint32_t i = 0; i < 4; ++i)
+                {
+                    float const average = sums[i] / 4;
+                    uint32_t const channel =
+                        (srgb && (i < 3)) ? LinearToSrgb8(average) : static_cast<uint32_t>(std::clamp(average, 0.0f, 1.0f) * 255 + 0.5f);
+                    texel |= channel << (i * 8);
+                }
+                dst[y * dst_width + x] = texel;
+            }
+        }
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    HostTexture::HostTexture(uint32_t width, uint32_t height, DXGI_FORMAT format, void const* data, Layout layout)
+        : width_(width), height_(height), format_(format), layout_(layout)
+    {
+        DXGI_FORMAT const linear_format = LinearFormatOf(format);
+        Verify((linear_format == DXGI_FORMAT_R8G8B8A8_UNORM) || (linear_format == DXGI_FORMAT_B8G8R8A8_UNORM));
+        Verify((width > 0) && (height > 0) && (data != nullptr));
+
+        bgra_ = (linear_format == DXGI_FORMAT_B8G8R8A8_UNORM);
+        srgb_ = IsSrgbFormat(format);
+
+        uint32_t const num_mips = static_cast<uint32_t>(std::log2(std::max(width, height))) + 1;
+        size_t num_texels = 0;
+        for (uint32_t mip = 0; mip < num_mips; ++mip)
+        {
+            mip_offsets_.push_back(num_texels);
+            uint32_t mip_width = this->Width(mip);
+            uint32_t mip_height = this->Height(mip);
+            if (layout_ == Layout::Tiled)
+            {
+                mip_width = (mip_width + TileDim - 1) / TileDim * TileDim;
+                mip_height = (mip_height + TileDim - 1) / TileDim * TileDim;
+            }
+            num_texels += static_cast<size_t>(mip_width) * mip_height;
+        }
+        texels_.resize(num_texels);
+
+        // Mips are filtered row-major, then scattered to the layout
+        std::vector<uint32_t> level(static_cast<size_t>(width) * height);
+        std::memcpy(level.data(), data, level.size() * sizeof(level[0]));
+        std::vector<uint32_t> next_level;
+        for (uint32_t mip = 0; mip < num_mips; ++mip)
+        {
+            uint32_t const mip_width = this->Width(mip);
+            uint32_t const mip_height = this->Height(mip);
+            for (uint32_t y = 0; y < mip_height; ++y)
+            {
+                for (uint32_t x = 0; x < mip_width; ++x)
+                {
+                    texels_[this->TexelIndex(x, y, mip)] = level[y * mip_width + x];
+                }
+            }
+
+            if (mip + 1 < num_mips)
+            {
+                next_level.resize(static_cast<size_t>(this->Width(mip + 1)) * this->Height(mip + 1));
+                DownsampleMip(level.data(), mip_width, mip_height, next_level.data(), this->Width(mip + 1), this->Height(mip + 1), srgb_);
+                level.swap(next_level);
+            }
+        }
+    }
+
+    XMVECTOR HostTexture::Load(uint32_t x, uint32_t y) const noexcept
+    {
+        return this->Load(x, y, 0);
+    }
+
+    XMVECTOR HostTexture::Load(uint32_t x, uint32_t y, uint32_t mip) const noexcept
+    {
+        return this->Decode(texels_[this->TexelIndex(x, y, mip)]);
+    }
+
+    size_t HostTexture::TexelIndex(uint32_t x, uint32_t y, uint32_t mip) const noexcept
+    {
+        if (layout_ == Layout::RowMajor)
+        {
+            return mip_offsets_[mip] + static_cast<size_t>(y) * this->Width(mip) + x;
+        }
+
+        uint32_t const tiles_x = (this->Width(mip) + TileDim - 1) / TileDim;
+        size_t const tile = static_cast<size_t>(y / TileDim) * tiles_x + x / TileDim;
+        return mip_offsets_[mip] + tile * (TileDim * TileDim) + MortonCode4x4(x % TileDim, y % TileDim);
+    }
+
+    XMVECTOR HostTexture::Decode(uint32_t texel) const noexcept
+    {
+        uint32_t channels[4];
+        for (uint32_t i = 0; i < 4; ++i)
+        {
+            channels[i] = (texel >> (i * 8)) & 0xFF;
+        }
+        if (bgra_)
+        {
+            std::swap(channels[0], channels[2]);
+        }
+
+        float rgba[4];
+        auto const& table = SrgbToLinearTable();
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            rgba[i] = srgb_ ? table[channels[i]] : channels[i] / 255.0f;
+        }
+        rgba[3] = channels[3] / 255.0f;
+
+        return XMVectorSet(rgba[0], rgba[1], rgba[2], rgba[3]);
+    }
+
+    XMVECTOR HostTexture::Sample(XMFLOAT2 const& tex_coord) const noexcept
+    {
+        float const u = tex_coord.x - std::floor(tex_coord.x);
+        float const v = tex_coord.y - std::floor(tex_coord.y);
+        uint32_t const x = std::min(static_cast<uint32_t>(u * width_), width_ - 1);
+        uint32_t const y = std::min(static_cast<uint32_t>(v * height_), height_ - 1);
+        return this->Load(x, y);
+    }
+
+    XMVECTOR HostTexture::SampleLevel(XMFLOAT2 const& tex_coord, float lod) const noexcept
+    {
+        if (!(lod > 0))
+        {
+            return this->Sample(tex_coord);
+        }
+
+        uint32_t const mip = std::min(static_cast<uint32_t>(lod + 0.5f), this->MipLevels() - 1);
+        uint32_t const width = this->Width(mip);
+        uint32_t const height = this->Height(mip);
+
+        // Texel centers are at half coordinates, and both neighbors wrap around
+        float const u = (tex_coord.x - std::floor(tex_coord.x)) * width - 0.5f;
+        float const v = (tex_coord.y - std::floor(tex_coord.y)) * height - 0.5f;
+        float const floor_u = std::floor(u);
+        float const floor_v = std::floor(v);
+        float const frac_u = u - floor_u;
+        float const frac_v = v - floor_v;
+        uint32_t const x0 = static_cast<uint32_t>(static_cast<int32_t>(floor_u) + static_cast<int32_t>(width)) % width;
+        uint32_t const y0 = static_cast<uint32_t>(static_cast<int32_t>(floor_v) + static_cast<int32_t>(height)) % height;
+        uint32_t const x1 = (x0 + 1) % width;
+        uint32_t const y1 = (y0 + 1) % height;
+
+        // All 4 texels are read before any is decoded, so the loads, often from one cache line, overlap
+        uint32_t const texel00 = texels_[this->TexelIndex(x0, y0, mip)];
+        uint32_t const texel10 = texels_[this->TexelIndex(x1, y0, mip)];
+        uint32_t const texel01 = texels_[this->TexelIndex(x0, y1, mip)];
+        uint32_t const texel11 = texels_[this->TexelIndex(x1, y1, mip)];
+
+        XMVECTOR const top = XMVectorLerp(this->Decode(texel00), this->Decode(texel10), frac_u);
+        XMVECTOR const bottom = XMVectorLerp(this->Decode(texel01), this->Decode(texel11), frac_u);
+        return XMVectorLerp(top, bottom, frac_v);
+    }
+} // namespace GoldenSun
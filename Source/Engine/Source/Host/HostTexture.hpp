@@ -0,0 +1,98 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <GoldenSun/Format.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "HostPlacement.hpp"
+
+namespace GoldenSun
+{
+    // CPU copy of a 8-bit RGBA texture, with a full mip chain box filtered from the top level. Texels are decoded to linear float4 on
+    // fetch.
+    //
+    // Mips are row-major by default. Layout::Tiled stores them as 4x4 tiles of 64 bytes, a cache line, with the texels of a tile in
+    // Morton order, so the 2x2 texels of a bilinear fetch are mostly in one line. It measured slower than row-major on the frames of
+    // TextureSceneBenchmark, so it isn't the default.
+    class HostTexture final
+    {
+        DISALLOW_COPY_AND_ASSIGN(HostTexture)
+
+    public:
+        // RowMajor is the layout of the source data
+        enum class Layout
+        {
+            RowMajor,
+            Tiled,
+        };
+
+        static constexpr uint32_t TileDim = 4;
+
+    public:
+        // data is row-major
+        HostTexture(uint32_t width, uint32_t height, DXGI_FORMAT format, void const* data, Layout layout = Layout::RowMajor);
+
+        uint32_t Width() const noexcept
+        {
+            return width_;
+        }
+
+        uint32_t Height() const noexcept
+        {
+            return height_;
+        }
+
+        DXGI_FORMAT Format() const noexcept
+        {
+            return format_;
+        }
+
+        // Of all mips
+        size_t ByteSize() const noexcept
+        {
+            return texels_.size() * sizeof(texels_[0]);
+        }
+
+        uint32_t MipLevels() const noexcept
+        {
+            return static_cast<uint32_t>(mip_offsets_.size());
+        }
+
+        uint32_t Width(uint32_t mip) const noexcept
+        {
+            return std::max(width_ >> mip, 1U);
+        }
+
+        uint32_t Height(uint32_t mip) const noexcept
+        {
+            return std::max(height_ >> mip, 1U);
+        }
+
+        DirectX::XMVECTOR Load(uint32_t x, uint32_t y) const noexcept;
+        DirectX::XMVECTOR Load(uint32_t x, uint32_t y, uint32_t mip) const noexcept;
+
+        // Matches SampleLevel(linear_wrap_sampler, tex_coord, 0) in the shader, which only hits the point mag filter
+        DirectX::XMVECTOR Sample(DirectX::XMFLOAT2 const& tex_coord) const noexcept;
+        // Matches SampleLevel(linear_wrap_sampler, tex_coord, lod). Above 0, the min filter takes the nearest mip, filtered bilinearly.
+        DirectX::XMVECTOR SampleLevel(DirectX::XMFLOAT2 const& tex_coord, float lod) const noexcept;
+
+    private:
+        size_t TexelIndex(uint32_t x, uint32_t y, uint32_t mip) const noexcept;
+        DirectX::XMVECTOR Decode(uint32_t texel) const noexcept;
+
+    private:
+        uint32_t width_;
+        uint32_t height_;
+        DXGI_FORMAT format_;
+        bool bgra_;
+        bool srgb_;
+        Layout layout_;
+        // Every mip, one after another. Tiled mips are padded to whole tiles.
+        HostVector<uint32_t> texels_;
+        std::vector<size_t> mip_offsets_;
+    };
+} // namespace GoldenSun
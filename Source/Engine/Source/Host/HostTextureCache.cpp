@@ -0,0 +1,163 @@
+#include "../pch.hpp"
+
+#include <GoldenSun/Util.hpp>
+
+#include "HostTextureCache.hpp"
+
+namespace GoldenSun
+{
+    HostTextureCache::HostTextureCache() = default;
+
+    uint32_t HostTextureCache::Add(std::shared_ptr<TextureSource> const& source)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto const [iter, inserted] = ids_.try_emplace(source.get(), static_cast<uint32_t>(entries_.size()));
+        if (inserted)
+        {
+            entries_.emplace_back().source = source;
+        }
+        return iter->second;
+    }
+
+    void HostTextureCache::Budget(uint64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        budget_ = bytes;
+        this->Evict(InvalidId);
+    }
+
+    void HostTextureCache::Placement(HostPlacement placement)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        placement_ = std::move(placement);
+    }
+
+    std::shared_ptr<HostTexture const> HostTextureCache::Acquire(uint32_t id)
+    {
+        auto& entry = entries_[id];
+        if (auto texture = std::atomic_load_explicit(&entry.texture, std::memory_order_acquire))
+        {
+            this->Touch(entry);
+            return texture;
+        }
+        if (entry.failed.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        loaded_.wait(lock, [&entry] { return !entry.loading; });
+
+        // Read by another thread while this one waited for the lock
+        if (entry.texture)
+        {
+            this->Touch(entry);
+            return entry.texture;
+        }
+        if (entry.failed.load(std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+
+        // Other textures can be hit or read while this one is being read
+        ++misses_;
+        uint64_t const epoch = use_epoch_.load(std::memory_order_relaxed) + 1;
+        use_epoch_.store(epoch, std::memory_order_relaxed);
+        entry.loading = true;
+        HostPlacement const placement = placement_;
+        lock.unlock();
+
+        std::shared_ptr<HostTexture const> texture;
+        auto& source = *entry.source;
+        uint32_t const width = source.Width();
+        uint32_t const height = source.Height();
+        if ((width > 0) && (height > 0))
+        {
+            std::vector<uint8_t> texels(static_cast<size_t>(width) * height * FormatSize(source.Format()));
+            if (source.Read(texels.data()))
+            {
+                HostPlacementScope scope(placement);
+                texture = std::make_shared<HostTexture const>(width, height, source.Format(), texels.data());
+            }
+        }
+
+        lock.lock();
+        entry.loading = false;
+        if (texture)
+        {
+            entry.last_use.store(epoch, std::memory_order_relaxed);
+            std::atomic_store_explicit(&entry.texture, texture, std::memory_order_release);
+            resident_.push_back(id);
+            resident_bytes_ += texture->ByteSize();
+            this->Evict(id);
+        }
+        else
+        {
+            entry.failed.store(true, std::memory_order_release);
+        }
+        loaded_.notify_all();
+
+        return texture;
+    }
+
+    uint64_t HostTextureCache::Hits() const noexcept
+    {
+        return hits_.load(std::memory_order_relaxed);
+    }
+
+    uint64_t HostTextureCache::Misses() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return misses_;
+    }
+
+    uint64_t HostTextureCache::ResidentBytes() const noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return resident_bytes_;
+    }
+
+    void HostTextureCache::Touch(Entry& entry) noexcept
+    {
+        // Only written once per epoch, so the hits of a texture between two misses don't fight over its line
+        uint64_t const epoch = use_epoch_.load(std::memory_order_relaxed);
+        if (entry.last_use.load(std::memory_order_relaxed) != epoch)
+        {
+            entry.last_use.store(epoch, std::memory_order_relaxed);
+        }
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Called with the lock held
+    void HostTextureCache::Evict(uint32_t keep_id)
+    {
+        while ((budget_ > 0) && (resident_bytes_ > budget_))
+        {
+            auto victim = resident_.end();
+            uint64_t victim_use = ~0ULL;
+            for (auto iter = resident_.begin(); iter != resident_.end(); ++iter)
+            {
+                uint64_t const last_use = entries_[*iter].last_use.load(std::memory_order_relaxed);
+                if ((*iter != keep_id) && (last_use < victim_use))
+                {
+                    victim = iter;
+                    victim_use = last_use;
+                }
+            }
+            if (victim == resident_.end())
+            {
+                break;
+            }
+
+            auto& entry = entries_[*victim];
+            resident_bytes_ -= entry.texture->ByteSize();
+            std::atomic_store_explicit(&entry.texture, std::shared_ptr<HostTexture const>(), std::memory_order_release);
+            *victim = resident_.back();
+            resident_.pop_back();
+        }
+    }
+} // namespace GoldenSun
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GoldenSun/Material.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "HostPlacement.hpp"
+#include "HostTexture.hpp"
+
+namespace GoldenSun
+{
+    // Textures read on demand from their sources, and kept under a budget of bytes by dropping the least recently used ones. The
+    // unit is a whole texture with its mip chain. Image files such as JPEG and PNG can only be decoded whole, so a finer tile would
+    // still decode the file on every miss.
+    //
+    // Hits of resident textures don't lock. They stamp the texture with the epoch of the last miss, and eviction drops the texture
+    // with the oldest stamp, so the order is only kept between misses.
+    class HostTextureCache final
+    {
+        DISALLOW_COPY_AND_ASSIGN(HostTextureCache)
+
+    public:
+        static constexpr uint32_t InvalidId = ~0U;
+
+    public:
+        HostTextureCache();
+
+        // The id of a source, the same one every time the same source is added. Not thread safe with Acquire.
+        uint32_t Add(std::shared_ptr<TextureSource> const& source);
+
+        // 0 is unlimited. The texture being acquired is always kept, even if it alone is over the budget.
+        void Budget(uint64_t bytes);
+        // Of the textures read from now on
+        void Placement(HostPlacement placement);
+
+        // Reads the texture on a miss. The returned pointer keeps it alive after it is evicted. nullptr if the source can't be read.
+        std::shared_ptr<HostTexture const> Acquire(uint32_t id);
+
+        uint64_t Hits() const noexcept;
+        uint64_t Misses() const noexcept;
+        uint64_t ResidentBytes() const noexcept;
+
+    private:
+        struct Entry
+        {
+            std::shared_ptr<TextureSource> source;
+            // Loaded and stored atomically, the hits read it without the lock. Only written with the lock held.
+            std::shared_ptr<HostTexture const> texture;
+            std::atomic<bool> failed{false};
+            std::atomic<uint64_t> last_use{0};
+            bool loading = false;
+        };
+
+    private:
+        void Touch(Entry& entry) noexcept;
+        void Evict(uint32_t keep_id);
+
+    private:
+        mutable std::mutex mutex_;
+        std::condition_variable loaded_;
+
+        // A deque, so Add doesn't move the entries a miss holds on to with the lock released
+        std::deque<Entry> entries_;
+        std::unordered_map<TextureSource const*, uint32_t> ids_;
+        // Ids of the resident textures
+        std::vector<uint32_t> resident_;
+        // Advanced by every miss
+        std::atomic<uint64_t> use_epoch_{0};
+
+        HostPlacement placement_;
+        uint64_t budget_ = 0;
+        uint64_t resident_bytes_ = 0;
+        std::atomic<uint64_t> hits_{0};
+        uint64_t misses_ = 0;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,124 @@
+#include "../pch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "HostCpu.hpp"
+#include "HostTriangleIntersection.hpp"
+
+namespace GoldenSun
+{
+    HostWatertightRay::HostWatertightRay(HostRay const& ray) noexcept
+    {
+        float const dir[] = {ray.direction.x, ray.direction.y, ray.direction.z};
+
+        uint32_t kz = 0;
+        if (std::abs(dir[1]) > std::abs(dir[kz]))
+        {
+            kz = 1;
+        }
+        if (std::abs(dir[2]) > std::abs(dir[kz]))
+        {
+            kz = 2;
+        }
+        uint32_t kx = (kz + 1) % 3;
+        uint32_t ky = (kx + 1) % 3;
+        // Keeps the winding of the triangles in the sheared space
+        if (dir[kz] < 0)
+        {
+            std::swap(kx, ky);
+        }
+
+        origin[0] = ray.origin.x;
+        origin[1] = ray.origin.y;
+        origin[2] = ray.origin.z;
+        t_min = ray.t_min;
+        shear[0] = dir[kx] / dir[kz];
+        shear[1] = dir[ky] / dir[kz];
+        shear[2] = 1.0f / dir[kz];
+        axes[0] = kx;
+        axes[1] = ky;
+        axes[2] = kz;
+    }
+
+    // The same operations in the same order as IntersectTrianglesSse4, lane by lane
+    uint32_t IntersectTrianglesScalar(HostTriangle4 const& triangles, HostWatertightRay const& ray, float t_max, bool cull_back_facing,
+        HostTriangleHits4& hits) noexcept
+    {
+        uint32_t const kx = ray.axes[0];
+        uint32_t const ky = ray.axes[1];
+        uint32_t const kz = ray.axes[2];
+
+        uint32_t hit_mask = 0;
+        for (uint32_t lane = 0; lane < HostTriangle4::Width; ++lane)
+        {
+            float const a_x = triangles.v0[kx][lane] - ray.origin[kx];
+            float const a_y = triangles.v0[ky][lane] - ray.origin[ky];
+            float const a_z = triangles.v0[kz][lane] - ray.origin[kz];
+            float const b_x = triangles.v1[kx][lane] - ray.origin[kx];
+            float const b_y = triangles.v1[ky][lane] - ray.origin[ky];
+            float const b_z = triangles.v1[kz][lane] - ray.origin[kz];
+            float const c_x = triangles.v2[kx][lane] - ray.origin[kx];
+            float const c_y = triangles.v2[ky][lane] - ray.origin[ky];
+            float const c_z = triangles.v2[kz][lane] - ray.origin[kz];
+
+            float const sheared_a_x = a_x - ray.shear[0] * a_z;
+            float const sheared_a_y = a_y - ray.shear[1] * a_z;
+            float const sheared_b_x = b_x - ray.shear[0] * b_z;
+            float const sheared_b_y = b_y - ray.shear[1] * b_z;
+            float const sheared_c_x = c_x - ray.shear[0] * c_z;
+            float const sheared_c_y = c_y - ray.shear[1] * c_z;
+
+            // Scaled barycentrics, the signed areas spanned with the edges facing v0, v1 and v2
+            float const u = sheared_c_x * sheared_b_y - sheared_c_y * sheared_b_x;
+            float const v = sheared_a_x * sheared_c_y - sheared_a_y * sheared_c_x;
+            float const w = sheared_b_x * sheared_a_y - sheared_b_y * sheared_a_x;
+
+            bool const any_negative = (u < 0) || (v < 0) || (w < 0);
+            bool const any_positive = (u > 0) || (v > 0) || (w > 0);
+            if (cull_back_facing ? any_negative : (any_negative && any_positive))
+            {
+                continue;
+            }
+
+            float const det = u + v + w;
+            if (det == 0)
+            {
+                continue;
+            }
+
+            float const inv_det = 1 / det;
+            float const t = (u * (ray.shear[2] * a_z) + v * (ray.shear[2] * b_z) + w * (ray.shear[2] * c_z)) * inv_det;
+            if ((t < ray.t_min) || (t >= t_max))
+            {
+                continue;
+            }
+
+            hits.t[lane] = t;
+            hits.u[lane] = v * inv_det;
+            hits.v[lane] = w * inv_det;
+            hit_mask |= 1U << lane;
+        }
+        return hit_mask;
+    }
+
+    HostIntersectTrianglesFunc SelectIntersectTrianglesFunc() noexcept
+    {
+        static HostIntersectTrianglesFunc const func = SupportsSse4() ? &IntersectTrianglesSse4 : &IntersectTrianglesScalar;
+        return func;
+    }
+
+    void SetTriangle(HostTriangle4& triangles, uint32_t lane, DirectX::XMFLOAT3 const& v0, DirectX::XMFLOAT3 const& v1,
+        DirectX::XMFLOAT3 const& v2) noexcept
+    {
+        float const* const vertices[] = {&v0.x, &v1.x, &v2.x};
+        float(*const dst[])[HostTriangle4::Width] = {triangles.v0, triangles.v1, triangles.v2};
+        for (uint32_t i = 0; i < 3; ++i)
+        {
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                dst[i][axis][lane] = vertices[i][axis];
+            }
+        }
+    }
+} // namespace GoldenSun
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <cstdint>
+
+#include "HostBvh.hpp"
+
+namespace GoldenSun
+{
+    // The triangles of one BVH leaf in SoA form, v0[axis][lane], so the SIMD tests load every coordinate straight into a register.
+    // The vertices are kept as they are, not as edges from v0. Two triangles sharing an edge then compute it from the same floats,
+    // which is what keeps the test watertight. Unused lanes are all zeros, a degenerate triangle that is never hit.
+    struct alignas(16) HostTriangle4
+    {
+        static uint32_t constexpr Width = 4;
+
+        float v0[3][Width];
+        float v1[3][Width];
+        float v2[3][Width];
+    };
+    static_assert(sizeof(HostTriangle4) == 144);
+
+    // Ray data of the watertight test (Woop, Benthin and Wald 2013). The ray is sheared to point along +z, with z being the largest
+    // axis of its direction, and the triangles are tested in 2D after the same shear. Set up once per ray, not per triangle.
+    struct HostWatertightRay
+    {
+        float origin[3];
+        float t_min;
+        float shear[3];
+        uint32_t axes[3];
+
+        HostWatertightRay() noexcept = default;
+        explicit HostWatertightRay(HostRay const& ray) noexcept;
+    };
+
+    struct HostTriangleHits4
+    {
+        float t[HostTriangle4::Width];
+        // Weights of v1 and v2, like BuiltInTriangleIntersectionAttributes
+        float u[HostTriangle4::Width];
+        float v[HostTriangle4::Width];
+    };
+
+    // Tests the ray against the 4 triangles, in [t_min, t_max). Front faces are clockwise seen from the ray origin, the D3D12 default,
+    // and only they are hit when cull_back_facing is set. Returns a bit mask of the hit lanes, with their distances and barycentrics in
+    // hits. Rays through an edge or a vertex shared by several triangles hit at least one of them.
+    using HostIntersectTrianglesFunc = uint32_t (*)(
+        HostTriangle4 const& triangles, HostWatertightRay const& ray, float t_max, bool cull_back_facing, HostTriangleHits4& hits);
+
+    uint32_t IntersectTrianglesScalar(HostTriangle4 const& triangles, HostWatertightRay const& ray, float t_max, bool cull_back_facing,
+        HostTriangleHits4& hits) noexcept;
+    uint32_t IntersectTrianglesSse4(HostTriangle4 const& triangles, HostWatertightRay const& ray, float t_max, bool cull_back_facing,
+        HostTriangleHits4& hits) noexcept;
+
+    // Chosen once from the ISA of the CPU. SSE4.1, or plain C++. Both give the same results bit for bit.
+    HostIntersectTrianglesFunc SelectIntersectTrianglesFunc() noexcept;
+
+    // Stores one triangle into a lane
+    void SetTriangle(HostTriangle4& triangles, uint32_t lane, DirectX::XMFLOAT3 const& v0, DirectX::XMFLOAT3 const& v1,
+        DirectX::XMFLOAT3 const& v2) noexcept;
+} // namespace GoldenSun
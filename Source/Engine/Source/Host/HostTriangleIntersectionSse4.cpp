@@ -0,0 +1,64 @@
+#include "../pch.hpp"
+
+#include <smmintrin.h>
+
+#include "HostTriangleIntersection.hpp"
+
+namespace GoldenSun
+{
+    // One ray against all 4 lanes. Only called when the CPU supports SSE4.1.
+    uint32_t IntersectTrianglesSse4(HostTriangle4 const& triangles, HostWatertightRay const& ray, float t_max, bool cull_back_facing,
+        HostTriangleHits4& hits) noexcept
+    {
+        uint32_t const kx = ray.axes[0];
+        uint32_t const ky = ray.axes[1];
+        uint32_t const kz = ray.axes[2];
+
+        __m128 const origin_x = _mm_set1_ps(ray.origin[kx]);
+        __m128 const origin_y = _mm_set1_ps(ray.origin[ky]);
+        __m128 const origin_z = _mm_set1_ps(ray.origin[kz]);
+        __m128 const shear_x = _mm_set1_ps(ray.shear[0]);
+        __m128 const shear_y = _mm_set1_ps(ray.shear[1]);
+        __m128 const shear_z = _mm_set1_ps(ray.shear[2]);
+
+        __m128 const a_x = _mm_sub_ps(_mm_load_ps(triangles.v0[kx]), origin_x);
+        __m128 const a_y = _mm_sub_ps(_mm_load_ps(triangles.v0[ky]), origin_y);
+        __m128 const a_z = _mm_sub_ps(_mm_load_ps(triangles.v0[kz]), origin_z);
+        __m128 const b_x = _mm_sub_ps(_mm_load_ps(triangles.v1[kx]), origin_x);
+        __m128 const b_y = _mm_sub_ps(_mm_load_ps(triangles.v1[ky]), origin_y);
+        __m128 const b_z = _mm_sub_ps(_mm_load_ps(triangles.v1[kz]), origin_z);
+        __m128 const c_x = _mm_sub_ps(_mm_load_ps(triangles.v2[kx]), origin_x);
+        __m128 const c_y = _mm_sub_ps(_mm_load_ps(triangles.v2[ky]), origin_y);
+        __m128 const c_z = _mm_sub_ps(_mm_load_ps(triangles.v2[kz]), origin_z);
+
+        __m128 const sheared_a_x = _mm_sub_ps(a_x, _mm_mul_ps(shear_x, a_z));
+        __m128 const sheared_a_y = _mm_sub_ps(a_y, _mm_mul_ps(shear_y, a_z));
+        __m128 const sheared_b_x = _mm_sub_ps(b_x, _mm_mul_ps(shear_x, b_z));
+        __m128 const sheared_b_y = _mm_sub_ps(b_y, _mm_mul_ps(shear_y, b_z));
+        __m128 const sheared_c_x = _mm_sub_ps(c_x, _mm_mul_ps(shear_x, c_z));
+        __m128 const sheared_c_y = _mm_sub_ps(c_y, _mm_mul_ps(shear_y, c_z));
+
+        __m128 const u = _mm_sub_ps(_mm_mul_ps(sheared_c_x, sheared_b_y), _mm_mul_ps(sheared_c_y, sheared_b_x));
+        __m128 const v = _mm_sub_ps(_mm_mul_ps(sheared_a_x, sheared_c_y), _mm_mul_ps(sheared_a_y, sheared_c_x));
+        __m128 const w = _mm_sub_ps(_mm_mul_ps(sheared_b_x, sheared_a_y), _mm_mul_ps(sheared_b_y, sheared_a_x));
+
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const any_negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+        __m128 const any_positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+        __m128 const outside = cull_back_facing ? any_negative : _mm_and_ps(any_negative, any_positive);
+
+        __m128 const det = _mm_add_ps(_mm_add_ps(u, v), w);
+        __m128 const inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+        __m128 const t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(shear_z, a_z)), _mm_mul_ps(v, _mm_mul_ps(shear_z, b_z))),
+                                        _mm_mul_ps(w, _mm_mul_ps(shear_z, c_z))),
+            inv_det);
+
+        __m128 const in_range = _mm_and_ps(_mm_cmpge_ps(t, _mm_set1_ps(ray.t_min)), _mm_cmplt_ps(t, _mm_set1_ps(t_max)));
+        __m128 const hit = _mm_andnot_ps(outside, _mm_and_ps(_mm_cmpneq_ps(det, zero), in_range));
+
+        _mm_storeu_ps(hits.t, t);
+        _mm_storeu_ps(hits.u, _mm_mul_ps(v, inv_det));
+        _mm_storeu_ps(hits.v, _mm_mul_ps(w, inv_det));
+        return static_cast<uint32_t>(_mm_movemask_ps(hit));
+    }
+} // namespace GoldenSun
@@ -0,0 +1,105 @@
+#include "../pch.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include "HostWavefront.hpp"
+
+using namespace DirectX;
+
+namespace
+{
+    uint32_t constexpr DirectionBits = 3;
+    uint32_t constexpr OriginBits = 7;
+
+    uint32_t constexpr RadixBits = 8;
+    uint32_t constexpr NumBuckets = 1U << RadixBits;
+
+    // Inserts 2 zero bits after each of the lowest 10 bits
+    uint32_t SpreadBits(uint32_t value) noexcept
+    {
+        uint32_t x = value & 0x3FFU;
+        x = (x | (x << 16)) & 0x030000FFU;
+        x = (x | (x << 8)) & 0x0300F00FU;
+        x = (x | (x << 4)) & 0x030C30C3U;
+        x = (x | (x << 2)) & 0x09249249U;
+        return x;
+    }
+
+    // Also maps NaN to 0
+    uint32_t Quantize(float value, float min_value, float scale, uint32_t max_cell) noexcept
+    {
+        float const f = (value - min_value) * scale;
+        return (f > 0) ? std::min(static_cast<uint32_t>(f), max_cell) : 0;
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    uint32_t RaySortKey(XMFLOAT3 const& origin, XMFLOAT3 const& direction, HostAabb const& bounds) noexcept
+    {
+        uint32_t constexpr MaxDirectionCell = (1U << DirectionBits) - 1;
+        uint32_t constexpr MaxOriginCell = (1U << OriginBits) - 1;
+
+        uint32_t direction_code = 0;
+        uint32_t origin_code = 0;
+        for (uint32_t axis = 0; axis < 3; ++axis)
+        {
+            float const dir = (&direction.x)[axis];
+            direction_code |= SpreadBits(Quantize(dir, -1, (MaxDirectionCell + 1) / 2.0f, MaxDirectionCell)) << (2 - axis);
+
+            // An empty or flat scene leaves the axis out
+            float const extent = (&bounds.max.x)[axis] - (&bounds.min.x)[axis];
+            float const scale = (extent > 0) ? (MaxOriginCell + 1) / extent : 0.0f;
+            origin_code |= SpreadBits(Quantize((&origin.x)[axis], (&bounds.min.x)[axis], scale, MaxOriginCell)) << (2 - axis);
+        }
+        return (origin_code << (3 * DirectionBits)) | direction_code;
+    }
+
+    void HostQueueSorter::Sort(std::vector<uint32_t>& paths, std::vector<uint32_t>& keys)
+    {
+        uint32_t const size = static_cast<uint32_t>(paths.size());
+        scratch_paths_.resize(size);
+        scratch_keys_.resize(size);
+
+        uint32_t all_bits = 0;
+        uint32_t any_bits = 0;
+        for (uint32_t const key : keys)
+        {
+            all_bits |= ~key;
+            any_bits |= key;
+        }
+        // Bits that differ between at least two keys
+        uint32_t const varying_bits = all_bits & any_bits;
+
+        for (uint32_t shift = 0; shift < 32; shift += RadixBits)
+        {
+            if (((varying_bits >> shift) & (NumBuckets - 1)) == 0)
+            {
+                continue;
+            }
+
+            std::array<uint32_t, NumBuckets> offsets{};
+            for (uint32_t const key : keys)
+            {
+                ++offsets[(key >> shift) & (NumBuckets - 1)];
+            }
+            uint32_t offset = 0;
+            for (auto& bucket_offset : offsets)
+            {
+                uint32_t const count = bucket_offset;
+                bucket_offset = offset;
+                offset += count;
+            }
+
+            for (uint32_t i = 0; i < size; ++i)
+            {
+                uint32_t const dst = offsets[(keys[i] >> shift) & (NumBuckets - 1)]++;
+                scratch_keys_[dst] = keys[i];
+                scratch_paths_[dst] = paths[i];
+            }
+            keys.swap(scratch_keys_);
+            paths.swap(scratch_paths_);
+        }
+    }
+} // namespace GoldenSun
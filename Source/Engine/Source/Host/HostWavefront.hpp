@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <DirectXMath.h>
+
+#include "HostBvh.hpp"
+#include "HostDenoiser.hpp"
+#include "HostLightShading.hpp"
+#include "HostSampling.hpp"
+#include "HostScene.hpp"
+
+namespace GoldenSun
+{
+    // Paths in flight of the wavefront path tracer, one array per field, indexed by the slot of the path. A stage runs over a queue
+    // of slots and only touches the fields it needs, instead of carrying the whole state of a path through every call.
+    struct HostPathStates
+    {
+        // Of the pixel, y * width + x
+        std::vector<uint32_t> pixels;
+        std::vector<uint32_t> sample_indices;
+        std::vector<HostRandom> randoms;
+
+        // The ray of the next extend, or of the hit being shaded
+        std::vector<DirectX::XMFLOAT3> origins;
+        std::vector<DirectX::XMFLOAT3> directions;
+        // Width and spread angle of the ray cone
+        std::vector<DirectX::XMFLOAT2> cones;
+        std::vector<HostHit> hits;
+
+        std::vector<DirectX::XMFLOAT3> throughputs;
+        std::vector<DirectX::XMFLOAT4> radiances;
+        std::vector<uint32_t> bounces;
+        std::vector<HostDenoiserFeatures> features;
+
+        // The vertex shaded last, added to the radiance once its shadow rays are traced. Its throughput, emission, and the sum of the
+        // unoccluded light samples.
+        std::vector<uint8_t> shaded;
+        std::vector<DirectX::XMFLOAT3> vertex_throughputs;
+        std::vector<DirectX::XMFLOAT3> vertex_emissions;
+        std::vector<DirectX::XMFLOAT3> vertex_direct;
+        // Whether the path bounces after the vertex
+        std::vector<uint8_t> continues;
+
+        void Resize(uint32_t num_paths)
+        {
+            pixels.resize(num_paths);
+            sample_indices.resize(num_paths);
+            randoms.resize(num_paths, HostRandom(0, 0));
+            origins.resize(num_paths);
+            directions.resize(num_paths);
+            cones.resize(num_paths);
+            hits.resize(num_paths);
+            throughputs.resize(num_paths);
+            radiances.resize(num_paths);
+            bounces.resize(num_paths);
+            features.resize(num_paths);
+            shaded.resize(num_paths);
+            vertex_throughputs.resize(num_paths);
+            vertex_emissions.resize(num_paths);
+            vertex_direct.resize(num_paths);
+            continues.resize(num_paths);
+        }
+    };
+
+    // Light samples of the vertices of one shade chunk, 4 to a batch, in the order they were drawn. The BRDF of a whole batch is
+    // evaluated at once, before the shadow rays are queued.
+    struct HostLightSampleQueue
+    {
+        std::vector<HostLightSamples4> batches;
+        std::vector<HostLightResults4> results;
+        // Of each sample
+        std::vector<uint32_t> paths;
+        std::vector<uint32_t> lights;
+
+        uint32_t Size() const noexcept
+        {
+            return static_cast<uint32_t>(paths.size());
+        }
+
+        void Clear() noexcept
+        {
+            batches.clear();
+            paths.clear();
+            lights.clear();
+        }
+
+        // The batch to store the sample in, at lane
+        HostLightSamples4& Push(uint32_t path, uint32_t light, uint32_t& lane)
+        {
+            lane = this->Size() % HostLightSamples4::Width;
+            if (lane == 0)
+            {
+                batches.emplace_back();
+            }
+            paths.push_back(path);
+            lights.push_back(light);
+            return batches.back();
+        }
+
+        void Shade(HostShadeLightsFunc shade_lights)
+        {
+            results.resize(batches.size());
+            for (size_t i = 0; i < batches.size(); ++i)
+            {
+                shade_lights(batches[i], results[i]);
+            }
+        }
+    };
+
+    // Shadow rays of the light samples of the shaded vertices, with what each adds to its path if the light is unoccluded. The rays
+    // of one path are consecutive and in the order of its light samples, so summing them keeps the order of the sums.
+    struct HostShadowQueue
+    {
+        std::vector<uint32_t> paths;
+        std::vector<DirectX::XMFLOAT3> origins;
+        std::vector<DirectX::XMFLOAT3> directions;
+        std::vector<DirectX::XMFLOAT3> contributions;
+        // Lights that don't cast shadows are queued as well, to keep the order, but never traced
+        std::vector<uint8_t> shadowing;
+        std::vector<uint8_t> occluded;
+
+        uint32_t Size() const noexcept
+        {
+            return static_cast<uint32_t>(paths.size());
+        }
+
+        void Clear() noexcept
+        {
+            paths.clear();
+            origins.clear();
+            directions.clear();
+            contributions.clear();
+            shadowing.clear();
+            occluded.clear();
+        }
+
+        void Push(uint32_t path, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, DirectX::FXMVECTOR contribution, bool shadow)
+        {
+            paths.push_back(path);
+            DirectX::XMStoreFloat3(&origins.emplace_back(), origin);
+            DirectX::XMStoreFloat3(&directions.emplace_back(), direction);
+            DirectX::XMStoreFloat3(&contributions.emplace_back(), contribution);
+            shadowing.push_back(shadow);
+            occluded.push_back(false);
+        }
+    };
+
+    // Key of a ray on Morton curves, for sorting a batch of incoherent rays before tracing them. The origin, 128 cells per axis of
+    // bounds, is the major part, so rays starting close together walk the same nodes near the leaves first. The direction, 8 cells
+    // per axis, orders the rays of one cell by where they go. Direction first traced slower in the scenes tried.
+    uint32_t RaySortKey(DirectX::XMFLOAT3 const& origin, DirectX::XMFLOAT3 const& direction, HostAabb const& bounds) noexcept;
+
+    // Stable LSD radix sort of a queue by one key per entry, skipping the digits every key has the same. Serial, a queue is one
+    // wave at most.
+    class HostQueueSorter final
+    {
+    public:
+        // Reorders paths by keys, keys[i] being the key of paths[i]. keys ends up sorted the same way.
+        void Sort(std::vector<uint32_t>& paths, std::vector<uint32_t>& keys);
+
+    private:
+        std::vector<uint32_t> scratch_paths_;
+        std::vector<uint32_t> scratch_keys_;
+    };
+} // namespace GoldenSun
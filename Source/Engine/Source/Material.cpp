@@ -4,7 +4,11 @@
 
 #include <GoldenSun/Util.hpp>
 
+#include <array>
+#include <memory>
+
 #include "EngineInternal.hpp"
+#include "Host/HostTexture.hpp"
 
 using namespace DirectX;
 
@@ -120,6 +124,7 @@ namespace GoldenSun
             return buffer_.occlusion_strength;
         }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
         void Texture(TextureSlot slot, ID3D12Resource* value) noexcept
         {
             textures_[std::to_underlying(slot)] = value;
@@ -129,6 +134,29 @@ namespace GoldenSun
         {
             return textures_[std::to_underlying(slot)].Get();
         }
+#endif
+
+        void Texture(TextureSlot slot, uint32_t width, uint32_t height, DXGI_FORMAT format, void const* data)
+        {
+            host_textures_[std::to_underlying(slot)] = std::make_shared<HostTexture const>(width, height, format, data);
+            texture_sources_[std::to_underlying(slot)].reset();
+        }
+
+        void Texture(TextureSlot slot, TextureSource* source)
+        {
+            host_textures_[std::to_underlying(slot)].reset();
+            texture_sources_[std::to_underlying(slot)].reset(source);
+        }
+
+        std::shared_ptr<HostTexture const> const& HostTextureOf(TextureSlot slot) const noexcept
+        {
+            return host_textures_[std::to_underlying(slot)];
+        }
+
+        std::shared_ptr<TextureSource> const& TextureSourceOf(TextureSlot slot) const noexcept
+        {
+            return texture_sources_[std::to_underlying(slot)];
+        }
 
         PbrMaterialBuffer const& Buffer() const noexcept
         {
@@ -137,7 +165,11 @@ namespace GoldenSun
 
     private:
         PbrMaterialBuffer buffer_{};
+#ifndef GOLDEN_SUN_HOST_ONLY
         std::array<ComPtr<ID3D12Resource>, std::to_underlying(TextureSlot::Num)> textures_;
+#endif
+        std::array<std::shared_ptr<HostTexture const>, std::to_underlying(TextureSlot::Num)> host_textures_;
+        std::array<std::shared_ptr<TextureSource>, std::to_underlying(TextureSlot::Num)> texture_sources_;
     };
 
 
@@ -170,7 +202,11 @@ namespace GoldenSun
     {
         PbrMaterial mtl;
         mtl.impl_->buffer_ = impl_->buffer_;
+#ifndef GOLDEN_SUN_HOST_ONLY
         mtl.impl_->textures_ = impl_->textures_;
+#endif
+        mtl.impl_->host_textures_ = impl_->host_textures_;
+        mtl.impl_->texture_sources_ = impl_->texture_sources_;
         return mtl;
     }
 
@@ -274,6 +310,7 @@ namespace GoldenSun
         return impl_->OcclusionStrength();
     }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     void PbrMaterial::Texture(TextureSlot slot, ID3D12Resource* value) noexcept
     {
         impl_->Texture(slot, value);
@@ -283,10 +320,33 @@ namespace GoldenSun
     {
         return impl_->Texture(slot);
     }
+#endif
+
+    void PbrMaterial::Texture(TextureSlot slot, uint32_t width, uint32_t height, DXGI_FORMAT format, void const* data)
+    {
+        impl_->Texture(slot, width, height, format, data);
+    }
+
+    void PbrMaterial::Texture(TextureSlot slot, TextureSource* source)
+    {
+        impl_->Texture(slot, source);
+    }
 
 
     PbrMaterialBuffer const& EngineInternal::Buffer(PbrMaterial const& material) noexcept
     {
         return material.impl_->Buffer();
     }
+
+    std::shared_ptr<HostTexture const> const& EngineInternal::HostTextureOf(
+        PbrMaterial const& material, PbrMaterial::TextureSlot slot) noexcept
+    {
+        return material.impl_->HostTextureOf(slot);
+    }
+
+    std::shared_ptr<TextureSource> const& EngineInternal::TextureSourceOf(
+        PbrMaterial const& material, PbrMaterial::TextureSlot slot) noexcept
+    {
+        return material.impl_->TextureSourceOf(slot);
+    }
 } // namespace GoldenSun
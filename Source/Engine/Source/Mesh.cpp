@@ -2,8 +2,12 @@
 
 #include <GoldenSun/Mesh.hpp>
 
+#include <GoldenSun/ErrorHandling.hpp>
 #include <GoldenSun/Material.hpp>
 
+#include <cassert>
+#include <cstring>
+
 #include "EngineInternal.hpp"
 
 using namespace DirectX;
@@ -64,6 +68,7 @@ namespace GoldenSun
             return materials_[material_id];
         }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
         uint32_t AddPrimitive(ID3D12Resource* vb, ID3D12Resource* ib, uint32_t material_id, D3D12_RAYTRACING_GEOMETRY_FLAGS flags)
         {
             uint32_t const primitive_id = static_cast<uint32_t>(primitives_.size());
@@ -86,6 +91,34 @@ namespace GoldenSun
 
             return primitive_id;
         }
+#endif
+
+        uint32_t AddPrimitive(Vertex const* vertices, uint32_t num_vertices, Index const* indices, uint32_t num_indices,
+            uint32_t material_id, D3D12_RAYTRACING_GEOMETRY_FLAGS flags)
+        {
+            assert((vertex_stride_in_bytes_ == sizeof(Vertex)) && (index_stride_in_bytes_ == sizeof(Index)));
+
+            uint32_t const primitive_id = static_cast<uint32_t>(primitives_.size());
+
+            auto& new_primitive = primitives_.emplace_back();
+
+            new_primitive.vb.count = num_vertices;
+            new_primitive.ib.count = num_indices;
+#ifndef GOLDEN_SUN_HOST_ONLY
+            new_primitive.vb.vertex_buffer = {};
+            new_primitive.ib.index_buffer = {};
+#endif
+
+            new_primitive.host_vertices.assign(vertices, vertices + num_vertices);
+            new_primitive.host_indices.assign(indices, indices + num_indices);
+
+            assert(material_id < this->NumMaterials());
+
+            new_primitive.material_id = material_id;
+            new_primitive.flags = flags;
+
+            return primitive_id;
+        }
 
         uint32_t NumPrimitives() const noexcept
         {
@@ -97,20 +130,24 @@ namespace GoldenSun
             return primitives_[primitive_id].vb.count;
         }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
         ID3D12Resource* VertexBuffer(uint32_t primitive_id) const noexcept
         {
             return primitives_[primitive_id].vb.resource.Get();
         }
+#endif
 
         uint32_t NumIndices(uint32_t primitive_id) const noexcept
         {
             return primitives_[primitive_id].ib.count;
         }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
         ID3D12Resource* IndexBuffer(uint32_t primitive_id) const noexcept
         {
             return primitives_[primitive_id].ib.resource.Get();
         }
+#endif
 
         void MaterialId(uint32_t primitive_id, uint32_t id) noexcept
         {
@@ -144,6 +181,12 @@ namespace GoldenSun
             return instances_[instance_id];
         }
 
+        D3D12_RAYTRACING_GEOMETRY_FLAGS GeometryFlags(uint32_t primitive_id) const noexcept
+        {
+            return primitives_[primitive_id].flags;
+        }
+
+#ifndef GOLDEN_SUN_HOST_ONLY
         std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> GeometryDescs() const
         {
             std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> ret;
@@ -165,17 +208,53 @@ namespace GoldenSun
 
             return ret;
         }
+#endif
+
+        void HostBuffers(uint32_t primitive_id, std::vector<Vertex>& vertices, std::vector<Index>& indices) const
+        {
+            auto const& primitive = primitives_[primitive_id];
+#ifndef GOLDEN_SUN_HOST_ONLY
+            if (primitive.vb.resource)
+            {
+                Verify((vertex_stride_in_bytes_ == sizeof(Vertex)) && (index_stride_in_bytes_ == sizeof(Index)));
+
+                vertices.resize(primitive.vb.count);
+                ReadBuffer(primitive.vb.resource.Get(), vertices.data(), vertices.size() * sizeof(Vertex));
+                indices.resize(primitive.ib.count);
+                ReadBuffer(primitive.ib.resource.Get(), indices.data(), indices.size() * sizeof(Index));
+                return;
+            }
+#endif
+
+            vertices = primitive.host_vertices;
+            indices = primitive.host_indices;
+        }
+
+    private:
+#ifndef GOLDEN_SUN_HOST_ONLY
+        static void ReadBuffer(ID3D12Resource* buffer, void* data, size_t size)
+        {
+            D3D12_RANGE const read_range{0, size};
+            void* mapped_data;
+            TIFHR(buffer->Map(0, &read_range, &mapped_data));
+            std::memcpy(data, mapped_data, size);
+            D3D12_RANGE const write_range{0, 0};
+            buffer->Unmap(0, &write_range);
+        }
+#endif
 
     private:
         struct Buffer
         {
-            ComPtr<ID3D12Resource> resource;
             uint32_t count;
+#ifndef GOLDEN_SUN_HOST_ONLY
+            ComPtr<ID3D12Resource> resource;
             union
             {
                 D3D12_GPU_VIRTUAL_ADDRESS_AND_STRIDE vertex_buffer;
                 D3D12_GPU_VIRTUAL_ADDRESS index_buffer;
             };
+#endif
         };
 
         struct Primitive
@@ -184,6 +263,10 @@ namespace GoldenSun
             Buffer ib;
             uint32_t material_id;
             D3D12_RAYTRACING_GEOMETRY_FLAGS flags;
+
+            // Only for primitives added from host memory
+            std::vector<Vertex> host_vertices;
+            std::vector<Index> host_indices;
         };
 
     private:
@@ -263,6 +346,7 @@ namespace GoldenSun
         return impl_->Material(material_id);
     }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     uint32_t Mesh::AddPrimitive(ID3D12Resource* vb, ID3D12Resource* ib, uint32_t material_id)
     {
         return impl_->AddPrimitive(vb, ib, material_id, D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE);
@@ -272,6 +356,19 @@ namespace GoldenSun
     {
         return impl_->AddPrimitive(vb, ib, material_id, flags);
     }
+#endif
+
+    uint32_t Mesh::AddPrimitive(
+        Vertex const* vertices, uint32_t num_vertices, Index const* indices, uint32_t num_indices, uint32_t material_id)
+    {
+        return impl_->AddPrimitive(vertices, num_vertices, indices, num_indices, material_id, D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE);
+    }
+
+    uint32_t Mesh::AddPrimitive(Vertex const* vertices, uint32_t num_vertices, Index const* indices, uint32_t num_indices,
+        uint32_t material_id, D3D12_RAYTRACING_GEOMETRY_FLAGS flags)
+    {
+        return impl_->AddPrimitive(vertices, num_vertices, indices, num_indices, material_id, flags);
+    }
 
     uint32_t Mesh::NumPrimitives() const noexcept
     {
@@ -283,20 +380,24 @@ namespace GoldenSun
         return impl_->NumVertices(primitive_id);
     }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     ID3D12Resource* Mesh::VertexBuffer(uint32_t primitive_id) const noexcept
     {
         return impl_->VertexBuffer(primitive_id);
     }
+#endif
 
     uint32_t Mesh::NumIndices(uint32_t primitive_id) const noexcept
     {
         return impl_->NumIndices(primitive_id);
     }
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     ID3D12Resource* Mesh::IndexBuffer(uint32_t primitive_id) const noexcept
     {
         return impl_->IndexBuffer(primitive_id);
     }
+#endif
 
     void Mesh::MaterialId(uint32_t primitive_id, uint32_t id) noexcept
     {
@@ -329,8 +430,20 @@ namespace GoldenSun
     }
 
 
+#ifndef GOLDEN_SUN_HOST_ONLY
     std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> EngineInternal::GeometryDescs(Mesh const& mesh)
     {
         return mesh.impl_->GeometryDescs();
     }
+#endif
+
+    D3D12_RAYTRACING_GEOMETRY_FLAGS EngineInternal::GeometryFlags(Mesh const& mesh, uint32_t primitive_id) noexcept
+    {
+        return mesh.impl_->GeometryFlags(primitive_id);
+    }
+
+    void EngineInternal::HostBuffers(Mesh const& mesh, uint32_t primitive_id, std::vector<Vertex>& vertices, std::vector<Index>& indices)
+    {
+        mesh.impl_->HostBuffers(primitive_id, vertices, indices);
+    }
 } // namespace GoldenSun
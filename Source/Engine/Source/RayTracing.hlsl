@@ -1,5 +1,7 @@
 static uint const MaxRayRecursionDepth = 3;
 static float const PI = 3.141592654f;
+// LOD of every sample while texture LOD is off. Far enough below 0 that no texture size brings it to a mip other than the top.
+static float const NoTextureLod = -128.0f;
 
 // Ray types traced in this sample.
 namespace RayType
@@ -40,6 +42,9 @@ struct SceneConstantBuffer
     float4 bg_color;
     float3 camera_pos;
     bool is_srgb_output;
+    float2 sample_position;
+    uint sample_index;
+    float pixel_spread_angle;
 };
 
 struct Light
@@ -80,6 +85,7 @@ struct PrimitiveConstantBuffer
 
 RaytracingAccelerationStructure scene : register(t0, space0);
 RWTexture2D<float4> render_target : register(u0, space0);
+RWTexture2D<float4> accumulation_target : register(u1, space0);
 
 ConstantBuffer<SceneConstantBuffer> scene_cb : register(b0, space0);
 StructuredBuffer<PbrMaterial> material_buffer : register(t1, space0);
@@ -173,10 +179,18 @@ float AttenuationTerm(float3 light_pos, float3 pos, float3 atten)
     return 1 / dot(atten, float3(1, d, d2));
 }
 
+// Ray cone (Akenine-Moller et al. 2019), for picking texture mips. The width at the origin of a ray, and the angle it grows by.
+struct RayCone
+{
+    float width;
+    float spread_angle;
+};
+
 struct RadianceRayPayload
 {
     float4 color;
     uint recursion_depth;
+    RayCone cone;
 };
 
 struct ShadowRayPayload
@@ -190,7 +204,7 @@ struct Ray
     float3 direction;
 };
 
-float4 TraceRadianceRay(Ray ray, uint curr_ray_recursion_depth)
+float4 TraceRadianceRay(Ray ray, RayCone cone, uint curr_ray_recursion_depth)
 {
     if (curr_ray_recursion_depth >= MaxRayRecursionDepth)
     {
@@ -203,7 +217,7 @@ float4 TraceRadianceRay(Ray ray, uint curr_ray_recursion_depth)
     ray_desc.TMin = 0.001f;
     ray_desc.TMax = 10000.0f;
 
-    RadianceRayPayload payload = {float4(0, 0, 0, 0), curr_ray_recursion_depth + 1};
+    RadianceRayPayload payload = {float4(0, 0, 0, 0), curr_ray_recursion_depth + 1, cone};
     TraceRay(scene, RAY_FLAG_CULL_BACK_FACING_TRIANGLES, TraceRayParameters::InstanceMask,
         TraceRayParameters::HitGroup::Offset[RayType::Radiance], TraceRayParameters::HitGroup::GeometryStride,
         TraceRayParameters::MissShader::Offset[RayType::Radiance], ray_desc, payload);
@@ -241,7 +255,7 @@ float3 LinearToSrgb(float3 color)
 [shader("raygeneration")]
 void RayGenShader()
 {
-    float2 pos_ss = (DispatchRaysIndex().xy + 0.5f) / DispatchRaysDimensions().xy * 2 - 1;
+    float2 pos_ss = (DispatchRaysIndex().xy + scene_cb.sample_position) / DispatchRaysDimensions().xy * 2 - 1;
     pos_ss.y = -pos_ss.y;
 
     float4 pos_ws = mul(float4(pos_ss, 0, 1), scene_cb.inv_view_proj);
@@ -251,8 +265,21 @@ void RayGenShader()
     ray.origin = scene_cb.camera_pos;
     ray.direction = normalize(pos_ws.xyz - ray.origin);
 
+    RayCone const cone = {0, scene_cb.pixel_spread_angle};
+
     uint curr_recursion_depth = 0;
-    float4 color = TraceRadianceRay(ray, curr_recursion_depth);
+    float4 color = TraceRadianceRay(ray, cone, curr_recursion_depth);
+
+    if (scene_cb.sample_index > 0)
+    {
+        float4 const sum = accumulation_target[DispatchRaysIndex().xy] + color;
+        accumulation_target[DispatchRaysIndex().xy] = sum;
+        color = sum / (scene_cb.sample_index + 1);
+    }
+    else
+    {
+        accumulation_target[DispatchRaysIndex().xy] = color;
+    }
 
     if (scene_cb.is_srgb_output)
     {
@@ -267,24 +294,35 @@ float3 TransformQuat(float3 v, float4 quat)
     return v + cross(quat.xyz, cross(quat.xyz, v) + quat.w * v) * 2;
 }
 
-float4 CalcLighting(float3 position, float3x3 tangent_frame, float2 tex_coord, uint recursion_depth)
+// tex_lod is for a single texel, each texture adds the log2 of its size
+float TextureLevel(Texture2D tex, float tex_lod)
+{
+    uint width;
+    uint height;
+    tex.GetDimensions(width, height);
+    return tex_lod + 0.5f * log2(width * height);
+}
+
+float4 CalcLighting(float3 position, float3x3 tangent_frame, float2 tex_coord, float tex_lod, RayCone cone, uint recursion_depth)
 {
     PbrMaterial mtl = material_buffer[primitive_cb.material_id];
 
     float const ambient_factor = 0.02f;
 
-    float4 const albedo_data = albedo_tex.SampleLevel(linear_wrap_sampler, tex_coord, 0);
+    float4 const albedo_data = albedo_tex.SampleLevel(linear_wrap_sampler, tex_coord, TextureLevel(albedo_tex, tex_lod));
     float3 const albedo = mtl.albedo * albedo_data.xyz;
     float const opacity = mtl.opacity * albedo_data.w;
 
-    float2 metallic_roughness = metallic_roughness_tex.SampleLevel(linear_wrap_sampler, tex_coord, 0).zy;
+    float2 metallic_roughness =
+        metallic_roughness_tex.SampleLevel(linear_wrap_sampler, tex_coord, TextureLevel(metallic_roughness_tex, tex_lod)).zy;
     float const metallic = saturate(mtl.metallic * metallic_roughness.x);
 
     float const roughness = saturate(mtl.roughness * metallic_roughness.y);
 
-    float const occlusion = mtl.occlusion_strength * occlusion_tex.SampleLevel(linear_wrap_sampler, tex_coord, 0).x;
+    float const occlusion =
+        mtl.occlusion_strength * occlusion_tex.SampleLevel(linear_wrap_sampler, tex_coord, TextureLevel(occlusion_tex, tex_lod)).x;
 
-    float3 normal = normal_tex.SampleLevel(linear_wrap_sampler, tex_coord, 0).xyz * 2 - 1;
+    float3 normal = normal_tex.SampleLevel(linear_wrap_sampler, tex_coord, TextureLevel(normal_tex, tex_lod)).xyz * 2 - 1;
     normal = normalize(mul(normal * float3(mtl.normal_scale.xx, 1), tangent_frame));
 
     float3 const view_dir = normalize(scene_cb.camera_pos - position);
@@ -325,13 +363,14 @@ float4 CalcLighting(float3 position, float3x3 tangent_frame, float2 tex_coord, u
     }
 
     float3 const ambient = ambient_factor * albedo;
-    float3 const emissive = mtl.emissive * emissive_tex.SampleLevel(linear_wrap_sampler, tex_coord, 0).xyz;
+    float3 const emissive =
+        mtl.emissive * emissive_tex.SampleLevel(linear_wrap_sampler, tex_coord, TextureLevel(emissive_tex, tex_lod)).xyz;
 
     float3 color = ambient + emissive + shading;
     if (mtl.transparent && (opacity < 1.0f - 0.5f / 255.0f))
     {
         Ray const ray = {position, WorldRayDirection()};
-        color = lerp(TraceRadianceRay(ray, recursion_depth).xyz, color, opacity);
+        color = lerp(TraceRadianceRay(ray, cone, recursion_depth).xyz, color, opacity);
     }
 
     return float4(color, 1);
@@ -424,7 +463,29 @@ void ClosestHitShader(inout RadianceRayPayload payload, in BuiltInTriangleInters
     float2 const tex_coord = vertex_tex_coords[0] + attr.barycentrics.x * (vertex_tex_coords[1] - vertex_tex_coords[0]) +
                              attr.barycentrics.y * (vertex_tex_coords[2] - vertex_tex_coords[0]);
 
-    payload.color = CalcLighting(hit_position, tangent_frame, tex_coord, payload.recursion_depth);
+    // Texture LOD from the ray cone (Akenine-Moller et al. 2019). The footprint of the cone, scaled from world space to uv space by
+    // the ratio of the triangle areas, and stretched by the angle it hits the triangle at.
+    RayCone const cone = {payload.cone.width + payload.cone.spread_angle * RayTCurrent(), payload.cone.spread_angle};
+    float tex_lod = NoTextureLod;
+    if (cone.spread_angle > 0)
+    {
+        float3 const vertex_positions[] = {
+            mul(float4(vertex_buffer[indices[0]].position, 1), model_matrix).xyz,
+            mul(float4(vertex_buffer[indices[1]].position, 1), model_matrix).xyz,
+            mul(float4(vertex_buffer[indices[2]].position, 1), model_matrix).xyz,
+        };
+        float3 const geometric_normal = cross(vertex_positions[1] - vertex_positions[0], vertex_positions[2] - vertex_positions[0]);
+        float const world_area = length(geometric_normal);
+        float2 const uv_edges[] = {vertex_tex_coords[1] - vertex_tex_coords[0], vertex_tex_coords[2] - vertex_tex_coords[0]};
+        float const uv_area = abs(uv_edges[0].x * uv_edges[1].y - uv_edges[1].x * uv_edges[0].y);
+        float const cos_angle = (world_area > 0) ? abs(dot(geometric_normal, WorldRayDirection())) / world_area : 0;
+        if ((uv_area > 0) && (cos_angle > 0))
+        {
+            tex_lod = 0.5f * log2(uv_area / world_area) + log2(abs(cone.width) / cos_angle);
+        }
+    }
+
+    payload.color = CalcLighting(hit_position, tangent_frame, tex_coord, tex_lod, cone, payload.recursion_depth);
 }
 
 [shader("miss")]
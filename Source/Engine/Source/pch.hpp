@@ -1,5 +1,6 @@
 #pragma once
 
+#ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -7,11 +8,16 @@
 #define NOMINMAX
 #endif
 #include <windows.h>
+#endif
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <d3d12.h>
 #include <dxgiformat.h>
+#endif
 
 #include <DirectXMath.h>
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <GoldenSun/ComPtr.hpp>
+#endif
 #include <GoldenSun/GoldenSun.hpp>
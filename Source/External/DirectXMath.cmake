@@ -0,0 +1,10 @@
+# Windows SDK has it, other platforms get it from GitHub
+UpdateExternalLib("DirectXMath" "https://github.com/microsoft/DirectXMath.git" "dec2022")
+
+add_library(DirectXMath INTERFACE)
+target_include_directories(DirectXMath
+    INTERFACE
+        ${CMAKE_CURRENT_SOURCE_DIR}/DirectXMath/Inc
+        # DirectXMath.h includes sal.h, which only comes with MSVC
+        ${CMAKE_CURRENT_SOURCE_DIR}/Sal
+)
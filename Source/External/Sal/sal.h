@@ -0,0 +1,17 @@
+#pragma once
+
+// The source annotations DirectXMath uses, as nothing. Only for compilers that don't come with sal.h.
+
+#define _Analysis_assume_(expr)
+#define _In_
+#define _In_opt_
+#define _In_reads_(size)
+#define _In_reads_bytes_(size)
+#define _Inout_
+#define _Inout_opt_
+#define _Out_
+#define _Out_opt_
+#define _Out_writes_(size)
+#define _Out_writes_bytes_(size)
+#define _Success_(expr)
+#define _Use_decl_annotations_
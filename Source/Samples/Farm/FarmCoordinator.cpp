@@ -0,0 +1,283 @@
+#include "pch.hpp"
+
+#include "FarmCoordinator.hpp"
+
+#include <GoldenSun/ErrorHandling.hpp>
+#include <GoldenSun/Util.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+    // How often Run looks at the timeouts when nothing arrives
+    int constexpr PollIntervalMs = 1000;
+
+    uint32_t constexpr PixelSize = 4;
+} // namespace
+
+namespace GoldenSun
+{
+    FarmCoordinator::FarmCoordinator(FarmJob const& job, uint32_t bucket_size, uint16_t port, uint32_t timeout_seconds)
+        : job_(job), timeout_(std::chrono::seconds(timeout_seconds)), listener_(FarmSocket::Listen(port))
+    {
+        if ((job.width == 0) || (job.height == 0) || (job.samples == 0))
+        {
+            throw std::invalid_argument("The frame needs a size and at least one sample per pixel.");
+        }
+
+        // On the tiles of the engine, so no tile accumulates in two buckets
+        bucket_size = Align<8>(std::max(bucket_size, 1U));
+
+        // In rows, the order they go out in
+        for (uint32_t top = 0; top < job.height; top += bucket_size)
+        {
+            for (uint32_t left = 0; left < job.width; left += bucket_size)
+            {
+                uint32_t const id = static_cast<uint32_t>(buckets_.size());
+                buckets_.push_back({id, left, top, std::min(left + bucket_size, job.width), std::min(top + bucket_size, job.height)});
+                pending_.push_back(id);
+            }
+        }
+    }
+
+    FarmCoordinator::~FarmCoordinator() noexcept
+    {
+        // Workers quit once they get Done, or once their connection to the coordinator closes. Close the ones left, in case Run
+        // didn't finish.
+        workers_.clear();
+        listener_.Close();
+        for (HANDLE process : processes_)
+        {
+            ::WaitForSingleObject(process, INFINITE);
+            ::CloseHandle(process);
+        }
+    }
+
+    uint16_t FarmCoordinator::Port() const
+    {
+        return listener_.Port();
+    }
+
+    void FarmCoordinator::SpawnWorkers(uint32_t num_workers, uint32_t fail_after)
+    {
+        if (num_workers == 0)
+        {
+            return;
+        }
+
+        char exe_file[MAX_PATH];
+        uint32_t const size = ::GetModuleFileNameA(nullptr, exe_file, static_cast<uint32_t>(std::size(exe_file)));
+        Verify((size != 0) && (size != std::size(exe_file)));
+
+        uint32_t const num_threads = std::max(std::thread::hardware_concurrency() / num_workers, 1U);
+        for (uint32_t i = 0; i < num_workers; ++i)
+        {
+            std::string cmd_line = '"' + std::string(exe_file) + "\" --worker --connect 127.0.0.1:" + std::to_string(this->Port()) +
+                                   " --threads " + std::to_string(num_threads);
+            if ((i == 0) && (fail_after > 0))
+            {
+                cmd_line += " --fail-after " + std::to_string(fail_after);
+            }
+
+            STARTUPINFOA startup_info{};
+            startup_info.cb = sizeof(startup_info);
+            PROCESS_INFORMATION process_info;
+            if (!::CreateProcessA(nullptr, cmd_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startup_info, &process_info))
+            {
+                throw std::runtime_error("Can't start a worker, error " + std::to_string(::GetLastError()) + '.');
+            }
+            ::CloseHandle(process_info.hThread);
+            processes_.push_back(process_info.hProcess);
+        }
+    }
+
+    std::vector<uint8_t> FarmCoordinator::Run()
+    {
+        std::vector<uint8_t> frame(static_cast<size_t>(job_.width) * job_.height * PixelSize);
+
+        auto idle_since = std::chrono::steady_clock::now();
+        std::vector<WSAPOLLFD> poll_fds;
+        while (num_finished_ < buckets_.size())
+        {
+            poll_fds.resize(1 + workers_.size());
+            poll_fds[0] = {listener_.Handle(), POLLRDNORM, 0};
+            for (size_t i = 0; i < workers_.size(); ++i)
+            {
+                poll_fds[i + 1] = {workers_[i].socket.Handle(), POLLRDNORM, 0};
+            }
+            if (::WSAPoll(poll_fds.data(), static_cast<ULONG>(poll_fds.size()), PollIntervalMs) == SOCKET_ERROR)
+            {
+                throw std::runtime_error("WSAPoll failed with error " + std::to_string(::WSAGetLastError()) + '.');
+            }
+
+            // A closed or broken connection is readable as well, Serve finds out when it reads nothing
+            for (size_t i = 0; i < workers_.size(); ++i)
+            {
+                if (poll_fds[i + 1].revents != 0)
+                {
+                    this->Serve(workers_[i], frame);
+                }
+            }
+
+            if (poll_fds[0].revents & POLLRDNORM)
+            {
+                FarmSocket socket = listener_.Accept();
+                if (socket.Valid())
+                {
+                    socket.ReceiveTimeout(static_cast<uint32_t>(timeout_.count()));
+
+                    auto& worker = workers_.emplace_back();
+                    worker.id = next_worker_id_;
+                    worker.socket = std::move(socket);
+                    ++next_worker_id_;
+                    std::cout << "Worker " << worker.id << " connected.\n";
+                }
+            }
+
+            auto const now = std::chrono::steady_clock::now();
+            if (timeout_.count() > 0)
+            {
+                for (auto& worker : workers_)
+                {
+                    if ((worker.bucket != NoBucket) && (now - worker.assigned_time > timeout_))
+                    {
+                        this->Drop(worker, "timed out");
+                    }
+                }
+            }
+
+            workers_.erase(
+                std::remove_if(workers_.begin(), workers_.end(), [](Worker const& worker) { return !worker.socket.Valid(); }),
+                workers_.end());
+
+            for (auto& worker : workers_)
+            {
+                this->Assign(worker);
+            }
+
+            if (!workers_.empty())
+            {
+                idle_since = now;
+            }
+            else if ((timeout_.count() > 0) && (now - idle_since > timeout_))
+            {
+                throw std::runtime_error("No worker left to finish the frame.");
+            }
+        }
+
+        for (auto& worker : workers_)
+        {
+            worker.socket.Send(FarmMessage::Done, nullptr, 0);
+        }
+        workers_.clear();
+
+        return frame;
+    }
+
+    void FarmCoordinator::Serve(Worker& worker, std::vector<uint8_t>& frame)
+    {
+        FarmMessage message;
+        std::vector<uint8_t> payload;
+        if (!worker.socket.Receive(message, payload))
+        {
+            this->Drop(worker, "connection lost");
+            return;
+        }
+
+        switch (message)
+        {
+        case FarmMessage::Hello:
+        {
+            FarmHello hello{};
+            if (payload.size() == sizeof(hello))
+            {
+                std::memcpy(&hello, payload.data(), sizeof(hello));
+            }
+            if (hello.version != FarmProtocolVersion)
+            {
+                this->Drop(worker, "different protocol version");
+                return;
+            }
+
+            if (!worker.socket.Send(FarmMessage::Job, job_))
+            {
+                this->Drop(worker, "connection lost");
+                return;
+            }
+            worker.has_job = true;
+            break;
+        }
+
+        case FarmMessage::Tile:
+        {
+            FarmBucket bucket;
+            if ((worker.bucket == NoBucket) || (payload.size() < sizeof(bucket)))
+            {
+                this->Drop(worker, "unexpected tile");
+                return;
+            }
+            std::memcpy(&bucket, payload.data(), sizeof(bucket));
+
+            FarmBucket const& expected = buckets_[worker.bucket];
+            uint32_t const row_size = (expected.right - expected.left) * PixelSize;
+            if ((std::memcmp(&bucket, &expected, sizeof(bucket)) != 0) ||
+                (payload.size() != sizeof(bucket) + (expected.bottom - expected.top) * row_size))
+            {
+                this->Drop(worker, "unexpected tile");
+                return;
+            }
+
+            uint8_t const* src = payload.data() + sizeof(bucket);
+            for (uint32_t y = expected.top; y < expected.bottom; ++y)
+            {
+                std::memcpy(&frame[(static_cast<size_t>(y) * job_.width + expected.left) * PixelSize], src, row_size);
+                src += row_size;
+            }
+
+            worker.bucket = NoBucket;
+            ++num_finished_;
+            break;
+        }
+
+        default:
+            this->Drop(worker, "unexpected message");
+            break;
+        }
+    }
+
+    void FarmCoordinator::Assign(Worker& worker)
+    {
+        if (!worker.has_job || (worker.bucket != NoBucket) || pending_.empty())
+        {
+            return;
+        }
+
+        worker.bucket = pending_.front();
+        pending_.pop_front();
+        worker.assigned_time = std::chrono::steady_clock::now();
+        if (!worker.socket.Send(FarmMessage::Bucket, buckets_[worker.bucket]))
+        {
+            this->Drop(worker, "connection lost");
+        }
+    }
+
+    void FarmCoordinator::Drop(Worker& worker, char const* reason)
+    {
+        std::cout << "Worker " << worker.id << " dropped, " << reason << '.';
+        if (worker.bucket != NoBucket)
+        {
+            // To the front, the next idle worker picks it up right away
+            std::cout << " Bucket " << worker.bucket << " goes back to the queue.";
+            pending_.push_front(worker.bucket);
+            worker.bucket = NoBucket;
+        }
+        std::cout << '\n';
+
+        worker.socket.Close();
+    }
+} // namespace GoldenSun
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "FarmProtocol.hpp"
+
+namespace GoldenSun
+{
+    // Splits a frame into buckets and hands them out to the workers that connect, one at a time each, so faster workers end up
+    // with more of them. Every bucket is rendered exactly like in a render of the whole frame, and lands in its own rectangle of
+    // the frame, so the image doesn't depend on which worker rendered what, or on how many there were. A worker that goes away
+    // puts its bucket back in the queue for the others.
+    class FarmCoordinator final
+    {
+        DISALLOW_COPY_AND_ASSIGN(FarmCoordinator)
+
+    public:
+        // bucket_size is rounded up to a multiple of 8 pixels. A worker that holds a bucket for longer than timeout_seconds, such as
+        // one on a machine that went down without closing its connection, is given up on. So is the job when no worker is left
+        // for that long. 0 waits forever.
+        FarmCoordinator(FarmJob const& job, uint32_t bucket_size, uint16_t port, uint32_t timeout_seconds);
+        ~FarmCoordinator() noexcept;
+
+        uint16_t Port() const;
+
+        // Starts num_workers processes of this executable as workers on this machine, each with its share of the hardware
+        // threads. The first of them quits on its fail_after-th bucket, if it's above 0.
+        void SpawnWorkers(uint32_t num_workers, uint32_t fail_after);
+
+        // Rows of width * 4 bytes, RGBA8 in sRGB
+        std::vector<uint8_t> Run();
+
+        uint32_t NumBuckets() const noexcept
+        {
+            return static_cast<uint32_t>(buckets_.size());
+        }
+        // That connected during Run, dropped ones included
+        uint32_t NumWorkers() const noexcept
+        {
+            return next_worker_id_;
+        }
+
+    private:
+        static constexpr uint32_t NoBucket = ~0U;
+
+        struct Worker
+        {
+            uint32_t id;
+            FarmSocket socket;
+            bool has_job = false;
+            uint32_t bucket = NoBucket;
+            std::chrono::steady_clock::time_point assigned_time;
+        };
+
+        void Serve(Worker& worker, std::vector<uint8_t>& frame);
+        void Assign(Worker& worker);
+        void Drop(Worker& worker, char const* reason);
+
+    private:
+        FarmJob job_;
+        std::chrono::milliseconds timeout_;
+
+        FarmSocket listener_;
+        std::vector<HANDLE> processes_;
+
+        std::vector<FarmBucket> buckets_;
+        std::deque<uint32_t> pending_;
+        uint32_t num_finished_ = 0;
+
+        std::vector<Worker> workers_;
+        uint32_t next_worker_id_ = 0;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,231 @@
+#include "pch.hpp"
+
+#include "FarmProtocol.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace
+{
+    // Far above a tile of any frame that fits in memory. A corrupt header shouldn't make the receiver allocate gigabytes.
+    uint32_t constexpr MaxPayloadSize = 256 * 1024 * 1024;
+
+    struct MessageHeader
+    {
+        GoldenSun::FarmMessage message;
+        uint32_t size;
+    };
+
+    std::runtime_error SocketError(char const* what)
+    {
+        return std::runtime_error(std::string(what) + " failed with error " + std::to_string(::WSAGetLastError()) + '.');
+    }
+} // namespace
+
+namespace GoldenSun
+{
+    WinsockScope::WinsockScope()
+    {
+        WSADATA wsa_data;
+        if (::WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0)
+        {
+            throw std::runtime_error("Winsock 2.2 isn't available.");
+        }
+    }
+
+    WinsockScope::~WinsockScope() noexcept
+    {
+        ::WSACleanup();
+    }
+
+
+    FarmSocket::FarmSocket() noexcept : socket_(INVALID_SOCKET)
+    {
+    }
+
+    FarmSocket::FarmSocket(SOCKET socket) noexcept : socket_(socket)
+    {
+    }
+
+    FarmSocket::~FarmSocket() noexcept
+    {
+        this->Close();
+    }
+
+    FarmSocket::FarmSocket(FarmSocket&& other) noexcept : socket_(std::exchange(other.socket_, INVALID_SOCKET))
+    {
+    }
+
+    FarmSocket& FarmSocket::operator=(FarmSocket&& other) noexcept
+    {
+        if (this != &other)
+        {
+            this->Close();
+            socket_ = std::exchange(other.socket_, INVALID_SOCKET);
+        }
+        return *this;
+    }
+
+    FarmSocket FarmSocket::Listen(uint16_t port)
+    {
+        FarmSocket ret(::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        if (!ret.Valid())
+        {
+            throw SocketError("socket");
+        }
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(port);
+        if (::bind(ret.socket_, reinterpret_cast<sockaddr const*>(&addr), sizeof(addr)) == SOCKET_ERROR)
+        {
+            throw SocketError("bind");
+        }
+        if (::listen(ret.socket_, SOMAXCONN) == SOCKET_ERROR)
+        {
+            throw SocketError("listen");
+        }
+
+        return ret;
+    }
+
+    FarmSocket FarmSocket::Connect(std::string const& host, uint16_t port)
+    {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        addrinfo* addrs;
+        if (::getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addrs) != 0)
+        {
+            throw SocketError("getaddrinfo");
+        }
+
+        FarmSocket ret;
+        for (addrinfo* addr = addrs; addr != nullptr; addr = addr->ai_next)
+        {
+            FarmSocket candidate(::socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol));
+            if (candidate.Valid() && (::connect(candidate.socket_, addr->ai_addr, static_cast<int>(addr->ai_addrlen)) != SOCKET_ERROR))
+            {
+                ret = std::move(candidate);
+                break;
+            }
+        }
+        ::freeaddrinfo(addrs);
+
+        if (!ret.Valid())
+        {
+            throw std::runtime_error("Can't connect to " + host + ':' + std::to_string(port) + '.');
+        }
+
+        // Tiles go out as soon as they are written, there is nothing to coalesce them with
+        BOOL const no_delay = TRUE;
+        ::setsockopt(ret.socket_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char const*>(&no_delay), sizeof(no_delay));
+
+        return ret;
+    }
+
+    FarmSocket FarmSocket::Accept()
+    {
+        FarmSocket ret(::accept(socket_, nullptr, nullptr));
+        if (ret.Valid())
+        {
+            BOOL const no_delay = TRUE;
+            ::setsockopt(ret.socket_, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char const*>(&no_delay), sizeof(no_delay));
+        }
+        return ret;
+    }
+
+    bool FarmSocket::Valid() const noexcept
+    {
+        return socket_ != INVALID_SOCKET;
+    }
+
+    SOCKET FarmSocket::Handle() const noexcept
+    {
+        return socket_;
+    }
+
+    uint16_t FarmSocket::Port() const
+    {
+        sockaddr_in addr{};
+        int addr_len = sizeof(addr);
+        if (::getsockname(socket_, reinterpret_cast<sockaddr*>(&addr), &addr_len) == SOCKET_ERROR)
+        {
+            throw SocketError("getsockname");
+        }
+        return ntohs(addr.sin_port);
+    }
+
+    void FarmSocket::Close() noexcept
+    {
+        if (socket_ != INVALID_SOCKET)
+        {
+            ::closesocket(socket_);
+            socket_ = INVALID_SOCKET;
+        }
+    }
+
+    void FarmSocket::ReceiveTimeout(uint32_t milliseconds)
+    {
+        DWORD const timeout = milliseconds;
+        ::setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char const*>(&timeout), sizeof(timeout));
+    }
+
+    bool FarmSocket::Send(FarmMessage message, void const* payload, uint32_t size)
+    {
+        MessageHeader const header = {message, size};
+        return this->SendAll(&header, sizeof(header)) && this->SendAll(payload, size);
+    }
+
+    bool FarmSocket::Receive(FarmMessage& message, std::vector<uint8_t>& payload)
+    {
+        MessageHeader header;
+        if (!this->ReceiveAll(&header, sizeof(header)) || (header.size > MaxPayloadSize))
+        {
+            return false;
+        }
+
+        message = header.message;
+        payload.resize(header.size);
+        return this->ReceiveAll(payload.data(), payload.size());
+    }
+
+    bool FarmSocket::SendAll(void const* data, size_t size)
+    {
+        auto const* bytes = static_cast<char const*>(data);
+        while (size > 0)
+        {
+            int const sent = ::send(socket_, bytes, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0);
+            if (sent <= 0)
+            {
+                return false;
+            }
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool FarmSocket::ReceiveAll(void* data, size_t size)
+    {
+        auto* bytes = static_cast<char*>(data);
+        while (size > 0)
+        {
+            // 0 is the peer closing the connection, before the message is complete
+            int const received = ::recv(socket_, bytes, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0);
+            if (received <= 0)
+            {
+                return false;
+            }
+            bytes += received;
+            size -= received;
+        }
+        return true;
+    }
+} // namespace GoldenSun
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace GoldenSun
+{
+    // Bumped whenever a message changes. The coordinator and the workers of a job have to speak the same one.
+    uint32_t constexpr FarmProtocolVersion = 1;
+
+    enum class FarmMessage : uint32_t
+    {
+        // Worker to coordinator, a FarmHello right after connecting
+        Hello,
+        // Coordinator to worker, the FarmJob to load
+        Job,
+        // Coordinator to worker, a FarmBucket to render
+        Bucket,
+        // Worker to coordinator, the FarmBucket rendered, followed by its pixels in rows of RGBA8
+        Tile,
+        // Coordinator to worker, no payload. The frame is complete.
+        Done,
+    };
+
+    struct FarmHello
+    {
+        uint32_t version;
+    };
+
+    // The same for every worker, so the pixels of a bucket don't depend on which worker renders it
+    struct FarmJob
+    {
+        uint32_t width;
+        uint32_t height;
+        // Per pixel. The cap of adaptive sampling when error_threshold is above 0.
+        uint32_t samples;
+        float error_threshold;
+        uint32_t max_bounces;
+        // Relative to the Assets directory next to the worker executable, loaded with LoadMesh
+        char mesh[256];
+    };
+
+    // Pixels [left, right) x [top, bottom) of the frame. The edges are on multiples of 8 pixels, or on the edges of the frame, so
+    // the tiles the engine accumulates together never span two buckets.
+    struct FarmBucket
+    {
+        uint32_t id;
+        uint32_t left;
+        uint32_t top;
+        uint32_t right;
+        uint32_t bottom;
+    };
+
+    // Payloads are sent as they are in memory. Both ends run the same build, on little-endian x64.
+    static_assert(std::is_trivially_copyable_v<FarmJob> && std::is_trivially_copyable_v<FarmBucket>);
+
+    // WSAStartup and WSACleanup around the lifetime of the sockets
+    class WinsockScope final
+    {
+        DISALLOW_COPY_AND_ASSIGN(WinsockScope)
+        DISALLOW_COPY_MOVE_AND_ASSIGN(WinsockScope)
+
+    public:
+        WinsockScope();
+        ~WinsockScope() noexcept;
+    };
+
+    // A TCP connection between the coordinator and a worker. Messages are a FarmMessage and the size of the payload, both uint32_t,
+    // then the payload. Send and Receive block until the whole message is through, and return false once the connection is lost.
+    // A worker that crashes closes its connection, which is how the coordinator notices.
+    class FarmSocket final
+    {
+        DISALLOW_COPY_AND_ASSIGN(FarmSocket)
+
+    public:
+        FarmSocket() noexcept;
+        explicit FarmSocket(SOCKET socket) noexcept;
+        ~FarmSocket() noexcept;
+
+        FarmSocket(FarmSocket&& other) noexcept;
+        FarmSocket& operator=(FarmSocket&& other) noexcept;
+
+        // On all interfaces, so workers on other machines can connect. Port 0 picks a free one.
+        static FarmSocket Listen(uint16_t port);
+        static FarmSocket Connect(std::string const& host, uint16_t port);
+        // Invalid if the connection went away before it was accepted
+        FarmSocket Accept();
+
+        bool Valid() const noexcept;
+        SOCKET Handle() const noexcept;
+        uint16_t Port() const;
+        void Close() noexcept;
+
+        // Receive gives up after it, so a peer that stops in the middle of a message can't stall the other end. 0 waits forever.
+        void ReceiveTimeout(uint32_t milliseconds);
+
+        bool Send(FarmMessage message, void const* payload, uint32_t size);
+        template <typename T>
+        bool Send(FarmMessage message, T const& payload)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            return this->Send(message, &payload, sizeof(payload));
+        }
+        bool Receive(FarmMessage& message, std::vector<uint8_t>& payload);
+
+    private:
+        bool SendAll(void const* data, size_t size);
+        bool ReceiveAll(void* data, size_t size);
+
+    private:
+        SOCKET socket_;
+    };
+} // namespace GoldenSun
@@ -0,0 +1,154 @@
+#include "pch.hpp"
+
+#include "FarmWorker.hpp"
+
+#include <GoldenSun/MeshHelper.hpp>
+#include <GoldenSun/Util.hpp>
+
+#include <cstring>
+#include <iostream>
+
+using namespace DirectX;
+
+namespace
+{
+    // The starting view of the App sample
+    XMFLOAT3 constexpr eye = {0.0f, 1.0f, -3.0f};
+    XMFLOAT3 constexpr look_at = {0.0f, 0.0f, 0.0f};
+    XMFLOAT3 constexpr up = {0.0f, 1.0f, 0.0f};
+
+    float constexpr fov = XMConvertToRadians(45);
+    float constexpr near_plane = 0.1f;
+    float constexpr far_plane = 20;
+
+    XMFLOAT3 constexpr light_pos = {0.0f, 1.8f, -3.0f};
+    XMFLOAT3 constexpr light_color = {20.0f, 20.0f, 20.0f};
+    XMFLOAT3 constexpr light_falloff = {1, 0, 1};
+    bool constexpr light_shadowing = true;
+
+    DXGI_FORMAT constexpr output_fmt = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+} // namespace
+
+namespace GoldenSun
+{
+    FarmWorker::FarmWorker(std::string const& host, uint16_t port, uint32_t num_threads, uint32_t fail_after)
+        : asset_dir_(ExeDirectory() + "Assets/"), fail_after_(fail_after), socket_(FarmSocket::Connect(host, port)),
+          engine_(num_threads)
+    {
+    }
+
+    int FarmWorker::Run()
+    {
+        if (!socket_.Send(FarmMessage::Hello, FarmHello{FarmProtocolVersion}))
+        {
+            std::cerr << "Lost the coordinator.\n";
+            return 1;
+        }
+
+        FarmMessage message;
+        std::vector<uint8_t> payload;
+        uint32_t num_buckets = 0;
+        while (socket_.Receive(message, payload))
+        {
+            switch (message)
+            {
+            case FarmMessage::Job:
+                if (payload.size() != sizeof(FarmJob))
+                {
+                    std::cerr << "Malformed job.\n";
+                    return 1;
+                }
+                std::memcpy(&job_, payload.data(), sizeof(job_));
+                this->LoadScene(job_);
+                break;
+
+            case FarmMessage::Bucket:
+            {
+                if (payload.size() != sizeof(FarmBucket))
+                {
+                    std::cerr << "Malformed bucket.\n";
+                    return 1;
+                }
+
+                ++num_buckets;
+                if (num_buckets == fail_after_)
+                {
+                    std::cerr << "Quitting on bucket " << num_buckets << " as asked.\n";
+                    return 1;
+                }
+
+                FarmBucket bucket;
+                std::memcpy(&bucket, payload.data(), sizeof(bucket));
+                this->RenderBucket(bucket);
+                if (!socket_.Send(FarmMessage::Tile, tile_.data(), static_cast<uint32_t>(tile_.size())))
+                {
+                    std::cerr << "Lost the coordinator.\n";
+                    return 1;
+                }
+                break;
+            }
+
+            case FarmMessage::Done:
+                return 0;
+
+            default:
+                std::cerr << "Unexpected message " << std::to_underlying(message) << ".\n";
+                return 1;
+            }
+        }
+
+        std::cerr << "Lost the coordinator.\n";
+        return 1;
+    }
+
+    void FarmWorker::LoadScene(FarmJob const& job)
+    {
+        engine_.RenderTarget(job.width, job.height, output_fmt);
+
+        camera_.Eye() = eye;
+        camera_.LookAt() = look_at;
+        camera_.Up() = up;
+        camera_.Fov() = fov;
+        camera_.NearPlane() = near_plane;
+        camera_.FarPlane() = far_plane;
+        engine_.Camera(camera_);
+
+        light_.Position() = light_pos;
+        light_.Color() = light_color;
+        light_.Falloff() = light_falloff;
+        light_.Shadowing() = light_shadowing;
+        engine_.Lights(&light_, 1);
+
+        std::string const mesh(job.mesh, strnlen(job.mesh, std::size(job.mesh)));
+        meshes_ = LoadMesh(asset_dir_ + mesh);
+        engine_.Meshes(meshes_.data(), static_cast<uint32_t>(meshes_.size()));
+
+        // Buckets start at sample 0 the first time the scissor rectangle covers them, so one accumulation serves every bucket of
+        // the frame
+        engine_.Accumulation(true);
+        engine_.PathTracing(job.max_bounces);
+        engine_.AdaptiveSampling(job.error_threshold, job.samples);
+    }
+
+    void FarmWorker::RenderBucket(FarmBucket const& bucket)
+    {
+        engine_.Scissor(bucket.left, bucket.top, bucket.right, bucket.bottom);
+        while (!engine_.Converged())
+        {
+            engine_.Render(nullptr);
+        }
+
+        uint32_t const row_size = (bucket.right - bucket.left) * FormatSize(output_fmt);
+        uint32_t const output_pitch = job_.width * FormatSize(output_fmt);
+        tile_.resize(sizeof(bucket) + (bucket.bottom - bucket.top) * row_size);
+        std::memcpy(tile_.data(), &bucket, sizeof(bucket));
+
+        auto const* output = static_cast<uint8_t const*>(engine_.HostOutput());
+        uint8_t* dst = tile_.data() + sizeof(bucket);
+        for (uint32_t y = bucket.top; y < bucket.bottom; ++y)
+        {
+            std::memcpy(dst, output + y * output_pitch + bucket.left * FormatSize(output_fmt), row_size);
+            dst += row_size;
+        }
+    }
+} // namespace GoldenSun
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GoldenSun/GoldenSun.hpp>
+
+#include <string>
+#include <vector>
+
+#include "FarmProtocol.hpp"
+
+namespace GoldenSun
+{
+    // Renders the buckets the coordinator hands out with the CPU renderer, until the frame is done or the coordinator goes away
+    class FarmWorker final
+    {
+        DISALLOW_COPY_AND_ASSIGN(FarmWorker)
+
+    public:
+        // 0 threads uses all hardware threads. A fail_after above 0 makes the worker quit without answering its fail_after-th
+        // bucket, to try out how the coordinator recovers.
+        FarmWorker(std::string const& host, uint16_t port, uint32_t num_threads, uint32_t fail_after);
+
+        // The exit code of the process
+        int Run();
+
+    private:
+        void LoadScene(FarmJob const& job);
+        void RenderBucket(FarmBucket const& bucket);
+
+    private:
+        std::string asset_dir_;
+        uint32_t fail_after_;
+
+        FarmSocket socket_;
+        Engine engine_;
+        FarmJob job_{};
+
+        Camera camera_;
+        PointLight light_;
+        std::vector<Mesh> meshes_;
+
+        // The FarmBucket, then its pixels
+        std::vector<uint8_t> tile_;
+    };
+} // namespace GoldenSun
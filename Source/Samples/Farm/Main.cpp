@@ -0,0 +1,174 @@
+#include "pch.hpp"
+
+#include <GoldenSun/TextureHelper.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "FarmCoordinator.hpp"
+#include "FarmWorker.hpp"
+
+using namespace GoldenSun;
+
+namespace
+{
+    char const Usage[] =
+        "Coordinator: GoldenSunFarm [--workers N] [--port P] [--timeout S] [--bucket B] [--width W] [--height H] [--samples S]\n"
+        "                           [--error E] [--bounces B] [--mesh M] [--output F] [--fail-after N]\n"
+        "Worker:      GoldenSunFarm --worker --connect HOST:PORT [--threads T] [--fail-after N]\n"
+        "\n"
+        "The coordinator starts N workers on this machine, 0 for none, and takes workers from other machines on port P. Those run\n"
+        "the same build with the same Assets, and connect to it with --worker. --fail-after makes a worker, the first local one for\n"
+        "the coordinator, quit on its Nth bucket, to watch its bucket go to another worker.\n";
+
+    struct Options
+    {
+        bool worker = false;
+        std::string host = "127.0.0.1";
+        uint16_t port = 0;
+        uint32_t num_threads = 0;
+        uint32_t num_workers = 4;
+        uint32_t timeout_seconds = 120;
+        uint32_t bucket_size = 64;
+        uint32_t fail_after = 0;
+        std::string output = "Farm.png";
+        FarmJob job = {1280, 720, 64, 0.0f, 3, "DamagedHelmet/DamagedHelmet.gltf"};
+    };
+
+    bool ParseOptions(int argc, char* argv[], Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string const name = argv[i];
+            if (name == "--worker")
+            {
+                options.worker = true;
+                continue;
+            }
+
+            if (i + 1 == argc)
+            {
+                return false;
+            }
+            char const* value = argv[++i];
+
+            if (name == "--connect")
+            {
+                char const* colon = std::strrchr(value, ':');
+                if (colon == nullptr)
+                {
+                    return false;
+                }
+                options.host.assign(value, colon);
+                options.port = static_cast<uint16_t>(std::atoi(colon + 1));
+            }
+            else if (name == "--port")
+            {
+                options.port = static_cast<uint16_t>(std::atoi(value));
+            }
+            else if (name == "--threads")
+            {
+                options.num_threads = std::atoi(value);
+            }
+            else if (name == "--workers")
+            {
+                options.num_workers = std::atoi(value);
+            }
+            else if (name == "--timeout")
+            {
+                options.timeout_seconds = std::atoi(value);
+            }
+            else if (name == "--bucket")
+            {
+                options.bucket_size = std::atoi(value);
+            }
+            else if (name == "--fail-after")
+            {
+                options.fail_after = std::atoi(value);
+            }
+            else if (name == "--output")
+            {
+                options.output = value;
+            }
+            else if (name == "--width")
+            {
+                options.job.width = std::atoi(value);
+            }
+            else if (name == "--height")
+            {
+                options.job.height = std::atoi(value);
+            }
+            else if (name == "--samples")
+            {
+                options.job.samples = std::atoi(value);
+            }
+            else if (name == "--error")
+            {
+                options.job.error_threshold = static_cast<float>(std::atof(value));
+            }
+            else if (name == "--bounces")
+            {
+                options.job.max_bounces = std::atoi(value);
+            }
+            else if (name == "--mesh")
+            {
+                if (std::strlen(value) >= std::size(options.job.mesh))
+                {
+                    return false;
+                }
+                std::strcpy(options.job.mesh, value);
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return !options.worker || (options.port != 0);
+    }
+} // namespace
+
+// Renders one frame of the CPU renderer with several processes, on this machine or others. The coordinator hands out the buckets
+// of the frame over TCP and puts the tiles that come back together, the workers render them.
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << Usage;
+        return 1;
+    }
+
+    try
+    {
+        WinsockScope winsock;
+
+        if (options.worker)
+        {
+            FarmWorker worker(options.host, options.port, options.num_threads, options.fail_after);
+            return worker.Run();
+        }
+
+        FarmCoordinator coordinator(options.job, options.bucket_size, options.port, options.timeout_seconds);
+        std::cout << "Listening on port " << coordinator.Port() << ".\n";
+        coordinator.SpawnWorkers(options.num_workers, options.fail_after);
+
+        auto const start = std::chrono::steady_clock::now();
+        std::vector<uint8_t> const frame = coordinator.Run();
+        std::chrono::duration<double> const seconds = std::chrono::steady_clock::now() - start;
+
+        SaveTexture(frame.data(), options.job.width, options.job.height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, options.output);
+        std::cout << coordinator.NumBuckets() << " buckets from " << coordinator.NumWorkers() << " workers in " << seconds.count()
+                  << " s, saved to " << options.output << ".\n";
+        return 0;
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#ifndef _CRT_SECURE_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+// Before windows.h, which would pull in the old winsock.h otherwise
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+
+#include <d3d12.h>
+
+#include <DirectXMath.h>
+
+#include <GoldenSun/GoldenSun.hpp>
@@ -4,14 +4,20 @@
 
 #include <GoldenSun/ErrorHandling.hpp>
 #include <GoldenSun/Util.hpp>
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <GoldenSun/Uuid.hpp>
+#endif
 
 #include <GoldenSun/TextureHelper.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <filesystem>
 #include <iostream>
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include "CompiledShaders/Comparator.h"
+#endif
 
 using namespace DirectX;
 using namespace testing;
@@ -42,15 +48,32 @@ namespace GoldenSun
 
     void TestEnvironment::TearDown()
     {
-        gpu_system_.WaitForGpu();
+#ifndef GOLDEN_SUN_HOST_ONLY
+        if (gpu_system_)
+        {
+            gpu_system_->WaitForGpu();
+        }
+#endif
+    }
+
+#ifndef GOLDEN_SUN_HOST_ONLY
+    GpuSystem& TestEnvironment::GpuSystem()
+    {
+        if (!gpu_system_)
+        {
+            gpu_system_ = std::make_unique<GoldenSun::GpuSystem>();
+        }
+        return *gpu_system_;
     }
 
     GpuTexture2D TestEnvironment::CloneTexture(GpuTexture2D& texture)
     {
-        GpuTexture2D ret = gpu_system_.CreateTexture2D(
+        auto& gpu_system = this->GpuSystem();
+
+        GpuTexture2D ret = gpu_system.CreateTexture2D(
             texture.Width(0), texture.Height(0), texture.MipLevels(), texture.Format(), texture.Flags(), D3D12_RESOURCE_STATE_COPY_DEST);
 
-        auto cmd_list = gpu_system_.CreateCommandList();
+        auto cmd_list = gpu_system.CreateCommandList();
 
         auto src_old_state = texture.State(0);
         texture.Transition(cmd_list, D3D12_RESOURCE_STATE_GENERIC_READ);
@@ -60,7 +83,7 @@ namespace GoldenSun
         texture.Transition(cmd_list, src_old_state);
         ret.Transition(cmd_list, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 
-        gpu_system_.Execute(std::move(cmd_list));
+        gpu_system.Execute(std::move(cmd_list));
 
         return ret;
     }
@@ -68,6 +91,8 @@ namespace GoldenSun
     TestEnvironment::CompareResult TestEnvironment::CompareImages(
         GpuTexture2D& expected_image, GpuTexture2D& actual_image, float channel_tolerance)
     {
+        auto& gpu_system = this->GpuSystem();
+
         TestEnvironment::CompareResult ret{};
 
         if ((expected_image.Width(0) != actual_image.Width(0)) || (expected_image.Height(0) != actual_image.Height(0)))
@@ -81,16 +106,16 @@ namespace GoldenSun
 
         if (!ret.size_unmatch && !ret.format_unmatch)
         {
-            ret.error_image = gpu_system_.CreateTexture2D(expected_image.Width(0), expected_image.Height(0), 1, DXGI_FORMAT_R8G8B8A8_UNORM,
+            ret.error_image = gpu_system.CreateTexture2D(expected_image.Width(0), expected_image.Height(0), 1, DXGI_FORMAT_R8G8B8A8_UNORM,
                 D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"ErrorImage");
 
-            auto channel_error_buff = gpu_system_.CreateDefaultBuffer(
+            auto channel_error_buff = gpu_system.CreateDefaultBuffer(
                 sizeof(XMUINT4), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, L"ChannelErrorBuffer");
-            auto channel_error_cpu_buff = gpu_system_.CreateReadbackBuffer(sizeof(XMUINT4), L"ChannelErrorCpuBuffer");
+            auto channel_error_cpu_buff = gpu_system.CreateReadbackBuffer(sizeof(XMUINT4), L"ChannelErrorCpuBuffer");
 
             // expected_image, actual_image, result_image, error_buffer
-            auto desc_block = gpu_system_.AllocCbvSrvUavDescBlock(4);
-            uint32_t const descriptor_size = gpu_system_.CbvSrvUavDescSize();
+            auto desc_block = gpu_system.AllocCbvSrvUavDescBlock(4);
+            uint32_t const descriptor_size = gpu_system.CbvSrvUavDescSize();
 
             auto const cpu_desc_handle_base = desc_block.CpuHandle();
             auto const gpu_desc_handle_base = desc_block.GpuHandle();
@@ -98,10 +123,10 @@ namespace GoldenSun
             auto const expected_srv_gpu_desc_handle = OffsetHandle(gpu_desc_handle_base, 0, descriptor_size);
             auto const result_uav_cpu_desc_handle = OffsetHandle(gpu_desc_handle_base, 2, descriptor_size);
 
-            gpu_system_.CreateShaderResourceView(expected_image, OffsetHandle(cpu_desc_handle_base, 0, descriptor_size));
-            gpu_system_.CreateShaderResourceView(actual_image, OffsetHandle(cpu_desc_handle_base, 1, descriptor_size));
-            gpu_system_.CreateUnorderedAccessView(ret.error_image, OffsetHandle(cpu_desc_handle_base, 2, descriptor_size));
-            gpu_system_.CreateUnorderedAccessView(
+            gpu_system.CreateShaderResourceView(expected_image, OffsetHandle(cpu_desc_handle_base, 0, descriptor_size));
+            gpu_system.CreateShaderResourceView(actual_image, OffsetHandle(cpu_desc_handle_base, 1, descriptor_size));
+            gpu_system.CreateUnorderedAccessView(ret.error_image, OffsetHandle(cpu_desc_handle_base, 2, descriptor_size));
+            gpu_system.CreateUnorderedAccessView(
                 channel_error_buff, 0, 1, sizeof(XMUINT4), OffsetHandle(cpu_desc_handle_base, 3, descriptor_size));
 
             struct ComparatorConstantBuffer
@@ -110,14 +135,14 @@ namespace GoldenSun
                 float channel_tolerance;
             };
 
-            ConstantBuffer<ComparatorConstantBuffer> comparator_cb(gpu_system_, 1, L"ComparatorCb");
+            ConstantBuffer<ComparatorConstantBuffer> comparator_cb(gpu_system, 1, L"ComparatorCb");
             {
                 comparator_cb->width_height = {expected_image.Width(0), expected_image.Height(0)};
                 comparator_cb->channel_tolerance = channel_tolerance;
                 comparator_cb.UploadToGpu();
             }
 
-            auto* d3d12_device = gpu_system_.NativeDeviceHandle<D3D12Traits>();
+            auto* d3d12_device = gpu_system.NativeDeviceHandle<D3D12Traits>();
 
             ComPtr<ID3D12RootSignature> root_sig;
             {
@@ -164,7 +189,7 @@ namespace GoldenSun
                 TIFHR(d3d12_device->CreateComputePipelineState(&pso_desc, UuidOf<ID3D12PipelineState>(), pso.PutVoid()));
             }
 
-            auto cmd_list = gpu_system_.CreateCommandList();
+            auto cmd_list = gpu_system.CreateCommandList();
             auto* d3d12_cmd_list = cmd_list.NativeHandle<D3D12Traits>();
 
             d3d12_cmd_list->SetComputeRootSignature(root_sig.Get());
@@ -188,8 +213,8 @@ namespace GoldenSun
 
             cmd_list.Copy(channel_error_cpu_buff, channel_error_buff);
 
-            gpu_system_.Execute(std::move(cmd_list));
-            gpu_system_.WaitForGpu();
+            gpu_system.Execute(std::move(cmd_list));
+            gpu_system.WaitForGpu();
 
             uint32_t channel_errors[4];
             memcpy(channel_errors, channel_error_cpu_buff.MappedData<uint32_t>(), sizeof(XMUINT4));
@@ -211,7 +236,7 @@ namespace GoldenSun
                 ret.error_image.Reset();
             }
 
-            gpu_system_.DeallocCbvSrvUavDescBlock(std::move(desc_block));
+            gpu_system.DeallocCbvSrvUavDescBlock(std::move(desc_block));
         }
 
         return ret;
@@ -219,25 +244,20 @@ namespace GoldenSun
 
     void TestEnvironment::CompareWithExpected(std::string const& expected_name, GpuTexture2D& actual_image, float channel_tolerance)
     {
-        auto expected_image = LoadTexture(gpu_system_, expected_dir_ + expected_name + ".png", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+        auto& gpu_system = this->GpuSystem();
 
-        {
-            std::filesystem::path leaf_dir = result_dir_ + expected_name;
-            leaf_dir = leaf_dir.parent_path();
-            if (!std::filesystem::exists(leaf_dir))
-            {
-                std::filesystem::create_directory(leaf_dir);
-            }
-        }
+        auto expected_image = LoadTexture(gpu_system, expected_dir_ + expected_name + ".png", DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+        this->CreateResultDir(expected_name);
 
         if (expected_image)
         {
             auto result = this->CompareImages(expected_image, actual_image, channel_tolerance);
             if (result.error_image)
             {
-                SaveTexture(gpu_system_, expected_image, result_dir_ + expected_name + "_expected.png");
-                SaveTexture(gpu_system_, actual_image, result_dir_ + expected_name + "_actual.png");
-                SaveTexture(gpu_system_, result.error_image, result_dir_ + expected_name + "_diff.png");
+                SaveTexture(gpu_system, expected_image, result_dir_ + expected_name + "_expected.png");
+                SaveTexture(gpu_system, actual_image, result_dir_ + expected_name + "_actual.png");
+                SaveTexture(gpu_system, result.error_image, result_dir_ + expected_name + "_diff.png");
             }
 
             EXPECT_FALSE(result.format_unmatch);
@@ -254,7 +274,114 @@ namespace GoldenSun
         {
             std::string const expected_file = result_dir_ + expected_name + ".png";
             std::cout << "Saving expected image to " << expected_file << '\n';
-            SaveTexture(gpu_system_, actual_image, expected_file.c_str());
+            SaveTexture(gpu_system, actual_image, expected_file.c_str());
+        }
+    }
+#endif
+
+    TestEnvironment::HostCompareResult TestEnvironment::CompareImages(uint8_t const* expected_data, uint8_t const* actual_data,
+        uint32_t width, uint32_t height, DXGI_FORMAT format, float channel_tolerance)
+    {
+        TestEnvironment::HostCompareResult ret{};
+
+        // Like the Comparator shader reads them, sRGB channels in linear space. Alpha is always linear.
+        float to_float[2][256];
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            float const value = i / 255.0f;
+            to_float[0][i] = value;
+            to_float[1][i] = IsSrgbFormat(format) ? XMVectorGetX(XMColorSRGBToRGB(XMVectorReplicate(value))) : value;
+        }
+
+        std::vector<uint8_t> error_image(width * height * 4);
+        bool match = true;
+        for (uint32_t i = 0; i < width * height * 4; ++i)
+        {
+            uint32_t const channel = i % 4;
+            auto const& channel_to_float = to_float[channel < 3];
+
+            float diff = std::abs(channel_to_float[expected_data[i]] - channel_to_float[actual_data[i]]);
+            ret.max_channel_error = std::max(ret.max_channel_error, diff);
+            if (diff < channel_tolerance)
+            {
+                diff = 0;
+            }
+            else if (diff > 0)
+            {
+                match = false;
+            }
+
+            error_image[i] = static_cast<uint8_t>(diff * 255 + 0.5f);
+            ret.channel_errors[channel] += diff;
+        }
+
+        if (!match)
+        {
+            ret.error_image = std::move(error_image);
+        }
+
+        return ret;
+    }
+
+    void TestEnvironment::CompareWithExpected(std::string const& expected_name, void const* actual_data, uint32_t width,
+        uint32_t height, DXGI_FORMAT format, float channel_tolerance)
+    {
+        uint32_t expected_width;
+        uint32_t expected_height;
+        auto const expected_image = LoadTexture(expected_dir_ + expected_name + ".png", expected_width, expected_height);
+
+        if (expected_image.empty())
+        {
+            this->CreateResultDir(expected_name);
+
+            std::string const expected_file = result_dir_ + expected_name + ".png";
+            std::cout << "Saving expected image to " << expected_file << '\n';
+            SaveTexture(actual_data, width, height, format, expected_file);
+
+            ADD_FAILURE() << "No expected image " << expected_name << ".png";
+            return;
+        }
+
+        EXPECT_EQ(expected_width, width);
+        EXPECT_EQ(expected_height, height);
+        if ((expected_width == width) && (expected_height == height))
+        {
+            this->CompareWithImage(expected_name, expected_image.data(), actual_data, width, height, format, channel_tolerance);
+        }
+    }
+
+    void TestEnvironment::CompareWithImage(std::string const& result_name, void const* expected_data, void const* actual_data,
+        uint32_t width, uint32_t height, DXGI_FORMAT format, float channel_tolerance)
+    {
+        auto const result = this->CompareImages(static_cast<uint8_t const*>(expected_data), static_cast<uint8_t const*>(actual_data),
+            width, height, format, channel_tolerance);
+        // So the tolerance a test passes with is a measured one
+        std::cout << result_name << ": max channel error " << result.max_channel_error * 255 << "/255, tolerance "
+                  << channel_tolerance * 255 << "/255\n";
+        if (!result.error_image.empty())
+        {
+            this->CreateResultDir(result_name);
+
+            SaveTexture(expected_data, width, height, format, result_dir_ + result_name + "_expected.png");
+            SaveTexture(actual_data, width, height, format, result_dir_ + result_name + "_actual.png");
+            SaveTexture(result.error_image.data(), width, height, DXGI_FORMAT_R8G8B8A8_UNORM, result_dir_ + result_name + "_diff.png");
+        }
+
+        EXPECT_LT(result.channel_errors[0], 1e-6f);
+        EXPECT_LT(result.channel_errors[1], 1e-6f);
+        EXPECT_LT(result.channel_errors[2], 1e-6f);
+        EXPECT_LT(result.channel_errors[3], 1e-6f);
+
+        EXPECT_TRUE(result.error_image.empty());
+    }
+
+    void TestEnvironment::CreateResultDir(std::string const& result_name)
+    {
+        std::filesystem::path leaf_dir = result_dir_ + result_name;
+        leaf_dir = leaf_dir.parent_path();
+        if (!std::filesystem::exists(leaf_dir))
+        {
+            std::filesystem::create_directory(leaf_dir);
         }
     }
 } // namespace GoldenSun
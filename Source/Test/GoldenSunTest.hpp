@@ -1,6 +1,12 @@
 #pragma once
 
+#ifndef GOLDEN_SUN_HOST_ONLY
 #include <GoldenSun/Gpu/GpuSystem.hpp>
+#endif
+
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -22,10 +28,9 @@ namespace GoldenSun
             return expected_dir_;
         }
 
-        GpuSystem& GpuSystem() noexcept
-        {
-            return gpu_system_;
-        }
+#ifndef GOLDEN_SUN_HOST_ONLY
+        // Created on first use, so tests of the CPU renderer run on machines without a D3D12 device
+        GpuSystem& GpuSystem();
 
         GpuTexture2D CloneTexture(GpuTexture2D& texture);
 
@@ -40,13 +45,38 @@ namespace GoldenSun
         CompareResult CompareImages(GpuTexture2D& expected_image, GpuTexture2D& actual_image, float channel_tolerance);
 
         void CompareWithExpected(std::string const& expected_name, GpuTexture2D& actual_image, float channel_tolerance = 2 / 255.0f);
+#endif
+
+        // Host versions, on the CPU. Images are 8-bit RGBA, compared like the Comparator shader does, sRGB formats in linear space.
+        // A missing expected image is a failure, the actual one is saved to Result/ to review and copy to Expected/.
+        struct HostCompareResult
+        {
+            float channel_errors[4];
+            // Largest difference of any channel, tolerance or not
+            float max_channel_error;
+
+            std::vector<uint8_t> error_image;
+        };
+        HostCompareResult CompareImages(uint8_t const* expected_data, uint8_t const* actual_data, uint32_t width, uint32_t height,
+            DXGI_FORMAT format, float channel_tolerance);
+
+        void CompareWithExpected(std::string const& expected_name, void const* actual_data, uint32_t width, uint32_t height,
+            DXGI_FORMAT format, float channel_tolerance = 2 / 255.0f);
+        // For a render that has to look like another one of the same run. result_name names the images saved when they don't.
+        void CompareWithImage(std::string const& result_name, void const* expected_data, void const* actual_data, uint32_t width,
+            uint32_t height, DXGI_FORMAT format, float channel_tolerance = 2 / 255.0f);
+
+    private:
+        void CreateResultDir(std::string const& result_name);
 
     private:
         std::string asset_dir_;
         std::string expected_dir_;
         std::string result_dir_;
 
-        GoldenSun::GpuSystem gpu_system_;
+#ifndef GOLDEN_SUN_HOST_ONLY
+        std::unique_ptr<GoldenSun::GpuSystem> gpu_system_;
+#endif
     };
 
     TestEnvironment& TestEnv();
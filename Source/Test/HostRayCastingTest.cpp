@@ -0,0 +1,701 @@
+#include "pch.hpp"
+
+#include "GoldenSunTest.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include <GoldenSun/MeshHelper.hpp>
+#include <GoldenSun/Util.hpp>
+
+using namespace DirectX;
+using namespace GoldenSun;
+
+namespace
+{
+    // The view of the RayCastingTest scenes, except Transparent
+    Camera MakeCamera()
+    {
+        Camera camera;
+        camera.Eye() = {2.0f, 2.0f, -5.0f};
+        camera.LookAt() = {0.0f, 0.0f, 0.0f};
+        camera.Up() = {0.0f, 1.0f, 0.0f};
+        camera.Fov() = XMConvertToRadians(45);
+        camera.NearPlane() = 0.1f;
+        camera.FarPlane() = 20;
+        return camera;
+    }
+
+    // The white cube of RayCastingTest/SingleObject, at the origin
+    std::vector<Mesh> MakeCubeMesh()
+    {
+        Vertex const cube_vertices[] = {
+            {{-1.0f, +1.0f, -1.0f}, {+0.880476236f, +0.115916885f, -0.279848129f, -0.364705175f}, {-1.0f, +1.0f}},
+            {{+1.0f, +1.0f, -1.0f}, {+0.880476236f, -0.115916885f, +0.279848129f, -0.364705175f}, {+1.0f, +1.0f}},
+            {{+1.0f, +1.0f, +1.0f}, {-0.364705175f, +0.279848129f, -0.115916885f, +0.880476236f}, {+1.0f, +1.0f}},
+            {{-1.0f, +1.0f, +1.0f}, {-0.364705175f, -0.279848129f, +0.115916885f, +0.880476236f}, {-1.0f, +1.0f}},
+
+            {{-1.0f, -1.0f, -1.0f}, {-0.880476236f, +0.115916885f, +0.279848129f, -0.364705175f}, {-1.0f, -1.0f}},
+            {{+1.0f, -1.0f, -1.0f}, {-0.880476236f, -0.115916885f, -0.279848129f, -0.364705175f}, {+1.0f, -1.0f}},
+            {{+1.0f, -1.0f, +1.0f}, {+0.364705175f, +0.279848129f, +0.115916885f, +0.880476236f}, {+1.0f, -1.0f}},
+            {{-1.0f, -1.0f, +1.0f}, {+0.364705175f, -0.279848129f, -0.115916885f, +0.880476236f}, {-1.0f, -1.0f}},
+        };
+
+        Index const cube_indices[] = {
+            3, 1, 0, 2, 1, 3, 6, 4, 5, 7, 4, 6, 3, 4, 7, 0, 4, 3, 1, 6, 5, 2, 6, 1, 0, 5, 4, 1, 5, 0, 2, 7, 6, 3, 7, 2};
+
+        PbrMaterial mtl;
+        mtl.Albedo() = {1.0f, 1.0f, 1.0f};
+
+        std::vector<Mesh> meshes;
+        auto& mesh = meshes.emplace_back(DXGI_FORMAT_R32G32B32_FLOAT, static_cast<uint32_t>(sizeof(Vertex)), DXGI_FORMAT_R16_UINT,
+            static_cast<uint32_t>(sizeof(uint16_t)));
+        mesh.AddMaterial(mtl);
+        mesh.AddPrimitive(cube_vertices, static_cast<uint32_t>(std::size(cube_vertices)), cube_indices,
+            static_cast<uint32_t>(std::size(cube_indices)), 0);
+
+        MeshInstance instance;
+        XMStoreFloat4x4(&instance.transform, XMMatrixIdentity());
+        mesh.AddInstance(std::move(instance));
+
+        return meshes;
+    }
+
+    // The yellow light of RayCastingTest/SingleObject
+    PointLight MakeCubeLight()
+    {
+        PointLight light;
+        light.Position() = {-2.0f, 1.8f, -3.0f};
+        light.Color() = {1.0f * XM_PI, 0.8f * XM_PI, 0.0f * XM_PI};
+        light.Falloff() = {1, 0, 0};
+        light.Shadowing() = false;
+        return light;
+    }
+
+    // The scene of RayCastingTest/SingleObject, but the render target
+    void SetupCubeScene(Engine& engine, std::vector<Mesh> const& meshes)
+    {
+        engine.Camera(MakeCamera());
+
+        PointLight const light = MakeCubeLight();
+        engine.Lights(&light, 1);
+
+        engine.Meshes(meshes.data(), static_cast<uint32_t>(meshes.size()));
+    }
+
+    // The two DamagedHelmet instances of RayCastingTest/MeshShadowed, next to the one the asset places at the origin
+    std::vector<Mesh> LoadHelmetMeshes()
+    {
+        auto meshes = LoadMesh(TestEnv().AssetDir() + "DamagedHelmet/DamagedHelmet.gltf");
+        for (auto& mesh : meshes)
+        {
+            MeshInstance instance;
+            XMStoreFloat4x4(&instance.transform,
+                XMLoadFloat4x4(&mesh.Instance(0).transform) * XMMatrixRotationY(0.4f) * XMMatrixTranslation(-1.8f, 0.5f, 0));
+            mesh.AddInstance(std::move(instance));
+
+            XMStoreFloat4x4(&instance.transform, XMLoadFloat4x4(&mesh.Instance(0).transform) * XMMatrixScaling(0.8f, 0.8f, 0.8f) *
+                                                     XMMatrixRotationY(-0.8f) * XMMatrixTranslation(+1.8f, 0, 0));
+            mesh.AddInstance(std::move(instance));
+        }
+        return meshes;
+    }
+
+    // The shadowing green light and the red one of RayCastingTest/MeshShadowed, in that order
+    std::vector<PointLight> MakeHelmetLights()
+    {
+        std::vector<PointLight> lights;
+
+        auto& light0 = lights.emplace_back();
+        light0.Position() = {2.0f, 0.0f, -2.0f};
+        light0.Color() = {15.0f * XM_PI, 18.0f * XM_PI, 15.0f * XM_PI};
+        light0.Falloff() = {1, 0, 1};
+        light0.Shadowing() = true;
+
+        auto& light1 = lights.emplace_back();
+        light1.Position() = {-2.0f, 1.8f, -3.0f};
+        light1.Color() = {15.0f * XM_PI, 4.5f * XM_PI, 4.5f * XM_PI};
+        light1.Falloff() = {1, 0, 1};
+        light1.Shadowing() = false;
+
+        return lights;
+    }
+
+    // The scene of RayCastingTest/MeshShadowed, but the render target
+    void SetupHelmetScene(Engine& engine, std::vector<Mesh> const& meshes,
+        Engine::BuildPreference build_preference = Engine::BuildPreference::FastTrace)
+    {
+        engine.Camera(MakeCamera());
+
+        std::vector<PointLight> const lights = MakeHelmetLights();
+        engine.Lights(lights.data(), static_cast<uint32_t>(lights.size()));
+
+        engine.Meshes(meshes.data(), static_cast<uint32_t>(meshes.size()), build_preference);
+    }
+} // namespace
+
+class HostRayCastingTest : public testing::Test
+{
+public:
+    void SetUp() override
+    {
+        golden_sun_engine_ = Engine(0);
+    }
+
+protected:
+    // On the CPU, so these tests don't need a GPU. Scenes with the glTF assets are held to the images of the DXR pipeline, which the
+    // CPU renderer mirrors. The others have images of their own in HostRayCastingTest/.
+    void CompareHostOutputWithExpected(std::string const& expected_name, uint32_t width, uint32_t height, DXGI_FORMAT format)
+    {
+        TestEnv().CompareWithExpected(expected_name, golden_sun_engine_.HostOutput(), width, height, format);
+    }
+
+    // The baseline of a test that renders the same scene another way, and holds the output to it
+    std::vector<uint8_t> CopyHostOutput(uint32_t width, uint32_t height, DXGI_FORMAT format)
+    {
+        auto const* output = static_cast<uint8_t const*>(golden_sun_engine_.HostOutput());
+        return std::vector<uint8_t>(output, output + width * height * FormatSize(format));
+    }
+    void CompareHostOutputWithImage(std::string const& result_name, std::vector<uint8_t> const& expected, uint32_t width,
+        uint32_t height, DXGI_FORMAT format, float channel_tolerance)
+    {
+        TestEnv().CompareWithImage(
+            result_name, expected.data(), golden_sun_engine_.HostOutput(), width, height, format, channel_tolerance);
+    }
+
+protected:
+    Engine golden_sun_engine_;
+};
+
+TEST_F(HostRayCastingTest, SingleObject)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = MakeCubeMesh();
+    SetupCubeScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Render(nullptr);
+
+    EXPECT_EQ(golden_sun_engine_.Output(), nullptr);
+    this->CompareHostOutputWithExpected("HostRayCastingTest/SingleObject", 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+}
+
+TEST_F(HostRayCastingTest, MeshShadowed)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = LoadHelmetMeshes();
+    SetupHelmetScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Render(nullptr);
+
+    this->CompareHostOutputWithExpected("RayCastingTest/MeshShadowed", 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+}
+
+TEST_F(HostRayCastingTest, MeshShadowedFastBuild)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = LoadHelmetMeshes();
+    SetupHelmetScene(golden_sun_engine_, meshes, Engine::BuildPreference::FastTrace);
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    golden_sun_engine_.Meshes(meshes.data(), static_cast<uint32_t>(meshes.size()), Engine::BuildPreference::FastBuild);
+    golden_sun_engine_.Render(nullptr);
+
+    // The tree is different, the closest hits are not. Only a tie between two triangles on an edge may go the other way.
+    this->CompareHostOutputWithImage(
+        "HostRayCastingTest/MeshShadowedFastBuild", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 2 / 255.0f);
+}
+
+TEST_F(HostRayCastingTest, MeshShadowedSpatialSplits)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = LoadHelmetMeshes();
+    SetupHelmetScene(golden_sun_engine_, meshes, Engine::BuildPreference::FastTrace);
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    golden_sun_engine_.Meshes(meshes.data(), static_cast<uint32_t>(meshes.size()), Engine::BuildPreference::FastTraceSpatialSplits);
+    golden_sun_engine_.Render(nullptr);
+
+    // Triangles referenced from several leaves must still give the same closest hits, up to ties on shared edges
+    this->CompareHostOutputWithImage(
+        "HostRayCastingTest/MeshShadowedSpatialSplits", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 2 / 255.0f);
+}
+
+TEST_F(HostRayCastingTest, Transparent)
+{
+    auto& test_env = TestEnv();
+
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    {
+        Camera camera;
+        camera.Eye() = {0.0f, 1.0f, -5.0f};
+        camera.LookAt() = {0.0f, 0.5f, 0.0f};
+        camera.Up() = {0.0f, 1.0f, 0.0f};
+        camera.Fov() = XMConvertToRadians(45);
+        camera.NearPlane() = 0.1f;
+        camera.FarPlane() = 20;
+
+        golden_sun_engine_.Camera(camera);
+    }
+    {
+        std::vector<PointLight> lights;
+
+        auto& light0 = lights.emplace_back();
+        light0.Position() = {2.0f, 0.0f, -2.0f};
+        light0.Color() = {8.0f * XM_PI, 10.0f * XM_PI, 8.0f * XM_PI};
+        light0.Falloff() = {1, 0, 1};
+        light0.Shadowing() = true;
+
+        auto& light1 = lights.emplace_back();
+        light1.Position() = {-2.0f, 1.5f, -3.0f};
+        light1.Color() = {12.0f * XM_PI, 2.5f * XM_PI, 2.5f * XM_PI};
+        light1.Falloff() = {1, 0, 1};
+        light1.Shadowing() = true;
+
+        golden_sun_engine_.Lights(lights.data(), static_cast<uint32_t>(lights.size()));
+    }
+
+    auto meshes = LoadMesh(test_env.AssetDir() + "AlphaBlendModeTest/AlphaBlendModeTest.gltf");
+    for (auto& mesh : meshes)
+    {
+        XMStoreFloat4x4(&mesh.Instance(0).transform, XMLoadFloat4x4(&mesh.Instance(0).transform) * XMMatrixScaling(0.6f, 0.6f, 0.6f));
+    }
+    golden_sun_engine_.Meshes(meshes.data(), static_cast<uint32_t>(meshes.size()));
+
+    golden_sun_engine_.Render(nullptr);
+
+    this->CompareHostOutputWithExpected("RayCastingTest/Transparent", 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+}
+
+TEST_F(HostRayCastingTest, Accumulation)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = MakeCubeMesh();
+    SetupCubeScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Accumulation(true);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 0U);
+
+    // The first sample is at the pixel centers, the same as without accumulation
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 1U);
+    this->CompareHostOutputWithExpected("HostRayCastingTest/SingleObject", 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        golden_sun_engine_.Render(nullptr);
+    }
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 4U);
+
+    // Setting the same view and lights again keeps the samples
+    Camera camera = MakeCamera();
+    PointLight light = MakeCubeLight();
+    golden_sun_engine_.Camera(camera);
+    golden_sun_engine_.Lights(&light, 1);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 4U);
+
+    camera.Eye() = {2.0f, 2.0f, -6.0f};
+    golden_sun_engine_.Camera(camera);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 0U);
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 1U);
+
+    light.Color() = {0.5f * XM_PI, 0.8f * XM_PI, 0.0f * XM_PI};
+    golden_sun_engine_.Lights(&light, 1);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 0U);
+
+    golden_sun_engine_.Render(nullptr);
+    golden_sun_engine_.Meshes(meshes.data(), static_cast<uint32_t>(meshes.size()));
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 0U);
+
+    golden_sun_engine_.Render(nullptr);
+    golden_sun_engine_.Accumulation(false);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 0U);
+    golden_sun_engine_.Render(nullptr);
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 1U);
+}
+
+TEST_F(HostRayCastingTest, AdaptiveSampling)
+{
+    golden_sun_engine_.RenderTarget(256, 192, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = MakeCubeMesh();
+    SetupCubeScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Accumulation(true);
+
+    // Only the cap
+    golden_sun_engine_.AdaptiveSampling(0, 3);
+    for (uint32_t i = 0; i < 5; ++i)
+    {
+        EXPECT_FALSE(golden_sun_engine_.Converged());
+        golden_sun_engine_.Render(nullptr);
+        if (golden_sun_engine_.SampleCount() == 3)
+        {
+            break;
+        }
+    }
+    EXPECT_TRUE(golden_sun_engine_.Converged());
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 3U);
+
+    // The background and the faces converge long before the edges of the cube, which stop at the cap
+    uint32_t constexpr MaxSamples = 64;
+    golden_sun_engine_.AdaptiveSampling(0.05f, MaxSamples);
+    EXPECT_FALSE(golden_sun_engine_.Converged());
+    while (!golden_sun_engine_.Converged())
+    {
+        golden_sun_engine_.Render(nullptr);
+        ASSERT_LE(golden_sun_engine_.SampleCount(), MaxSamples);
+    }
+
+    // A restart samples every tile again
+    golden_sun_engine_.Lights(nullptr, 0);
+    EXPECT_FALSE(golden_sun_engine_.Converged());
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 0U);
+}
+
+TEST_F(HostRayCastingTest, Denoise)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = MakeCubeMesh();
+    SetupCubeScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Accumulation(true);
+    golden_sun_engine_.AdaptiveSampling(0, 1);
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    // The filter keeps the image close to its samples. It moves no channel by more than 28/255 in this scene.
+    golden_sun_engine_.Denoise(true);
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_TRUE(golden_sun_engine_.Converged());
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 1U);
+    this->CompareHostOutputWithImage("HostRayCastingTest/Denoise", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 32 / 255.0f);
+
+    // No new samples, but the output goes back to the samples as they are
+    golden_sun_engine_.Denoise(false);
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_EQ(golden_sun_engine_.SampleCount(), 1U);
+    this->CompareHostOutputWithImage("HostRayCastingTest/DenoiseOff", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0);
+}
+
+TEST_F(HostRayCastingTest, PathTracing)
+{
+    uint32_t constexpr Width = 1024;
+    uint32_t constexpr Height = 768;
+    golden_sun_engine_.RenderTarget(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, {1.0f, 1.0f, 1.0f, 1.0f});
+
+    auto const meshes = MakeCubeMesh();
+    SetupCubeScene(golden_sun_engine_, meshes);
+    golden_sun_engine_.Lights(nullptr, 0);
+
+    auto const center_texel = [this] {
+        uint8_t const* output = static_cast<uint8_t const*>(golden_sun_engine_.HostOutput());
+        return output + ((Height / 2) * Width + Width / 2) * 4;
+    };
+
+    // Direct lighting only leaves the ambient term without lights
+    golden_sun_engine_.Render(nullptr);
+    EXPECT_LT(center_texel()[0], 64);
+
+    // Every bounce off a convex white cube escapes to the white sky, so the cube is exactly white whatever the path
+    golden_sun_engine_.PathTracing(4);
+    golden_sun_engine_.Render(nullptr);
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        EXPECT_EQ(center_texel()[i], 255);
+    }
+}
+
+TEST_F(HostRayCastingTest, LightSampling)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = MakeCubeMesh();
+    SetupCubeScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    // With one light, the light BVH always picks it with a probability of 1, so the one light sample is the full direct lighting
+    golden_sun_engine_.LightSampling(1);
+    golden_sun_engine_.Render(nullptr);
+
+    EXPECT_EQ(golden_sun_engine_.Output(), nullptr);
+    this->CompareHostOutputWithImage("HostRayCastingTest/LightSampling", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0);
+}
+
+TEST_F(HostRayCastingTest, LightCulling)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = MakeCubeMesh();
+
+    std::vector<PointLight> lights;
+    lights.push_back(MakeCubeLight());
+
+    // Dim local lights well below the cube. Their spheres of influence don't reach it, and every bounce off the convex cube escapes
+    // to the sky, so the grid culls them at every vertex of every path. Shaded, all 4096 of them would add up to a few steps of the
+    // output.
+    for (uint32_t z = 0; z < 64; ++z)
+    {
+        for (uint32_t x = 0; x < 64; ++x)
+        {
+            auto& light = lights.emplace_back();
+            light.Position() = {x * 0.25f - 8, -6.0f, z * 0.25f - 8};
+            light.Color() = {0.001f, 0.001f, 0.001f};
+            light.Falloff() = {1, 0, 1};
+            light.Shadowing() = false;
+        }
+    }
+
+    // Direct lighting culls the same way as the path tracer
+    for (uint32_t const max_bounces : {0U, 2U})
+    {
+        SetupCubeScene(golden_sun_engine_, meshes);
+        golden_sun_engine_.PathTracing(max_bounces);
+        golden_sun_engine_.Render(nullptr);
+        std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+        golden_sun_engine_.Lights(lights.data(), static_cast<uint32_t>(lights.size()));
+        golden_sun_engine_.Render(nullptr);
+
+        EXPECT_EQ(golden_sun_engine_.Output(), nullptr);
+        this->CompareHostOutputWithImage("HostRayCastingTest/LightCulling", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0);
+    }
+}
+
+TEST_F(HostRayCastingTest, TextureLod)
+{
+    // Small, so the textures of the helmets are minified a lot
+    uint32_t constexpr Width = 256;
+    uint32_t constexpr Height = 192;
+    uint32_t constexpr NumReferenceSamples = 64;
+
+    golden_sun_engine_.RenderTarget(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = LoadHelmetMeshes();
+    SetupHelmetScene(golden_sun_engine_, meshes);
+
+    // The reference averages the texels under each pixel with many samples of the top mip
+    golden_sun_engine_.Accumulation(true);
+    for (uint32_t i = 0; i < NumReferenceSamples; ++i)
+    {
+        golden_sun_engine_.Render(nullptr);
+    }
+    std::vector<uint8_t> const reference = this->CopyHostOutput(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    // A single sample at the pixel centers, where the top mip aliases
+    golden_sun_engine_.Accumulation(false);
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const top_mip = this->CopyHostOutput(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    golden_sun_engine_.TextureLod(true);
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const filtered = this->CopyHostOutput(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const error = [&reference](std::vector<uint8_t> const& image) {
+        auto const result = TestEnv().CompareImages(reference.data(), image.data(), Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0);
+        return result.channel_errors[0] + result.channel_errors[1] + result.channel_errors[2];
+    };
+
+    // The mips the ray cones pick are prefiltered, so one sample of them lands closer to the reference
+    float const top_mip_error = error(top_mip);
+    float const filtered_error = error(filtered);
+    EXPECT_LT(filtered_error, top_mip_error);
+}
+
+TEST_F(HostRayCastingTest, TextureCache)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = LoadHelmetMeshes();
+    SetupHelmetScene(golden_sun_engine_, meshes);
+
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    // Every texture is read once, on its first hit
+    uint64_t const misses = golden_sun_engine_.TextureCacheMisses();
+    EXPECT_GT(misses, 0U);
+    EXPECT_GT(golden_sun_engine_.TextureCacheHits(), misses);
+
+    // A budget below any texture evicts them all, so the next frame reads them again. The texels read back are the same, and so is
+    // every pixel.
+    golden_sun_engine_.TextureCacheBudget(1);
+    golden_sun_engine_.TextureCacheBudget(0);
+    golden_sun_engine_.Render(nullptr);
+
+    EXPECT_EQ(golden_sun_engine_.TextureCacheMisses(), misses * 2);
+
+    this->CompareHostOutputWithImage("HostRayCastingTest/TextureCache", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0);
+}
+
+TEST_F(HostRayCastingTest, ThreadCountInvariance)
+{
+    uint32_t constexpr Width = 1024;
+    uint32_t constexpr Height = 768;
+
+    auto const meshes = LoadHelmetMeshes();
+
+    // Paths draw their random numbers from their pixel and sample, so how the tiles are spread over the threads can't show
+    auto render = [&meshes](uint32_t num_threads) {
+        Engine engine(num_threads);
+        engine.RenderTarget(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+        SetupHelmetScene(engine, meshes);
+        engine.Lights(MakeHelmetLights().data(), 1);
+
+        engine.Accumulation(true);
+        engine.PathTracing(3);
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            engine.Render(nullptr);
+        }
+
+        auto const* output = static_cast<uint8_t const*>(engine.HostOutput());
+        return std::vector<uint8_t>(output, output + Width * Height * 4);
+    };
+
+    std::vector<uint8_t> const expected = render(1);
+    for (uint32_t const num_threads : {2U, 3U, 0U})
+    {
+        EXPECT_TRUE(render(num_threads) == expected) << num_threads << " threads";
+    }
+}
+
+TEST_F(HostRayCastingTest, ScenePlacement)
+{
+    golden_sun_engine_.RenderTarget(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    auto const meshes = LoadHelmetMeshes();
+
+    // Where the scene lives can't change what the rays hit, so both placements give the same pixels
+    golden_sun_engine_.ScenePlacement(Engine::Placement::Replicated);
+    SetupHelmetScene(golden_sun_engine_, meshes);
+    golden_sun_engine_.Render(nullptr);
+    std::vector<uint8_t> const expected = this->CopyHostOutput(1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+    golden_sun_engine_.ScenePlacement(Engine::Placement::Interleaved);
+    golden_sun_engine_.Render(nullptr);
+    this->CompareHostOutputWithImage("HostRayCastingTest/ScenePlacement", expected, 1024, 768, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, 0);
+}
+
+TEST_F(HostRayCastingTest, Scissor)
+{
+    uint32_t constexpr Width = 1024;
+    uint32_t constexpr Height = 768;
+
+    auto const meshes = LoadHelmetMeshes();
+
+    auto render = [&meshes](Engine& engine, uint32_t left, uint32_t top, uint32_t right, uint32_t bottom) {
+        engine.RenderTarget(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+        SetupHelmetScene(engine, meshes);
+        engine.Lights(MakeHelmetLights().data(), 1);
+
+        engine.Accumulation(true);
+        engine.PathTracing(3);
+        engine.Scissor(left, top, right, bottom);
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            engine.Render(nullptr);
+        }
+        EXPECT_EQ(engine.SampleCount(), 2U);
+    };
+
+    render(golden_sun_engine_, 0, 0, 0, 0);
+    auto const* expected = static_cast<uint8_t const*>(golden_sun_engine_.HostOutput());
+
+    // Each quadrant in an engine of its own, the way separate processes would render them
+    std::vector<uint8_t> merged(Width * Height * 4);
+    for (uint32_t quadrant = 0; quadrant < 4; ++quadrant)
+    {
+        uint32_t const left = (quadrant % 2) * Width / 2;
+        uint32_t const top = (quadrant / 2) * Height / 2;
+
+        Engine engine(0);
+        render(engine, left, top, left + Width / 2, top + Height / 2);
+
+        auto const* output = static_cast<uint8_t const*>(engine.HostOutput());
+        for (uint32_t y = top; y < top + Height / 2; ++y)
+        {
+            std::memcpy(&merged[(y * Width + left) * 4], &output[(y * Width + left) * 4], Width / 2 * 4);
+        }
+
+        // The quadrant above or below it is never rendered, its pixels keep the 0 of a new render target
+        uint32_t const other_top = (top + Height / 2) % Height;
+        EXPECT_EQ(output[(other_top * Width + left) * 4 + 3], 0);
+    }
+
+    EXPECT_TRUE(std::memcmp(merged.data(), expected, merged.size()) == 0);
+}
+
+TEST_F(HostRayCastingTest, ScissorUnaligned)
+{
+    uint32_t constexpr Width = 1024;
+    uint32_t constexpr Height = 768;
+    uint32_t constexpr Split = 500;
+    uint32_t constexpr TileBegin = Split / 8 * 8;
+    uint32_t constexpr TileEnd = TileBegin + 8;
+
+    auto const meshes = LoadHelmetMeshes();
+
+    auto setup = [&meshes](Engine& engine) {
+        engine.RenderTarget(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+
+        SetupHelmetScene(engine, meshes);
+        engine.Lights(MakeHelmetLights().data(), 1);
+
+        engine.Accumulation(true);
+        engine.PathTracing(3);
+    };
+
+    setup(golden_sun_engine_);
+    std::vector<uint8_t> expected[2];
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        golden_sun_engine_.Render(nullptr);
+        if (i % 2 == 1)
+        {
+            expected[i / 2] = this->CopyHostOutput(Width, Height, DXGI_FORMAT_R8G8B8A8_UNORM_SRGB);
+        }
+    }
+
+    // The split cuts through a column of tiles. Both sides round out to whole tiles, so that column is rendered by both, and ends up
+    // with the 4 samples of the two renders of each side. All its pixels have them, the same as a full render of 4 samples.
+    Engine engine(0);
+    setup(engine);
+    for (uint32_t const left : {0U, Split})
+    {
+        engine.Scissor(left, 0, (left == 0) ? Split : Width, Height);
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            engine.Render(nullptr);
+        }
+    }
+
+    auto const* output = static_cast<uint8_t const*>(engine.HostOutput());
+    uint32_t num_wrong_rows = 0;
+    for (uint32_t y = 0; y < Height; ++y)
+    {
+        size_t const row = y * Width * 4;
+        if ((std::memcmp(&output[row], &expected[0][row], TileBegin * 4) != 0) ||
+            (std::memcmp(&output[row + TileBegin * 4], &expected[1][row + TileBegin * 4], (TileEnd - TileBegin) * 4) != 0) ||
+            (std::memcmp(&output[row + TileEnd * 4], &expected[0][row + TileEnd * 4], (Width - TileEnd) * 4) != 0))
+        {
+            ++num_wrong_rows;
+        }
+    }
+    EXPECT_EQ(num_wrong_rows, 0U);
+}